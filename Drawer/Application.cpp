@@ -1,6 +1,8 @@
 ﻿#include "Application.h"
 #include "picoc.h"
 #include <iostream>
+#include <cmath>
+#include <unordered_map>
 
 void Application::init()
 {
@@ -73,9 +75,12 @@ int Application::main()
 	sf::Vector2f dragMousePosition;
 	sf::FloatRect dragGraphRect = mGraphRect;
 	size_t dragPointIndex = 0;
+	Trace::nameThread("ui");
 
 	while (mWindow.isOpen())
 	{
+		TraceSpan frame("frame", "ui");
+
 		//***************************************************
 		// Events and inputs
 		//***************************************************
@@ -110,10 +115,34 @@ int Application::main()
 						mSourceCodeRedo.pop_front();
 					mSourceCode = mSourceCodeHistory.back();
 					mSourceDirty = true;
+					mLatency.edit();
 					mSourceCodeHistory.pop_back();
 					mMutex.unlock();
 					mSourceCodeEditBox->setText(mSourceCode);
 				}
+				// the performance HUD
+				if (event.key.code == sf::Keyboard::F3)
+				{
+					mShowLatency = !mShowLatency;
+				}
+				// a trace of the evaluations and the frames, from one press to the next
+				if (event.key.code == sf::Keyboard::F4)
+				{
+					sf::Lock lock(mMutex);
+					if (Trace::enabled())
+					{
+						Trace::stop();
+						mErrorMessage.setString("Saved trace.json");
+					}
+					else if (Trace::start("trace.json"))
+					{
+						mErrorMessage.setString("Tracing to trace.json, F4 to stop");
+					}
+					else
+					{
+						mErrorMessage.setString("Couldn't write trace.json");
+					}
+				}
 				//Redo
 				if (event.key.code == sf::Keyboard::Y && event.key.control && !mSourceCodeRedo.empty())
 				{
@@ -123,6 +152,7 @@ int Application::main()
 						mSourceCodeHistory.pop_front();
 					mSourceCode = mSourceCodeRedo.back();
 					mSourceDirty = true;
+					mLatency.edit();
 					mSourceCodeRedo.pop_back();
 					mMutex.unlock();
 					mSourceCodeEditBox->setText(mSourceCode);
@@ -202,6 +232,7 @@ int Application::main()
 					break;
 				}
 				mSourceDirty = true;
+				mLatency.edit();
 			}
 			else 
 			{
@@ -276,12 +307,27 @@ int Application::main()
 			{
 				char str[64];
 				sprintf_s(str, "(%g, %g)", mPoints[dragPointIndex].x, mPoints[dragPointIndex].y);
-				sf::Text text(str, *mGui.getFont(), 12);
-				text.setPosition(mousePosition);
-				mWindow.draw(text);
+				mOverlay.addText(str, mousePosition, 12);
 			}
 		}
 
+		if (mShowLatency)
+		{
+			showLatency();
+		}
+
+		// the labels and markers gathered while drawing the graph, all at once
+		mOverlay.draw(mWindow);
+
+		// the last evaluation's line profile, in the editor's gutter
+		mMutex.lock();
+		if (mLineProfileDirty)
+		{
+			mSourceCodeEditBox->setLineProfile(mLineHits, mLineShares);
+			mLineProfileDirty = false;
+		}
+		mMutex.unlock();
+
 		// Display messages
 		mMutex.lock();
 		mErrorMessage.setPosition(30.f, mWindow.getSize().y - 70.f);
@@ -300,9 +346,14 @@ int Application::main()
 		mGui.draw();
 
 		mWindow.popGLStates();
-		mWindow.display();
+		{
+			TraceSpan display("display", "ui");
+			mWindow.display();
+		}
+		mLatency.presented();
 	}
 
+	Trace::stop();
 	if (mThread)
 		mThread->detach();
 	return EXIT_SUCCESS;
@@ -311,7 +362,12 @@ int Application::main()
 void Application::execute()
 {
 	std::vector<sf::Vector2f> result2D;
+	std::vector<float> slopes2D;
+	std::vector<sf::Vector2f> ranges2D;
 	std::vector<sf::Vector3f> result3D;
+	std::vector<sf::Vector2f> gradients3D;
+	LineProfile lineProfile;
+	Trace::nameThread("evaluation");
 	
 	while (1)
 	{
@@ -320,47 +376,86 @@ void Application::execute()
 			std::this_thread::sleep_for(std::chrono::milliseconds(10));
 		}
 		mSourceDirty = false;
+		mLatency.dequeue();
+		TraceSpan evaluation("evaluate", "pipeline");
 
 		mMutex.lock();
 		enumCoordinate coordinate = mCoordinate;
 		mMutex.unlock();
 		int curveWidth = 0;
 
-		if (coordinate != THREE_D)
+		if (coordinate == IMPLICIT)
+		{
+			result2D.clear();
+			slopes2D.clear();
+			ranges2D.clear();
+			if (evaluateImplicit(result2D, lineProfile))
+			{
+				continue;
+			}
+			mLatency.sampled((int)result2D.size());
+		}
+		else if (coordinate != THREE_D)
 		{
 			result2D.clear();
-			if (evaluate2D(result2D, coordinate))
+			slopes2D.clear();
+			ranges2D.clear();
+			if (evaluate2D(result2D, slopes2D, ranges2D, coordinate, lineProfile))
 			{
 				continue;
 			}
+			mLatency.sampled((int)result2D.size());
 		}
 		else // 3D curve
 		{
 			result3D.clear();
-			if (evaluate3D(result3D, curveWidth))
+			gradients3D.clear();
+			if (evaluate3D(result3D, gradients3D, curveWidth, lineProfile))
 			{
 				continue;
 			}
+			mLatency.sampled((int)result3D.size());
+		}
+
+		double publishStart = Trace::now();
+		double profileTime = 0.0;
+		for (double time : lineProfile.Time)
+		{
+			profileTime += time;
+		}
+		std::vector<float> lineShares(lineProfile.Time.size());
+		for (size_t i = 0; i < lineShares.size(); i++)
+		{
+			lineShares[i] = profileTime > 0.0 ? (float)(lineProfile.Time[i] / profileTime) : 0.f;
 		}
 
 		mMutex.lock();
+		mLineHits = lineProfile.Hits;
+		mLineShares = lineShares;
+		mLineProfileDirty = true;
 		if (coordinate == mCoordinate)
 		{
 			if (coordinate != THREE_D)
 			{
 				mPoints2D = result2D;
+				mSlopes2D = slopes2D;
+				mRanges2D = ranges2D;
 			}
 			else // 3d curve
 			{
 				mPoints3D = result3D;
+				mGradients3D = gradients3D;
 				mCurveWidth = curveWidth;
+				mMeshDirty = true;
 			}
+			mLatency.mark(STAGE_PUBLISHED);
 		}
 		mMutex.unlock();
+		Trace::complete("publish", "pipeline", publishStart);
 	}
 }
 
-bool Application::evaluate2D(std::vector<sf::Vector2f>& result, enumCoordinate coordinate)
+bool Application::evaluate2D(std::vector<sf::Vector2f>& result, std::vector<float>& slopes, std::vector<sf::Vector2f>& ranges, enumCoordinate coordinate, LineProfile& profile)
 {
 	mMutex.lock();
 	float width = mGraphRect.width;
@@ -368,36 +463,80 @@ bool Application::evaluate2D(std::vector<sf::Vector2f>& result, enumCoordinate c
 	std::string buffer = mSourceCode;
 	int numPoint = mNumPoint2D;
 	std::vector<Tweakable> tweakables = mTweakables;
+	bool profiling = mProfile;
 	mMutex.unlock();
 
 	Picoc pc;
 	std::string errorBuffer;
 	double x;
 	PicocInitialise(&pc, &x, 1, buffer, tweakables, errorBuffer);
+	mLatency.mark(STAGE_INITIALISED);
+	profile = LineProfile();
+	if (profiling && errorBuffer.empty())
+	{
+		PicocProfile(pc, &profile);
+	}
 
 	if (errorBuffer.empty())
 	{
+		double batchStart = Trace::now();
+		std::vector<double> xs(numPoint);
+		std::vector<double> ys(numPoint);
 		for (int i = 0; i < numPoint; i++)
 		{
-			x = (double)i / numPoint;
-			mProgression = (float)x;
+			xs[i] = (double)i / numPoint;
 			if (coordinate == CARTESIAN)
 			{
-				x = x * width + start;
+				xs[i] = xs[i] * width + start;
 			}
 			else
 			{
-				x *= 6.283185307179586;
+				xs[i] *= 6.283185307179586;
 			}
+		}
 
-			float y = (float)PicocEvaluate(pc, 1, errorBuffer);
-			if (!errorBuffer.empty())
+		/* the whole curve at once when main can be evaluated over blocks of x, with its exact
+		 * slope too when it can be differentiated */
+		std::vector<double> dys(numPoint);
+		bool gradientDone = numPoint > 0 && coordinate == CARTESIAN && PicocEvaluateGradient(pc, &xs[0], &ys[0], &dys[0], NULL, numPoint);
+		bool vectorDone = gradientDone || (numPoint > 0 && PicocEvaluateVector(pc, &xs[0], &ys[0], numPoint));
+
+		/* bounds of the curve between each point and the next, which show the poles and spikes
+		 * falling between the points */
+		std::vector<double> xEnds(numPoint);
+		std::vector<double> yLows(numPoint);
+		std::vector<double> yHighs(numPoint);
+		for (int i = 0; i < numPoint; i++)
+		{
+			xEnds[i] = xs[i] + (double)width / numPoint;
+		}
+		bool rangeDone = numPoint > 0 && coordinate == CARTESIAN && PicocEvaluateInterval(pc, &xs[0], &xEnds[0], NULL, NULL, &yLows[0], &yHighs[0], numPoint);
+
+		for (int i = 0; i < numPoint; i++)
+		{
+			mProgression = (float)i / numPoint;
+			x = xs[i];
+
+			if (!vectorDone)
 			{
-				break;
+				ys[i] = PicocEvaluate(pc, 1, errorBuffer);
+				if (!errorBuffer.empty())
+				{
+					break;
+				}
 			}
 
-			result.push_back(sf::Vector2f((float)x, y));
+			result.push_back(sf::Vector2f((float)x, (float)ys[i]));
+			if (gradientDone)
+			{
+				slopes.push_back((float)dys[i]);
+			}
+			if (rangeDone)
+			{
+				ranges.push_back(sf::Vector2f((float)yLows[i], (float)yHighs[i]));
+			}
 		}
+		Trace::complete("sample batch", "pipeline", batchStart);
 	}
 	PicocCleanup(&pc);
 	mErrorMessage.setString(errorBuffer);
@@ -405,7 +544,7 @@ bool Application::evaluate2D(std::vector<sf::Vector2f>& result, enumCoordinate c
 	return !errorBuffer.empty();
 }
 
-bool Application::evaluate3D(std::vector<sf::Vector3f>& result, int& curveWidth)
+bool Application::evaluate3D(std::vector<sf::Vector3f>& result, std::vector<sf::Vector2f>& gradients, int& curveWidth, LineProfile& profile)
 {
 	mMutex.lock();
 	float width = mGraphRect.width;
@@ -413,31 +552,68 @@ bool Application::evaluate3D(std::vector<sf::Vector3f>& result, int& curveWidth)
 	std::string buffer = mSourceCode;
 	curveWidth = mNumPoint3D;
 	std::vector<Tweakable> tweakables = mTweakables;
+	bool profiling = mProfile;
 	mMutex.unlock();
 	
 	Picoc pc;
 	std::string errorBuffer;
 	double point[2];
 	PicocInitialise(&pc, point, 2, buffer, tweakables, errorBuffer);
+	mLatency.mark(STAGE_INITIALISED);
+	profile = LineProfile();
+	if (profiling && errorBuffer.empty())
+	{
+		PicocProfile(pc, &profile);
+	}
+
+	std::vector<double> ys(curveWidth);
+	std::vector<double> zs(curveWidth);
+	std::vector<double> dzdxs(curveWidth);
+	std::vector<double> dzdys(curveWidth);
+	bool exact = curveWidth > 0;
+	for (int j = 0; j < curveWidth; j++)
+	{
+		ys[j] = (double)j / (curveWidth - 1) * width + start;
+	}
 
 	for (int i = 0; i < curveWidth; i++)
 	{
-		double posX = (double)i / curveWidth;
+		TraceSpan row("sample row", "pipeline");
+		double posX = (double)i / (curveWidth - 1);
 		mProgression = (float)posX;
+		point[0] = posX * width + start;
+
+		PicocPrepareRow(pc, errorBuffer);
+		if (!errorBuffer.empty())
+		{
+			break;
+		}
+
+		/* the whole row at once when main can be evaluated over blocks of y. Differentiating it
+		 * as well gives the surface's exact slopes, which make its normals */
+		exact = exact && PicocEvaluateGradient(pc, &ys[0], &zs[0], &dzdys[0], &dzdxs[0], curveWidth);
+		bool vectorDone = exact || (curveWidth > 0 && PicocEvaluateVector(pc, &ys[0], &zs[0], curveWidth));
 
 		for (int j = 0; j < curveWidth; j++)
 		{
-			point[0] = posX * width + start;
-			double posY = (double)j / curveWidth;
-			point[1] = posY * width + start;
+			double posY = (double)j / (curveWidth - 1);
+			point[1] = ys[j];
 
-			float z = (float)PicocEvaluate(pc, 2, errorBuffer);
-			if (!errorBuffer.empty())
+			if (!vectorDone)
 			{
-				break;
+				zs[j] = PicocEvaluate(pc, 2, errorBuffer);
+				if (!errorBuffer.empty())
+				{
+					break;
+				}
 			}
 
-			result.push_back(sf::Vector3f((float)(posX-0.5f), (float)(posY-0.5f), z));
+			result.push_back(sf::Vector3f((float)(posX-0.5f), (float)(posY-0.5f), (float)zs[j]));
+			if (exact)
+			{
+				// by the grid's coordinates, which run over the width from 0 to 1
+				gradients.push_back(sf::Vector2f((float)(dzdxs[j] * width), (float)(dzdys[j] * width)));
+			}
 		}
 
 		if (!errorBuffer.empty())
@@ -447,10 +623,251 @@ bool Application::evaluate3D(std::vector<sf::Vector3f>& result, int& curveWidth)
 	}
 	PicocCleanup(&pc);
 	mErrorMessage.setString(errorBuffer);
+
+	if (!exact)
+	{
+		gradients.clear();
+	}
 	
 	return !errorBuffer.empty();
 }
 
+// the curve main(x, y) = 0 is found with a quadtree over the graph. Cells are split while the
+// curve may go through them, down to under a pixel, and marching squares draws it through the
+// smallest ones. A cell is dropped once main has the same sign at its corners, or straight away
+// when main can be bounded and its bounds over the cell don't hold 0
+bool Application::evaluateImplicit(std::vector<sf::Vector2f>& segments, LineProfile& profile)
+{
+	mMutex.lock();
+	sf::FloatRect rect = mGraphRect;
+	float screenSize = std::max(mGraphScreen.width, mGraphScreen.height);
+	std::string buffer = mSourceCode;
+	std::vector<Tweakable> tweakables = mTweakables;
+	bool profiling = mProfile;
+	mMutex.unlock();
+
+	Picoc pc;
+	std::string errorBuffer;
+	double point[2];
+	PicocInitialise(&pc, point, 2, buffer, tweakables, errorBuffer);
+	mLatency.mark(STAGE_INITIALISED);
+	profile = LineProfile();
+	if (profiling && errorBuffer.empty())
+	{
+		PicocProfile(pc, &profile);
+	}
+
+	if (errorBuffer.empty())
+	{
+		const int rootCells = 16;           // the tree starts from a grid of this many cells a side
+		const int minLevel = 2;             // and without bounds, isn't pruned on signs until split this often
+		const size_t maxCells = 1 << 16;    // beyond which a level's cells aren't split any further
+		int maxLevel = 0;
+		while (maxLevel < 12 && screenSize / (rootCells << maxLevel) > 1.f)
+		{
+			maxLevel++;
+		}
+
+		// cells and corners are numbered on the finest grid
+		const long long side = (long long)rootCells << maxLevel;
+		const double stepX = (double)rect.width / side;
+		const double stepY = (double)rect.height / side;
+		std::unordered_map<long long, double> values;
+		auto cornerKey = [side](const sf::Vector2i& cell, int size, int corner)
+		{
+			long long x = cell.x + ((corner == 1 || corner == 2) ? size : 0);
+			long long y = cell.y + ((corner >= 2) ? size : 0);
+			return x * (side + 1) + y;
+		};
+		std::vector<sf::Vector2i> cells;
+		std::vector<sf::Vector2i> split;
+		for (int i = 0; i < rootCells; i++)
+		{
+			for (int j = 0; j < rootCells; j++)
+			{
+				cells.push_back(sf::Vector2i(i << maxLevel, j << maxLevel));
+			}
+		}
+
+		std::vector<long long> pending;
+		std::vector<double> xs, ys, zs;
+		std::vector<double> xLows, xHighs, yLows, yHighs, lows, highs;
+		for (int level = 0; level <= maxLevel && !cells.empty(); level++)
+		{
+			TraceSpan batch("sample level", "pipeline");
+			mProgression = (float)level / (maxLevel + 1);
+			const int size = 1 << (maxLevel - level);
+
+			// main at the corners no cell has had yet, all at once when it can be
+			pending.clear();
+			for (const sf::Vector2i& cell : cells)
+			{
+				for (int corner = 0; corner < 4; corner++)
+				{
+					long long key = cornerKey(cell, size, corner);
+					if (values.emplace(key, 0.0).second)
+					{
+						pending.push_back(key);
+					}
+				}
+			}
+
+			xs.resize(pending.size());
+			ys.resize(pending.size());
+			zs.resize(pending.size());
+			for (size_t k = 0; k < pending.size(); k++)
+			{
+				xs[k] = rect.left + (pending[k] / (side + 1)) * stepX;
+				ys[k] = rect.top + (pending[k] % (side + 1)) * stepY;
+			}
+
+			if (!pending.empty() && !PicocEvaluatePoints(pc, &xs[0], &ys[0], &zs[0], (int)pending.size()))
+			{
+				for (size_t k = 0; k < pending.size() && errorBuffer.empty(); k++)
+				{
+					point[0] = xs[k];
+					point[1] = ys[k];
+					zs[k] = PicocEvaluate(pc, 2, errorBuffer);
+				}
+			}
+
+			if (!errorBuffer.empty())
+			{
+				break;
+			}
+
+			for (size_t k = 0; k < pending.size(); k++)
+			{
+				values[pending[k]] = zs[k];
+			}
+
+			// main's bounds over each cell
+			size_t count = cells.size();
+			xLows.resize(count); xHighs.resize(count);
+			yLows.resize(count); yHighs.resize(count);
+			lows.resize(count); highs.resize(count);
+			for (size_t k = 0; k < count; k++)
+			{
+				xLows[k] = rect.left + cells[k].x * stepX;
+				xHighs[k] = rect.left + (cells[k].x + size) * stepX;
+				yLows[k] = rect.top + cells[k].y * stepY;
+				yHighs[k] = rect.top + (cells[k].y + size) * stepY;
+			}
+			bool bounded = PicocEvaluateInterval(pc, &yLows[0], &yHighs[0], &xLows[0], &xHighs[0], &lows[0], &highs[0], (int)count);
+
+			// the cells the curve may go through
+			size_t kept = 0;
+			for (size_t k = 0; k < count; k++)
+			{
+				int signs = 0;
+				for (int corner = 0; corner < 4; corner++)
+				{
+					signs |= (values[cornerKey(cells[k], size, corner)] > 0.0) << corner;
+				}
+
+				// NaN bounds mean main has no value in the cell
+				if (bounded ? (lows[k] <= 0.0 && highs[k] >= 0.0) : (signs != 0 && signs != 15) || level < minLevel)
+				{
+					cells[kept] = cells[k];
+					lows[kept] = lows[k];
+					highs[kept] = highs[k];
+					kept++;
+				}
+			}
+			cells.resize(kept);
+
+			// split them all, or if there are too many march through them as they are
+			if (level < maxLevel && 4 * kept <= maxCells)
+			{
+				int half = size / 2;
+				split.clear();
+				for (const sf::Vector2i& cell : cells)
+				{
+					split.push_back(cell);
+					split.push_back(sf::Vector2i(cell.x + half, cell.y));
+					split.push_back(sf::Vector2i(cell.x, cell.y + half));
+					split.push_back(sf::Vector2i(cell.x + half, cell.y + half));
+				}
+				cells.swap(split);
+				continue;
+			}
+
+			for (size_t k = 0; k < kept; k++)
+			{
+				// unbounded across the smallest cell is a pole, where the sign flips without a curve
+				if (bounded && (std::isinf(lows[k]) || std::isinf(highs[k])))
+				{
+					continue;
+				}
+
+				double corners[4];
+				for (int corner = 0; corner < 4; corner++)
+				{
+					corners[corner] = values[cornerKey(cells[k], size, corner)];
+				}
+
+				sf::Vector2f origin((float)(rect.left + cells[k].x * stepX), (float)(rect.top + cells[k].y * stepY));
+				marchSquare(segments, origin, sf::Vector2f((float)(size * stepX), (float)(size * stepY)), corners);
+			}
+			break;
+		}
+	}
+	PicocCleanup(&pc);
+	mErrorMessage.setString(errorBuffer);
+
+	return !errorBuffer.empty();
+}
+
+// the segments of the curve through a cell from main's values at its corners, counterclockwise
+// from the origin. Corners are joined through the middle when they're opposite and alike
+void Application::marchSquare(std::vector<sf::Vector2f>& segments, const sf::Vector2f& origin, const sf::Vector2f& size, const double corners[4]) const
+{
+	static const sf::Vector2f offsets[4] = { sf::Vector2f(0.f, 0.f), sf::Vector2f(1.f, 0.f), sf::Vector2f(1.f, 1.f), sf::Vector2f(0.f, 1.f) };
+	sf::Vector2f crossings[4];
+	bool crossed[4];
+	int numCrossed = 0;
+	for (int edge = 0; edge < 4; edge++)
+	{
+		double a = corners[edge];
+		double b = corners[(edge + 1) % 4];
+		if (!std::isfinite(a) || !std::isfinite(b))
+		{
+			return;
+		}
+
+		crossed[edge] = (a > 0.0) != (b > 0.0);
+		if (crossed[edge])
+		{
+			float t = (float)(a / (a - b));
+			sf::Vector2f p = offsets[edge] + t * (offsets[(edge + 1) % 4] - offsets[edge]);
+			crossings[edge] = origin + sf::Vector2f(p.x * size.x, p.y * size.y);
+			numCrossed++;
+		}
+	}
+
+	if (numCrossed == 2)
+	{
+		for (int edge = 0; edge < 4; edge++)
+		{
+			if (crossed[edge])
+			{
+				segments.push_back(crossings[edge]);
+			}
+		}
+	}
+	else if (numCrossed == 4)
+	{
+		// the middle decides whether the first corner is cut off with the third or on its own
+		double middle = 0.25 * (corners[0] + corners[1] + corners[2] + corners[3]);
+		int first = ((middle > 0.0) == (corners[0] > 0.0)) ? 0 : 3;
+		for (int pair = 0; pair < 2; pair++)
+		{
+			segments.push_back(crossings[(first + 2 * pair) % 4]);
+			segments.push_back(crossings[(first + 2 * pair + 1) % 4]);
+		}
+	}
+}
+
 void Application::ApplyZoomOnGraph(float factor)
 {
 	sf::Vector2f center(mGraphRect.left + 0.5f * mGraphRect.width, mGraphRect.top + 0.5f * mGraphRect.height);
@@ -460,15 +877,20 @@ void Application::ApplyZoomOnGraph(float factor)
 	mGraphRect.left = center.x - 0.5f * mGraphRect.width;
 	mGraphRect.top = center.y - 0.5f * mGraphRect.height;
 	mSourceDirty = true;
+	mLatency.edit();
 }
 
 void Application::showGraph()
 {
 	std::vector<sf::Vertex> lines;
+	std::vector<sf::Vertex> spikes;
+	const sf::Color spikeColor(255, 255, 255, 96);
 	mMutex.lock();
-	for (const sf::Vector2f& p : mPoints2D)
+	bool bounded = mCoordinate == CARTESIAN && mRanges2D.size() == mPoints2D.size();
+	for (size_t i = 0; i < mPoints2D.size(); i++)
 	{
-		if (mCoordinate == CARTESIAN)
+		const sf::Vector2f& p = mPoints2D[i];
+		if (mCoordinate == CARTESIAN || mCoordinate == IMPLICIT)
 		{
 			lines.push_back(convertGraphCoordToScreen(p));
 		}
@@ -477,9 +899,43 @@ void Application::showGraph()
 			sf::Vector2f p(p.y * cos(p.x), p.y * sin(p.x));
 			lines.push_back(convertGraphCoordToScreen(p));
 		}
+
+		if (bounded && i + 1 < mPoints2D.size())
+		{
+			const sf::Vector2f& next = mPoints2D[i + 1];
+			const sf::Vector2f& range = mRanges2D[i];
+			if (!std::isfinite(range.x) || !std::isfinite(range.y))
+			{
+				// a pole or a gap between this point and the next, don't join them
+				mGui.getWindow()->draw(lines.data(), lines.size(), sf::LinesStrip);
+				lines.clear();
+			}
+			else
+			{
+				// the curve goes well beyond both points in between: mark how far it can go
+				float low = std::min(p.y, next.y);
+				float high = std::max(p.y, next.y);
+				float pixel = mGraphRect.height / mGraphScreen.height;
+				float missed = std::max(low - range.x, range.y - high);
+				if (missed > std::max(3.f * pixel, 2.f * (high - low)))
+				{
+					float x = 0.5f * (p.x + next.x);
+					float bottom = std::max(range.x, mGraphRect.top);
+					float top = std::min(range.y, mGraphRect.top + mGraphRect.height);
+					if (bottom < top)
+					{
+						spikes.push_back(sf::Vertex(convertGraphCoordToScreen(sf::Vector2f(x, bottom)), spikeColor));
+						spikes.push_back(sf::Vertex(convertGraphCoordToScreen(sf::Vector2f(x, top)), spikeColor));
+					}
+				}
+			}
+		}
 	}
 	mMutex.unlock();
-	mGui.getWindow()->draw(lines.data(), lines.size(), sf::LinesStrip);
+	mLatency.mark(STAGE_GEOMETRY);
+	// an implicit curve comes as separate segments
+	mGui.getWindow()->draw(lines.data(), lines.size(), (mCoordinate == IMPLICIT) ? sf::Lines : sf::LinesStrip);
+	mGui.getWindow()->draw(spikes.data(), spikes.size(), sf::Lines);
 	lines.clear();
 
 	// Axis
@@ -501,10 +957,8 @@ void Application::showGraph()
 	{
 		char str[32];
 		sprintf_s<32>(str, "%g", x);
-		sf::Text text(str, *mGui.getFont(), 12);
 		x = (x - mGraphRect.left) / mGraphRect.width;
-		text.setPosition(mGraphScreen.left + x * mGraphScreen.width, mGraphScreen.top + middleY*mGraphScreen.height - graduationSize);
-		mGui.getWindow()->draw(text);
+		mOverlay.addText(str, sf::Vector2f(mGraphScreen.left + x * mGraphScreen.width, mGraphScreen.top + middleY*mGraphScreen.height - graduationSize), 12);
 
 		lines.push_back(sf::Vector2f(mGraphScreen.left + x * mGraphScreen.width, mGraphScreen.top + middleY*mGraphScreen.height + graduationSize));
 		lines.push_back(sf::Vector2f(mGraphScreen.left + x * mGraphScreen.width, mGraphScreen.top + middleY*mGraphScreen.height - graduationSize));
@@ -515,10 +969,8 @@ void Application::showGraph()
 	{
 		char str[32];
 		sprintf_s<32>(str, "%g", y);
-		sf::Text text(str, *mGui.getFont(), 12);
 		y = (y - mGraphRect.top) / mGraphRect.height;
-		text.setPosition(mGraphScreen.left + middleX*mGraphScreen.width + graduationSize + 1.f, mGraphScreen.top + (1.f - y) * mGraphScreen.height - 5.f);
-		mWindow.draw(text);
+		mOverlay.addText(str, sf::Vector2f(mGraphScreen.left + middleX*mGraphScreen.width + graduationSize + 1.f, mGraphScreen.top + (1.f - y) * mGraphScreen.height - 5.f), 12);
 
 		lines.push_back(sf::Vector2f(mGraphScreen.left + middleX*mGraphScreen.width + graduationSize, mGraphScreen.top + (1.f - y) * mGraphScreen.height));
 		lines.push_back(sf::Vector2f(mGraphScreen.left + middleX*mGraphScreen.width - graduationSize, mGraphScreen.top + (1.f - y) * mGraphScreen.height));
@@ -527,17 +979,13 @@ void Application::showGraph()
 
 	for (const auto& it : mPoints)
 	{
-		sf::CircleShape circle(2.5f);
-		circle.setFillColor(sf::Color::Blue);
-		circle.setOutlineThickness(1.f);
-		circle.setOutlineColor(sf::Color::Cyan);
-		circle.setPosition(convertGraphCoordToScreen(it) - sf::Vector2f(2.5f, 2.5f));
-		mWindow.draw(circle);
+		mOverlay.addMarker(convertGraphCoordToScreen(it));
 	}
 
 	sf::Vector2f mouse = convertScreenCoordToGraph(sf::Vector2f((float)sf::Mouse::getPosition(mWindow).x, (float)sf::Mouse::getPosition(mWindow).y));
 	
-	if (mouse.x >= mGraphRect.left && mouse.x <= mGraphRect.left + mGraphRect.width)
+	// an implicit curve has no one y for each x to show
+	if (mCoordinate != IMPLICIT && mouse.x >= mGraphRect.left && mouse.x <= mGraphRect.left + mGraphRect.width)
 	{
 		if (mCoordinate == POLAR)
 		{
@@ -547,9 +995,17 @@ void Application::showGraph()
 		}
 
 		float y = getAccurateYValue(mouse.x);
-		char str[64];
-		sprintf_s(str, "(%g, %g)", mouse.x, y);
-		sf::Text text(str, *mGui.getFont(), 12);
+		float slope = 0.f;
+		bool hasSlope = mCoordinate == CARTESIAN && getAccurateSlope(mouse.x, slope);
+		char str[96];
+		if (hasSlope)
+		{
+			sprintf_s(str, "(%g, %g) slope %g", mouse.x, y, slope);
+		}
+		else
+		{
+			sprintf_s(str, "(%g, %g)", mouse.x, y);
+		}
 		sf::Vector2f textPos;
 		if (mCoordinate == CARTESIAN)
 		{
@@ -561,12 +1017,23 @@ void Application::showGraph()
 			textPos = sf::Vector2f(y * cos(mouse.x), y * sin(mouse.x));
 			textPos = convertGraphCoordToScreen(textPos);
 		}
-		text.setPosition(textPos);
-		mWindow.draw(text);
+		mOverlay.addText(str, textPos, 12);
 		sf::RectangleShape rect(sf::Vector2f(3.f,3.f));
 		rect.setPosition(textPos.x - 1.5f, textPos.y - 1.5f);
 		rect.setFillColor(sf::Color(128,128,255));
 		mWindow.draw(rect);
+
+		// the tangent under the mouse, over a tenth of the graph's width either side
+		if (hasSlope)
+		{
+			float halfWidth = 0.1f * mGraphRect.width;
+			sf::Vertex tangent[2] =
+			{
+				sf::Vertex(convertGraphCoordToScreen(sf::Vector2f(mouse.x - halfWidth, y - slope * halfWidth)), sf::Color(128, 128, 255)),
+				sf::Vertex(convertGraphCoordToScreen(sf::Vector2f(mouse.x + halfWidth, y + slope * halfWidth)), sf::Color(128, 128, 255))
+			};
+			mWindow.draw(tangent, 2, sf::Lines);
+		}
 	}
 }
 
@@ -591,14 +1058,14 @@ void Application::show3DGraph()
 	glLoadIdentity();
 	glTranslatef(0.f, 0.f, -4.f);
 	static sf::Clock clock;
+	mTurn3D = clock.getElapsedTime().asSeconds() * 30.f;
 	glRotatef(30.f, -1.f, 0.2f, 0.f);
-	glRotatef(clock.getElapsedTime().asSeconds() * 30.f, 0.f, 0.f, 1.f);
+	glRotatef(mTurn3D, 0.f, 0.f, 1.f);
 	float scale = 3.f;
 	glScalef(scale, scale, scale);
 
 	std::vector<sf::Vector3f> positions;
 	std::vector<sf::Color> colors;
-	std::vector<sf::Vector3f> vertNormals;
 
 	float minZ = 0, maxZ = 0;
 	for (const sf::Vector3f& p : mPoints3D)
@@ -612,67 +1079,87 @@ void Application::show3DGraph()
 	if (maxZ - minZ > 1e-7f)
 		deltaZ = 1.f / (maxZ - minZ);
 
+	// every point's colour at once, the triangles share them
+	std::vector<float> heights(mPoints3D.size());
+	for (size_t i = 0; i < mPoints3D.size(); i++)
+		heights[i] = mPoints3D[i].z;
+	std::vector<sf::Color> pointColors(mPoints3D.size());
+	Colormap::get(mColormap).apply(heights.data(), (int)heights.size(), minZ, (deltaZ > 0.f) ? maxZ : minZ, (unsigned char*)pointColors.data());
+
+	// the surface is drawn with z scaled by deltaZ / 2, its normal is (-dz/dx, -dz/dy, 1) in those
+	// units. The slopes are exact when main could be differentiated, otherwise they're estimated
+	// from the neighbouring points, and the border is left flat
+	bool exact = mGradients3D.size() == mPoints3D.size();
 	std::vector<sf::Vector3f> Normals(mPoints3D.size());
-	for (int x = 0; x < mCurveWidth - 1; x++)
+	for (int x = 0; x < mCurveWidth; x++)
 	{
-		for (int y = 0; y < mCurveWidth - 1; y++)
+		for (int y = 0; y < mCurveWidth; y++)
 		{
-			if (x == 0 || y == 0 || x == mCurveWidth - 2 || y == mCurveWidth - 2)
+			sf::Vector2f slope;
+			if (exact)
+			{
+				slope = mGradients3D[x * mCurveWidth + y];
+			}
+			else if (x == 0 || y == 0 || x == mCurveWidth - 1 || y == mCurveWidth - 1)
 			{
 				Normals[x * mCurveWidth + y] = sf::Vector3f(0.f, 0.f, 1.f);
 				continue;
 			}
+			else
+			{
+				sf::Vector3f p0 = mPoints3D[(x - 1) * mCurveWidth + y];
+				sf::Vector3f p1 = mPoints3D[(x + 1) * mCurveWidth + y];
+				sf::Vector3f p2 = mPoints3D[x * mCurveWidth + y - 1];
+				sf::Vector3f p3 = mPoints3D[x * mCurveWidth + y + 1];
+				slope = sf::Vector2f(p1.z - p0.z, p3.z - p2.z) * (0.5f * (mCurveWidth - 1));
+			}
 
-			sf::Vector3f p0 = mPoints3D[(x - 1) * mCurveWidth + y];
-			sf::Vector3f p1 = mPoints3D[(x + 1) * mCurveWidth + y];
-			sf::Vector3f p2 = mPoints3D[x * mCurveWidth + y - 1];
-			sf::Vector3f p3 = mPoints3D[x * mCurveWidth + y + 1];
-			sf::Vector3f Norm((p1.z - p0.z) * deltaZ, (p3.y - p2.y) * deltaZ, 2.f);
+			sf::Vector3f Norm(-slope.x * 0.5f * deltaZ, -slope.y * 0.5f * deltaZ, 1.f);
 			Norm *= 1.f / sqrt(Norm.x * Norm.x + Norm.y * Norm.y + Norm.z * Norm.z);
 			Normals[x * mCurveWidth + y] = Norm;
 		}
 	}
-	for (int x = 0; x < mCurveWidth-1; x++)
+	// the points are shared by the triangles which meet at them
+	for (const sf::Vector3f& p : mPoints3D)
+	{
+		positions.push_back(sf::Vector3f(p.x, p.y, ((p.z - minZ) * deltaZ - 0.5f) * 0.5f));
+	}
+
+	// fewer triangles where the surface is flat, leaving out points that are within
+	// mLodPixelError of the triangles on screen. The frustum gives a 90 degree field of view, and
+	// the surface, scaled by 3, comes no nearer than 1.75 to the camera as it turns
+	if (mMeshDirty)
 	{
-		for (int y = 0; y < mCurveWidth-1; y++)
+		mMeshDirty = false;
+		mMeshError = -1.f;
+		if (!mMesh3D.build(heights.data(), mCurveWidth))
 		{
-			sf::Vector3f p0 = mPoints3D[x * mCurveWidth + y];
-			sf::Vector3f p1 = mPoints3D[(x+1) * mCurveWidth + y];
-			sf::Vector3f p2 = mPoints3D[(x+1) * mCurveWidth + y + 1];
-			sf::Vector3f p3 = mPoints3D[x * mCurveWidth + y + 1];
-			sf::Color c0 = rainbowColor(p0.z = (p0.z - minZ) * deltaZ);
-			sf::Color c1 = rainbowColor(p1.z = (p1.z - minZ) * deltaZ);
-			sf::Color c2 = rainbowColor(p2.z = (p2.z - minZ) * deltaZ);
-			sf::Color c3 = rainbowColor(p3.z = (p3.z - minZ) * deltaZ);
-			p0.z -=  0.5f; p1.z -= 0.5f; p2.z -= 0.5f; p3.z -= 0.5f;
-			p0.z *= 0.5f; p1.z *= 0.5f; p2.z *= 0.5f; p3.z *= 0.5f;
-
-			positions.push_back(p0);
-			positions.push_back(p1);
-			positions.push_back(p2);
-			positions.push_back(p2);
-			positions.push_back(p3);
-			positions.push_back(p0);
-			colors.push_back(c0);
-			colors.push_back(c1);
-			colors.push_back(c2);
-			colors.push_back(c2);
-			colors.push_back(c3);
-			colors.push_back(c0);
-			vertNormals.push_back(Normals[x * mCurveWidth + y]);
-			vertNormals.push_back(Normals[(x + 1) * mCurveWidth + y]);
-			vertNormals.push_back(Normals[(x + 1) * mCurveWidth + y + 1]);
-			vertNormals.push_back(Normals[(x + 1) * mCurveWidth + y + 1]);
-			vertNormals.push_back(Normals[x * mCurveWidth + y + 1]);
-			vertNormals.push_back(Normals[x * mCurveWidth + y]);
+			// not a grid the mesh can be built on, every cell is drawn
+			mMeshIndices.clear();
+			for (int x = 0; x < mCurveWidth - 1; x++)
+			{
+				for (int y = 0; y < mCurveWidth - 1; y++)
+				{
+					unsigned p0 = x * mCurveWidth + y, p1 = p0 + mCurveWidth, p2 = p1 + 1, p3 = p0 + 1;
+					mMeshIndices.insert(mMeshIndices.end(), { p0, p1, p2, p2, p3, p0 });
+				}
+			}
 		}
 	}
+	float pixelsPerUnit = scale * 0.5f * deltaZ * 0.5f * mWindow.getSize().y / 1.75f;
+	float maxError = (pixelsPerUnit > 0.f) ? mLodPixelError / pixelsPerUnit : INFINITY;
+	if (mMesh3D.size() == mCurveWidth && maxError != mMeshError)
+	{
+		mMesh3D.triangulate(maxError, mMeshIndices);
+		mMeshError = maxError;
+	}
 	mMutex.unlock();
+	mLatency.mark(STAGE_GEOMETRY);
 
 	glVertexPointer(3, GL_FLOAT, 3 * sizeof(float), positions.data());
-	glColorPointer(4, GL_UNSIGNED_BYTE, 4 * sizeof(unsigned char), colors.data());
-	glNormalPointer(GL_FLOAT, 3 * sizeof(float), vertNormals.data());
-	glDrawArrays(GL_TRIANGLES, 0, positions.size());
+	glColorPointer(4, GL_UNSIGNED_BYTE, 4 * sizeof(unsigned char), pointColors.data());
+	glNormalPointer(GL_FLOAT, 3 * sizeof(float), Normals.data());
+	glDrawElements(GL_TRIANGLES, (GLsizei)mMeshIndices.size(), GL_UNSIGNED_INT, mMeshIndices.data());
 
 	//Axis
 	positions.clear();
@@ -714,22 +1201,96 @@ void Application::show3DGraph()
 	// Axis description
 	char buffer[256];
 	sprintf_s<256>(buffer, "Axis Z: %g to %g", minZ, maxZ);
-	sf::Text text(buffer, *mGui.getFont(), 14);
-	text.setPosition(mWindow.getSize().x - 230.f, mWindow.getSize().y - 60.f);
-	text.setColor(sf::Color::Blue);
-	mWindow.draw(text);
+	sf::Vector2f textPos(mWindow.getSize().x - 230.f, mWindow.getSize().y - 60.f);
+	mOverlay.addText(buffer, textPos, 14, sf::Color::Blue);
 
 	sprintf_s<256>(buffer, "Axis Y: %g to %g", mGraphRect.top, mGraphRect.top + mGraphRect.height);
-	text.setString(buffer);
-	text.setPosition(text.getPosition().x, text.getPosition().y - 30);
-	text.setColor(sf::Color::Green);
-	mWindow.draw(text);
+	textPos.y -= 30;
+	mOverlay.addText(buffer, textPos, 14, sf::Color::Green);
 
 	sprintf_s<256>(buffer, "Axis X: %g to %g", mGraphRect.left, mGraphRect.left + mGraphRect.width);
-	text.setString(buffer);
-	text.setPosition(text.getPosition().x, text.getPosition().y - 30);
-	text.setColor(sf::Color::Red);
-	mWindow.draw(text);
+	textPos.y -= 30;
+	mOverlay.addText(buffer, textPos, 14, sf::Color::Red);
+}
+
+// the graph as it is now, drawn again at width by height on the CPU and saved as a PNG by a
+// thread of its own, so the window carries on while it's done
+void Application::exportImage(const std::string& path, int width, int height)
+{
+	PlotExport plot;
+	mMutex.lock();
+	plot.left = mGraphRect.left;
+	plot.top = mGraphRect.top;
+	plot.width = mGraphRect.width;
+	plot.height = mGraphRect.height;
+	if (mCoordinate == THREE_D)
+	{
+		plot.size = mCurveWidth;
+		for (const sf::Vector3f& p : mPoints3D)
+			plot.heights.push_back(p.z);
+		for (const sf::Vector2f& slope : mGradients3D)
+			plot.slopes.insert(plot.slopes.end(), { slope.x, slope.y });
+		plot.turn = mTurn3D;
+		plot.colormap = mColormap;
+	}
+	else
+	{
+		bool bounded = mCoordinate == CARTESIAN && mRanges2D.size() == mPoints2D.size();
+		for (size_t i = 0; i < mPoints2D.size(); i++)
+		{
+			sf::Vector2f p = mPoints2D[i];
+			if (mCoordinate == POLAR)
+				p = sf::Vector2f(p.y * cos(p.x), p.y * sin(p.x));
+			plot.curve.insert(plot.curve.end(), { p.x, p.y });
+
+			// broken where showGraph breaks it, at poles and gaps
+			if (bounded && (!std::isfinite(mRanges2D[i].x) || !std::isfinite(mRanges2D[i].y)))
+				plot.curve.insert(plot.curve.end(), { NAN, NAN });
+		}
+		plot.segments = mCoordinate == IMPLICIT;
+		for (const sf::Vector2f& p : mPoints)
+			plot.markers.insert(plot.markers.end(), { p.x, p.y });
+	}
+	mMutex.unlock();
+
+	std::thread([this, plot, path, width, height] {
+		bool saved = plot.save(path, width, height);
+		mMutex.lock();
+		mErrorMessage.setString(saved ? "Saved " + path : "Couldn't save " + path);
+		mMutex.unlock();
+	}).detach();
+}
+
+// where the time goes between an edit and the frame showing it, in the top right corner
+void Application::showLatency()
+{
+	const float columnWidth = 55.f;
+	sf::Vector2f origin(mWindow.getSize().x - 90.f - 3.f * columnWidth - 10.f, 10.f);
+	sf::RectangleShape background(sf::Vector2f(90.f + 3.f * columnWidth + 5.f, 10.f * 16.f + 5.f));
+	background.setPosition(origin - sf::Vector2f(5.f, 0.f));
+	background.setFillColor(sf::Color(0, 0, 0, 160));
+	mWindow.draw(background);
+
+	// a row to each line of the report, its values in columns after the name
+	std::string report = mLatency.report();
+	sf::Vector2f position = origin;
+	size_t start = 0;
+	while (start < report.size())
+	{
+		size_t end = std::min(report.find('\n', start), report.size());
+		size_t column = 0;
+		size_t cell = start;
+		while (cell < end)
+		{
+			size_t next = std::min(report.find('\t', cell), end);
+			float x = position.x + ((column == 0) ? 0.f : 90.f + (column - 1) * columnWidth);
+			mOverlay.addText(report.substr(cell, next - cell), sf::Vector2f(x, position.y), 12, sf::Color(255, 255, 160));
+			cell = next + 1;
+			column++;
+		}
+		position.y += 16.f;
+		start = end + 1;
+	}
 }
 
 void Application::callbackTextEdit()
@@ -741,12 +1302,17 @@ void Application::callbackTextEdit()
 	mSourceCodeRedo.clear();
 	mSourceCode = mSourceCodeEditBox->getText().toAnsiString();
 	mSourceDirty = true;
+	mLatency.edit();
 	mMutex.unlock();
 }
 
 void Application::fillDefaultSourceCode()
 {
-	if (mCoordinate != THREE_D)
+	if (mCoordinate == IMPLICIT)
+	{
+		mSourceCodeEditBox->setText("double main(double x, double y){\n\nreturn x*x + y*y - 25.0;\n}");
+	}
+	else if (mCoordinate != THREE_D)
 	{
 		mSourceCodeEditBox->setText("double main(double x){\n\nreturn x;\n}");
 	}
@@ -763,9 +1329,7 @@ void Application::showBuiltInFunctions()
 	GetBuiltInFunctionConstants(list);
 	const char* str = list.c_str();
 
-	sf::Text text("", *mGui.getFont(), 12);
-	text.setPosition(mWindow.getSize().x * mDelimitatorRatio + 30.f, 30.f);
-	text.setColor(sf::Color::White);
+	sf::Vector2f pos(mWindow.getSize().x * mDelimitatorRatio + 30.f, 30.f);
 
 	const char* strEnd = str + list.length();
 
@@ -774,17 +1338,15 @@ void Application::showBuiltInFunctions()
 		if (*splitEnd == '\n')
 		{
 			const ptrdiff_t splitLen = splitEnd - str;
-			text.setString(std::string(str, splitLen));
+			std::string line(str, splitLen);
 			str = splitEnd + 1;
 
-			sf::Vector2f pos = text.getPosition();
 			pos.y += 15.f;
 			if (pos.y > mWindow.getSize().y - 50)
 			{
 				pos = sf::Vector2f(pos.x + 250.f, 30.f);
 			}
-			text.setPosition(pos);
-			mGui.getWindow()->draw(text);
+			mOverlay.addText(line, pos, 12);
 		}
 	}
 }
@@ -973,6 +1535,7 @@ void Application::loadWidgets()
 	coordinateBox->addItem("Cartesian coordinates");
 	coordinateBox->addItem("Polar coordinates");
 	coordinateBox->addItem("3D curve");
+	coordinateBox->addItem("Implicit curve");
 	coordinateBox->setSelectedItemByIndex(mCoordinate);
 	mGui.add(coordinateBox);
 	coordinateBox->connect("ItemSelected", [this](tgui::ComboBox::Ptr box) {
@@ -999,20 +1562,84 @@ void Application::loadWidgets()
 		{
 		case 0:
 			mNumPoint2D = 128;
-			mNumPoint3D = 16;
+			mNumPoint3D = 17;
 			break;
 		case 1:
 			mNumPoint2D = 1024;
-			mNumPoint3D = 32;
+			mNumPoint3D = 33;
 			break;
 		case 2:
 			mNumPoint2D = 1500;
-			mNumPoint3D = 64;
+			mNumPoint3D = 65;
 			break;
 		}
 	}, highDefBox);
 
+	tgui::ComboBox::Ptr colormapBox = tgui::ComboBox::create();
+	colormapBox->setSize(100, 25);
+	colormapBox->setPosition(tgui::bindRight(highDefBox) + 20.f, tgui::bindTop(highDefBox));
+	for (int map = 0; map < COLORMAP_COUNT; map++)
+		colormapBox->addItem(Colormap::name((enumColormap)map));
+	colormapBox->setSelectedItemByIndex(mColormap);
+	mGui.add(colormapBox);
+	colormapBox->connect("ItemSelected", [this](tgui::ComboBox::Ptr box) {
+		mColormap = (enumColormap)box->getSelectedItemIndex();
+	}, colormapBox);
+
+	tgui::Button::Ptr exportButton = tgui::Button::create();
+	exportButton->setSize(100, 25);
+	exportButton->setPosition(tgui::bindRight(colormapBox) + 20.f, tgui::bindTop(colormapBox));
+	exportButton->setText("Export 8K");
+	mGui.add(exportButton);
+	exportButton->connect("pressed", [this] {
+		exportImage("plot.png", 7680, 4320);
+	});
+
+#ifdef FEATURE_NATIVE_COMPILE
+	tgui::CheckBox::Ptr nativeBox = tgui::CheckBox::create();
+	nativeBox->setSize(25, 25);
+	nativeBox->setPosition(tgui::bindRight(exportButton) + 20.f, tgui::bindTop(exportButton));
+	nativeBox->setText("Native");
+	mGui.add(nativeBox);
+	nativeBox->connect("Checked", [this] {
+		extern bool gNativeCompile;
+		gNativeCompile = true;
+		mSourceDirty = true;
+		mLatency.edit();
+	});
+	nativeBox->connect("Unchecked", [this] {
+		extern bool gNativeCompile;
+		gNativeCompile = false;
+		mSourceDirty = true;
+		mLatency.edit();
+	});
+#endif
+
+	// how often each line runs and where the time goes, shown next to the code
+	tgui::CheckBox::Ptr profileBox = tgui::CheckBox::create();
+	profileBox->setSize(25, 25);
+#ifdef FEATURE_NATIVE_COMPILE
+	profileBox->setPosition(tgui::bindRight(nativeBox) + 70.f, tgui::bindTop(exportButton));
+#else
+	profileBox->setPosition(tgui::bindRight(exportButton) + 20.f, tgui::bindTop(exportButton));
+#endif
+	profileBox->setText("Profile lines");
+	mGui.add(profileBox);
+	profileBox->connect("Checked", [this] {
+		sf::Lock lock(mMutex);
+		mProfile = true;
+		mSourceDirty = true;
+		mLatency.edit();
+	});
+	profileBox->connect("Unchecked", [this] {
+		sf::Lock lock(mMutex);
+		mProfile = false;
+		mSourceDirty = true;
+		mLatency.edit();
+	});
+
 	mErrorMessage.setFont(*mGui.getFont());
+	mOverlay.setFont(*mGui.getFont());
 	mErrorMessage.setCharacterSize(14);
 	mErrorMessage.setColor(sf::Color::Red);
 
@@ -1058,6 +1685,7 @@ void Application::loadWidgets()
 					it.value = it.value * (it.max - it.min) + it.min;
 					updateTweakable(false);
 					mSourceDirty = true;
+					mLatency.edit();
 					return;
 				}
 			}
@@ -1204,43 +1832,7 @@ bool Application::isMouseOverDelimitator()
 
 std::vector<float> Application::computeAxisGraduation(float min, float max) const
 {
-	float delta = max - min;
-	const static double mul[] = { 1.0, 2.0, 5.0 };
-	std::vector<float> axis;
-
-	bool ok = false;
-	double step = FLT_MAX;
-	for (int e = -7; e < 9; e++)
-	{
-		double a = pow(10.0, e);
-
-		for (int i = 0; i < 3; i++)
-		{
-			double b = a * mul[i];
-
-			if (delta / b <= 10)
-			{
-				step = b;
-				ok = true;
-				break;
-			}
-		}
-		if (ok)
-		{
-			break;
-		}
-	}
-
-	double i = floor(min / step) * step;
-	for (; i < max + 0.1*step; i += step)
-	{
-		if (abs(i) > 1e-9)
-		{
-			axis.push_back((float)i);
-		}
-	}
-
-	return axis;
+	return PlotExport::graduation(min, max);
 }
 
 float Application::getAccurateYValue(float x) const
@@ -1266,33 +1858,19 @@ float Application::getAccurateYValue(float x) const
 	return a * (p1.y - p0.y) + p0.y;
 }
 
-//i entre 0 et 1
-sf::Color Application::rainbowColor(float i)
+// the exact slope of the curve at x, when main could be differentiated
+bool Application::getAccurateSlope(float x, float& slope) const
 {
-	i *= 0.833333f;
+	sf::Lock lock(mMutex);
 
-	if (i < 0.16666667f)
-	{
-		return sf::Color(255, 0, (sf::Uint8)(i * 6.f*255.f));
-	}
-	else if (i < 0.33333333f)
-	{
-		return sf::Color((sf::Uint8)(255.f - (i - 0.16666667f) * 6.f * 255.f), 0, 255);
-	}
-	else if (i < 0.5f)
-	{
-		return sf::Color(0, (sf::Uint8)((i - 0.3333333f) * 6.f * 255.f), 255);
-	}
-	else if (i < 0.66666667f)
-	{
-		return sf::Color(0, 255, (sf::Uint8)(255.f - (i - 0.5f) * 6.f * 255.f));
-	}
-	else if (i < 0.8333333f)
-	{
-		return sf::Color((sf::Uint8)((i - 0.6666667f) * 6.f * 255.f), 255, 0);
-	}
-	else
-	{
-		return sf::Color(255, (sf::Uint8)(255.f - (i - 0.8333333f) * 6.f * 255.f), 0);
-	}
+	if (mPoints2D.size() < 2 || mSlopes2D.size() != mPoints2D.size())
+		return false;
+
+	unsigned i = 1;
+	while (i < mPoints2D.size() - 1 && mPoints2D[i].x <= x)
+		i++;
+
+	float a = (x - mPoints2D[i-1].x) / (mPoints2D[i].x - mPoints2D[i-1].x);
+	slope = a * (mSlopes2D[i] - mSlopes2D[i-1]) + mSlopes2D[i-1];
+	return true;
 }
\ No newline at end of file
@@ -1,4 +1,4 @@
-#pragma once
+﻿#pragma once
 
 #include <SFML/Window.hpp>
 #include <SFML/Graphics.hpp>
@@ -9,12 +9,19 @@
 #include <chrono>
 #include <random>
 #include "Tweakable.h"
+#include "Colormap.h"
+#include "Latency.h"
+#include "LodMesh.h"
+#include "Overlay.h"
+#include "PlotExport.h"
+#include "Trace.h"
 
 enum enumCoordinate
 {
 	CARTESIAN,
 	POLAR,
-	THREE_D
+	THREE_D,
+	IMPLICIT
 };
 
 enum enumDragMode
@@ -27,6 +34,8 @@ enum enumDragMode
 	DRAG_POINT
 };
 
+struct LineProfile;
+
 class Application
 {
 public:
@@ -36,11 +45,15 @@ public:
 
 private:
 	void               execute();
-	bool               evaluate2D(std::vector<sf::Vector2f>& result, enumCoordinate coordinate);
-	bool               evaluate3D(std::vector<sf::Vector3f>& result, int& curveWidth);
+	bool               evaluate2D(std::vector<sf::Vector2f>& result, std::vector<float>& slopes, std::vector<sf::Vector2f>& ranges, enumCoordinate coordinate, LineProfile& profile);
+	bool               evaluate3D(std::vector<sf::Vector3f>& result, std::vector<sf::Vector2f>& gradients, int& curveWidth, LineProfile& profile);
+	bool               evaluateImplicit(std::vector<sf::Vector2f>& segments, LineProfile& profile);
+	void               marchSquare(std::vector<sf::Vector2f>& segments, const sf::Vector2f& origin, const sf::Vector2f& size, const double corners[4]) const;
 	void               ApplyZoomOnGraph(float factor);
 	void               showGraph();
 	void               show3DGraph();
+	void               exportImage(const std::string& path, int width, int height);
+	void               showLatency();
 	void               callbackTextEdit();
 	void               fillDefaultSourceCode();
 	void               showBuiltInFunctions();
@@ -56,7 +69,7 @@ private:
 	bool               isMouseOverDelimitator();
 	std::vector<float> computeAxisGraduation(float min, float max) const;
 	float              getAccurateYValue(float x) const;
-	sf::Color          rainbowColor(float i);
+	bool               getAccurateSlope(float x, float& slope) const;
 
 
 	std::mt19937              mRandomGenerator;
@@ -72,18 +85,35 @@ private:
 	std::list<std::string>    mSourceCodeHistory;
 	std::list<std::string>    mSourceCodeRedo;
 	bool                      mSourceDirty = true;
-	std::vector<sf::Vector2f> mPoints2D;
+	std::vector<sf::Vector2f> mPoints2D;    // the ends of each segment in implicit mode
+	std::vector<float>        mSlopes2D;    // exact dy/dx at each point, empty when main can't be differentiated
+	std::vector<sf::Vector2f> mRanges2D;    // bounds of y from each point to the next, empty when main can't be bounded
 	std::vector<sf::Vector3f> mPoints3D;
-	int                       mCurveWidth = 32;
+	std::vector<sf::Vector2f> mGradients3D; // exact slopes along both axes of the grid at each point, or empty
+	int                       mCurveWidth = 33;
+	LodMesh                   mMesh3D;
+	std::vector<unsigned>     mMeshIndices; // the triangles the surface is drawn with
+	bool                      mMeshDirty = true;
+	float                     mMeshError = -1.f;   // the error mMeshIndices were worked out for
+	float                     mLodPixelError = 1.f; // how far in pixels the drawn surface may be from a point
+	float                     mTurn3D = 0.f;        // how far the surface has turned about its vertical axis, in degrees
 	int                       mNumPoint2D = 1024;
-	int                       mNumPoint3D = 32;
+	int                       mNumPoint3D = 33;   // 2^n + 1 points a side, for the mesh to be built on
 	float                     mDelimitatorRatio = 0.25f;
 	sf::FloatRect             mGraphRect = sf::FloatRect(-10.f, -10.f, 20.f, 20.f);
 	sf::FloatRect             mGraphScreen;
 	sf::Text                  mErrorMessage;
+	Overlay                   mOverlay;     // the frame's labels and point markers, drawn together
+	Latency                   mLatency;     // how long edits take to reach the screen, stage by stage
+	bool                      mShowLatency = false;
+	bool                      mProfile = false;      // the lines of the program are profiled, which has every point interpreted
+	std::vector<long long>    mLineHits;    // how many times each line ran in the last evaluation, empty when it wasn't profiled
+	std::vector<float>        mLineShares;  // and its share of the time
+	bool                      mLineProfileDirty = false;
 	float                     mProgression = 0.f;
 	bool                      mShowFunctionList = false;
 	enumCoordinate            mCoordinate = CARTESIAN;
+	enumColormap              mColormap = COLORMAP_RAINBOW;
 	std::vector<Tweakable>    mTweakables;
 	std::string               mCurrentTweakable;
 	std::vector<sf::Vector2f> mPoints;
@@ -0,0 +1,164 @@
+#include "Colormap.h"
+#include <cmath>
+#include <cstring>
+
+// like the interpreter's vector loops, an AVX2 version of the colouring loop is picked at load time
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+#define COLORMAP_TARGET __attribute__((target_clones("avx2", "default")))
+#else
+#define COLORMAP_TARGET
+#endif
+
+namespace
+{
+	std::uint32_t packColor(float r, float g, float b)
+	{
+		unsigned char bytes[4] =
+		{
+			(unsigned char)(std::fmin(std::fmax(r, 0.f), 1.f) * 255.f + 0.5f),
+			(unsigned char)(std::fmin(std::fmax(g, 0.f), 1.f) * 255.f + 0.5f),
+			(unsigned char)(std::fmin(std::fmax(b, 0.f), 1.f) * 255.f + 0.5f),
+			255
+		};
+		std::uint32_t color;
+		std::memcpy(&color, bytes, sizeof(color));
+		return color;
+	}
+
+	// around the hue circle from red through magenta, blue, cyan and green to yellow
+	std::uint32_t rainbow(float i)
+	{
+		i *= 0.833333f;
+
+		if (i < 0.16666667f)
+			return packColor(1.f, 0.f, i * 6.f);
+		else if (i < 0.33333333f)
+			return packColor(1.f - (i - 0.16666667f) * 6.f, 0.f, 1.f);
+		else if (i < 0.5f)
+			return packColor(0.f, (i - 0.3333333f) * 6.f, 1.f);
+		else if (i < 0.66666667f)
+			return packColor(0.f, 1.f, 1.f - (i - 0.5f) * 6.f);
+		else if (i < 0.8333333f)
+			return packColor((i - 0.6666667f) * 6.f, 1.f, 0.f);
+		else
+			return packColor(1.f, 1.f - (i - 0.8333333f) * 6.f, 0.f);
+	}
+
+	// the perceptually uniform maps are polynomial fits of matplotlib's, one row of coefficients
+	// for each power of t from 0 to 6
+	const float viridisFit[7][3] =
+	{
+		{ 0.2777273272234177f, 0.005407344544966578f, 0.3340998053353061f },
+		{ 0.1050930431085774f, 1.404613529898575f, 1.384590162594685f },
+		{ -0.3308618287255563f, 0.214847559468213f, 0.09509516302823659f },
+		{ -4.634230498983486f, -5.799100973351585f, -19.33244095627987f },
+		{ 6.228269936347081f, 14.17993336680509f, 56.69055260068105f },
+		{ 4.776384997670288f, -13.74514537774601f, -65.35303263337234f },
+		{ -5.435455855934631f, 4.645852612178535f, 26.3124352495832f }
+	};
+
+	const float magmaFit[7][3] =
+	{
+		{ -0.002136485053939582f, -0.000749655052795221f, -0.005386127855323933f },
+		{ 0.2516605407371642f, 0.6775232436837668f, 2.494026599312351f },
+		{ 8.353717279216625f, -3.577719514958484f, 0.3144679030132573f },
+		{ -27.66873308576866f, 14.26473078096533f, -13.64921318813922f },
+		{ 52.17613981234068f, -27.94360607168351f, 12.94416944238394f },
+		{ -50.76852536473588f, 29.04658282127291f, 4.23415299384598f },
+		{ 18.65570506591883f, -11.48977351997711f, -5.601961508734096f }
+	};
+
+	std::uint32_t polynomial(const float fit[7][3], float t)
+	{
+		float color[3];
+		for (int channel = 0; channel < 3; channel++)
+		{
+			color[channel] = fit[6][channel];
+			for (int power = 5; power >= 0; power--)
+			{
+				color[channel] = color[channel] * t + fit[power][channel];
+			}
+		}
+		return packColor(color[0], color[1], color[2]);
+	}
+
+	// the table's index for each value, worked out a whole block at a time so the arithmetic runs
+	// on vectors, then its colour. Out of range values are clamped, NaNs get the lowest colour
+	COLORMAP_TARGET void lookUp(const std::uint32_t* table, const float* values, int count, float low, float scale, unsigned char* rgba)
+	{
+		const int block = 256;
+		const float last = (float)(Colormap::size - 1);
+		float padded[block] = {};
+		int indices[block];
+		for (int start = 0; start < count; start += block)
+		{
+			// the last block is padded out to the full length
+			int length = (count - start < block) ? count - start : block;
+			const float* source = values + start;
+			if (length < block)
+			{
+				std::memcpy(padded, source, sizeof(float) * length);
+				source = padded;
+			}
+
+			for (int i = 0; i < block; i++)
+			{
+				float t = (source[i] - low) * scale + 0.5f;
+				t = (t > 0.f) ? t : 0.f;
+				t = (t < last) ? t : last;
+				indices[i] = (int)t;
+			}
+
+			for (int i = 0; i < length; i++)
+			{
+				std::memcpy(rgba + 4 * (start + i), &table[indices[i]], 4);
+			}
+		}
+	}
+}
+
+Colormap::Colormap(enumColormap map)
+{
+	for (int i = 0; i < size; i++)
+	{
+		float t = (float)i / (size - 1);
+		switch (map)
+		{
+		case COLORMAP_VIRIDIS:
+			mTable[i] = polynomial(viridisFit, t);
+			break;
+		case COLORMAP_MAGMA:
+			mTable[i] = polynomial(magmaFit, t);
+			break;
+		default:
+			mTable[i] = rainbow(t);
+			break;
+		}
+	}
+}
+
+const Colormap& Colormap::get(enumColormap map)
+{
+	static const Colormap maps[COLORMAP_COUNT] = { Colormap(COLORMAP_RAINBOW), Colormap(COLORMAP_VIRIDIS), Colormap(COLORMAP_MAGMA) };
+	return maps[(map >= 0 && map < COLORMAP_COUNT) ? map : COLORMAP_RAINBOW];
+}
+
+const char* Colormap::name(enumColormap map)
+{
+	static const char* names[COLORMAP_COUNT] = { "Rainbow", "Viridis", "Magma" };
+	return names[(map >= 0 && map < COLORMAP_COUNT) ? map : COLORMAP_RAINBOW];
+}
+
+std::uint32_t Colormap::at(float t) const
+{
+	std::uint32_t color;
+	apply(&t, 1, 0.f, 1.f, (unsigned char*)&color);
+	return color;
+}
+
+void Colormap::apply(const float* values, int count, float low, float high, unsigned char* rgba) const
+{
+	// everything has the lowest colour when the values are all the same
+	float scale = (high > low) ? (size - 1) / (high - low) : 0.f;
+	lookUp(mTable, values, count, low, scale, rgba);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+
+enum enumColormap
+{
+	COLORMAP_RAINBOW,
+	COLORMAP_VIRIDIS,
+	COLORMAP_MAGMA,
+	COLORMAP_COUNT
+};
+
+// a colour map with its colours worked out once for evenly spaced values from 0 to 1, each one
+// stored as its r, g, b and a bytes in that order, the way sf::Color and GL's colour arrays have them
+class Colormap
+{
+public:
+	static const int size = 4096;
+
+	static const Colormap& get(enumColormap map);
+	static const char*     name(enumColormap map);
+
+	// the colour for t from 0 to 1
+	std::uint32_t at(float t) const;
+	// the colours for count values, which run from low to high, all in one pass
+	void          apply(const float* values, int count, float low, float high, unsigned char* rgba) const;
+
+private:
+	explicit Colormap(enumColormap map);
+
+	std::uint32_t mTable[size];
+};
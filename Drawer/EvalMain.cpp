@@ -0,0 +1,348 @@
+#include "picoc.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+// cplot-eval: the interpreter without the window. It samples a plot's main() the way the graph
+// does and writes the samples out as text, one point to a line, for batch jobs to read
+
+namespace
+{
+	enum Mode
+	{
+		MODE_CARTESIAN,
+		MODE_POLAR,
+		MODE_3D,
+	};
+
+	// how many points of a curve are evaluated at once, so long curves are written as they go
+	const int blockSize = 4096;
+
+	void usage()
+	{
+		std::fprintf(stderr,
+			"usage: cplot-eval [options] source.c\n"
+			"  -m, --mode MODE      cartesian (main(x)), polar (main(theta)) or 3d (main(x, y)),\n"
+			"                       cartesian by default\n"
+			"  -r, --range MIN:MAX  the x range, and y's too in 3d. -10:10 by default, 0:2pi in polar\n"
+			"  -n, --points N       points on the curve, 1024 by default, or a side of the grid in 3d,\n"
+			"                       33 by default\n"
+			"  -s, --set NAME=VALUE a tweakable's value, as many times as there are tweakables\n"
+			"  -o, --output FILE    where the samples go, stdout by default\n"
+			"      --native         build main() with the system's compiler, where that's supported\n"
+			"      --trace FILE     write a Chrome trace of the interpreter's stages and the batches\n"
+			"      --profile FILE   write how often each line ran and its share of the time, which\n"
+			"                       has every point interpreted\n"
+			"\n"
+			"Each line is x y, theta r in polar or x y z in 3d, with a blank line after each row of\n"
+			"the grid.\n");
+	}
+
+	bool parseRange(const char* text, double& min, double& max)
+	{
+		char* end;
+		min = std::strtod(text, &end);
+		if (end == text || *end != ':')
+			return false;
+		const char* second = end + 1;
+		max = std::strtod(second, &end);
+		return end != second && *end == '\0' && min < max;
+	}
+
+	bool parseTweakable(const char* text, std::vector<Tweakable>& tweakables)
+	{
+		const char* equal = std::strchr(text, '=');
+		if (equal == nullptr || equal == text)
+			return false;
+		char* end;
+		double value = std::strtod(equal + 1, &end);
+		if (end == equal + 1 || *end != '\0')
+			return false;
+
+		Tweakable tweakable(std::string(text, equal));
+		tweakable.value = value;
+		tweakables.push_back(tweakable);
+		return true;
+	}
+
+	// each line of the source with the statements started on it and its share of the time, tab
+	// separated
+	bool writeProfile(const char* path, const LineProfile& profile, const std::string& source)
+	{
+		FILE* file = std::fopen(path, "w");
+		if (file == nullptr)
+			return false;
+
+		double total = 0.0;
+		for (double time : profile.Time)
+			total += time;
+
+		std::fprintf(file, "line\thits\ttime%%\tsource\n");
+		std::istringstream lines(source);
+		std::string text;
+		for (size_t line = 0; std::getline(lines, text); line++)
+		{
+			if (!text.empty() && text.back() == '\r')
+				text.pop_back();
+			long long hits = line < profile.Hits.size() ? profile.Hits[line] : 0;
+			double share = line < profile.Time.size() && total > 0.0 ? 100.0 * profile.Time[line] / total : 0.0;
+			std::fprintf(file, "%d\t%lld\t%.1f\t%s\n", (int)line + 1, hits, share, text.c_str());
+		}
+		return std::fclose(file) == 0;
+	}
+
+	// main(x) or main(theta) from start over width, numPoint points not counting the end, like
+	// Application::evaluate2D
+	bool evaluate2D(Picoc& pc, double& x, double start, double width, int numPoint, FILE* output, std::string& errorBuffer)
+	{
+		std::vector<double> xs(blockSize);
+		std::vector<double> ys(blockSize);
+		for (int first = 0; first < numPoint; first += blockSize)
+		{
+			TraceSpan span("sample batch", "pipeline");
+			int count = std::min(blockSize, numPoint - first);
+			for (int i = 0; i < count; i++)
+			{
+				xs[i] = (double)(first + i) / numPoint * width + start;
+			}
+
+			bool vectorDone = PicocEvaluateVector(pc, &xs[0], &ys[0], count);
+			for (int i = 0; i < count; i++)
+			{
+				if (!vectorDone)
+				{
+					x = xs[i];
+					ys[i] = PicocEvaluate(pc, 1, errorBuffer);
+					if (!errorBuffer.empty())
+						return false;
+				}
+				std::fprintf(output, "%.17g %.17g\n", xs[i], ys[i]);
+			}
+		}
+		return true;
+	}
+
+	// main(x, y) on a grid of curveWidth points a side from start over width on both axes, ends
+	// included, like Application::evaluate3D
+	bool evaluate3D(Picoc& pc, double* point, double start, double width, int curveWidth, FILE* output, std::string& errorBuffer)
+	{
+		std::vector<double> ys(curveWidth);
+		std::vector<double> zs(curveWidth);
+		for (int j = 0; j < curveWidth; j++)
+		{
+			ys[j] = (double)j / (curveWidth - 1) * width + start;
+		}
+
+		for (int i = 0; i < curveWidth; i++)
+		{
+			TraceSpan span("sample row", "pipeline");
+			point[0] = (double)i / (curveWidth - 1) * width + start;
+
+			PicocPrepareRow(pc, errorBuffer);
+			if (!errorBuffer.empty())
+				return false;
+
+			bool vectorDone = PicocEvaluateVector(pc, &ys[0], &zs[0], curveWidth);
+			for (int j = 0; j < curveWidth; j++)
+			{
+				if (!vectorDone)
+				{
+					point[1] = ys[j];
+					zs[j] = PicocEvaluate(pc, 2, errorBuffer);
+					if (!errorBuffer.empty())
+						return false;
+				}
+				std::fprintf(output, "%.17g %.17g %.17g\n", point[0], ys[j], zs[j]);
+			}
+			std::fprintf(output, "\n");
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Mode mode = MODE_CARTESIAN;
+	bool rangeSet = false;
+	double min = -10.0;
+	double max = 10.0;
+	int numPoint = 0;
+	std::vector<Tweakable> tweakables;
+	const char* outputPath = nullptr;
+	const char* tracePath = nullptr;
+	const char* profilePath = nullptr;
+	const char* sourcePath = nullptr;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+		bool hasValue = i + 1 < argc;
+		if ((option == "-m" || option == "--mode") && hasValue)
+		{
+			std::string value = argv[++i];
+			if (value == "cartesian")
+				mode = MODE_CARTESIAN;
+			else if (value == "polar")
+				mode = MODE_POLAR;
+			else if (value == "3d" || value == "3D")
+				mode = MODE_3D;
+			else
+			{
+				std::fprintf(stderr, "cplot-eval: unknown mode %s\n", value.c_str());
+				return 2;
+			}
+		}
+		else if ((option == "-r" || option == "--range") && hasValue)
+		{
+			if (!parseRange(argv[++i], min, max))
+			{
+				std::fprintf(stderr, "cplot-eval: bad range %s, expected MIN:MAX\n", argv[i]);
+				return 2;
+			}
+			rangeSet = true;
+		}
+		else if ((option == "-n" || option == "--points") && hasValue)
+		{
+			numPoint = std::atoi(argv[++i]);
+			if (numPoint <= 0)
+			{
+				std::fprintf(stderr, "cplot-eval: bad number of points %s\n", argv[i]);
+				return 2;
+			}
+		}
+		else if ((option == "-s" || option == "--set") && hasValue)
+		{
+			if (!parseTweakable(argv[++i], tweakables))
+			{
+				std::fprintf(stderr, "cplot-eval: bad tweakable %s, expected NAME=VALUE\n", argv[i]);
+				return 2;
+			}
+		}
+		else if ((option == "-o" || option == "--output") && hasValue)
+		{
+			outputPath = argv[++i];
+		}
+		else if (option == "--trace" && hasValue)
+		{
+			tracePath = argv[++i];
+		}
+		else if (option == "--profile" && hasValue)
+		{
+			profilePath = argv[++i];
+		}
+		else if (option == "--native")
+		{
+			extern bool gNativeCompile;
+			gNativeCompile = true;
+		}
+		else if (option == "-h" || option == "--help")
+		{
+			usage();
+			return 0;
+		}
+		else if (option[0] != '-' && sourcePath == nullptr)
+		{
+			sourcePath = argv[i];
+		}
+		else
+		{
+			usage();
+			return 2;
+		}
+	}
+	if (sourcePath == nullptr)
+	{
+		usage();
+		return 2;
+	}
+
+	std::ifstream file(sourcePath, std::ios::binary);
+	if (!file)
+	{
+		std::fprintf(stderr, "cplot-eval: can't read %s\n", sourcePath);
+		return 1;
+	}
+	std::stringstream stream;
+	stream << file.rdbuf();
+	// errors quote the program's lines from this until it's cleaned up
+	std::string source = stream.str();
+
+	if (mode == MODE_POLAR && !rangeSet)
+	{
+		min = 0.0;
+		max = 6.283185307179586;
+	}
+	if (numPoint == 0)
+	{
+		numPoint = mode == MODE_3D ? 33 : 1024;
+	}
+	if (mode == MODE_3D && numPoint < 2)
+	{
+		std::fprintf(stderr, "cplot-eval: a grid needs at least 2 points a side\n");
+		return 2;
+	}
+
+	FILE* output = stdout;
+	if (outputPath != nullptr)
+	{
+		output = std::fopen(outputPath, "w");
+		if (output == nullptr)
+		{
+			std::fprintf(stderr, "cplot-eval: can't write %s\n", outputPath);
+			return 1;
+		}
+	}
+
+	if (tracePath != nullptr)
+	{
+		if (!Trace::start(tracePath))
+		{
+			std::fprintf(stderr, "cplot-eval: can't write %s\n", tracePath);
+			return 1;
+		}
+		Trace::nameThread("main");
+	}
+
+	// the tweakables are read through pointers to their values from here on, the vector mustn't move
+	Picoc pc;
+	std::string errorBuffer;
+	double point[2] = { 0.0, 0.0 };
+	LineProfile profile;
+	PicocInitialise(&pc, point, mode == MODE_3D ? 2 : 1, source, tweakables, errorBuffer);
+	if (errorBuffer.empty())
+	{
+		if (profilePath != nullptr)
+			PicocProfile(pc, &profile);
+		if (mode == MODE_3D)
+			evaluate3D(pc, point, min, max - min, numPoint, output, errorBuffer);
+		else
+			evaluate2D(pc, point[0], min, max - min, numPoint, output, errorBuffer);
+	}
+	PicocCleanup(&pc);
+	Trace::stop();
+
+	bool written = std::fflush(output) == 0 && !std::ferror(output);
+	if (output != stdout)
+		written = std::fclose(output) == 0 && written;
+
+	if (!errorBuffer.empty())
+	{
+		std::fprintf(stderr, "%s:\n%s\n", sourcePath, errorBuffer.c_str());
+		return 1;
+	}
+	if (profilePath != nullptr && !writeProfile(profilePath, profile, source))
+	{
+		std::fprintf(stderr, "cplot-eval: can't write %s\n", profilePath);
+		return 1;
+	}
+	if (!written)
+	{
+		std::fprintf(stderr, "cplot-eval: couldn't write the samples\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,161 @@
+#include "Latency.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+	// the rows of the report, each the time from the stage before
+	const char* const stageNames[STAGE_COUNT] = { "edit", "queue", "initialise", "sample", "publish", "geometry", "present" };
+
+	double seconds(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<double>(duration).count();
+	}
+}
+
+void Latency::edit()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (!mEditPending)
+	{
+		mEditPending = true;
+		mEditTime = Clock::now();
+	}
+}
+
+void Latency::dequeue()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	Clock::time_point now = Clock::now();
+	mCurrent = Pass();
+	mCurrent.times[STAGE_EDIT] = mEditPending ? mEditTime : now;
+	mCurrent.reached[STAGE_EDIT] = true;
+	mCurrent.times[STAGE_DEQUEUE] = now;
+	mCurrent.reached[STAGE_DEQUEUE] = true;
+	mEditPending = false;
+	mEvaluating = true;
+}
+
+void Latency::mark(enumStage stage)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	Clock::time_point now = Clock::now();
+	if (stage == STAGE_INITIALISED)
+	{
+		if (mEvaluating)
+		{
+			mCurrent.times[stage] = now;
+			mCurrent.reached[stage] = true;
+		}
+	}
+	else if (stage == STAGE_PUBLISHED)
+	{
+		// an evaluation published before this one and never drawn is dropped, it never reached the screen
+		if (mEvaluating)
+		{
+			mCurrent.times[stage] = now;
+			mCurrent.reached[stage] = true;
+			mPublished = mCurrent;
+			mWaiting = true;
+			mEvaluating = false;
+		}
+	}
+	else if (stage == STAGE_GEOMETRY)
+	{
+		if (mWaiting && !mPublished.reached[stage])
+		{
+			mPublished.times[stage] = now;
+			mPublished.reached[stage] = true;
+		}
+	}
+}
+
+void Latency::sampled(int count)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (mEvaluating)
+	{
+		mCurrent.times[STAGE_SAMPLED] = Clock::now();
+		mCurrent.reached[STAGE_SAMPLED] = true;
+		mCurrent.samples = count;
+	}
+}
+
+void Latency::presented()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	Clock::time_point now = Clock::now();
+	if (mFramed)
+	{
+		if (mFrameTimes.size() == historySize)
+			mFrameTimes.erase(mFrameTimes.begin());
+		mFrameTimes.push_back(seconds(now - mLastFrame));
+	}
+	mLastFrame = now;
+	mFramed = true;
+
+	if (mWaiting)
+	{
+		// a stage that was skipped, like the geometry when the function list is shown, took no time
+		mPublished.times[STAGE_PRESENTED] = now;
+		mPublished.reached[STAGE_PRESENTED] = true;
+		for (int i = 1; i < STAGE_COUNT; i++)
+		{
+			if (!mPublished.reached[i])
+				mPublished.times[i] = mPublished.times[i - 1];
+		}
+
+		if (mPasses.size() == historySize)
+			mPasses.erase(mPasses.begin());
+		mPasses.push_back(mPublished);
+		mWaiting = false;
+	}
+}
+
+std::string Latency::report() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	std::string text = "latency ms\tp50\tp95\tp99\n";
+	char line[128];
+
+	std::vector<double> durations(mPasses.size());
+	for (int i = STAGE_DEQUEUE; i <= STAGE_COUNT; i++)
+	{
+		// the last row is the whole way from the edit to the screen
+		bool total = i == STAGE_COUNT;
+		for (size_t j = 0; j < mPasses.size(); j++)
+		{
+			const Pass& pass = mPasses[j];
+			durations[j] = total ? seconds(pass.times[STAGE_PRESENTED] - pass.times[STAGE_EDIT]) : seconds(pass.times[i] - pass.times[i - 1]);
+		}
+		std::snprintf(line, sizeof(line), "%s\t%.1f\t%.1f\t%.1f\n", total ? "total" : stageNames[i],
+			1000.0 * percentile(durations, 0.5), 1000.0 * percentile(durations, 0.95), 1000.0 * percentile(durations, 0.99));
+		text += line;
+	}
+
+	// how fast the points themselves were evaluated, once the program was ready
+	double samples = 0.0;
+	double time = 0.0;
+	for (const Pass& pass : mPasses)
+	{
+		samples += pass.samples;
+		time += seconds(pass.times[STAGE_SAMPLED] - pass.times[STAGE_INITIALISED]);
+	}
+	std::snprintf(line, sizeof(line), "samples/s\t%.3g\n", time > 0.0 ? samples / time : 0.0);
+	text += line;
+
+	std::snprintf(line, sizeof(line), "frame ms\t%.1f\t%.1f\t%.1f", 1000.0 * percentile(mFrameTimes, 0.5),
+		1000.0 * percentile(mFrameTimes, 0.95), 1000.0 * percentile(mFrameTimes, 0.99));
+	text += line;
+	return text;
+}
+
+// the value p of the way through the sorted values, the nearest one there is
+double Latency::percentile(std::vector<double> values, double p)
+{
+	if (values.empty())
+		return 0.0;
+	size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
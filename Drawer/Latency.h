@@ -0,0 +1,66 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// the stages an edit goes through before it's on screen, in order
+enum enumStage
+{
+	STAGE_EDIT,         // the source, a tweakable or the view changed
+	STAGE_DEQUEUE,      // the evaluation thread picked the change up
+	STAGE_INITIALISED,  // PicocInitialise is done
+	STAGE_SAMPLED,      // every point has been evaluated
+	STAGE_PUBLISHED,    // the points have been handed to the window
+	STAGE_GEOMETRY,     // the window has built the curve or the mesh from them
+	STAGE_PRESENTED,    // the frame showing them has been displayed
+	STAGE_COUNT
+};
+
+// how long edits take to reach the screen. Each evaluation is timestamped at every stage, from
+// whichever thread reaches it, and the last ones are kept for their percentiles, along with the
+// frame times and how fast points are evaluated
+class Latency
+{
+public:
+	// a change waiting to be evaluated. Several before the evaluation starts count from the first
+	void edit();
+	// the evaluation thread starts on the changes made so far
+	void dequeue();
+	// the evaluation in progress, or the one waiting to be drawn, has reached stage now
+	void mark(enumStage stage);
+	// the evaluation in progress has reached STAGE_SAMPLED, with count points
+	void sampled(int count);
+	// a frame has been displayed, with the last evaluation published on it if there was one
+	void presented();
+
+	// a line to each stage with its p50, p95 and p99 in milliseconds, then the points sampled per
+	// second and the frame time, the columns separated by tabs
+	std::string report() const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	static const int historySize = 128;
+
+	struct Pass
+	{
+		Clock::time_point times[STAGE_COUNT];
+		bool              reached[STAGE_COUNT];
+		int               samples;
+	};
+
+	static double percentile(std::vector<double> values, double p);
+
+	mutable std::mutex  mMutex;
+	bool                mEditPending = false;
+	Clock::time_point   mEditTime;
+	Pass                mCurrent = Pass();   // being evaluated
+	bool                mEvaluating = false;
+	Pass                mPublished = Pass(); // evaluated and waiting for a frame
+	bool                mWaiting = false;
+	Clock::time_point   mLastFrame;
+	bool                mFramed = false;
+	std::vector<Pass>   mPasses;             // the last historySize finished, oldest first
+	std::vector<double> mFrameTimes;         // the last historySize, in seconds, oldest first
+};
@@ -0,0 +1,143 @@
+#include "LodMesh.h"
+#include <cmath>
+#include <algorithm>
+
+bool LodMesh::build(const float* heights, int size)
+{
+	mSize = 0;
+	mErrors.clear();
+	if (size < 3 || ((size - 1) & (size - 2)) != 0)
+		return false;
+
+	mSize = size;
+	mErrors.assign(size * size, 0.f);
+	const int last = size - 1;
+	measure(heights, last * size, last * size + last, 0);
+	measure(heights, last, 0, last * size + last);
+
+	// from the smallest squares up, a point's error is also the error of any point which can't
+	// be there without it, so the triangles around it are split first
+	for (int s = 2; s <= last; s *= 2)
+	{
+		const int half = s / 2;
+
+		// the middle of each edge of a square needs the middles of the squares either side
+		for (int i = half; i < last; i += s)
+		{
+			for (int j = 0; j <= last; j += s)
+			{
+				if (j > 0)
+					saturate(i, j - half, mErrors[i * size + j]);
+				if (j < last)
+					saturate(i, j + half, mErrors[i * size + j]);
+			}
+		}
+		for (int i = 0; i <= last; i += s)
+		{
+			for (int j = half; j < last; j += s)
+			{
+				if (i > 0)
+					saturate(i - half, j, mErrors[i * size + j]);
+				if (i < last)
+					saturate(i + half, j, mErrors[i * size + j]);
+			}
+		}
+
+		// the middle of each square needs the two of its corners which are the middles of the
+		// edges of the square it's a quarter of
+		for (int i = half; i < last && s < last; i += s)
+		{
+			for (int j = half; j < last; j += s)
+			{
+				for (int corner = 0; corner < 4; corner++)
+				{
+					int ci = (corner & 1) ? i + half : i - half;
+					int cj = (corner & 2) ? j + half : j - half;
+					if ((ci % (2 * s) == s) != (cj % (2 * s) == s))
+						saturate(ci, cj, mErrors[i * size + j]);
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+// each triangle that can be split, at the middle of its long edge from left to right, gives
+// that point how far the grid's points inside it are from it. A point of a hole is always kept,
+// so the hole stays the shape it was sampled
+void LodMesh::measure(const float* heights, int apex, int left, int right)
+{
+	int i = left / mSize + right / mSize;
+	int j = left % mSize + right % mSize;
+	if (i % 2 != 0 || j % 2 != 0)
+		return;
+
+	const int x[3] = { apex / mSize, left / mSize, right / mSize };
+	const int y[3] = { apex % mSize, left % mSize, right % mSize };
+	const float z[3] = { heights[apex], heights[left], heights[right] };
+	const int area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	float error = 0.f;
+	for (int pi = std::min(x[0], std::min(x[1], x[2])); pi <= std::max(x[0], std::max(x[1], x[2])); pi++)
+	{
+		for (int pj = std::min(y[0], std::min(y[1], y[2])); pj <= std::max(y[0], std::max(y[1], y[2])); pj++)
+		{
+			// the point's weights for the apex and the left end, times the area
+			int a = (x[1] - pi) * (y[2] - pj) - (y[1] - pj) * (x[2] - pi);
+			int b = (x[2] - pi) * (y[0] - pj) - (y[2] - pj) * (x[0] - pi);
+			if (a < 0 || b < 0 || a + b > area)
+				continue;
+
+			float e = std::fabs(heights[pi * mSize + pj] - (a * z[0] + b * z[1] + (area - a - b) * z[2]) / area);
+			error = std::isnan(e) ? INFINITY : std::fmax(error, e);
+		}
+	}
+
+	int middle = (i / 2) * mSize + j / 2;
+	if (!(mErrors[middle] >= error))
+		mErrors[middle] = error;
+
+	measure(heights, middle, apex, left);
+	measure(heights, middle, right, apex);
+}
+
+void LodMesh::saturate(int i, int j, float error)
+{
+	float& saturated = mErrors[i * mSize + j];
+	if (error > saturated)
+		saturated = error;
+}
+
+void LodMesh::triangulate(float maxError, std::vector<unsigned>& indices) const
+{
+	indices.clear();
+	if (mSize == 0)
+		return;
+
+	// the two halves of the whole grid either side of a diagonal, counterclockwise
+	const int last = mSize - 1;
+	bisect(last * mSize, last * mSize + last, 0, maxError, indices);
+	bisect(last, 0, last * mSize + last, maxError, indices);
+}
+
+// the triangle is split in two at the middle of its long edge, from left to right, if the point
+// there is too far from it. Otherwise, or once it covers half a cell, it's drawn
+void LodMesh::bisect(int apex, int left, int right, float maxError, std::vector<unsigned>& indices) const
+{
+	int i = left / mSize + right / mSize;
+	int j = left % mSize + right % mSize;
+	if (i % 2 == 0 && j % 2 == 0)
+	{
+		int middle = (i / 2) * mSize + j / 2;
+		if (mErrors[middle] > maxError)
+		{
+			bisect(middle, apex, left, maxError, indices);
+			bisect(middle, right, apex, maxError, indices);
+			return;
+		}
+	}
+
+	indices.push_back(apex);
+	indices.push_back(left);
+	indices.push_back(right);
+}
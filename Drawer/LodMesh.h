@@ -0,0 +1,24 @@
+#pragma once
+#include <vector>
+
+// a surface sampled on a square grid of 2^n + 1 points a side, drawn with fewer triangles where
+// it's flat. The grid is split into right triangles by bisecting their longest edge, the way a
+// restricted quadtree is, so neighbouring triangles always meet at whole edges and leave no cracks
+class LodMesh
+{
+public:
+	// the grid's heights, point (i, j) at i * size + j. Returns false if size isn't 2^n + 1
+	bool build(const float* heights, int size);
+	// the triangles needed for no point left out to be further than maxError from the surface,
+	// as indices into the grid, three to each
+	void triangulate(float maxError, std::vector<unsigned>& indices) const;
+	int  size() const { return mSize; }
+
+private:
+	void measure(const float* heights, int apex, int left, int right);
+	void saturate(int i, int j, float error);
+	void bisect(int apex, int left, int right, float maxError, std::vector<unsigned>& indices) const;
+
+	int                mSize = 0;
+	std::vector<float> mErrors;     // the largest error of each point and every point that needs it
+};
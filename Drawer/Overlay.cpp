@@ -0,0 +1,136 @@
+#include "Overlay.h"
+#include <cmath>
+
+namespace
+{
+	// a marker is a disc with a border, as wide as markerSize pixels all told
+	const int   markerSize = 8;
+	const float markerRadius = 2.5f;
+	const float markerBorder = 1.f;
+}
+
+void Overlay::addText(const std::string& str, const sf::Vector2f& position, unsigned size, const sf::Color& color)
+{
+	if (mFont == nullptr)
+		return;
+
+	// the same layout as sf::Text's: the first line's baseline is size pixels down, whitespace
+	// only moves along and kerning applies between every pair of characters
+	std::vector<sf::Vertex>& quads = mText[size];
+	const float space = (float)mFont->getGlyph(L' ', size, false).advance;
+	const float lineSpacing = mFont->getLineSpacing(size);
+	float x = position.x;
+	float y = position.y + size;
+	sf::Uint32 previous = 0;
+	for (unsigned char c : str)
+	{
+		sf::Uint32 current = c;
+		x += mFont->getKerning(previous, current, size);
+		previous = current;
+
+		if (current == ' ')
+		{
+			x += space;
+			continue;
+		}
+		if (current == '\t')
+		{
+			x += 4.f * space;
+			continue;
+		}
+		if (current == '\n')
+		{
+			x = position.x;
+			y += lineSpacing;
+			continue;
+		}
+
+		const sf::Glyph& glyph = mFont->getGlyph(current, size, false);
+		float left = x + glyph.bounds.left;
+		float top = y + glyph.bounds.top;
+		float right = left + glyph.bounds.width;
+		float bottom = top + glyph.bounds.height;
+		float u1 = (float)glyph.textureRect.left;
+		float v1 = (float)glyph.textureRect.top;
+		float u2 = (float)(glyph.textureRect.left + glyph.textureRect.width);
+		float v2 = (float)(glyph.textureRect.top + glyph.textureRect.height);
+		quads.push_back(sf::Vertex(sf::Vector2f(left, top), color, sf::Vector2f(u1, v1)));
+		quads.push_back(sf::Vertex(sf::Vector2f(right, top), color, sf::Vector2f(u2, v1)));
+		quads.push_back(sf::Vertex(sf::Vector2f(right, bottom), color, sf::Vector2f(u2, v2)));
+		quads.push_back(sf::Vertex(sf::Vector2f(left, bottom), color, sf::Vector2f(u1, v2)));
+
+		x += glyph.advance;
+	}
+}
+
+void Overlay::addMarker(const sf::Vector2f& position)
+{
+	// every marker is the same quad of the same texture, moved
+	const float half = 0.5f * markerSize;
+	const float size = (float)markerSize;
+	mMarkers.push_back(sf::Vertex(position + sf::Vector2f(-half, -half), sf::Vector2f(0.f, 0.f)));
+	mMarkers.push_back(sf::Vertex(position + sf::Vector2f(half, -half), sf::Vector2f(size, 0.f)));
+	mMarkers.push_back(sf::Vertex(position + sf::Vector2f(half, half), sf::Vector2f(size, size)));
+	mMarkers.push_back(sf::Vertex(position + sf::Vector2f(-half, half), sf::Vector2f(0.f, size)));
+}
+
+void Overlay::draw(sf::RenderTarget& target)
+{
+	if (!mMarkers.empty())
+	{
+		if (mMarkerTexture.getSize().x == 0)
+			createMarker();
+		target.draw(mMarkers.data(), mMarkers.size(), sf::Quads, sf::RenderStates(&mMarkerTexture));
+		mMarkers.clear();
+	}
+
+	// the labels go over the markers. The vectors are kept for their memory
+	for (auto& it : mText)
+	{
+		if (!it.second.empty() && mFont != nullptr)
+			target.draw(it.second.data(), it.second.size(), sf::Quads, sf::RenderStates(&mFont->getTexture(it.first)));
+		it.second.clear();
+	}
+}
+
+// the blue disc with a cyan border points were drawn with as circles, each pixel's colour
+// blended by how much of it is covered
+void Overlay::createMarker()
+{
+	const int samples = 4;
+	const float centre = 0.5f * markerSize;
+	sf::Image image;
+	image.create(markerSize, markerSize, sf::Color::Transparent);
+	for (int y = 0; y < markerSize; y++)
+	{
+		for (int x = 0; x < markerSize; x++)
+		{
+			int inside = 0;
+			int border = 0;
+			for (int sy = 0; sy < samples; sy++)
+			{
+				for (int sx = 0; sx < samples; sx++)
+				{
+					float dx = x + (sx + 0.5f) / samples - centre;
+					float dy = y + (sy + 0.5f) / samples - centre;
+					float distance = std::sqrt(dx * dx + dy * dy);
+					if (distance <= markerRadius)
+						inside++;
+					else if (distance <= markerRadius + markerBorder)
+						border++;
+				}
+			}
+			if (inside + border == 0)
+				continue;
+
+			// the colour of the parts covered, as opaque as the share of the pixel they cover
+			sf::Color color;
+			color.r = 0;
+			color.g = (sf::Uint8)(255 * border / (inside + border));
+			color.b = 255;
+			color.a = (sf::Uint8)(255 * (inside + border) / (samples * samples));
+			image.setPixel(x, y, color);
+		}
+	}
+	mMarkerTexture.loadFromImage(image);
+}
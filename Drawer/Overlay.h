@@ -0,0 +1,28 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <map>
+#include <vector>
+
+// the text and point markers drawn over a graph, gathered through the frame and drawn with one
+// call for each size of text and one for all the markers, however many there are
+class Overlay
+{
+public:
+	void setFont(const sf::Font& font) { mFont = &font; }
+
+	// a label laid out the way sf::Text would, its top left at position
+	void addText(const std::string& str, const sf::Vector2f& position, unsigned size, const sf::Color& color = sf::Color::White);
+	// a point marker centred on position
+	void addMarker(const sf::Vector2f& position);
+
+	// draws everything added since the last time and forgets it
+	void draw(sf::RenderTarget& target);
+
+private:
+	void createMarker();
+
+	const sf::Font*                              mFont = nullptr;
+	std::map<unsigned, std::vector<sf::Vertex>> mText;    // glyph quads for each size of text
+	std::vector<sf::Vertex>                      mMarkers;
+	sf::Texture                                  mMarkerTexture;
+};
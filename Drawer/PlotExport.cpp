@@ -0,0 +1,313 @@
+#include "PlotExport.h"
+#include "Raster.h"
+#include "LodMesh.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+	// the graph on screen is laid out for a window this many pixels high
+	const float windowHeight = 700.f;
+
+	const std::uint32_t white = Raster::color(255, 255, 255);
+	const std::uint32_t red = Raster::color(255, 0, 0);
+	const std::uint32_t green = Raster::color(0, 255, 0);
+	const std::uint32_t blue = Raster::color(0, 0, 255);
+
+	// a turn by angle degrees about the axis (x, y, z), as glRotatef makes it
+	void rotation(float angle, float x, float y, float z, float r[3][3])
+	{
+		float length = std::sqrt(x * x + y * y + z * z);
+		x /= length;
+		y /= length;
+		z /= length;
+		float c = std::cos(angle * 3.14159265f / 180.f);
+		float s = std::sin(angle * 3.14159265f / 180.f);
+		float t = 1.f - c;
+		float m[3][3] =
+		{
+			{ t * x * x + c, t * x * y - s * z, t * x * z + s * y },
+			{ t * x * y + s * z, t * y * y + c, t * y * z - s * x },
+			{ t * x * z - s * y, t * y * z + s * x, t * z * z + c }
+		};
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				r[i][j] = m[i][j];
+	}
+
+	void apply(const float r[3][3], const float v[3], float out[3])
+	{
+		for (int i = 0; i < 3; i++)
+			out[i] = r[i][0] * v[0] + r[i][1] * v[1] + r[i][2] * v[2];
+	}
+
+	// the curve, the axes with their values and the marked points, as showGraph draws them
+	void draw2D(const PlotExport& plot, Raster& raster, float unit)
+	{
+		// nothing was plotted, the picture is left blank
+		if (plot.curve.size() < 2)
+			return;
+
+		const float screenLeft = 30.f * unit;
+		const float screenTop = 50.f * unit;
+		const float screenWidth = raster.width() - 80.f * unit;
+		const float screenHeight = raster.height() - 100.f * unit;
+		auto toScreen = [&](float x, float y, float* out)
+		{
+			out[0] = screenLeft + (x - plot.left) / plot.width * screenWidth;
+			out[1] = screenTop + (1.f - (y - plot.top) / plot.height) * screenHeight;
+		};
+
+		// separate segments are broken apart by NaNs, to be drawn as one line
+		std::vector<float> points;
+		for (size_t i = 0; i + 1 < plot.curve.size(); i += 2)
+		{
+			float p[2];
+			toScreen(plot.curve[i], plot.curve[i + 1], p);
+			points.insert(points.end(), p, p + 2);
+			if (plot.segments && (i / 2) % 2 == 1)
+				points.insert(points.end(), 2, NAN);
+		}
+		raster.addLine(points.data(), (int)points.size() / 2, unit, white);
+
+		// the axes through the origin, with a mark and a label for each value along them
+		const float graduationSize = 2.f * unit;
+		const float middleY = 1.f + plot.top / plot.height;
+		const float middleX = -plot.left / plot.width;
+		const float axisY = screenTop + middleY * screenHeight;
+		const float axisX = screenLeft + middleX * screenWidth;
+		std::vector<float> ticks =
+		{
+			screenLeft, axisY, screenLeft + screenWidth, axisY, NAN, NAN,
+			axisX, screenTop - 20.f * unit, axisX, screenTop + screenHeight + 50.f * unit, NAN, NAN
+		};
+
+		char str[32];
+		for (float x : PlotExport::graduation(plot.left, plot.left + plot.width))
+		{
+			snprintf(str, sizeof(str), "%g", x);
+			float screenX = screenLeft + (x - plot.left) / plot.width * screenWidth;
+			raster.addText(str, screenX, axisY - graduationSize, 12.f * unit, white);
+			ticks.insert(ticks.end(), { screenX, axisY + graduationSize, screenX, axisY - graduationSize, NAN, NAN });
+		}
+		for (float y : PlotExport::graduation(plot.top, plot.top + plot.height))
+		{
+			snprintf(str, sizeof(str), "%g", y);
+			float screenY = screenTop + (1.f - (y - plot.top) / plot.height) * screenHeight;
+			raster.addText(str, axisX + graduationSize + unit, screenY - 5.f * unit, 12.f * unit, white);
+			ticks.insert(ticks.end(), { axisX + graduationSize, screenY, axisX - graduationSize, screenY, NAN, NAN });
+		}
+		raster.addLine(ticks.data(), (int)ticks.size() / 2, unit, white);
+
+		// a blue dot with a cyan border for each point
+		points.clear();
+		for (size_t i = 0; i + 1 < plot.markers.size(); i += 2)
+		{
+			float p[2];
+			toScreen(plot.markers[i], plot.markers[i + 1], p);
+			points.insert(points.end(), { p[0], p[1], NAN, NAN });
+		}
+		raster.addLine(points.data(), (int)points.size() / 2, 7.f * unit, Raster::color(0, 255, 255));
+		raster.addLine(points.data(), (int)points.size() / 2, 5.f * unit, blue);
+	}
+
+	// the surface, lit and seen from where show3DGraph's camera is, with its axes and their ranges
+	void draw3D(const PlotExport& plot, Raster& raster, float unit)
+	{
+		const int size = plot.size;
+		const int count = size * size;
+		float minZ = 0.f, maxZ = 0.f;
+		for (int i = 0; i < count; i++)
+		{
+			minZ = std::fmin(minZ, plot.heights[i]);
+			maxZ = std::fmax(maxZ, plot.heights[i]);
+		}
+		float deltaZ = (maxZ - minZ > 1e-7f) ? 1.f / (maxZ - minZ) : 0.f;
+
+		// the same view as the window's: moved 4 back, tilted 30 degrees, turned and scaled by 3,
+		// through a frustum from 1 to 500 with a 90 degree field of view
+		const float scale = 3.f;
+		const float ratio = (float)raster.width() / raster.height();
+		const float zNear = 1.f, zFar = 500.f;
+		float tilt[3][3], turn[3][3], view[3][3];
+		rotation(30.f, -1.f, 0.2f, 0.f, tilt);
+		rotation(plot.turn, 0.f, 0.f, 1.f, turn);
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				view[i][j] = tilt[i][0] * turn[0][j] + tilt[i][1] * turn[1][j] + tilt[i][2] * turn[2][j];
+
+		auto project = [&](const float p[3], float eye[3], float* screen)
+		{
+			float scaled[3] = { p[0] * scale, p[1] * scale, p[2] * scale };
+			apply(view, scaled, eye);
+			eye[2] -= 4.f;
+			float w = -eye[2];
+			screen[0] = (eye[0] / ratio / w + 1.f) * 0.5f * raster.width();
+			screen[1] = (1.f - eye[1] / w) * 0.5f * raster.height();
+			screen[2] = (-(zFar + zNear) / (zFar - zNear) * eye[2] - 2.f * zFar * zNear / (zFar - zNear)) / w;
+		};
+
+		std::vector<std::uint32_t> colors(count);
+		Colormap::get(plot.colormap).apply(plot.heights.data(), count, minZ, (deltaZ > 0.f) ? maxZ : minZ, (unsigned char*)colors.data());
+
+		// GL lights each point from (10, 0, 0) before the camera, the glScalef shrinking the
+		// normals by 3 and the diffuse light of 3 making up for it, over an ambient light of 0.2
+		bool exact = plot.slopes.size() == 2 * (size_t)count;
+		std::vector<float> points(3 * count);
+		for (int x = 0; x < size; x++)
+		{
+			for (int y = 0; y < size; y++)
+			{
+				int i = x * size + y;
+				float slope[2] = { 0.f, 0.f };
+				if (exact)
+				{
+					slope[0] = plot.slopes[2 * i];
+					slope[1] = plot.slopes[2 * i + 1];
+				}
+				else if (x > 0 && y > 0 && x < size - 1 && y < size - 1)
+				{
+					slope[0] = (plot.heights[i + size] - plot.heights[i - size]) * (0.5f * (size - 1));
+					slope[1] = (plot.heights[i + 1] - plot.heights[i - 1]) * (0.5f * (size - 1));
+				}
+				float normal[3] = { -slope[0] * 0.5f * deltaZ, -slope[1] * 0.5f * deltaZ, 1.f };
+				float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + 1.f);
+				for (float& n : normal)
+					n /= length;
+
+				float p[3] = { (float)x / (size - 1) - 0.5f, (float)y / (size - 1) - 0.5f, ((plot.heights[i] - minZ) * deltaZ - 0.5f) * 0.5f };
+				float eye[3], eyeNormal[3];
+				project(p, eye, &points[3 * i]);
+				apply(view, normal, eyeNormal);
+				float light[3] = { 10.f - eye[0], -eye[1], -eye[2] };
+				float distance = std::sqrt(light[0] * light[0] + light[1] * light[1] + light[2] * light[2]);
+				float diffuse = (eyeNormal[0] * light[0] + eyeNormal[1] * light[1] + eyeNormal[2] * light[2]) / distance;
+				float shade = std::fmin(0.2f + std::fmax(diffuse, 0.f), 1.f);
+
+				unsigned char* rgba = (unsigned char*)&colors[i];
+				for (int channel = 0; channel < 3; channel++)
+					rgba[channel] = (unsigned char)(rgba[channel] * shade + 0.5f);
+			}
+		}
+
+		// as few triangles as keep the surface within a pixel of every point, at this size
+		LodMesh mesh;
+		std::vector<unsigned> indices;
+		float pixelsPerUnit = scale * 0.5f * deltaZ * 0.5f * raster.height() / 1.75f;
+		if (mesh.build(plot.heights.data(), size))
+		{
+			mesh.triangulate((pixelsPerUnit > 0.f) ? 1.f / pixelsPerUnit : INFINITY, indices);
+		}
+		else
+		{
+			for (int x = 0; x < size - 1; x++)
+			{
+				for (int y = 0; y < size - 1; y++)
+				{
+					unsigned p0 = x * size + y, p1 = p0 + size, p2 = p1 + 1, p3 = p0 + 1;
+					indices.insert(indices.end(), { p0, p1, p2, p2, p3, p0 });
+				}
+			}
+		}
+		raster.addTriangles(points.data(), colors.data(), indices.data(), (int)indices.size() / 3);
+
+		// the axes with an arrow at their ends, hidden where the surface is in front of them
+		const float axisSize = 0.85f;
+		const std::uint32_t axisColors[3] = { red, green, blue };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			int across = (axis == 0) ? 1 : 0;
+			float ends[4][3] = {};
+			ends[0][axis] = -axisSize;
+			ends[1][axis] = axisSize;
+			ends[2][axis] = axisSize - 0.07f;
+			ends[2][across] = 0.07f;
+			ends[3][axis] = axisSize - 0.07f;
+			ends[3][across] = -0.07f;
+
+			// from one end to the other, out to one side of the arrow and back to the other
+			const int order[5] = { 0, 1, 2, 1, 3 };
+			float line[10], depths[5];
+			for (int k = 0; k < 5; k++)
+			{
+				float eye[3], screen[3];
+				project(ends[order[k]], eye, screen);
+				line[2 * k] = screen[0];
+				line[2 * k + 1] = screen[1];
+				depths[k] = screen[2];
+			}
+			raster.addLine(line, 5, unit, axisColors[axis], depths);
+		}
+
+		// the ranges go in the bottom right corner, moved in as far as the longest needs
+		char captions[3][256];
+		snprintf(captions[0], sizeof(captions[0]), "Axis Z: %g to %g", minZ, maxZ);
+		snprintf(captions[1], sizeof(captions[1]), "Axis Y: %g to %g", plot.top, plot.top + plot.height);
+		snprintf(captions[2], sizeof(captions[2]), "Axis X: %g to %g", plot.left, plot.left + plot.width);
+		const float textSize = 14.f * unit;
+		float textX = raster.width() - 230.f * unit;
+		for (const char* caption : captions)
+			textX = std::fmin(textX, raster.width() - Raster::textWidth(caption, textSize) - 10.f * unit);
+		const std::uint32_t captionColors[3] = { blue, green, red };
+		for (int k = 0; k < 3; k++)
+			raster.addText(captions[k], textX, raster.height() - (60.f + 30.f * k) * unit, textSize, captionColors[k]);
+	}
+}
+
+bool PlotExport::save(const std::string& path, int imageWidth, int imageHeight, int threads) const
+{
+	if (imageWidth <= 0 || imageHeight <= 0)
+		return false;
+
+	Raster raster(imageWidth, imageHeight, Raster::color(0, 0, 0));
+	const float unit = imageHeight / windowHeight;
+	if (size >= 2 && heights.size() == (size_t)size * size)
+		draw3D(*this, raster, unit);
+	else
+		draw2D(*this, raster, unit);
+
+	raster.render(threads);
+	return raster.writePng(path, threads);
+}
+
+std::vector<float> PlotExport::graduation(float min, float max)
+{
+	float delta = max - min;
+	const static double mul[] = { 1.0, 2.0, 5.0 };
+	std::vector<float> axis;
+
+	bool ok = false;
+	double step = FLT_MAX;
+	for (int e = -7; e < 9; e++)
+	{
+		double a = pow(10.0, e);
+
+		for (int i = 0; i < 3; i++)
+		{
+			double b = a * mul[i];
+
+			if (delta / b <= 10)
+			{
+				step = b;
+				ok = true;
+				break;
+			}
+		}
+		if (ok)
+		{
+			break;
+		}
+	}
+
+	double i = floor(min / step) * step;
+	for (; i < max + 0.1*step; i += step)
+	{
+		if (std::abs(i) > 1e-9)
+		{
+			axis.push_back((float)i);
+		}
+	}
+
+	return axis;
+}
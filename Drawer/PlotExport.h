@@ -0,0 +1,39 @@
+#pragma once
+#include "Colormap.h"
+#include <string>
+#include <vector>
+
+// a plot saved as an image without a window, for sizes no screen has. It's laid out like the
+// graph on screen, with the lines and text scaled up with the image's height
+struct PlotExport
+{
+	// the part of the graph shown, like Application's mGraphRect: x from left over width, y from
+	// top over height
+	float left = -10.f;
+	float top = -10.f;
+	float width = 20.f;
+	float height = 20.f;
+
+	// a curve's points, x then y in the graph's coordinates. A NaN point breaks it, and with
+	// segments set they're taken in pairs, each pair a separate segment
+	std::vector<float> curve;
+	bool               segments = false;
+	// the points marked on the graph, x then y
+	std::vector<float> markers;
+
+	// a surface instead, size points a side over the graph's width the way evaluate3D samples
+	// it, point (i, j) at i * size + j. Its slopes along both axes of the grid, which run from 0
+	// to 1, may be given two to a point, otherwise they're estimated from the heights
+	int                size = 0;
+	std::vector<float> heights;
+	std::vector<float> slopes;
+	float              turn = 0.f;   // how far the surface has turned about its vertical axis, in degrees
+	enumColormap       colormap = COLORMAP_RAINBOW;
+
+	// draws the plot imageWidth by imageHeight pixels and saves it as a PNG, with as many
+	// threads as there are processors when threads is 0
+	bool save(const std::string& path, int imageWidth, int imageHeight, int threads = 0) const;
+
+	// the values between min and max to mark along an axis, at a round step
+	static std::vector<float> graduation(float min, float max);
+};
@@ -0,0 +1,802 @@
+#include "Raster.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+namespace
+{
+	// a 5 by 7 pixel font for the printable ASCII characters, from space on. Each byte is a column,
+	// its lowest bit the top pixel
+	const unsigned char font[95][5] =
+	{
+		{ 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5F, 0x00, 0x00 }, { 0x00, 0x07, 0x00, 0x07, 0x00 }, { 0x14, 0x7F, 0x14, 0x7F, 0x14 },
+		{ 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 }, { 0x36, 0x49, 0x56, 0x20, 0x50 }, { 0x00, 0x00, 0x07, 0x00, 0x00 },
+		{ 0x00, 0x1C, 0x22, 0x41, 0x00 }, { 0x00, 0x41, 0x22, 0x1C, 0x00 }, { 0x2A, 0x1C, 0x7F, 0x1C, 0x2A }, { 0x08, 0x08, 0x3E, 0x08, 0x08 },
+		{ 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 }, { 0x00, 0x60, 0x60, 0x00, 0x00 }, { 0x20, 0x10, 0x08, 0x04, 0x02 },
+		{ 0x3E, 0x51, 0x49, 0x45, 0x3E }, { 0x00, 0x42, 0x7F, 0x40, 0x00 }, { 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4B, 0x31 },
+		{ 0x18, 0x14, 0x12, 0x7F, 0x10 }, { 0x27, 0x45, 0x45, 0x45, 0x39 }, { 0x3C, 0x4A, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 },
+		{ 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1E }, { 0x00, 0x36, 0x36, 0x00, 0x00 }, { 0x00, 0x56, 0x36, 0x00, 0x00 },
+		{ 0x08, 0x14, 0x22, 0x41, 0x00 }, { 0x14, 0x14, 0x14, 0x14, 0x14 }, { 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 },
+		{ 0x32, 0x49, 0x79, 0x41, 0x3E }, { 0x7E, 0x11, 0x11, 0x11, 0x7E }, { 0x7F, 0x49, 0x49, 0x49, 0x36 }, { 0x3E, 0x41, 0x41, 0x41, 0x22 },
+		{ 0x7F, 0x41, 0x41, 0x22, 0x1C }, { 0x7F, 0x49, 0x49, 0x49, 0x41 }, { 0x7F, 0x09, 0x09, 0x09, 0x01 }, { 0x3E, 0x41, 0x49, 0x49, 0x7A },
+		{ 0x7F, 0x08, 0x08, 0x08, 0x7F }, { 0x00, 0x41, 0x7F, 0x41, 0x00 }, { 0x20, 0x40, 0x41, 0x3F, 0x01 }, { 0x7F, 0x08, 0x14, 0x22, 0x41 },
+		{ 0x7F, 0x40, 0x40, 0x40, 0x40 }, { 0x7F, 0x02, 0x0C, 0x02, 0x7F }, { 0x7F, 0x04, 0x08, 0x10, 0x7F }, { 0x3E, 0x41, 0x41, 0x41, 0x3E },
+		{ 0x7F, 0x09, 0x09, 0x09, 0x06 }, { 0x3E, 0x41, 0x51, 0x21, 0x5E }, { 0x7F, 0x09, 0x19, 0x29, 0x46 }, { 0x46, 0x49, 0x49, 0x49, 0x31 },
+		{ 0x01, 0x01, 0x7F, 0x01, 0x01 }, { 0x3F, 0x40, 0x40, 0x40, 0x3F }, { 0x1F, 0x20, 0x40, 0x20, 0x1F }, { 0x3F, 0x40, 0x38, 0x40, 0x3F },
+		{ 0x63, 0x14, 0x08, 0x14, 0x63 }, { 0x07, 0x08, 0x70, 0x08, 0x07 }, { 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x7F, 0x41, 0x41, 0x00 },
+		{ 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x7F, 0x00 }, { 0x04, 0x02, 0x01, 0x02, 0x04 }, { 0x40, 0x40, 0x40, 0x40, 0x40 },
+		{ 0x00, 0x01, 0x02, 0x04, 0x00 }, { 0x20, 0x54, 0x54, 0x54, 0x78 }, { 0x7F, 0x48, 0x44, 0x44, 0x38 }, { 0x38, 0x44, 0x44, 0x44, 0x20 },
+		{ 0x38, 0x44, 0x44, 0x48, 0x7F }, { 0x38, 0x54, 0x54, 0x54, 0x18 }, { 0x08, 0x7E, 0x09, 0x01, 0x02 }, { 0x0C, 0x52, 0x52, 0x52, 0x3E },
+		{ 0x7F, 0x08, 0x04, 0x04, 0x78 }, { 0x00, 0x44, 0x7D, 0x40, 0x00 }, { 0x20, 0x40, 0x44, 0x3D, 0x00 }, { 0x7F, 0x10, 0x28, 0x44, 0x00 },
+		{ 0x00, 0x41, 0x7F, 0x40, 0x00 }, { 0x7C, 0x04, 0x18, 0x04, 0x78 }, { 0x7C, 0x08, 0x04, 0x04, 0x78 }, { 0x38, 0x44, 0x44, 0x44, 0x38 },
+		{ 0x7C, 0x14, 0x14, 0x14, 0x08 }, { 0x08, 0x14, 0x14, 0x18, 0x7C }, { 0x7C, 0x08, 0x04, 0x04, 0x08 }, { 0x48, 0x54, 0x54, 0x54, 0x20 },
+		{ 0x04, 0x3F, 0x44, 0x40, 0x20 }, { 0x3C, 0x40, 0x40, 0x20, 0x7C }, { 0x1C, 0x20, 0x40, 0x20, 0x1C }, { 0x3C, 0x40, 0x30, 0x40, 0x3C },
+		{ 0x44, 0x28, 0x10, 0x28, 0x44 }, { 0x0C, 0x50, 0x50, 0x50, 0x3C }, { 0x44, 0x64, 0x54, 0x4C, 0x44 }, { 0x00, 0x08, 0x36, 0x41, 0x00 },
+		{ 0x00, 0x00, 0x7F, 0x00, 0x00 }, { 0x00, 0x41, 0x36, 0x08, 0x00 }, { 0x08, 0x04, 0x08, 0x10, 0x08 }
+	};
+
+	// a letter is 6 font pixels wide with the gap after it, a line of text 10 high
+	const float fontColumns = 6.f;
+	const float fontRows = 10.f;
+
+	void unpack(std::uint32_t color, float rgba[4])
+	{
+		unsigned char bytes[4];
+		std::memcpy(bytes, &color, sizeof(bytes));
+		for (int i = 0; i < 4; i++)
+			rgba[i] = bytes[i];
+	}
+
+	std::uint32_t pack(const float rgba[4])
+	{
+		unsigned char bytes[4];
+		for (int i = 0; i < 4; i++)
+			bytes[i] = (unsigned char)std::min(std::max(rgba[i] + 0.5f, 0.f), 255.f);
+		std::uint32_t color;
+		std::memcpy(&color, bytes, sizeof(color));
+		return color;
+	}
+
+	int threadCount(int threads)
+	{
+		if (threads <= 0)
+			threads = (int)std::thread::hardware_concurrency();
+		return std::max(threads, 1);
+	}
+
+	// runs work(i) for i from 0 to count, handing the next one to whichever thread is free
+	template <typename Work> void share(int count, int threads, Work work)
+	{
+		std::atomic<int> next(0);
+		auto run = [&]
+		{
+			for (int i = next++; i < count; i = next++)
+				work(i);
+		};
+
+		std::vector<std::thread> workers;
+		for (int i = 1; i < std::min(threads, count); i++)
+			workers.push_back(std::thread(run));
+		run();
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+
+	//***************************************************
+	// PNG
+	//***************************************************
+
+	struct BitWriter
+	{
+		std::vector<unsigned char>& out;
+		std::uint32_t               bits = 0;
+		int                         count = 0;
+
+		explicit BitWriter(std::vector<unsigned char>& out) : out(out) {}
+
+		void put(std::uint32_t value, int length)
+		{
+			bits |= value << count;
+			count += length;
+			while (count >= 8)
+			{
+				out.push_back((unsigned char)bits);
+				bits >>= 8;
+				count -= 8;
+			}
+		}
+
+		// Huffman codes go in from their highest bit
+		static std::uint32_t reverse(std::uint32_t code, int length)
+		{
+			std::uint32_t reversed = 0;
+			for (int i = 0; i < length; i++)
+				reversed |= ((code >> i) & 1) << (length - 1 - i);
+			return reversed;
+		}
+
+		void align()
+		{
+			if (count > 0)
+				out.push_back((unsigned char)bits);
+			bits = 0;
+			count = 0;
+		}
+	};
+
+	const int lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const int lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const int distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const int distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	// deflate's fixed Huffman code for the literal and length symbols, reversed ready to go in,
+	// with their lengths
+	struct FixedCode
+	{
+		std::uint32_t codes[288];
+		int           lengths[288];
+		std::uint32_t distances[30];
+
+		FixedCode()
+		{
+			for (int symbol = 0; symbol < 288; symbol++)
+			{
+				if (symbol < 144)
+					lengths[symbol] = 8, codes[symbol] = BitWriter::reverse(0x30 + symbol, 8);
+				else if (symbol < 256)
+					lengths[symbol] = 9, codes[symbol] = BitWriter::reverse(0x190 + symbol - 144, 9);
+				else if (symbol < 280)
+					lengths[symbol] = 7, codes[symbol] = BitWriter::reverse(symbol - 256, 7);
+				else
+					lengths[symbol] = 8, codes[symbol] = BitWriter::reverse(0xC0 + symbol - 280, 8);
+			}
+			for (int code = 0; code < 30; code++)
+				distances[code] = BitWriter::reverse(code, 5);
+		}
+	};
+	const FixedCode fixedCode;
+
+	void putSymbol(BitWriter& writer, int symbol)
+	{
+		writer.put(fixedCode.codes[symbol], fixedCode.lengths[symbol]);
+	}
+
+	void putMatch(BitWriter& writer, int length, int distance)
+	{
+		int code = 28;
+		while (lengthBase[code] > length)
+			code--;
+		putSymbol(writer, 257 + code);
+		writer.put(length - lengthBase[code], lengthExtra[code]);
+
+		code = 29;
+		while (distanceBase[code] > distance)
+			code--;
+		writer.put(fixedCode.distances[code], 5);
+		writer.put(distance - distanceBase[code], distanceExtra[code]);
+	}
+
+	// data compressed on its own as fixed Huffman blocks, ending on a whole byte with an empty
+	// stored block so the pieces of a stream compressed by different threads can be put together.
+	// Repeats are found through the last place each three bytes were seen
+	void deflate(const unsigned char* data, int size, std::vector<unsigned char>& out)
+	{
+		const int window = 32768;
+		const int maxLength = 258;
+		std::vector<int> last(1 << 15, -1);
+		auto hash = [data](int i) { return ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & 0x7FFF; };
+
+		BitWriter writer(out);
+		writer.put(0, 1);
+		writer.put(1, 2);
+		int i = 0;
+		while (i < size)
+		{
+			int length = 0;
+			int distance = 0;
+			if (i + 3 <= size)
+			{
+				int h = hash(i);
+				int candidate = last[h];
+				last[h] = i;
+				if (candidate >= 0 && i - candidate <= window)
+				{
+					// eight bytes at a time while they're the same
+					int limit = std::min(maxLength, size - i);
+					std::uint64_t before, after;
+					while (length + 8 <= limit && (std::memcpy(&before, data + candidate + length, 8), std::memcpy(&after, data + i + length, 8), before == after))
+						length += 8;
+					while (length < limit && data[candidate + length] == data[i + length])
+						length++;
+					distance = i - candidate;
+				}
+			}
+
+			if (length >= 3)
+			{
+				putMatch(writer, length, distance);
+				// the places inside a long repeat are left out, they'd only find more of it
+				for (int j = i + 1; j < i + length && j + 3 <= size && length < 32; j++)
+					last[hash(j)] = j;
+				i += length;
+			}
+			else
+			{
+				putSymbol(writer, data[i]);
+				i++;
+			}
+		}
+		putSymbol(writer, 256);
+
+		writer.put(0, 3);
+		writer.align();
+		const unsigned char empty[4] = { 0x00, 0x00, 0xFF, 0xFF };
+		out.insert(out.end(), empty, empty + 4);
+	}
+
+	const std::uint32_t adlerBase = 65521;
+
+	std::uint32_t adler32(const unsigned char* data, size_t size)
+	{
+		std::uint32_t a = 1, b = 0;
+		while (size > 0)
+		{
+			// the sums can't overflow in this many bytes before they're reduced
+			size_t length = std::min(size, (size_t)5552);
+			size -= length;
+			while (length--)
+			{
+				a += *data++;
+				b += a;
+			}
+			a %= adlerBase;
+			b %= adlerBase;
+		}
+		return (b << 16) | a;
+	}
+
+	// the checksum of two pieces of data from each one's, the second length bytes long
+	std::uint32_t adler32Combine(std::uint32_t first, std::uint32_t second, size_t length)
+	{
+		std::uint32_t remainder = (std::uint32_t)(length % adlerBase);
+		std::uint32_t a = first & 0xFFFF;
+		std::uint32_t b = (std::uint32_t)(((std::uint64_t)remainder * a) % adlerBase);
+		a += (second & 0xFFFF) + adlerBase - 1;
+		b += (first >> 16) + (second >> 16) + adlerBase - remainder;
+		a %= adlerBase;
+		b %= adlerBase;
+		return (b << 16) | a;
+	}
+
+	std::uint32_t crc32(const unsigned char* data, size_t size, std::uint32_t crc = 0)
+	{
+		static std::uint32_t table[256];
+		static bool tableReady = false;
+		if (!tableReady)
+		{
+			for (std::uint32_t n = 0; n < 256; n++)
+			{
+				std::uint32_t c = n;
+				for (int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+				table[n] = c;
+			}
+			tableReady = true;
+		}
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	void putBigEndian(std::vector<unsigned char>& out, std::uint32_t value)
+	{
+		for (int shift = 24; shift >= 0; shift -= 8)
+			out.push_back((unsigned char)(value >> shift));
+	}
+
+	void writeChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data)
+	{
+		std::vector<unsigned char> header;
+		putBigEndian(header, (std::uint32_t)data.size());
+		header.insert(header.end(), type, type + 4);
+		std::uint32_t crc = crc32(header.data() + 4, 4);
+		crc = crc32(data.data(), data.size(), crc);
+
+		std::vector<unsigned char> trailer;
+		putBigEndian(trailer, crc);
+		file.write((const char*)header.data(), header.size());
+		file.write((const char*)data.data(), data.size());
+		file.write((const char*)trailer.data(), trailer.size());
+	}
+
+	// a row filtered by one of PNG's filters, each byte less what it's predicted to be from the
+	// pixel left of it, the one above and the one above that. Returns the sum of the differences
+	// as signed bytes, to judge how well it'll compress
+	template <int filter> long applyFilter(const unsigned char* row, const unsigned char* previous, int length, unsigned char* out)
+	{
+		long sum = 0;
+		for (int i = 0; i < length; i++)
+		{
+			int left = (i >= 4) ? row[i - 4] : 0;
+			int up = previous[i];
+			int upLeft = (i >= 4) ? previous[i - 4] : 0;
+			int predicted = 0;
+			if (filter == 1)
+			{
+				predicted = left;
+			}
+			else if (filter == 2)
+			{
+				predicted = up;
+			}
+			else if (filter == 3)
+			{
+				predicted = (left + up) / 2;
+			}
+			else if (filter == 4)
+			{
+				int p = left + up - upLeft;
+				int pa = std::abs(p - left), pb = std::abs(p - up), pc = std::abs(p - upLeft);
+				predicted = (pa <= pb && pa <= pc) ? left : (pb <= pc) ? up : upLeft;
+			}
+			unsigned char value = (unsigned char)(row[i] - predicted);
+			out[i] = value;
+			sum += (value < 128) ? value : 256 - value;
+		}
+		return sum;
+	}
+
+	// a row of pixels with the filter which leaves the smallest differences ahead of it, for it
+	// to compress best. The row above the first is all zeros
+	void filterRow(const unsigned char* row, const unsigned char* previous, int length, unsigned char* out, std::vector<unsigned char>& scratch)
+	{
+		typedef long(*Filter)(const unsigned char*, const unsigned char*, int, unsigned char*);
+		static const Filter filters[5] = { applyFilter<0>, applyFilter<1>, applyFilter<2>, applyFilter<3>, applyFilter<4> };
+
+		// a row just like the one above needs no more looking at
+		if (std::memcmp(row, previous, length) == 0)
+		{
+			out[0] = 2;
+			std::memset(out + 1, 0, length);
+			return;
+		}
+
+		scratch.resize(5 * (size_t)length);
+		int best = 0;
+		long bestSum = -1;
+		for (int filter = 0; filter < 5; filter++)
+		{
+			long sum = filters[filter](row, previous, length, &scratch[(size_t)filter * length]);
+			if (bestSum < 0 || sum < bestSum)
+			{
+				bestSum = sum;
+				best = filter;
+			}
+		}
+		out[0] = (unsigned char)best;
+		std::memcpy(out + 1, &scratch[(size_t)best * length], length);
+	}
+}
+
+Raster::Raster(int width, int height, std::uint32_t background)
+	: mWidth(std::max(width, 1))
+	, mHeight(std::max(height, 1))
+	, mBackground(background)
+{
+	mTilesX = (mWidth + tileSize - 1) / tileSize;
+	mTilesY = (mHeight + tileSize - 1) / tileSize;
+	mPixels.assign((size_t)mWidth * mHeight, background);
+	mTriangleBins.resize(mTilesX * mTilesY);
+	mShapeBins.resize(mTilesX * mTilesY);
+}
+
+std::uint32_t Raster::color(unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+{
+	const unsigned char bytes[4] = { r, g, b, a };
+	std::uint32_t color;
+	std::memcpy(&color, bytes, sizeof(color));
+	return color;
+}
+
+float Raster::textWidth(const std::string& str, float size)
+{
+	return str.size() * fontColumns * size / fontRows;
+}
+
+void Raster::addLine(const float* points, int count, float width, std::uint32_t color, const float* depths)
+{
+	if (count == 0)
+		return;
+
+	// thinner than a pixel is drawn a pixel wide and fainter
+	Item item;
+	item.text = false;
+	item.depthTested = depths != nullptr;
+	item.halfWidth = 0.5f * std::max(width, 1.f);
+	item.alpha = std::min(width, 1.f);
+	item.color = color;
+	int index = (int)mItems.size();
+	mItems.push_back(item);
+
+	const float reach = item.halfWidth + 1.f;
+	int start = -1;
+	for (int i = 0; i <= count; i++)
+	{
+		bool finite = i < count && std::isfinite(points[2 * i]) && std::isfinite(points[2 * i + 1]) && (!depths || std::isfinite(depths[i]));
+		if (finite && start >= 0)
+		{
+			Shape shape = { points[2 * i - 2], points[2 * i - 1], points[2 * i], points[2 * i + 1], depths ? depths[i - 1] : 0.f, depths ? depths[i] : 0.f };
+			addShape(index, shape, reach);
+		}
+		else if (!finite && start >= 0 && start == i - 1)
+		{
+			// a point on its own is a dot
+			Shape shape = { points[2 * start], points[2 * start + 1], points[2 * start], points[2 * start + 1], depths ? depths[start] : 0.f, depths ? depths[start] : 0.f };
+			addShape(index, shape, reach);
+		}
+
+		if (!finite)
+			start = -1;
+		else if (start < 0)
+			start = i;
+	}
+}
+
+void Raster::addText(const std::string& str, float x, float y, float size, std::uint32_t color)
+{
+	Item item;
+	item.text = true;
+	item.depthTested = false;
+	item.halfWidth = 0.f;
+	item.alpha = 1.f;
+	item.color = color;
+	int index = (int)mItems.size();
+	mItems.push_back(item);
+
+	// the letters sit a font pixel and a half down, the way sf::Text's do
+	const float unit = size / fontRows;
+	float left = x;
+	float top = y + 1.5f * unit;
+	for (unsigned char c : str)
+	{
+		if (c == '\n')
+		{
+			left = x;
+			top += size;
+			continue;
+		}
+
+		const unsigned char* glyph = font[(c >= 32 && c < 127) ? c - 32 : '?' - 32];
+		for (int column = 0; column < 5; column++)
+		{
+			// each run of pixels down a column is one block
+			for (int row = 0; row < 7; row++)
+			{
+				if (!(glyph[column] & (1 << row)))
+					continue;
+				int end = row;
+				while (end < 7 && (glyph[column] & (1 << end)))
+					end++;
+
+				Shape shape = { left + column * unit, top + row * unit, left + (column + 1) * unit, top + end * unit, 0.f, 0.f };
+				addShape(index, shape, 1.f);
+				row = end;
+			}
+		}
+		left += fontColumns * unit;
+	}
+}
+
+void Raster::addTriangles(const float* points, const std::uint32_t* colors, const unsigned* indices, int count)
+{
+	for (int t = 0; t < count; t++)
+	{
+		Vertex corners[3];
+		bool finite = true;
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned i = indices[3 * t + k];
+			corners[k] = { points[3 * i], points[3 * i + 1], points[3 * i + 2], colors[i] };
+			finite = finite && std::isfinite(corners[k].x) && std::isfinite(corners[k].y) && std::isfinite(corners[k].depth);
+		}
+		if (!finite)
+			continue;
+
+		float left = std::min(corners[0].x, std::min(corners[1].x, corners[2].x));
+		float right = std::max(corners[0].x, std::max(corners[1].x, corners[2].x));
+		float top = std::min(corners[0].y, std::min(corners[1].y, corners[2].y));
+		float bottom = std::max(corners[0].y, std::max(corners[1].y, corners[2].y));
+		if (right < 0.f || bottom < 0.f || left >= mWidth || top >= mHeight)
+			continue;
+
+		int index = (int)mTriangles.size() / 3;
+		mTriangles.insert(mTriangles.end(), corners, corners + 3);
+		int tileLeft = std::max((int)left / tileSize, 0);
+		int tileRight = std::min((int)right / tileSize, mTilesX - 1);
+		int tileTop = std::max((int)top / tileSize, 0);
+		int tileBottom = std::min((int)bottom / tileSize, mTilesY - 1);
+		for (int ty = tileTop; ty <= tileBottom; ty++)
+		{
+			for (int tx = tileLeft; tx <= tileRight; tx++)
+				mTriangleBins[ty * mTilesX + tx].push_back(index);
+		}
+	}
+}
+
+// a shape goes in the bins of the tiles it reaches. A part of a line only goes in those its
+// middle passes near, not every one under the box around it
+void Raster::addShape(int item, const Shape& shape, float reach)
+{
+	float left = std::min(shape.x0, shape.x1) - reach;
+	float right = std::max(shape.x0, shape.x1) + reach;
+	float top = std::min(shape.y0, shape.y1) - reach;
+	float bottom = std::max(shape.y0, shape.y1) + reach;
+	if (right < 0.f || bottom < 0.f || left >= mWidth || top >= mHeight)
+		return;
+
+	int index = (int)mShapes.size();
+	mShapes.push_back(shape);
+	int tileLeft = std::max((int)left / tileSize, 0);
+	int tileRight = std::min((int)right / tileSize, mTilesX - 1);
+	int tileTop = std::max((int)top / tileSize, 0);
+	int tileBottom = std::min((int)bottom / tileSize, mTilesY - 1);
+	const float tileRadius = 0.7072f * tileSize + reach;
+	float dx = shape.x1 - shape.x0;
+	float dy = shape.y1 - shape.y0;
+	float length2 = dx * dx + dy * dy;
+	for (int ty = tileTop; ty <= tileBottom; ty++)
+	{
+		for (int tx = tileLeft; tx <= tileRight; tx++)
+		{
+			if (!mItems[item].text && length2 > 0.f)
+			{
+				float cx = (tx + 0.5f) * tileSize - shape.x0;
+				float cy = (ty + 0.5f) * tileSize - shape.y0;
+				float t = std::min(std::max((cx * dx + cy * dy) / length2, 0.f), 1.f);
+				float ex = cx - t * dx;
+				float ey = cy - t * dy;
+				if (ex * ex + ey * ey > tileRadius * tileRadius)
+					continue;
+			}
+			mShapeBins[ty * mTilesX + tx].push_back({ item, index });
+		}
+	}
+}
+
+void Raster::render(int threads)
+{
+	share(mTilesX * mTilesY, threadCount(threads), [this](int tile)
+	{
+		// each thread only needs one tile's worth of these at a time
+		thread_local std::vector<float> coverage;
+		thread_local std::vector<float> depth;
+		coverage.assign(tileSize * tileSize, 0.f);
+		depth.resize(tileSize * tileSize);
+		renderTile(tile, coverage.data(), depth.data());
+	});
+}
+
+void Raster::renderTile(int tile, float* coverage, float* depth)
+{
+	const int left = (tile % mTilesX) * tileSize;
+	const int top = (tile / mTilesX) * tileSize;
+	const int right = std::min(left + tileSize, mWidth);
+	const int bottom = std::min(top + tileSize, mHeight);
+
+	for (int y = top; y < bottom; y++)
+	{
+		std::fill(&mPixels[(size_t)y * mWidth + left], &mPixels[(size_t)y * mWidth + right], mBackground);
+	}
+	std::fill(depth, depth + tileSize * tileSize, INFINITY);
+
+	for (int t : mTriangleBins[tile])
+	{
+		drawTriangle(&mTriangles[3 * t], left, top, right, bottom, depth);
+	}
+
+	// the shapes of one line or text are gathered into how much of each pixel they cover, then
+	// blended in once, so where its parts overlap isn't drawn darker
+	int current = -1;
+	int coveredLeft = right, coveredTop = bottom, coveredRight = left, coveredBottom = top;
+	auto blend = [&]
+	{
+		if (current < 0)
+			return;
+
+		const Item& item = mItems[current];
+		float source[4];
+		unpack(item.color, source);
+		for (int y = coveredTop; y < coveredBottom; y++)
+		{
+			for (int x = coveredLeft; x < coveredRight; x++)
+			{
+				float& c = coverage[(y - top) * tileSize + (x - left)];
+				if (c <= 0.f)
+					continue;
+
+				std::uint32_t& pixel = mPixels[(size_t)y * mWidth + x];
+				float destination[4];
+				unpack(pixel, destination);
+				float a = std::min(c, 1.f) * item.alpha * source[3] / 255.f;
+				float d = destination[3] / 255.f * (1.f - a);
+				float alpha = a + d;
+				for (int i = 0; i < 3; i++)
+					destination[i] = (alpha > 0.f) ? (source[i] * a + destination[i] * d) / alpha : 0.f;
+				destination[3] = alpha * 255.f;
+				pixel = pack(destination);
+				c = 0.f;
+			}
+		}
+		coveredLeft = right, coveredTop = bottom, coveredRight = left, coveredBottom = top;
+	};
+
+	for (const Entry& entry : mShapeBins[tile])
+	{
+		if (entry.item != current)
+		{
+			blend();
+			current = entry.item;
+		}
+
+		const Item& item = mItems[entry.item];
+		const Shape& shape = mShapes[entry.shape];
+		float reach = item.text ? 0.f : item.halfWidth + 1.f;
+		int x0 = std::max((int)std::floor(std::min(shape.x0, shape.x1) - reach), left);
+		int x1 = std::min((int)std::ceil(std::max(shape.x0, shape.x1) + reach), right);
+		int y0 = std::max((int)std::floor(std::min(shape.y0, shape.y1) - reach), top);
+		int y1 = std::min((int)std::ceil(std::max(shape.y0, shape.y1) + reach), bottom);
+		if (x0 >= x1 || y0 >= y1)
+			continue;
+		coveredLeft = std::min(coveredLeft, x0);
+		coveredRight = std::max(coveredRight, x1);
+		coveredTop = std::min(coveredTop, y0);
+		coveredBottom = std::max(coveredBottom, y1);
+
+		if (item.text)
+		{
+			// the share of each pixel under the block
+			for (int y = y0; y < y1; y++)
+			{
+				float h = std::min(y + 1.f, shape.y1) - std::max((float)y, shape.y0);
+				for (int x = x0; x < x1; x++)
+				{
+					float w = std::min(x + 1.f, shape.x1) - std::max((float)x, shape.x0);
+					if (w > 0.f && h > 0.f)
+						coverage[(y - top) * tileSize + (x - left)] += w * h;
+				}
+			}
+			continue;
+		}
+
+		// a pixel is covered by as much of it as is within half the width of the line, judged
+		// from its centre
+		float dx = shape.x1 - shape.x0;
+		float dy = shape.y1 - shape.y0;
+		float length2 = dx * dx + dy * dy;
+		for (int y = y0; y < y1; y++)
+		{
+			for (int x = x0; x < x1; x++)
+			{
+				float px = x + 0.5f - shape.x0;
+				float py = y + 0.5f - shape.y0;
+				float t = (length2 > 0.f) ? std::min(std::max((px * dx + py * dy) / length2, 0.f), 1.f) : 0.f;
+				float ex = px - t * dx;
+				float ey = py - t * dy;
+				float c = item.halfWidth + 0.5f - std::sqrt(ex * ex + ey * ey);
+				if (c <= 0.f)
+					continue;
+
+				int i = (y - top) * tileSize + (x - left);
+				if (item.depthTested && shape.depth0 + t * (shape.depth1 - shape.depth0) > depth[i] + 1e-5f)
+					continue;
+				coverage[i] = std::max(coverage[i], std::min(c, 1.f));
+			}
+		}
+	}
+	blend();
+}
+
+// the pixels whose centres are inside the triangle, where it's nearer than what's there already
+void Raster::drawTriangle(const Vertex* v, int left, int top, int right, int bottom, float* depth)
+{
+	float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+	if (area == 0.f)
+		return;
+
+	int x0 = std::max((int)std::floor(std::min(v[0].x, std::min(v[1].x, v[2].x))), left);
+	int x1 = std::min((int)std::ceil(std::max(v[0].x, std::max(v[1].x, v[2].x))), right);
+	int y0 = std::max((int)std::floor(std::min(v[0].y, std::min(v[1].y, v[2].y))), top);
+	int y1 = std::min((int)std::ceil(std::max(v[0].y, std::max(v[1].y, v[2].y))), bottom);
+
+	float colors[3][4];
+	for (int k = 0; k < 3; k++)
+		unpack(v[k].color, colors[k]);
+
+	for (int y = y0; y < y1; y++)
+	{
+		float py = y + 0.5f;
+		for (int x = x0; x < x1; x++)
+		{
+			// each corner's weight is the area of the triangle the pixel makes with the other two
+			float px = x + 0.5f;
+			float w0 = ((v[2].x - v[1].x) * (py - v[1].y) - (v[2].y - v[1].y) * (px - v[1].x)) / area;
+			float w1 = ((v[0].x - v[2].x) * (py - v[2].y) - (v[0].y - v[2].y) * (px - v[2].x)) / area;
+			float w2 = 1.f - w0 - w1;
+			if (w0 < 0.f || w1 < 0.f || w2 < 0.f)
+				continue;
+
+			float z = w0 * v[0].depth + w1 * v[1].depth + w2 * v[2].depth;
+			float& nearest = depth[(y - top) * tileSize + (x - left)];
+			if (!(z < nearest))
+				continue;
+			nearest = z;
+
+			float color[4];
+			for (int i = 0; i < 4; i++)
+				color[i] = w0 * colors[0][i] + w1 * colors[1][i] + w2 * colors[2][i];
+			mPixels[(size_t)y * mWidth + x] = pack(color);
+		}
+	}
+}
+
+bool Raster::writePng(const std::string& path, int threads) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	// bands of rows are filtered and compressed by separate threads, each into a piece of the
+	// one deflate stream
+	const int rowLength = 4 * mWidth;
+	const int bandRows = std::max(1, (1 << 20) / (rowLength + 1));
+	const int bands = (mHeight + bandRows - 1) / bandRows;
+	std::vector<std::vector<unsigned char>> pieces(bands);
+	std::vector<std::uint32_t> checksums(bands);
+	std::vector<size_t> lengths(bands);
+	const std::vector<unsigned char> zeros(rowLength, 0);
+	share(bands, threadCount(threads), [&](int band)
+	{
+		int first = band * bandRows;
+		int last = std::min(first + bandRows, mHeight);
+		std::vector<unsigned char> filtered((size_t)(last - first) * (rowLength + 1));
+		std::vector<unsigned char> scratch;
+		for (int y = first; y < last; y++)
+		{
+			const unsigned char* row = (const unsigned char*)&mPixels[(size_t)y * mWidth];
+			const unsigned char* previous = (y > 0) ? row - rowLength : zeros.data();
+			filterRow(row, previous, rowLength, &filtered[(size_t)(y - first) * (rowLength + 1)], scratch);
+		}
+		checksums[band] = adler32(filtered.data(), filtered.size());
+		lengths[band] = filtered.size();
+		deflate(filtered.data(), (int)filtered.size(), pieces[band]);
+	});
+
+	std::vector<unsigned char> data = { 0x78, 0x01 };
+	std::uint32_t checksum = 1;
+	for (int band = 0; band < bands; band++)
+	{
+		data.insert(data.end(), pieces[band].begin(), pieces[band].end());
+		checksum = adler32Combine(checksum, checksums[band], lengths[band]);
+	}
+	// an empty last block ends the stream
+	data.push_back(0x03);
+	data.push_back(0x00);
+	putBigEndian(data, checksum);
+
+	const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write((const char*)signature, sizeof(signature));
+
+	std::vector<unsigned char> header;
+	putBigEndian(header, mWidth);
+	putBigEndian(header, mHeight);
+	header.insert(header.end(), { 8, 6, 0, 0, 0 });   // 8 bits RGBA, not interlaced
+	writeChunk(file, "IHDR", header);
+	writeChunk(file, "IDAT", data);
+	writeChunk(file, "IEND", std::vector<unsigned char>());
+	return (bool)file;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// an image drawn on the CPU, with no window or GL context, for plots bigger than any screen.
+// Lines, text and triangles are added in pixel coordinates, sorted into tiles as they come, and
+// the tiles are drawn by several threads at once. Colours are packed the way Colormap's are, as
+// their r, g, b and a bytes in that order
+class Raster
+{
+public:
+	Raster(int width, int height, std::uint32_t background);
+
+	static std::uint32_t color(unsigned char r, unsigned char g, unsigned char b, unsigned char a = 255);
+	// how wide a line of text is at size pixels high
+	static float         textWidth(const std::string& str, float size);
+
+	// an anti-aliased line through count points, x then y, with round ends and joins. A NaN point
+	// breaks it. Given a depth for each point, it's hidden where the triangles are nearer
+	void addLine(const float* points, int count, float width, std::uint32_t color, const float* depths = nullptr);
+	// text with its top left at x, y, size pixels to a line
+	void addText(const std::string& str, float x, float y, float size, std::uint32_t color);
+	// count triangles, three indices to each, between points given as x, y and a depth which is
+	// smaller nearer and varies linearly across the screen. They're drawn under the lines and the
+	// text, blending their corners' colours
+	void addTriangles(const float* points, const std::uint32_t* colors, const unsigned* indices, int count);
+
+	// draws everything added, with as many threads as there are processors when threads is 0
+	void render(int threads = 0);
+	// saves the image as an RGBA PNG, compressed by as many threads
+	bool writePng(const std::string& path, int threads = 0) const;
+
+	int                  width() const { return mWidth; }
+	int                  height() const { return mHeight; }
+	const std::uint32_t* pixels() const { return mPixels.data(); }
+
+private:
+	static const int tileSize = 64;
+
+	struct Vertex
+	{
+		float         x, y, depth;
+		std::uint32_t color;
+	};
+
+	// a part of a line from one end to the other, or a block of a letter's pixels from its top
+	// left to its bottom right
+	struct Shape
+	{
+		float x0, y0, x1, y1;
+		float depth0, depth1;
+	};
+
+	struct Item
+	{
+		bool          text;
+		bool          depthTested;
+		float         halfWidth;
+		float         alpha;
+		std::uint32_t color;
+	};
+
+	struct Entry
+	{
+		int item;
+		int shape;
+	};
+
+	void addShape(int item, const Shape& shape, float reach);
+	void renderTile(int tile, float* coverage, float* depth);
+	void drawTriangle(const Vertex* v, int left, int top, int right, int bottom, float* depth);
+
+	int                             mWidth;
+	int                             mHeight;
+	int                             mTilesX;
+	int                             mTilesY;
+	std::uint32_t                   mBackground;
+	std::vector<std::uint32_t>      mPixels;
+	std::vector<Vertex>             mTriangles;     // three corners to each
+	std::vector<Shape>              mShapes;
+	std::vector<Item>               mItems;
+	std::vector<std::vector<int>>   mTriangleBins;  // the triangles over each tile
+	std::vector<std::vector<Entry>> mShapeBins;     // the lines' and text's shapes over each tile, in order
+};
@@ -30,13 +30,37 @@
 #include "SourceTextBox.hpp"
 #include <TGUI/Clipping.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdio>
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 namespace tgui
 {
+	namespace
+	{
+		// The labels of the line profile are a bit smaller than the text they are next to
+		unsigned int getGutterTextSize(unsigned int textSize)
+		{
+			return std::max(1u, textSize * 3 / 4);
+		}
+
+		// How many times a line ran, shortened when it is large
+		std::string formatHits(long long hits)
+		{
+			char label[16];
+			if (hits < 10000)
+				std::snprintf(label, sizeof(label), "%lld", hits);
+			else if (hits < 10000000)
+				std::snprintf(label, sizeof(label), "%.1fk", hits / 1000.0);
+			else
+				std::snprintf(label, sizeof(label), "%.1fM", hits / 1000000.0);
+			return label;
+		}
+	}
+
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 	SourceTextBox::SourceTextBox()
@@ -75,7 +99,10 @@ namespace tgui
 		m_selectionRects(scrollbarToCopy.m_selectionRects), // Did not compile in VS2013 when using braces
 		m_scroll{ Scrollbar::copy(scrollbarToCopy.m_scroll) },
 		m_possibleDoubleClick{ scrollbarToCopy.m_possibleDoubleClick },
-		m_readOnly{ scrollbarToCopy.m_readOnly }
+		m_readOnly{ scrollbarToCopy.m_readOnly },
+		m_profileHits(scrollbarToCopy.m_profileHits),
+		m_profileShares(scrollbarToCopy.m_profileShares),
+		m_gutterWidth{ scrollbarToCopy.m_gutterWidth }
 	{
 	}
 
@@ -108,6 +135,9 @@ namespace tgui
 			std::swap(m_scroll, temp.m_scroll);
 			std::swap(m_possibleDoubleClick, temp.m_possibleDoubleClick);
 			std::swap(m_readOnly, temp.m_readOnly);
+			std::swap(m_profileHits, temp.m_profileHits);
+			std::swap(m_profileShares, temp.m_profileShares);
+			std::swap(m_gutterWidth, temp.m_gutterWidth);
 		}
 
 		return *this;
@@ -400,6 +430,7 @@ namespace tgui
 		else
 			m_lineHeight = 0;
 
+		updateGutterWidth();
 		updateSize();
 	}
 
@@ -454,6 +485,20 @@ namespace tgui
 
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+	void SourceTextBox::setLineProfile(const std::vector<long long>& hits, const std::vector<float>& shares)
+	{
+		m_profileHits = hits;
+		m_profileShares = shares;
+
+		// The text only has to be rearranged when the gutter appears or disappears
+		float oldGutterWidth = m_gutterWidth;
+		updateGutterWidth();
+		if (m_gutterWidth != oldGutterWidth)
+			rearrangeText(true);
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 	void SourceTextBox::setOpacity(float opacity)
 	{
 		Widget::setOpacity(opacity);
@@ -1769,6 +1814,21 @@ namespace tgui
 
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+	void SourceTextBox::updateGutterWidth()
+	{
+		if ((m_profileHits.empty() && m_profileShares.empty()) || (m_font == nullptr))
+		{
+			m_gutterWidth = 0;
+			return;
+		}
+
+		// Wide enough for the widest labels, with some space around them
+		sf::Text widest{ "999.9M 100.0%", *m_font, getGutterTextSize(m_textSize) };
+		m_gutterWidth = std::round(widest.getLocalBounds().width + getGutterTextSize(m_textSize));
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 	void SourceTextBox::update(sf::Time elapsedTime)
 	{
 		Widget::update(elapsedTime);
@@ -1815,6 +1875,63 @@ namespace tgui
 		// Draw the background and borders
 		getRenderer()->draw(target, states);
 
+		// Draw the line profile in the gutter, next to the first row of each line of the text
+		if (m_gutterWidth > 0)
+		{
+			Padding padding = getRenderer()->getScaledPadding();
+			sf::Vector2f gutterPosition{ getPosition().x + padding.left - m_gutterWidth, getPosition().y + padding.top };
+			float gutterHeight = getSize().y - padding.top - padding.bottom;
+			Clipping clipping{ target, states, gutterPosition, { m_gutterWidth, gutterHeight } };
+
+			unsigned int labelSize = getGutterTextSize(m_textSize);
+			float margin = labelSize * 0.25f;
+			float labelShiftY = getTextVerticalCorrection(getFont(), labelSize) - (m_lineHeight - m_font->getLineSpacing(labelSize)) / 2;
+			float scroll = m_scroll ? static_cast<float>(m_scroll->getValue()) : 0;
+			sf::Text label{ "", *m_font, labelSize };
+			label.setColor(calcColorOpacity(getRenderer()->m_textColor, getOpacity()));
+
+			std::size_t line = 0;
+			for (std::size_t i = 0; i < m_lines.size(); ++i)
+			{
+				// Rows wrapped from the line above belong to the same line
+				if (i > 0)
+				{
+					if (m_lines[i - 1].isEmpty() || (m_lines[i - 1][m_lines[i - 1].getSize() - 1] != '\n'))
+						continue;
+					line++;
+				}
+
+				float top = gutterPosition.y + (i * m_lineHeight) - scroll;
+				if (top + m_lineHeight < gutterPosition.y)
+					continue;
+				if (top > gutterPosition.y + gutterHeight)
+					break;
+				if ((line >= m_profileHits.size()) || (m_profileHits[line] == 0))
+					continue;
+
+				float share = (line < m_profileShares.size()) ? std::min(std::max(m_profileShares[line], 0.f), 1.f) : 0;
+				sf::RectangleShape bar{ { share * (m_gutterWidth - margin), static_cast<float>(m_lineHeight) } };
+				bar.setPosition(gutterPosition.x, top);
+				bar.setFillColor(calcColorOpacity(sf::Color(255, 110, 40, 110), getOpacity()));
+				target.draw(bar, states);
+
+				label.setString(formatHits(m_profileHits[line]));
+				label.setPosition(std::round(gutterPosition.x + margin), std::round(top - labelShiftY));
+				target.draw(label, states);
+
+				char percentage[16];
+				std::snprintf(percentage, sizeof(percentage), "%.1f%%", share * 100);
+				label.setString(percentage);
+				label.setPosition(std::round(gutterPosition.x + m_gutterWidth - margin - label.getLocalBounds().width), std::round(top - labelShiftY));
+				target.draw(label, states);
+			}
+
+			sf::RectangleShape separator{ { 1, gutterHeight } };
+			separator.setPosition(gutterPosition.x + m_gutterWidth - 1, gutterPosition.y);
+			separator.setFillColor(calcColorOpacity(getRenderer()->m_borderColor, getOpacity()));
+			target.draw(separator, states);
+		}
+
 		// Draw the contents of the text box
 		{
 			// Set the clipping for all draw calls that happen until this clipping object goes out of scope
@@ -2165,6 +2282,8 @@ namespace tgui
 			}
 		}
 
+		// The text goes to the right of the line profile's gutter
+		scaledPadding.left += m_textBox->m_gutterWidth;
 		return scaledPadding;
 	}
 
@@ -303,6 +303,19 @@ namespace tgui
 		bool isReadOnly() const;
 
 
+		/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+		/// @brief Shows a profile of the lines of the text in a gutter on the left of it
+		///
+		/// @param hits    How many times each line ran, the first line at index 0
+		/// @param shares  The share of the time spent on each line, from 0 to 1
+		///
+		/// Each line that ran is labelled with its hits and its share of the time, over a bar as long as that share.
+		/// Lines past the end of the vectors are left blank. Passing empty vectors removes the gutter.
+		///
+		/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+		void setLineProfile(const std::vector<long long>& hits, const std::vector<float>& shares);
+
+
 		/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 		/// @brief Changes the opacity of the widget.
 		///
@@ -421,6 +434,12 @@ namespace tgui
 		void updateSelectionTexts();
 
 
+		/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+		// Makes room on the left for the labels of the line profile, or none when there is no profile.
+		/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+		void updateGutterWidth();
+
+
 		/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	protected:
 
@@ -500,6 +519,11 @@ namespace tgui
 
 		bool m_readOnly = false;
 
+		// The line profile shown in the gutter, by line of the text, and the width of the gutter (0 without a profile)
+		std::vector<long long> m_profileHits;
+		std::vector<float> m_profileShares;
+		float m_gutterWidth = 0;
+
 		friend class SourceTextBoxRenderer;
 
 		/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
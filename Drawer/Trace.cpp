@@ -0,0 +1,238 @@
+#include "Trace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// how many spans a thread can record before the tracer's thread catches up, beyond which
+	// they're dropped and counted. A power of two
+	const unsigned ringSize = 8192;
+	// how often the tracer's thread writes out what the rings hold, in milliseconds
+	const int flushInterval = 50;
+
+	struct Event
+	{
+		const char* name;
+		const char* category;
+		double      start;
+		double      duration;
+	};
+
+	// a thread's spans, added by the thread at head and taken by the tracer's thread from tail
+	struct Ring
+	{
+		Event                    events[ringSize];
+		std::atomic<unsigned>    head{ 0 };
+		std::atomic<unsigned>    tail{ 0 };
+		std::atomic<unsigned>    dropped{ 0 };
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<bool>        owned{ true };      // false once its thread has finished, for another to take it
+		int                      thread = 0;
+		const char*              writtenName = nullptr; // the name last written, by the tracer's thread
+	};
+
+	std::atomic<bool>  gEnabled{ false };
+	std::mutex         gRingsMutex;     // taken when a thread records for the first time, and to list the rings
+	std::vector<Ring*> gRings;          // never freed, a finished thread's ring is reused
+	std::mutex         gFileMutex;
+	FILE*              gFile = nullptr;
+	bool               gFirstEvent = true;
+	double             gOrigin = 0.0;
+	std::thread        gWriter;
+	std::atomic<bool>  gStopping{ false };
+
+	// gives the ring back when its thread finishes
+	struct RingOwner
+	{
+		Ring* ring = nullptr;
+		~RingOwner()
+		{
+			if (ring != nullptr)
+				ring->owned = false;
+		}
+	};
+	thread_local RingOwner tOwner;
+
+	Ring* threadRing()
+	{
+		if (tOwner.ring != nullptr)
+			return tOwner.ring;
+
+		std::lock_guard<std::mutex> lock(gRingsMutex);
+		for (Ring* it : gRings)
+		{
+			// one left by a finished thread, once everything in it has been written
+			if (!it->owned && it->head == it->tail)
+			{
+				it->owned = true;
+				it->name = nullptr;
+				tOwner.ring = it;
+				return it;
+			}
+		}
+		Ring* ring = new Ring();
+		ring->thread = (int)gRings.size() + 1;
+		gRings.push_back(ring);
+		tOwner.ring = ring;
+		return ring;
+	}
+
+	void separate()
+	{
+		if (!gFirstEvent)
+			std::fputs(",\n", gFile);
+		gFirstEvent = false;
+	}
+
+	// everything the rings hold, written out. The file's mutex is held
+	void drain()
+	{
+		std::vector<Ring*> rings;
+		{
+			std::lock_guard<std::mutex> lock(gRingsMutex);
+			rings = gRings;
+		}
+
+		for (Ring* ring : rings)
+		{
+			const char* name = ring->name;
+			if (name != nullptr && name != ring->writtenName)
+			{
+				separate();
+				std::fprintf(gFile, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", ring->thread, name);
+				ring->writtenName = name;
+			}
+
+			unsigned tail = ring->tail.load(std::memory_order_relaxed);
+			unsigned head = ring->head.load(std::memory_order_acquire);
+			for (; tail != head; tail++)
+			{
+				const Event& event = ring->events[tail % ringSize];
+				// left over from a trace before this one
+				if (event.start < gOrigin)
+					continue;
+				separate();
+				std::fprintf(gFile, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+					event.name, event.category, event.start - gOrigin, event.duration, ring->thread);
+			}
+			ring->tail.store(tail, std::memory_order_release);
+		}
+	}
+
+	void writeInBackground()
+	{
+		while (!gStopping)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(flushInterval));
+			std::lock_guard<std::mutex> lock(gFileMutex);
+			drain();
+			std::fflush(gFile);
+		}
+	}
+}
+
+bool Trace::start(const std::string& path)
+{
+	stop();
+
+	std::lock_guard<std::mutex> lock(gFileMutex);
+	gFile = std::fopen(path.c_str(), "w");
+	if (gFile == nullptr)
+		return false;
+
+	std::fputs("{\"traceEvents\":[\n", gFile);
+	gFirstEvent = true;
+	separate();
+	std::fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"C-Plot\"}}", gFile);
+	{
+		// thread names are written again in this trace
+		std::lock_guard<std::mutex> ringsLock(gRingsMutex);
+		for (Ring* ring : gRings)
+			ring->writtenName = nullptr;
+	}
+
+	gOrigin = now();
+	gStopping = false;
+	gWriter = std::thread(writeInBackground);
+	gEnabled = true;
+	return true;
+}
+
+void Trace::stop()
+{
+	if (!gWriter.joinable())
+		return;
+
+	gEnabled = false;
+	gStopping = true;
+	gWriter.join();
+
+	std::lock_guard<std::mutex> lock(gFileMutex);
+	drain();
+
+	// spans lost to full rings show as one instant at the end of the trace, on their thread
+	std::lock_guard<std::mutex> ringsLock(gRingsMutex);
+	for (Ring* ring : gRings)
+	{
+		unsigned dropped = ring->dropped.exchange(0);
+		if (dropped > 0)
+		{
+			separate();
+			std::fprintf(gFile, "{\"name\":\"dropped spans\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"count\":%u}}",
+				now() - gOrigin, ring->thread, dropped);
+		}
+	}
+	std::fputs("\n]}\n", gFile);
+	std::fclose(gFile);
+	gFile = nullptr;
+}
+
+bool Trace::enabled()
+{
+	return gEnabled.load(std::memory_order_relaxed);
+}
+
+double Trace::now()
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::complete(const char* name, const char* category, double start)
+{
+	if (!enabled())
+		return;
+
+	double end = now();
+	Ring* ring = threadRing();
+	unsigned head = ring->head.load(std::memory_order_relaxed);
+	if (head - ring->tail.load(std::memory_order_acquire) >= ringSize)
+	{
+		ring->dropped++;
+		return;
+	}
+	Event& event = ring->events[head % ringSize];
+	event.name = name;
+	event.category = category;
+	event.start = start;
+	event.duration = end - start;
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Trace::nameThread(const char* name)
+{
+	threadRing()->name = name;
+}
+
+TraceSpan::TraceSpan(const char* name, const char* category) : mName(name), mCategory(category), mStart(Trace::enabled() ? Trace::now() : 0.0)
+{
+}
+
+TraceSpan::~TraceSpan()
+{
+	if (mStart != 0.0)
+		Trace::complete(mName, mCategory, mStart);
+}
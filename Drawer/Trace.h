@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+
+// an optional tracer writing Chrome's trace event JSON, which chrome://tracing and Perfetto open.
+// Each thread records its spans into a ring of its own without locking, and a thread of the
+// tracer's writes them out in the background. Names and categories must be string literals, or
+// live as long as the trace. While no trace is being written, recording costs a load and a test
+class Trace
+{
+public:
+	// starts writing a trace to path, replacing any trace in progress
+	static bool start(const std::string& path);
+	// writes out what's left and closes the trace
+	static void stop();
+	static bool enabled();
+
+	// a clock for the start of a span, in microseconds
+	static double now();
+	// a span on the calling thread from start until now
+	static void complete(const char* name, const char* category, double start);
+	// what the calling thread is called in the trace
+	static void nameThread(const char* name);
+};
+
+// a span over a scope. Not for the interpreter's code, which can longjmp out of a scope without
+// destroying what's in it, it records its spans with Trace::complete instead
+class TraceSpan
+{
+public:
+	TraceSpan(const char* name, const char* category);
+	~TraceSpan();
+
+private:
+	const char* mName;
+	const char* mCategory;
+	double      mStart;
+};
@@ -27,6 +27,20 @@ void LibraryInit(Picoc *pc)
     VariableDefinePlatformVar(pc, NULL, "LITTLE_ENDIAN", &pc->IntType, (union AnyValue *)&LittleEndian, FALSE);
 }
 
+/* what's known of a library function's purity and entry points, or NULL if it's impure */
+static struct LibraryNative *LibraryFindNative(void (*Func)(struct ParseState *Parser, struct Value *, struct Value **, int))
+{
+    int Count;
+
+    for (Count = 0; MathNatives[Count].Func != NULL; Count++)
+    {
+        if (MathNatives[Count].Func == Func)
+            return &MathNatives[Count];
+    }
+
+    return NULL;
+}
+
 /* add a library */
 void LibraryAdd(Picoc *pc, struct Table *GlobalTable, const char *LibraryName, struct LibraryFunction *FuncList)
 {
@@ -37,6 +51,7 @@ void LibraryAdd(Picoc *pc, struct Table *GlobalTable, const char *LibraryName, s
     struct Value *NewValue;
     void *Tokens;
     char *IntrinsicName = TableStrRegister(pc, "c library");
+    struct LibraryNative *Native;
     
     /* read all the library definitions */
     for (Count = 0; FuncList[Count].Prototype != NULL; Count++)
@@ -45,7 +60,13 @@ void LibraryAdd(Picoc *pc, struct Table *GlobalTable, const char *LibraryName, s
         LexInitParser(&Parser, pc, FuncList[Count].Prototype, Tokens, IntrinsicName, TRUE, FALSE);
         TypeParse(&Parser, &ReturnType, &Identifier, NULL);
         NewValue = ParseFunctionDefinition(&Parser, ReturnType, Identifier);
-        NewValue->Val->FuncDef.Intrinsic = FuncList[Count].Func;
+        NewValue->Val->FuncDef->Intrinsic = FuncList[Count].Func;
+        Native = LibraryFindNative(FuncList[Count].Func);
+        if (Native != NULL)
+            NewValue->Val->FuncDef->Native = Native->Native;
+
+        NewValue->Val->FuncDef->IsPure = (Native != NULL);
+        NewValue->Val->FuncDef->Purity = (Native != NULL) ? PurityPure : PurityImpure;
         HeapFreeMem(pc, Tokens);
     }
 }
@@ -79,10 +79,14 @@ void MathFabs(struct ParseState *Parser, struct Value *ReturnValue, struct Value
     ReturnValue->Val->FP = fabs(Param[0]->Val->FP);
 }
 
+static double MathNativeSgn(double val)
+{
+	return (0.0 < val) - (val < 0.0);
+}
+
 void MathSgn(struct ParseState *Parser, struct Value *ReturnValue, struct Value **Param, int NumArgs)
 {
-	double val = Param[0]->Val->FP;
-	ReturnValue->Val->FP = (0.0 < val) - (val < 0.0);
+	ReturnValue->Val->FP = MathNativeSgn(Param[0]->Val->FP);
 }
 
 void MathFmod(struct ParseState *Parser, struct Value *ReturnValue, struct Value **Param, int NumArgs)
@@ -125,11 +129,16 @@ void MathSqrt(struct ParseState *Parser, struct Value *ReturnValue, struct Value
     ReturnValue->Val->FP = sqrt(Param[0]->Val->FP);
 }
 
-void MathRound(struct ParseState *Parser, struct Value *ReturnValue, struct Value **Param, int NumArgs)
+static double MathNativeRound(double x)
 {
     /* this awkward definition of "round()" due to it being inconsistently
      * declared in math.h */
-    ReturnValue->Val->FP = ceil(Param[0]->Val->FP - 0.5);
+    return ceil(x - 0.5);
+}
+
+void MathRound(struct ParseState *Parser, struct Value *ReturnValue, struct Value **Param, int NumArgs)
+{
+    ReturnValue->Val->FP = MathNativeRound(Param[0]->Val->FP);
 }
 
 void MathCeil(struct ParseState *Parser, struct Value *ReturnValue, struct Value **Param, int NumArgs)
@@ -142,38 +151,844 @@ void MathFloor(struct ParseState *Parser, struct Value *ReturnValue, struct Valu
     ReturnValue->Val->FP = floor(Param[0]->Val->FP);
 }
 
+static double MathNativeMin(double a, double b)
+{
+	if (a < b)
+		return a;
+	else
+		return b;
+}
+
 void MathMin(struct ParseState *Parser, struct Value *ReturnValue, struct Value **Param, int NumArgs)
 {
-	if (Param[0]->Val->FP < Param[1]->Val->FP)
-		ReturnValue->Val->FP = Param[0]->Val->FP;
+	ReturnValue->Val->FP = MathNativeMin(Param[0]->Val->FP, Param[1]->Val->FP);
+}
+
+static double MathNativeMax(double a, double b)
+{
+	if (a > b)
+		return a;
 	else
-		ReturnValue->Val->FP = Param[1]->Val->FP;
+		return b;
 }
 
 void MathMax(struct ParseState *Parser, struct Value *ReturnValue, struct Value **Param, int NumArgs)
 {
-	if (Param[0]->Val->FP > Param[1]->Val->FP)
-		ReturnValue->Val->FP = Param[0]->Val->FP;
-	else
-		ReturnValue->Val->FP = Param[1]->Val->FP;
+	ReturnValue->Val->FP = MathNativeMax(Param[0]->Val->FP, Param[1]->Val->FP);
+}
+
+static double MathNativeClamp(double s, double low, double high)
+{
+	if (s < low)
+		s = low;
+	else if (s > high)
+		s = high;
+	return s;
 }
 
 void MathClamp(struct ParseState *Parser, struct Value *ReturnValue, struct Value **Param, int NumArgs)
 {
-	double s = Param[0]->Val->FP;
-	if (s < Param[1]->Val->FP)
-		s = Param[1]->Val->FP;
-	else if (s > Param[2]->Val->FP)
-		s = Param[2]->Val->FP;
-	ReturnValue->Val->FP = s;
+	ReturnValue->Val->FP = MathNativeClamp(Param[0]->Val->FP, Param[1]->Val->FP, Param[2]->Val->FP);
+}
+
+static double MathNativeLerp(double i, double a, double b)
+{
+	return (1.0-i) * a + i * b;
 }
 
 void MathLerp(struct ParseState *Parser, struct Value *ReturnValue, struct Value **Param, int NumArgs)
 {
-	double i = Param[0]->Val->FP;
-	ReturnValue->Val->FP = (1.0-i) * Param[1]->Val->FP + i * Param[2]->Val->FP;
+	ReturnValue->Val->FP = MathNativeLerp(Param[0]->Val->FP, Param[1]->Val->FP, Param[2]->Val->FP);
+}
+
+/* versions of sin, cos, exp, log and pow which work on VECTOR_LANES values at a time, for the
+ * vector evaluator. Each is a loop with no branches or calls using the fdlibm polynomials, which
+ * the compiler's vectoriser turns into SSE2 or AVX2 code, then any lane with arguments outside
+ * the range the kernel handles is worked out again by the C library. The largest errors seen
+ * against long double results over 10^7 random arguments in each range are:
+ *
+ *   sin, cos   |x| < 823549                    0.78 ULP
+ *   exp        |x| <= 707                      0.89 ULP
+ *   log        all normal x > 0                0.66 ULP
+ *   pow        |y ln(x)| <= 707, |y| <= 16     1.6 ULP
+ *              |y| <= 1024                     about 80 ULP, growing with |y| from the error in ln(x)
+ *
+ * The double double steps rely on products being rounded on their own, and the range checks on
+ * NaNs and infinities being honoured, so the kernels are built with precise floating point even
+ * where the rest of the program isn't: MSVC by the pragma below, GCC and Clang with
+ * -ffp-contract=off and -fno-fast-math on this file (see CMakeLists.txt) */
+#ifdef __FAST_MATH__
+#error "math.cpp's vector kernels need precise floating point, build it with -fno-fast-math"
+#endif
+#ifdef _MSC_VER
+#pragma float_control(precise, on, push)
+#pragma fp_contract(off)
+#endif
+
+#define MATH_ROUND_MAGIC 6755399441055744.0                     /* 1.5 * 2^52, adding it rounds to an integer */
+#define MATH_EXPONENT_MAGIC 4503599627371519.0                  /* 2^52 + 1023 */
+#define MATH_SPLIT 134217729.0                                  /* 2^27 + 1, for splitting a double in half */
+#define MATH_TRIG_MAX 823549.0                                  /* 2^19 pi/2, the reduction below is exact up to here */
+#define MATH_EXP_MAX 707.0                                      /* exp() stays a normal number up to here */
+
+static const double MathInvPio2 = 6.36619772367581382433e-01;
+static const double MathPio2_1 = 1.57079632673412561417e+00;    /* pi/2 in three 33 bit pieces */
+static const double MathPio2_2 = 6.07710050630396597660e-11;
+static const double MathPio2_3 = 2.02226624871116645580e-21;
+static const double MathPio2_3t = 8.47842766036889956997e-32;
+static const double MathInvLn2 = 1.44269504088896338700e+00;
+static const double MathLn2Hi = 6.93147180369123816490e-01;     /* ln 2 in two pieces */
+static const double MathLn2Lo = 1.90821492927058770002e-10;
+
+static unsigned long long MathBits(double Value)
+{
+    unsigned long long Bits;
+
+    memcpy((void *)&Bits, (void *)&Value, sizeof(Bits));
+    return Bits;
+}
+
+static double MathFromBits(unsigned long long Bits)
+{
+    double Value;
+
+    memcpy((void *)&Value, (void *)&Bits, sizeof(Value));
+    return Value;
+}
+
+/* sin(x + y) and cos(x + y) for |x + y| <= pi/4, where y is the tail of x */
+static inline double MathKernelSin(double x, double y)
+{
+    double z = x*x;
+    double v = z*x;
+    double r = 8.33333333332248946124e-03 + z*(-1.98412698298579493134e-04 + z*(2.75573137070700676789e-06 + z*(-2.50507602534068634195e-08 + z*1.58969099521155010221e-10)));
+
+    return x - ((z*(0.5*y - v*r) - y) - v*-1.66666666666666324348e-01);
+}
+
+static inline double MathKernelCos(double x, double y)
+{
+    double z = x*x;
+    double w = z*z;
+    double r = z*(4.16666666666666019037e-02 + z*(-1.38888888888741095749e-03 + z*2.48015872894767294178e-05)) +
+        w*w*(-2.75573143513906633035e-07 + z*(2.08757232129817482790e-09 + z*-1.13596475577881948265e-11));
+    double hz = 0.5*z;
+
+    w = 1.0 - hz;
+    return w + (((1.0 - w) - hz) + (z*r - x*y));
+}
+
+/* sin(x) when Quadrant is 0 and cos(x) when it's 1 */
+VECTOR_TARGET static void MathVectorSinCos(double *__restrict Result, const double *__restrict Arg, unsigned long long Quadrant)
+{
+    unsigned long long Bits;
+    unsigned long long Swap;
+    unsigned long long n;
+    double Rounded;
+    double fn;
+    double r;
+    double t;
+    double w;
+    double Part;
+    double Tail;
+    double y0;
+    double y1;
+    int Lane;
+
+    for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+    {
+        /* take away the nearest multiple of pi/2 a piece at a time, keeping the remainder as a
+         * double double. The first two products and the first difference are exact */
+        Rounded = Arg[Lane] * MathInvPio2 + MATH_ROUND_MAGIC;
+        fn = Rounded - MATH_ROUND_MAGIC;
+        t = Arg[Lane] - fn*MathPio2_1;
+        w = fn*MathPio2_2;
+        r = t - w;
+        Part = r - t;
+        Tail = ((t - (r - Part)) - (w + Part)) - fn*MathPio2_3 - fn*MathPio2_3t;
+        y0 = r + Tail;
+        y1 = Tail - (y0 - r);
+
+        /* odd quadrants use the other kernel, the upper two are negated */
+        n = Quadrant + (MathBits(Rounded) - MathBits(MATH_ROUND_MAGIC));
+        Swap = 0 - (n & 1);
+        Bits = (MathBits(MathKernelCos(y0, y1)) & Swap) | (MathBits(MathKernelSin(y0, y1)) & ~Swap);
+        Result[Lane] = MathFromBits(Bits ^ ((n & 2) << 62));
+    }
+
+    for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+    {
+        if (!(fabs(Arg[Lane]) < MATH_TRIG_MAX))
+            Result[Lane] = (Quadrant == 0) ? sin(Arg[Lane]) : cos(Arg[Lane]);
+    }
+}
+
+static void MathVectorSin(double *__restrict Result, const double *__restrict Arg)
+{
+    MathVectorSinCos(Result, Arg, 0);
+}
+
+static void MathVectorCos(double *__restrict Result, const double *__restrict Arg)
+{
+    MathVectorSinCos(Result, Arg, 1);
+}
+
+/* exp(x + y) where y is much smaller than x, for |x| <= MATH_EXP_MAX */
+static inline double MathKernelExp(double x, double y)
+{
+    double Rounded = x * MathInvLn2 + MATH_ROUND_MAGIC;
+    double k = Rounded - MATH_ROUND_MAGIC;
+    double hi = x - k*MathLn2Hi;
+    double lo = k*MathLn2Lo - y;
+    double r = hi - lo;
+    double t = r*r;
+    double c = r - t*(1.66666666666666019037e-01 + t*(-2.77777777770155933842e-03 + t*(6.61375632143793436117e-05 + t*(-1.65339022054652515390e-06 + t*4.13813679705723846039e-08))));
+    double Scaled = 1.0 - ((lo - (r*c)/(2.0 - c)) - hi);
+
+    /* multiply by 2^k by adding it to the exponent */
+    return MathFromBits(MathBits(Scaled) + ((MathBits(Rounded) - MathBits(MATH_ROUND_MAGIC)) << 52));
+}
+
+VECTOR_TARGET static void MathVectorExp(double *__restrict Result, const double *__restrict Arg)
+{
+    int Lane;
+
+    for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+        Result[Lane] = MathKernelExp(Arg[Lane], 0.0);
+
+    for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+    {
+        if (!(fabs(Arg[Lane]) <= MATH_EXP_MAX))
+            Result[Lane] = exp(Arg[Lane]);
+    }
+}
+
+/* ln(x) for normal x > 0 as a double double, Hi + Lo */
+static inline void MathKernelLog(double x, double *Hi, double *Lo)
+{
+    /* x = m 2^Exponent with m between sqrt(1/2) and sqrt(2). Moving the bits up by the
+     * difference between 1 and sqrt(1/2) carries into the exponent when m is over sqrt(2) */
+    unsigned long long Bits = MathBits(x) + (0x3ff0000000000000ULL - 0x3fe6a09e667f3bcdULL);
+    double Exponent = MathFromBits(MathBits(4503599627370496.0) | (Bits >> 52)) - MATH_EXPONENT_MAGIC;
+    double m = MathFromBits((Bits & 0x000fffffffffffffULL) + 0x3fe6a09e667f3bcdULL);
+    double f, s, z, w, R, hfsq, fsq, fh, fl, Sum, Big, Part, Tail;
+
+    f = m - 1.0;
+    s = f / (2.0 + f);
+    z = s*s;
+    w = z*z;
+    R = z*(6.666666666666735130e-01 + w*(2.857142874366239149e-01 + w*(1.818357216161805012e-01 + w*1.479819860511658591e-01))) +
+        w*(3.999999999940941908e-01 + w*(2.222219843214978396e-01 + w*1.531383769920937332e-01));
+
+    /* f*f exactly, then the large terms added up without losing what's rounded off */
+    fsq = f*f;
+    fh = f*MATH_SPLIT - (f*MATH_SPLIT - f);
+    fl = f - fh;
+    hfsq = 0.5 * fsq;
+    Tail = s*(hfsq + R) + Exponent*MathLn2Lo - 0.5 * (((fh*fh - fsq) + 2.0*fh*fl) + fl*fl);
+
+    Big = Exponent*MathLn2Hi;
+    Sum = Big + f;
+    Part = Sum - Big;
+    Tail += (Big - (Sum - Part)) + (f - Part);
+    Big = Sum;
+    Sum = Big - hfsq;
+    Part = Sum - Big;
+    Tail += (Big - (Sum - Part)) + (-hfsq - Part);
+
+    *Hi = Sum + Tail;
+    *Lo = Tail - (*Hi - Sum);
+}
+
+static int MathIsNormalPositive(double x)
+{
+    return x >= 2.2250738585072014e-308 && x <= 1.7976931348623157e308;
+}
+
+VECTOR_TARGET static void MathVectorLog(double *__restrict Result, const double *__restrict Arg)
+{
+    double Hi;
+    double Lo;
+    int Lane;
+
+    for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+    {
+        MathKernelLog(Arg[Lane], &Hi, &Lo);
+        Result[Lane] = Hi + Lo;
+    }
+
+    for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+    {
+        if (!MathIsNormalPositive(Arg[Lane]))
+            Result[Lane] = log(Arg[Lane]);
+    }
+}
+
+/* x^y as exp(y ln(x)), with y ln(x) worked out to more than double precision */
+VECTOR_TARGET static void MathVectorPow(double *__restrict Result, const double *__restrict Base, const double *__restrict Power)
+{
+    double Product[VECTOR_LANES];
+    double Hi, Lo, y, yh, yl, Lh, Ll, p, q, t;
+    int Lane;
+
+    for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+    {
+        MathKernelLog(Base[Lane], &Hi, &Lo);
+        y = Power[Lane];
+        yh = y*MATH_SPLIT - (y*MATH_SPLIT - y);
+        yl = y - yh;
+        Lh = Hi*MATH_SPLIT - (Hi*MATH_SPLIT - Hi);
+        Ll = Hi - Lh;
+        p = y*Hi;
+        q = (((yh*Lh - p) + yh*Ll + yl*Lh) + yl*Ll) + y*Lo;
+        t = p + q;
+        Product[Lane] = t;
+        Result[Lane] = MathKernelExp(t, q - (t - p));
+    }
+
+    for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+    {
+        if (!MathIsNormalPositive(Base[Lane]) || !(fabs(Product[Lane]) <= MATH_EXP_MAX))
+            Result[Lane] = pow(Base[Lane], Power[Lane]);
+    }
+}
+
+#ifdef _MSC_VER
+#pragma float_control(pop)
+#endif
+
+
+/* the derivatives of the functions by each of their arguments, given the arguments and the
+ * result, for the gradient evaluator. Where a function isn't differentiable, such as at a step
+ * of floor() or the corner of fabs(), the derivative of either side is given */
+static void MathPartialFlat(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = 0.0;
+}
+
+static void MathPartialAcos(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = -1.0 / sqrt(1.0 - Arg[0]*Arg[0]);
+}
+
+static void MathPartialAsin(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = 1.0 / sqrt(1.0 - Arg[0]*Arg[0]);
+}
+
+static void MathPartialAtan(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = 1.0 / (1.0 + Arg[0]*Arg[0]);
+}
+
+static void MathPartialAtan2(double *Partial, const double *Arg, double Result)
+{
+    double Square = Arg[0]*Arg[0] + Arg[1]*Arg[1];
+
+    Partial[0] = Arg[1] / Square;
+    Partial[1] = -Arg[0] / Square;
+}
+
+static void MathPartialCos(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = -sin(Arg[0]);
+}
+
+static void MathPartialCosh(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = sinh(Arg[0]);
+}
+
+static void MathPartialExp(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = Result;
+}
+
+static void MathPartialFabs(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = (Arg[0] < 0.0) ? -1.0 : 1.0;
+}
+
+static void MathPartialFmod(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = 1.0;
+    Partial[1] = -trunc(Arg[0] / Arg[1]);
+}
+
+static void MathPartialLog(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = 1.0 / Arg[0];
+}
+
+static void MathPartialLog10(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = M_LOG10EValue / Arg[0];
+}
+
+/* a negative base only has a result for whole powers, so the power doesn't vary there */
+static void MathPartialPow(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = (Arg[1] == 0.0) ? 0.0 : Arg[1] * pow(Arg[0], Arg[1] - 1.0);
+    Partial[1] = (Arg[0] > 0.0) ? Result * log(Arg[0]) : 0.0;
+}
+
+static void MathPartialSin(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = cos(Arg[0]);
+}
+
+static void MathPartialSinh(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = cosh(Arg[0]);
+}
+
+static void MathPartialSqrt(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = 0.5 / Result;
+}
+
+static void MathPartialTan(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = 1.0 + Result*Result;
+}
+
+static void MathPartialTanh(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = 1.0 - Result*Result;
+}
+
+static void MathPartialMin(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = (Arg[0] < Arg[1]) ? 1.0 : 0.0;
+    Partial[1] = 1.0 - Partial[0];
+}
+
+static void MathPartialMax(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = (Arg[0] > Arg[1]) ? 1.0 : 0.0;
+    Partial[1] = 1.0 - Partial[0];
+}
+
+static void MathPartialClamp(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = 0.0;
+    Partial[1] = 0.0;
+    Partial[2] = 0.0;
+
+    if (Arg[0] < Arg[1])
+        Partial[1] = 1.0;
+    else if (Arg[0] > Arg[2])
+        Partial[2] = 1.0;
+    else
+        Partial[0] = 1.0;
+}
+
+static void MathPartialLerp(double *Partial, const double *Arg, double Result)
+{
+    Partial[0] = Arg[2] - Arg[1];
+    Partial[1] = 1.0 - Arg[0];
+    Partial[2] = Arg[0];
+}
+
+
+/* the range of each function over boxes of arguments, for the interval evaluator. These are
+ * the tightest bounds the C library's results give, the evaluator widens them for rounding.
+ * Arguments outside a function's domain are left out, and a box with none in it has no
+ * values at all, which is given as NaN bounds. Each returns whether it gives a NaN somewhere
+ * in the box from arguments which aren't NaNs. The evaluator takes it that a NaN argument gives
+ * a NaN, so ArgNaN is only looked at by the functions which turn one back into a number */
+#define MATH_TWO_PI 6.28318530717958647692
+
+/* a function which only rises or only falls, defined from DomainLow to DomainHigh */
+static int MathRangeMonotone(double (*Function)(double), double *Low, double *High, double ArgLow, double ArgHigh, double DomainLow, double DomainHigh)
+{
+    double Value1;
+    double Value2;
+    int OutsideDomain = (ArgLow < DomainLow || ArgHigh > DomainHigh);
+
+    if (ArgLow < DomainLow)
+        ArgLow = DomainLow;
+
+    if (ArgHigh > DomainHigh)
+        ArgHigh = DomainHigh;
+
+    if (!(ArgLow <= ArgHigh))
+    {
+        *Low = *High = NAN;
+        return OutsideDomain;
+    }
+
+    Value1 = Function(ArgLow);
+    Value2 = Function(ArgHigh);
+    *Low = (Value1 < Value2) ? Value1 : Value2;
+    *High = (Value1 < Value2) ? Value2 : Value1;
+    return OutsideDomain;
+}
+
+/* the extremes found at a box's corners, starting from [HUGE_VAL, -HUGE_VAL]. If none of the
+ * corners had a value, the arguments were NaNs and so is the result */
+static void MathRangeCorners(double *Low, double *High)
+{
+    if (*Low > *High)
+        *Low = *High = NAN;
+}
+
+/* sin and cos, which reach 1 at Peak and -1 half a period on. The range is between the ends'
+ * values unless there's a peak or a trough in between. They're NaN at the infinities */
+static int MathRangePeriodic(double (*Function)(double), double *Low, double *High, double ArgLow, double ArgHigh, double Peak)
+{
+    if (!(ArgHigh - ArgLow < MATH_TWO_PI))
+    {
+        *Low = -1.0;
+        *High = 1.0;
+        return isinf(ArgLow) || isinf(ArgHigh);
+    }
+
+    MathRangeMonotone(Function, Low, High, ArgLow, ArgHigh, -HUGE_VAL, HUGE_VAL);
+    if (ceil((ArgLow - Peak) / MATH_TWO_PI) * MATH_TWO_PI + Peak <= ArgHigh)
+        *High = 1.0;
+
+    if (ceil((ArgLow - Peak - M_PIValue) / MATH_TWO_PI) * MATH_TWO_PI + Peak + M_PIValue <= ArgHigh)
+        *Low = -1.0;
+
+    return FALSE;
+}
+
+static int MathRangeAcos(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    return MathRangeMonotone(acos, Low, High, ArgLow[0], ArgHigh[0], -1.0, 1.0);
+}
+
+static int MathRangeAsin(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    return MathRangeMonotone(asin, Low, High, ArgLow[0], ArgHigh[0], -1.0, 1.0);
+}
+
+static int MathRangeAtan(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    return MathRangeMonotone(atan, Low, High, ArgLow[0], ArgHigh[0], -HUGE_VAL, HUGE_VAL);
+}
+
+/* the angles of a box are those of its corners, unless it holds the origin or crosses the
+ * negative x axis, where the angle goes from pi round to -pi. An x of -0 is on that axis too */
+static int MathRangeAtan2(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    double Value;
+    int Corner;
+
+    if (ArgLow[1] <= 0.0 && ArgLow[0] <= 0.0 && ArgHigh[0] >= 0.0)
+    {
+        *Low = -M_PIValue;
+        *High = M_PIValue;
+        return FALSE;
+    }
+
+    *Low = HUGE_VAL;
+    *High = -HUGE_VAL;
+    for (Corner = 0; Corner < 4; Corner++)
+    {
+        Value = atan2((Corner & 1) ? ArgHigh[0] : ArgLow[0], (Corner & 2) ? ArgHigh[1] : ArgLow[1]);
+        *Low = (Value < *Low) ? Value : *Low;
+        *High = (Value > *High) ? Value : *High;
+    }
+    MathRangeCorners(Low, High);
+    return FALSE;
+}
+
+static int MathRangeCeil(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    return MathRangeMonotone(ceil, Low, High, ArgLow[0], ArgHigh[0], -HUGE_VAL, HUGE_VAL);
+}
+
+static int MathRangeCos(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    return MathRangePeriodic(cos, Low, High, ArgLow[0], ArgHigh[0], 0.0);
+}
+
+static int MathRangeCosh(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    MathRangeMonotone(cosh, Low, High, ArgLow[0], ArgHigh[0], -HUGE_VAL, HUGE_VAL);
+    if (ArgLow[0] < 0.0 && ArgHigh[0] > 0.0)
+        *Low = 1.0;
+
+    return FALSE;
+}
+
+static int MathRangeExp(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    return MathRangeMonotone(exp, Low, High, ArgLow[0], ArgHigh[0], -HUGE_VAL, HUGE_VAL);
+}
+
+static int MathRangeFabs(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    MathRangeMonotone(fabs, Low, High, ArgLow[0], ArgHigh[0], -HUGE_VAL, HUGE_VAL);
+    if (ArgLow[0] < 0.0 && ArgHigh[0] > 0.0)
+        *Low = 0.0;
+
+    return FALSE;
+}
+
+/* the sign of a NaN is 0 */
+static int MathRangeSgn(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    MathRangeMonotone(MathNativeSgn, Low, High, ArgLow[0], ArgHigh[0], -HUGE_VAL, HUGE_VAL);
+    if (ArgNaN[0])
+    {
+        *Low = fmin(*Low, 0.0);
+        *High = fmax(*High, 0.0);
+    }
+    return FALSE;
+}
+
+static int MathRangeFloor(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    return MathRangeMonotone(floor, Low, High, ArgLow[0], ArgHigh[0], -HUGE_VAL, HUGE_VAL);
+}
+
+/* the result is smaller than the divisor and the dividend and has the dividend's sign. Within
+ * a single multiple of a constant divisor it rises with the dividend. A divisor of 0 or an
+ * infinite dividend give a NaN */
+static int MathRangeFmod(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    double Divisor = (fabs(ArgLow[1]) > fabs(ArgHigh[1])) ? fabs(ArgLow[1]) : fabs(ArgHigh[1]);
+    int MakesNaN = (ArgLow[1] <= 0.0 && ArgHigh[1] >= 0.0) || isinf(ArgLow[0]) || isinf(ArgHigh[0]);
+    double Value1;
+    double Value2;
+
+    if (ArgLow[1] == ArgHigh[1] && ArgLow[1] != 0.0 && (ArgLow[0] >= 0.0 || ArgHigh[0] <= 0.0) &&
+            trunc(ArgLow[0] / ArgLow[1]) == trunc(ArgHigh[0] / ArgLow[1]))
+    {
+        Value1 = fmod(ArgLow[0], ArgLow[1]);
+        Value2 = fmod(ArgHigh[0], ArgLow[1]);
+        if (Value1 <= Value2)
+        {
+            *Low = Value1;
+            *High = Value2;
+            return MakesNaN;
+        }
+    }
+
+    *Low = (ArgLow[0] < 0.0) ? ((-Divisor > ArgLow[0]) ? -Divisor : ArgLow[0]) : 0.0;
+    *High = (ArgHigh[0] > 0.0) ? ((Divisor < ArgHigh[0]) ? Divisor : ArgHigh[0]) : 0.0;
+    return MakesNaN;
+}
+
+static int MathRangeLog(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    return MathRangeMonotone(log, Low, High, ArgLow[0], ArgHigh[0], 0.0, HUGE_VAL);
+}
+
+static int MathRangeLog10(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    return MathRangeMonotone(log10, Low, High, ArgLow[0], ArgHigh[0], 0.0, HUGE_VAL);
+}
+
+/* a whole power is monotonic either side of 0. Otherwise the base can't be negative, and the
+ * log of the result is bilinear in the power and the log of the base, so its extremes are at
+ * the corners. A negative base with a range of powers is left unbounded. pow(NaN, 0) and
+ * pow(1, NaN) are both 1 */
+static int MathRangePow(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    double Power = ArgLow[1];
+    double BaseLow = ArgLow[0];
+    double Value;
+    int MakesNaN = FALSE;
+    int Corner;
+
+    if (ArgLow[1] == ArgHigh[1] && Power == floor(Power))
+    {
+        Value = pow(ArgLow[0], Power);
+        *Low = fmin(Value, pow(ArgHigh[0], Power));
+        *High = fmax(Value, pow(ArgHigh[0], Power));
+        if (ArgLow[0] < 0.0 && ArgHigh[0] >= 0.0)
+        {
+            if (fmod(Power, 2.0) == 0.0)
+            {
+                /* even powers fall to 0 at 0, or rise to infinity there */
+                if (Power > 0.0)
+                    *Low = 0.0;
+                else
+                    *High = HUGE_VAL;
+            }
+            else if (Power < 0.0)
+            {
+                *Low = -HUGE_VAL;
+                *High = HUGE_VAL;
+            }
+        }
+    }
+    else if (BaseLow < 0.0 && ArgLow[1] != ArgHigh[1])
+    {
+        *Low = -HUGE_VAL;
+        *High = HUGE_VAL;
+        MakesNaN = TRUE;
+    }
+    else if (BaseLow < 0.0 && ArgHigh[0] < 0.0)
+    {
+        *Low = *High = NAN;
+        MakesNaN = TRUE;
+    }
+    else
+    {
+        if (BaseLow < 0.0)
+        {
+            BaseLow = 0.0;
+            MakesNaN = TRUE;
+        }
+
+        *Low = HUGE_VAL;
+        *High = -HUGE_VAL;
+        for (Corner = 0; Corner < 4; Corner++)
+        {
+            Value = pow((Corner & 1) ? ArgHigh[0] : BaseLow, (Corner & 2) ? ArgHigh[1] : ArgLow[1]);
+            *Low = (Value < *Low) ? Value : *Low;
+            *High = (Value > *High) ? Value : *High;
+        }
+        MathRangeCorners(Low, High);
+    }
+
+    if ((ArgNaN[0] && ArgLow[1] <= 0.0 && ArgHigh[1] >= 0.0) || (ArgNaN[1] && ArgLow[0] <= 1.0 && ArgHigh[0] >= 1.0))
+    {
+        *Low = fmin(*Low, 1.0);
+        *High = fmax(*High, 1.0);
+    }
+    return MakesNaN;
+}
+
+static int MathRangeRound(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    return MathRangeMonotone(MathNativeRound, Low, High, ArgLow[0], ArgHigh[0], -HUGE_VAL, HUGE_VAL);
+}
+
+static int MathRangeSin(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    return MathRangePeriodic(sin, Low, High, ArgLow[0], ArgHigh[0], M_PI_2Value);
+}
+
+static int MathRangeSinh(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    return MathRangeMonotone(sinh, Low, High, ArgLow[0], ArgHigh[0], -HUGE_VAL, HUGE_VAL);
+}
+
+static int MathRangeSqrt(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    return MathRangeMonotone(sqrt, Low, High, ArgLow[0], ArgHigh[0], 0.0, HUGE_VAL);
 }
 
+/* unbounded over a pole at pi/2 + k pi, and rising between them. NaN at the infinities */
+static int MathRangeTan(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    if (!(ArgHigh[0] - ArgLow[0] < M_PIValue) ||
+            ceil((ArgLow[0] - M_PI_2Value) / M_PIValue) * M_PIValue + M_PI_2Value <= ArgHigh[0])
+    {
+        *Low = -HUGE_VAL;
+        *High = HUGE_VAL;
+        return isinf(ArgLow[0]) || isinf(ArgHigh[0]);
+    }
+
+    *Low = tan(ArgLow[0]);
+    *High = tan(ArgHigh[0]);
+
+    /* the ends were rounded to either side of a pole */
+    if (*Low > *High)
+    {
+        *Low = -HUGE_VAL;
+        *High = HUGE_VAL;
+    }
+    return FALSE;
+}
+
+static int MathRangeTanh(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    return MathRangeMonotone(tanh, Low, High, ArgLow[0], ArgHigh[0], -HUGE_VAL, HUGE_VAL);
+}
+
+/* min(NaN, b) and max(NaN, b) are b */
+static int MathRangeMin(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    *Low = MathNativeMin(ArgLow[0], ArgLow[1]);
+    *High = MathNativeMin(ArgHigh[0], ArgHigh[1]);
+    if (ArgNaN[0])
+    {
+        *Low = fmin(*Low, ArgLow[1]);
+        *High = fmax(*High, ArgHigh[1]);
+    }
+    return FALSE;
+}
+
+static int MathRangeMax(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    *Low = MathNativeMax(ArgLow[0], ArgLow[1]);
+    *High = MathNativeMax(ArgHigh[0], ArgHigh[1]);
+    if (ArgNaN[0])
+    {
+        *Low = fmin(*Low, ArgLow[1]);
+        *High = fmax(*High, ArgHigh[1]);
+    }
+    return FALSE;
+}
+
+/* rising in each argument while the limits can't cross, otherwise it's one of the three. A
+ * NaN limit doesn't limit, which also leaves one of the three */
+static int MathRangeClamp(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    if (ArgHigh[1] <= ArgLow[2] && !ArgNaN[1] && !ArgNaN[2])
+    {
+        *Low = MathNativeClamp(ArgLow[0], ArgLow[1], ArgLow[2]);
+        *High = MathNativeClamp(ArgHigh[0], ArgHigh[1], ArgHigh[2]);
+        return FALSE;
+    }
+
+    *Low = fmin(ArgLow[0], fmin(ArgLow[1], ArgLow[2]));
+    *High = fmax(ArgHigh[0], fmax(ArgHigh[1], ArgHigh[2]));
+    return FALSE;
+}
+
+/* linear in each argument, so the extremes are at the corners, give or take the rounding of the
+ * products, which is a few ulps of the largest of them rather than of the result. With an infinite
+ * bound, 0 times infinity or infinity less infinity give NaNs, and the corners don't bound the rest */
+static int MathRangeLerp(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN)
+{
+    double Value;
+    double Magnitude = 0.0;
+    double From;
+    double To;
+    double Amount;
+    int NumNaN = 0;
+    int Corner;
+    int Arg;
+
+    *Low = HUGE_VAL;
+    *High = -HUGE_VAL;
+    for (Corner = 0; Corner < 8; Corner++)
+    {
+        From = (Corner & 1) ? ArgHigh[0] : ArgLow[0];
+        To = (Corner & 2) ? ArgHigh[1] : ArgLow[1];
+        Amount = (Corner & 4) ? ArgHigh[2] : ArgLow[2];
+        Value = MathNativeLerp(From, To, Amount);
+        NumNaN += (Value != Value);
+        Magnitude = fmax(Magnitude, fabs(From) + fabs((1.0 - Amount) * From) + fabs(Amount * To));
+        *Low = (Value < *Low) ? Value : *Low;
+        *High = (Value > *High) ? Value : *High;
+    }
+    MathRangeCorners(Low, High);
+
+    for (Arg = 0; Arg < 3; Arg++)
+    {
+        if (isinf(ArgLow[Arg]) || isinf(ArgHigh[Arg]) || (NumNaN > 0 && NumNaN < 8))
+        {
+            *Low = -HUGE_VAL;
+            *High = HUGE_VAL;
+            return TRUE;
+        }
+    }
+
+    *Low -= ldexp(Magnitude, -50);
+    *High += ldexp(Magnitude, -50);
+    return NumNaN > 0;
+}
+
+
 /* all math.h functions */
 struct LibraryFunction MathFunctions[] =
 {
@@ -208,6 +1023,43 @@ struct LibraryFunction MathFunctions[] =
     { NULL,             NULL }
 };
 
+/* the pure math.h functions. Functions of doubles also have a direct entry point which the
+ * expression evaluator calls without boxing the arguments, and all of them may be folded by the
+ * optimiser. Those with a vector version are run on all the lanes at once by the vector evaluator,
+ * those with partial derivatives can be differentiated by the gradient evaluator, and those with
+ * a range can be bounded by the interval evaluator. frexp and modf write through pointers, so
+ * they aren't here */
+struct LibraryNative MathNatives[] =
+{
+    { MathAcos,  { acos, NULL, NULL, NULL, NULL, MathPartialAcos, MathRangeAcos } },
+    { MathAsin,  { asin, NULL, NULL, NULL, NULL, MathPartialAsin, MathRangeAsin } },
+    { MathAtan,  { atan, NULL, NULL, NULL, NULL, MathPartialAtan, MathRangeAtan } },
+    { MathAtan2, { NULL, atan2, NULL, NULL, NULL, MathPartialAtan2, MathRangeAtan2 } },
+    { MathCeil,  { ceil, NULL, NULL, NULL, NULL, MathPartialFlat, MathRangeCeil } },
+    { MathCos,   { cos, NULL, NULL, MathVectorCos, NULL, MathPartialCos, MathRangeCos } },
+    { MathCosh,  { cosh, NULL, NULL, NULL, NULL, MathPartialCosh, MathRangeCosh } },
+    { MathExp,   { exp, NULL, NULL, MathVectorExp, NULL, MathPartialExp, MathRangeExp } },
+    { MathFabs,  { fabs, NULL, NULL, NULL, NULL, MathPartialFabs, MathRangeFabs } },
+	{ MathSgn,   { MathNativeSgn, NULL, NULL, NULL, NULL, MathPartialFlat, MathRangeSgn } },
+    { MathFloor, { floor, NULL, NULL, NULL, NULL, MathPartialFlat, MathRangeFloor } },
+    { MathFmod,  { NULL, fmod, NULL, NULL, NULL, MathPartialFmod, MathRangeFmod } },
+    { MathLdexp, { NULL, NULL, NULL, NULL, NULL, NULL, NULL } },
+    { MathLog,   { log, NULL, NULL, MathVectorLog, NULL, MathPartialLog, MathRangeLog } },
+    { MathLog10, { log10, NULL, NULL, NULL, NULL, MathPartialLog10, MathRangeLog10 } },
+    { MathPow,   { NULL, pow, NULL, NULL, MathVectorPow, MathPartialPow, MathRangePow } },
+    { MathRound, { MathNativeRound, NULL, NULL, NULL, NULL, MathPartialFlat, MathRangeRound } },
+    { MathSin,   { sin, NULL, NULL, MathVectorSin, NULL, MathPartialSin, MathRangeSin } },
+    { MathSinh,  { sinh, NULL, NULL, NULL, NULL, MathPartialSinh, MathRangeSinh } },
+    { MathSqrt,  { sqrt, NULL, NULL, NULL, NULL, MathPartialSqrt, MathRangeSqrt } },
+    { MathTan,   { tan, NULL, NULL, NULL, NULL, MathPartialTan, MathRangeTan } },
+    { MathTanh,  { tanh, NULL, NULL, NULL, NULL, MathPartialTanh, MathRangeTanh } },
+	{ MathMin,   { NULL, MathNativeMin, NULL, NULL, NULL, MathPartialMin, MathRangeMin } },
+	{ MathMax,   { NULL, MathNativeMax, NULL, NULL, NULL, MathPartialMax, MathRangeMax } },
+	{ MathClamp, { NULL, NULL, MathNativeClamp, NULL, NULL, MathPartialClamp, MathRangeClamp } },
+	{ MathLerp,  { NULL, NULL, MathNativeLerp, NULL, NULL, MathPartialLerp, MathRangeLerp } },
+    { NULL,      { NULL, NULL, NULL, NULL, NULL, NULL, NULL } }
+};
+
 LibraryConstant MathConstants[] =
 {
 	LibraryConstant((union AnyValue *)&M_EValue       , TypeFP, "M_E"),
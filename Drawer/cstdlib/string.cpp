@@ -38,12 +38,12 @@ void StringStrncat(struct ParseState *Parser, struct Value *ReturnValue, struct
 #ifndef WIN32
 void StringIndex(struct ParseState *Parser, struct Value *ReturnValue, struct Value **Param, int NumArgs)
 {
-    ReturnValue->Val->Pointer = index(Param[0]->Val->Pointer, Param[1]->Val->Integer);
+    ReturnValue->Val->Pointer = (void*)index((char*)Param[0]->Val->Pointer, Param[1]->Val->Integer);
 }
 
 void StringRindex(struct ParseState *Parser, struct Value *ReturnValue, struct Value **Param, int NumArgs)
 {
-    ReturnValue->Val->Pointer = rindex(Param[0]->Val->Pointer, Param[1]->Val->Integer);
+    ReturnValue->Val->Pointer = (void*)rindex((char*)Param[0]->Val->Pointer, Param[1]->Val->Integer);
 }
 #endif
 
@@ -130,12 +130,12 @@ void StringStrxfrm(struct ParseState *Parser, struct Value *ReturnValue, struct
 #ifndef WIN32
 void StringStrdup(struct ParseState *Parser, struct Value *ReturnValue, struct Value **Param, int NumArgs)
 {
-    ReturnValue->Val->Pointer = strdup(Param[0]->Val->Pointer);
+    ReturnValue->Val->Pointer = strdup((char*)Param[0]->Val->Pointer);
 }
 
 void StringStrtok_r(struct ParseState *Parser, struct Value *ReturnValue, struct Value **Param, int NumArgs)
 {
-    ReturnValue->Val->Pointer = strtok_r(Param[0]->Val->Pointer, Param[1]->Val->Pointer, Param[2]->Val->Pointer);
+    ReturnValue->Val->Pointer = strtok_r((char*)Param[0]->Val->Pointer, (char*)Param[1]->Val->Pointer, (char**)Param[2]->Val->Pointer);
 }
 #endif
 
@@ -66,17 +66,17 @@ void StdStrptime(struct ParseState *Parser, struct Value *ReturnValue, struct Va
 {
 	  extern char *strptime(const char *s, const char *format, struct tm *tm);
 	  
-    ReturnValue->Val->Pointer = strptime(Param[0]->Val->Pointer, Param[1]->Val->Pointer, Param[2]->Val->Pointer);
+    ReturnValue->Val->Pointer = strptime((char*)Param[0]->Val->Pointer, (char*)Param[1]->Val->Pointer, (tm*)Param[2]->Val->Pointer);
 }
 
 void StdGmtime_r(struct ParseState *Parser, struct Value *ReturnValue, struct Value **Param, int NumArgs)
 {
-    ReturnValue->Val->Pointer = gmtime_r(Param[0]->Val->Pointer, Param[1]->Val->Pointer);
+    ReturnValue->Val->Pointer = gmtime_r((time_t*)Param[0]->Val->Pointer, (tm*)Param[1]->Val->Pointer);
 }
 
 void StdTimegm(struct ParseState *Parser, struct Value *ReturnValue, struct Value **Param, int NumArgs)
 {
-    ReturnValue->Val->Integer = timegm(Param[0]->Val->Pointer);
+    ReturnValue->Val->Integer = timegm((tm*)Param[0]->Val->Pointer);
 }
 #endif
 
@@ -115,7 +115,9 @@ LibraryConstant StdTimeConstants[] =
 #ifdef CLK_PER_SEC
 	LibraryConstant((union AnyValue *)&CLK_PER_SECValue, TypeInt, "CLK_PER_SEC"),
 #endif
+#ifdef CLK_TCK
 	LibraryConstant((union AnyValue *)&CLK_TCKValue, TypeInt, "CLK_TCK"),
+#endif
 	LibraryConstant(NULL, TypeInt, NULL)
 };
 
@@ -573,7 +573,7 @@ void ExpressionPrefixOperator(struct ParseState *Parser, struct ExpressionStack
             {
                 /* integer prefix arithmetic */
                 long ResultInt = 0;
-                long TopInt = ExpressionCoerceInteger(TopValue);
+                long TopInt = (TopValue->Typ == &Parser->pc->IntType) ? TopValue->Val->Integer : ExpressionCoerceInteger(TopValue);
                 switch (Op)
                 {
                     case TokenPlus:         ResultInt = TopInt; break;
@@ -680,6 +680,67 @@ void ExpressionPostfixOperator(struct ParseState *Parser, struct ExpressionStack
         ProgramFail(Parser, "invalid operation");
 }
 
+#ifndef NO_FP
+/* fast path for double op double - no coercion needed. Returns FALSE if the operator isn't handled here */
+static int ExpressionInfixFP(struct ParseState *Parser, struct ExpressionStack **StackTop, enum LexToken Op, struct Value *BottomValue, struct Value *TopValue)
+{
+    double TopFP = TopValue->Val->FP;
+    double BottomFP = BottomValue->Val->FP;
+
+    switch (Op)
+    {
+        case TokenPlus:             ExpressionPushFP(Parser, StackTop, BottomFP + TopFP); break;
+        case TokenMinus:            ExpressionPushFP(Parser, StackTop, BottomFP - TopFP); break;
+        case TokenAsterisk:         ExpressionPushFP(Parser, StackTop, BottomFP * TopFP); break;
+        case TokenSlash:            ExpressionPushFP(Parser, StackTop, BottomFP / TopFP); break;
+        case TokenAssign:           ExpressionPushFP(Parser, StackTop, ExpressionAssignFP(Parser, BottomValue, TopFP)); break;
+        case TokenAddAssign:        ExpressionPushFP(Parser, StackTop, ExpressionAssignFP(Parser, BottomValue, BottomFP + TopFP)); break;
+        case TokenSubtractAssign:   ExpressionPushFP(Parser, StackTop, ExpressionAssignFP(Parser, BottomValue, BottomFP - TopFP)); break;
+        case TokenMultiplyAssign:   ExpressionPushFP(Parser, StackTop, ExpressionAssignFP(Parser, BottomValue, BottomFP * TopFP)); break;
+        case TokenDivideAssign:     ExpressionPushFP(Parser, StackTop, ExpressionAssignFP(Parser, BottomValue, BottomFP / TopFP)); break;
+        case TokenEqual:            ExpressionPushInt(Parser, StackTop, BottomFP == TopFP); break;
+        case TokenNotEqual:         ExpressionPushInt(Parser, StackTop, BottomFP != TopFP); break;
+        case TokenLessThan:         ExpressionPushInt(Parser, StackTop, BottomFP < TopFP); break;
+        case TokenGreaterThan:      ExpressionPushInt(Parser, StackTop, BottomFP > TopFP); break;
+        case TokenLessEqual:        ExpressionPushInt(Parser, StackTop, BottomFP <= TopFP); break;
+        case TokenGreaterEqual:     ExpressionPushInt(Parser, StackTop, BottomFP >= TopFP); break;
+        default:                    return FALSE;
+    }
+    
+    return TRUE;
+}
+#endif
+
+/* fast path for int op int. Arithmetic is done in long like the generic path so results are identical */
+static int ExpressionInfixInt(struct ParseState *Parser, struct ExpressionStack **StackTop, enum LexToken Op, struct Value *BottomValue, struct Value *TopValue)
+{
+    long TopInt = TopValue->Val->Integer;
+    long BottomInt = BottomValue->Val->Integer;
+    long ResultInt;
+
+    switch (Op)
+    {
+        case TokenPlus:             ResultInt = BottomInt + TopInt; break;
+        case TokenMinus:            ResultInt = BottomInt - TopInt; break;
+        case TokenAsterisk:         ResultInt = BottomInt * TopInt; break;
+        case TokenEqual:            ResultInt = BottomInt == TopInt; break;
+        case TokenNotEqual:         ResultInt = BottomInt != TopInt; break;
+        case TokenLessThan:         ResultInt = BottomInt < TopInt; break;
+        case TokenGreaterThan:      ResultInt = BottomInt > TopInt; break;
+        case TokenLessEqual:        ResultInt = BottomInt <= TopInt; break;
+        case TokenGreaterEqual:     ResultInt = BottomInt >= TopInt; break;
+        case TokenLogicalOr:        ResultInt = BottomInt || TopInt; break;
+        case TokenLogicalAnd:       ResultInt = BottomInt && TopInt; break;
+        case TokenAssign:           ResultInt = ExpressionAssignInt(Parser, BottomValue, TopInt, FALSE); break;
+        case TokenAddAssign:        ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt + TopInt, FALSE); break;
+        case TokenSubtractAssign:   ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt - TopInt, FALSE); break;
+        default:                    return FALSE;
+    }
+
+    ExpressionPushInt(Parser, StackTop, ResultInt);
+    return TRUE;
+}
+
 /* evaluate an infix operator */
 void ExpressionInfixOperator(struct ParseState *Parser, struct ExpressionStack **StackTop, enum LexToken Op, struct Value *BottomValue, struct Value *TopValue)
 {
@@ -690,6 +751,19 @@ void ExpressionInfixOperator(struct ParseState *Parser, struct ExpressionStack *
     debugf("ExpressionInfixOperator()\n");
     if (BottomValue == NULL || TopValue == NULL || BottomValue->Typ == NULL || TopValue->Typ == NULL)
         ProgramFail(Parser, "invalid expression");
+
+    /* same-type numeric operands skip the coercion below. This is decided on every execution,
+     * not once per operator: the expression is parsed again each time it runs, so there's
+     * nowhere to keep a choice per site that is cheaper to look up than these two compares */
+    if (TopValue->Typ == BottomValue->Typ)
+    {
+#ifndef NO_FP
+        if (TopValue->Typ == &Parser->pc->FPType && ExpressionInfixFP(Parser, StackTop, Op, BottomValue, TopValue))
+            return;
+#endif
+        if (TopValue->Typ == &Parser->pc->IntType && ExpressionInfixInt(Parser, StackTop, Op, BottomValue, TopValue))
+            return;
+    }
         
     if (Op == TokenLeftSquareBracket)
     { 
@@ -1070,7 +1144,7 @@ void ExpressionGetStructElement(struct ParseState *Parser, struct ExpressionStac
         if (StructType->Base != TypeStruct && StructType->Base != TypeUnion)
             ProgramFail(Parser, "can't use " + ((Token == TokenDot) ? std::string(".") : std::string("->")) + " on something that's not a struct or union " + ((Token == TokenArrow) ? std::string("pointer") : std::string()));
             
-        if (!TableGet(StructType->Members, Ident->Val->Identifier, &MemberValue, NULL, NULL, NULL))
+        if (!TableGet(Parser->pc, StructType->Members, Ident->Val->Identifier, &MemberValue, NULL, NULL, NULL))
             ProgramFail(Parser, "doesn't have a member called " + std::string(Ident->Val->Identifier));
         
         /* pop the value - assume it'll still be there until we're done */
@@ -1273,9 +1347,9 @@ int ExpressionParse(struct ParseState *Parser, struct Value **Result)
                         struct ParseState MacroParser;
                         struct Value *MacroResult;
                         
-                        ParserCopy(&MacroParser, &VariableValue->Val->MacroDef.Body);
+                        ParserCopy(&MacroParser, &VariableValue->Val->MacroDef->Body);
                         MacroParser.Mode = Parser->Mode;
-                        if (VariableValue->Val->MacroDef.NumParams != 0)
+                        if (VariableValue->Val->MacroDef->NumParams != 0)
                             ProgramFail(&MacroParser, "macro arguments missing");
                             
                         if (!ExpressionParse(&MacroParser, &MacroResult) || LexGetToken(&MacroParser, NULL, FALSE) != TokenEndOfFunction)
@@ -1434,8 +1508,7 @@ void ExpressionParseMacroCall(struct ParseState *Parser, struct ExpressionStack
         
         ParserCopy(&MacroParser, &MDef->Body);
         MacroParser.Mode = Parser->Mode;
-        VariableStackFrameAdd(Parser, MacroName, 0);
-        Parser->pc->TopStackFrame->NumParams = ArgCount;
+        VariableStackFrameAdd(Parser, MacroName, NULL, NULL, 0);
         Parser->pc->TopStackFrame->ReturnValue = ReturnValue;
         for (Count = 0; Count < MDef->NumParams; Count++)
             VariableDefine(Parser->pc, Parser, MDef->ParamName[Count], ParamArray[Count], NULL, TRUE);
@@ -1447,6 +1520,107 @@ void ExpressionParseMacroCall(struct ParseState *Parser, struct ExpressionStack
     }
 }
 
+/* find what's called at this point. Functions are global and stay put once they're defined, so the
+ * lookup is remembered for the next time the same call is made */
+static struct Value *ExpressionGetCallTarget(struct ParseState *Parser, const unsigned char *CallPos, const char *FuncName)
+{
+    struct CallSite *Site = &Parser->pc->CallSiteCache[((unsigned long)CallPos) % CALL_SITE_CACHE_SIZE];
+    struct Value *FuncValue;
+
+    if (Site->Pos == CallPos && Site->FuncName == FuncName)
+        return Site->FuncValue;
+
+    VariableGet(Parser->pc, Parser, FuncName, &FuncValue);
+    if (FuncValue->Typ->Base == TypeFunction)
+    {
+        Site->Pos = CallPos;
+        Site->FuncName = FuncName;
+        Site->FuncValue = FuncValue;
+    }
+
+    return FuncValue;
+}
+
+/* does this function have a direct entry point for its number of parameters? */
+static int ExpressionIsNative(struct FuncDef *Func)
+{
+    switch (Func->NumParams)
+    {
+        case 1:     return Func->Native.FP1 != NULL;
+        case 2:     return Func->Native.FP2 != NULL;
+        case 3:     return Func->Native.FP3 != NULL;
+        default:    return FALSE;
+    }
+}
+
+/* call a library function of doubles through its direct entry point, passing the arguments unboxed */
+static void ExpressionParseNativeCall(struct ParseState *Parser, struct ExpressionStack **StackTop, const char *FuncName, struct FuncDef *Func)
+{
+    double Arg[3];
+    struct Value *Param;
+    int ArgCount = 0;
+    enum LexToken Token;
+
+    do {
+        if (ExpressionParse(Parser, &Param))
+        {
+            if (ArgCount >= Func->NumParams)
+                ProgramFail(Parser, "too many arguments to " + std::string(FuncName) + "()");
+
+            if (!IS_NUMERIC_COERCIBLE(Param))
+                AssignFail(Parser, " from ", &Parser->pc->FPType, Param->Typ, FuncName, ArgCount+1);
+
+            Arg[ArgCount++] = ExpressionCoerceFP(Param);
+            VariableStackPop(Parser, Param);
+
+            Token = LexGetToken(Parser, NULL, TRUE);
+            if (Token != TokenComma && Token != TokenCloseBracket)
+                ProgramFail(Parser, "comma expected");
+        }
+        else
+        { 
+            /* end of argument list? */
+            Token = LexGetToken(Parser, NULL, TRUE);
+            if (Token != TokenCloseBracket)
+                ProgramFail(Parser, "bad argument");
+        }
+
+    } while (Token != TokenCloseBracket);
+
+    if (ArgCount < Func->NumParams)
+        ProgramFail(Parser, "not enough arguments to '" + std::string(FuncName) + "'");
+
+    switch (Func->NumParams)
+    {
+        case 1:     ExpressionPushFP(Parser, StackTop, Func->Native.FP1(Arg[0])); break;
+        case 2:     ExpressionPushFP(Parser, StackTop, Func->Native.FP2(Arg[0], Arg[1])); break;
+        default:    ExpressionPushFP(Parser, StackTop, Func->Native.FP3(Arg[0], Arg[1], Arg[2])); break;
+    }
+}
+
+/* where a pure function's result for these arguments is remembered, if it's been worked out */
+static struct MemoEntry *ExpressionMemoEntry(Picoc *pc, struct FuncDef *Func, struct Value **ParamArray, double *Arg)
+{
+    unsigned long long Hash = 0xcbf29ce484222325ULL;
+    unsigned long long Bits;
+    int Count;
+
+    for (Count = 0; Count < Func->NumParams; Count++)
+    {
+        Arg[Count] = (Func->ParamType[Count] == &pc->FPType) ? ParamArray[Count]->Val->FP : (double)ParamArray[Count]->Val->Integer;
+        memcpy((void *)&Bits, (void *)&Arg[Count], sizeof(Bits));
+        Hash = (Hash ^ Bits) * 0x100000001b3ULL;
+        Hash ^= Hash >> 29;
+    }
+
+    return &Func->Memo[Hash % MEMO_TABLE_SIZE];
+}
+
+static int ExpressionMemoMatches(struct FuncDef *Func, struct MemoEntry *Entry, double *Arg)
+{
+    return Entry->IsUsed && memcmp((void *)Entry->Arg, (void *)Arg, sizeof(double) * Func->NumParams) == 0;
+}
+
 /* do a function call */
 void ExpressionParseFunctionCall(struct ParseState *Parser, struct ExpressionStack **StackTop, const char *FuncName, int RunIt)
 {
@@ -1455,28 +1629,36 @@ void ExpressionParseFunctionCall(struct ParseState *Parser, struct ExpressionSta
     struct Value *Param;
     struct Value **ParamArray = NULL;
     int ArgCount;
+    const unsigned char *CallPos = Parser->Pos;
     enum LexToken Token = LexGetToken(Parser, NULL, TRUE);    /* open bracket */
     enum RunMode OldMode = Parser->Mode;
     
     if (RunIt)
     { 
         /* get the function definition */
-        VariableGet(Parser->pc, Parser, FuncName, &FuncValue);
+        FuncValue = ExpressionGetCallTarget(Parser, CallPos, FuncName);
         
         if (FuncValue->Typ->Base == TypeMacro)
         {
             /* this is actually a macro, not a function */
-            ExpressionParseMacroCall(Parser, StackTop, FuncName, &FuncValue->Val->MacroDef);
+            ExpressionParseMacroCall(Parser, StackTop, FuncName, FuncValue->Val->MacroDef);
             return;
         }
         
         if (FuncValue->Typ->Base != TypeFunction)
             ProgramFail(Parser, "it is not a function - can't call");
+
+        STATS_ADD(Parser->pc, FunctionCalls, 1);
+        if (ExpressionIsNative(FuncValue->Val->FuncDef))
+        {
+            ExpressionParseNativeCall(Parser, StackTop, FuncName, FuncValue->Val->FuncDef);
+            return;
+        }
     
-        ExpressionStackPushValueByType(Parser, StackTop, FuncValue->Val->FuncDef.ReturnType);
+        ExpressionStackPushValueByType(Parser, StackTop, FuncValue->Val->FuncDef->ReturnType);
         ReturnValue = (*StackTop)->Val;
         HeapPushStackFrame(Parser->pc);
-        ParamArray = (Value**)HeapAllocStack(Parser->pc, sizeof(struct Value *) * FuncValue->Val->FuncDef.NumParams);    
+        ParamArray = (Value**)HeapAllocStack(Parser->pc, sizeof(struct Value *) * FuncValue->Val->FuncDef->NumParams);    
         if (ParamArray == NULL)
             ProgramFail(Parser, "out of memory");
     }
@@ -1489,21 +1671,21 @@ void ExpressionParseFunctionCall(struct ParseState *Parser, struct ExpressionSta
     /* parse arguments */
     ArgCount = 0;
     do {
-        if (RunIt && ArgCount < FuncValue->Val->FuncDef.NumParams)
-            ParamArray[ArgCount] = VariableAllocValueFromType(Parser->pc, Parser, FuncValue->Val->FuncDef.ParamType[ArgCount], FALSE, NULL, FALSE);
+        if (RunIt && ArgCount < FuncValue->Val->FuncDef->NumParams)
+            ParamArray[ArgCount] = VariableAllocValueFromType(Parser->pc, Parser, FuncValue->Val->FuncDef->ParamType[ArgCount], FALSE, NULL, FALSE);
         
         if (ExpressionParse(Parser, &Param))
         {
             if (RunIt)
             { 
-                if (ArgCount < FuncValue->Val->FuncDef.NumParams)
+                if (ArgCount < FuncValue->Val->FuncDef->NumParams)
                 {
                     ExpressionAssign(Parser, ParamArray[ArgCount], Param, TRUE, FuncName, ArgCount+1, FALSE);
                     VariableStackPop(Parser, Param);
                 }
                 else
                 {
-                    if (!FuncValue->Val->FuncDef.VarArgs)
+                    if (!FuncValue->Val->FuncDef->VarArgs)
                         ProgramFail(Parser, "too many arguments to " + std::string(FuncName) + "()");
                 }
             }
@@ -1528,38 +1710,48 @@ void ExpressionParseFunctionCall(struct ParseState *Parser, struct ExpressionSta
     if (RunIt) 
     { 
         /* run the function */
-        if (ArgCount < FuncValue->Val->FuncDef.NumParams)
+        if (ArgCount < FuncValue->Val->FuncDef->NumParams)
             ProgramFail(Parser, "not enough arguments to '" + std::string(FuncName) + "'");
         
-        if (FuncValue->Val->FuncDef.Intrinsic == NULL)
+        if (FuncValue->Val->FuncDef->Intrinsic == NULL)
         { 
             /* run a user-defined function */
+            struct FuncDef *Func = FuncValue->Val->FuncDef;
             struct ParseState FuncParser;
-            int Count;
-            int OldScopeID = Parser->ScopeID;
+            struct MemoEntry *Entry = NULL;
+            double Arg[MEMO_PARAMS_MAX];
             
-            if (FuncValue->Val->FuncDef.Body.Pos == NULL)
+            if (FuncValue->Val->FuncDef->Body.Pos == NULL)
                 ProgramFail(Parser, "'" + std::string(FuncName) + "' is undefined");
-            
-            ParserCopy(&FuncParser, &FuncValue->Val->FuncDef.Body);
-            VariableStackFrameAdd(Parser, FuncName, FuncValue->Val->FuncDef.Intrinsic ? FuncValue->Val->FuncDef.NumParams : 0);
-            Parser->pc->TopStackFrame->NumParams = ArgCount;
-            Parser->pc->TopStackFrame->ReturnValue = ReturnValue;
 
-            /* Function parameters should not go out of scope */
-            Parser->ScopeID = -1;
-
-            for (Count = 0; Count < FuncValue->Val->FuncDef.NumParams; Count++)
-                VariableDefine(Parser->pc, Parser, FuncValue->Val->FuncDef.ParamName[Count], ParamArray[Count], NULL, TRUE);
+            /* a pure function called with the same arguments as before gives the same result */
+            if (Func->Memo != NULL)
+            {
+                Entry = ExpressionMemoEntry(Parser->pc, Func, ParamArray, Arg);
+                if (ExpressionMemoMatches(Func, Entry, Arg))
+                {
+                    if (Func->ReturnType == &Parser->pc->FPType)
+                        ReturnValue->Val->FP = Entry->Result;
+                    else
+                        ReturnValue->Val->Integer = (int)Entry->Result;
 
-            Parser->ScopeID = OldScopeID;
+                    HeapPopStackFrame(Parser->pc);
+                    Parser->Mode = OldMode;
+                    return;
+                }
+            }
+            
+            ParserCopy(&FuncParser, &FuncValue->Val->FuncDef->Body);
+            /* the arguments were converted into values of the parameter types, use them as the parameters */
+            VariableStackFrameAdd(Parser, FuncName, ParamArray, Func->ParamName, Func->NumParams);
+            Parser->pc->TopStackFrame->ReturnValue = ReturnValue;
                 
             if (ParseStatement(&FuncParser, TRUE) != ParseResultOk)
                 ProgramFail(&FuncParser, "function body expected");
             
             if (RunIt)
             {
-                if (FuncParser.Mode == RunModeRun && FuncValue->Val->FuncDef.ReturnType != &Parser->pc->VoidType)
+                if (FuncParser.Mode == RunModeRun && FuncValue->Val->FuncDef->ReturnType != &Parser->pc->VoidType)
                     ProgramFail(&FuncParser, "no value returned from a function returning something");
 
                 else if (FuncParser.Mode == RunModeGoto)
@@ -1567,9 +1759,16 @@ void ExpressionParseFunctionCall(struct ParseState *Parser, struct ExpressionSta
             }
             
             VariableStackFramePop(Parser);
+
+            if (Entry != NULL)
+            {
+                memcpy((void *)Entry->Arg, (void *)Arg, sizeof(double) * Func->NumParams);
+                Entry->Result = (Func->ReturnType == &Parser->pc->FPType) ? ReturnValue->Val->FP : (double)ReturnValue->Val->Integer;
+                Entry->IsUsed = TRUE;
+            }
         }
         else
-            FuncValue->Val->FuncDef.Intrinsic(Parser, ReturnValue, ParamArray, ArgCount);
+            FuncValue->Val->FuncDef->Intrinsic(Parser, ReturnValue, ParamArray, ArgCount);
 
         HeapPopStackFrame(Parser->pc);
     }
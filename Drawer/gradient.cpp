@@ -0,0 +1,163 @@
+/* picoc gradients - main's derivatives by its arguments, worked out alongside its values
+ * by running the batch's vector program with a dual number in each register */
+
+#include "interpreter.h"
+
+extern bool gResetParser;
+
+/* forward mode differentiation of the block VectorRun() has just worked out. Each operation
+ * works out its result's derivative from its operands' values and derivatives, as a dual number
+ * would. Constants have none, and the input or the first argument's global is the variable.
+ * Integer and comparison results are steps which are flat either side, so theirs are 0 */
+VECTOR_TARGET static void GradientDifferentiate(struct VectorProgram *Vector, double (*Tangent)[VECTOR_LANES], int ByFirst)
+{
+    const struct VectorOp *Op;
+    double Partial[3];
+    double Args[3];
+    double Sum;
+    int NumArgs;
+    int Count;
+    int Arg;
+    int Lane;
+
+    for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+        Tangent[Vector->Input][Lane] = ByFirst ? 0.0 : 1.0;
+
+    for (Count = 0; Count < Vector->NumOps; Count++)
+    {
+        Op = &Vector->Ops[Count];
+
+        double *__restrict Result = Tangent[Op->Result];
+        const double *__restrict Value = Vector->Registers[Op->Result];
+        const double *__restrict A = (Op->Operand[0] != VECTOR_NONE) ? Vector->Registers[Op->Operand[0]] : NULL;
+        const double *__restrict B = (Op->Operand[1] != VECTOR_NONE) ? Vector->Registers[Op->Operand[1]] : NULL;
+        const double *__restrict DA = (Op->Operand[0] != VECTOR_NONE) ? Tangent[Op->Operand[0]] : NULL;
+        const double *__restrict DB = (Op->Operand[1] != VECTOR_NONE) ? Tangent[Op->Operand[1]] : NULL;
+        const double *__restrict DC = (Op->Operand[2] != VECTOR_NONE) ? Tangent[Op->Operand[2]] : NULL;
+
+        switch (Op->Code)
+        {
+            case VectorGlobal:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (ByFirst && Op->Address == Vector->First) ? 1.0 : 0.0;
+                break;
+
+            case VectorAdd:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = DA[Lane] + DB[Lane];
+                break;
+
+            case VectorSubtract:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = DA[Lane] - DB[Lane];
+                break;
+
+            case VectorMultiply:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = DA[Lane] * B[Lane] + A[Lane] * DB[Lane];
+                break;
+
+            case VectorDivide:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (DA[Lane] - Value[Lane] * DB[Lane]) / B[Lane];
+                break;
+
+            case VectorNegate:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = -DA[Lane];
+                break;
+
+            case VectorSelect:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (A[Lane] != 0.0) ? DB[Lane] : DC[Lane];
+                break;
+
+            /* the chain rule over each argument. One which doesn't vary is left out, so a
+             * function which is infinitely steep there doesn't make the derivative a NaN */
+            case VectorKernel1:
+            case VectorKernel2:
+            case VectorCall1:
+            case VectorCall2:
+            case VectorCall3:
+                NumArgs = 0;
+                while (NumArgs < 3 && Op->Operand[NumArgs] != VECTOR_NONE)
+                    NumArgs++;
+
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                {
+                    for (Arg = 0; Arg < NumArgs; Arg++)
+                        Args[Arg] = Vector->Registers[Op->Operand[Arg]][Lane];
+
+                    Op->Native->Partials(Partial, Args, Value[Lane]);
+                    Sum = 0.0;
+                    for (Arg = 0; Arg < NumArgs; Arg++)
+                    {
+                        if (Tangent[Op->Operand[Arg]][Lane] != 0.0)
+                            Sum += Partial[Arg] * Tangent[Op->Operand[Arg]][Lane];
+                    }
+
+                    Result[Lane] = Sum;
+                }
+                break;
+
+            default:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = 0.0;
+                break;
+        }
+    }
+}
+
+/* make room for the derivatives in the batch's vector program, if every function it calls
+ * gives its partial derivatives. Returns FALSE if main can't be differentiated */
+int GradientPrepare(Picoc *pc, struct VectorProgram *Vector)
+{
+    int Count;
+
+    for (Count = 0; Count < Vector->NumOps; Count++)
+    {
+        if (Vector->Ops[Count].Code >= VectorKernel1 && Vector->Ops[Count].Native->Partials == NULL)
+            return FALSE;
+    }
+
+    Vector->Tangents = (double (*)[VECTOR_LANES])HeapAllocMem(pc, sizeof(double) * VECTOR_LANES * Vector->NumRegisters * 2);
+    return Vector->Tangents != NULL;
+}
+
+/* evaluate main and its derivatives by its last and first argument for Count values of the
+ * last one. DFirst may be NULL, and is all 0 for a main of one argument. Returns FALSE if there's
+ * no gradient program */
+int GradientEvaluate(Picoc *pc, const double *Last, double *Result, double *DLast, double *DFirst, int Count)
+{
+    struct VectorProgram *Vector = pc->JitBatchVector;
+    double (*ByFirst)[VECTOR_LANES];
+    double *Input;
+    int Start;
+    int Lanes;
+    int Lane;
+
+    if (Vector == NULL || Vector->Tangents == NULL || gResetParser)
+        return FALSE;
+
+    Input = Vector->Registers[Vector->Input];
+    ByFirst = &Vector->Tangents[Vector->NumRegisters];
+    for (Start = 0; Start < Count; Start += VECTOR_LANES)
+    {
+        Lanes = (Count - Start < VECTOR_LANES) ? Count - Start : VECTOR_LANES;
+        for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+            Input[Lane] = Last[Start + ((Lane < Lanes) ? Lane : Lanes-1)];
+
+        VectorRun(Vector, NULL);
+        GradientDifferentiate(Vector, Vector->Tangents, FALSE);
+        memcpy((void *)&Result[Start], (void *)Vector->Registers[Vector->Result], sizeof(double) * Lanes);
+        memcpy((void *)&DLast[Start], (void *)Vector->Tangents[Vector->Result], sizeof(double) * Lanes);
+
+        if (DFirst != NULL)
+        {
+            GradientDifferentiate(Vector, ByFirst, TRUE);
+            memcpy((void *)&DFirst[Start], (void *)ByFirst[Vector->Result], sizeof(double) * Lanes);
+        }
+    }
+
+    return TRUE;
+}
@@ -75,6 +75,7 @@ void *HeapAllocStack(Picoc *pc, int Size)
         return NULL;
         
     pc->HeapStackTop = (void *)NewTop;
+    STATS_MAX(pc, StackHighWater, NewTop - (char *)&(pc->HeapMemory)[0]);
     memset((void *)NewMem, '\0', Size);
     return NewMem;
 }
@@ -86,6 +87,7 @@ void HeapUnpopStack(Picoc *pc, int Size)
     printf("HeapUnpopStack(%ld) at 0x%lx\n", (unsigned long)MEM_ALIGN(Size), (unsigned long)pc->HeapStackTop);
 #endif
     pc->HeapStackTop = (void *)((char *)pc->HeapStackTop + MEM_ALIGN(Size));
+    STATS_MAX(pc, StackHighWater, (char *)pc->HeapStackTop - (char *)&(pc->HeapMemory)[0]);
 }
 
 /* free some space at the top of the stack */
@@ -116,6 +118,7 @@ void HeapPushStackFrame(Picoc *pc)
     *(void **)pc->HeapStackTop = pc->StackFrame;
     pc->StackFrame = pc->HeapStackTop;
     pc->HeapStackTop = (void *)((char *)pc->HeapStackTop + MEM_ALIGN(sizeof(ALIGN_TYPE)));
+    STATS_MAX(pc, StackHighWater, (char *)pc->HeapStackTop - (char *)&(pc->HeapMemory)[0]);
 }
 
 /* pop the current stack frame, freeing all memory in the frame. can return NULL */
@@ -137,6 +140,8 @@ int HeapPopStackFrame(Picoc *pc)
 /* allocate some dynamically allocated memory. memory is cleared. can return NULL if out of memory */
 void *HeapAllocMem(Picoc *pc, int Size)
 {
+    STATS_ADD(pc, HeapAllocs, 1);
+    STATS_ADD(pc, HeapAllocBytes, Size);
 #ifdef USE_MALLOC_HEAP
     return calloc(Size, 1);
 #else
@@ -228,12 +233,15 @@ void *HeapAllocMem(Picoc *pc, int Size)
 /* free some dynamically allocated memory */
 void HeapFreeMem(Picoc *pc, void *Mem)
 {
+    if (Mem != NULL)
+        STATS_ADD(pc, HeapFrees, 1);
 #ifdef USE_MALLOC_HEAP
     free(Mem);
 #else
     struct AllocNode *MemNode = (struct AllocNode *)((char *)Mem - MEM_ALIGN(sizeof(MemNode->Size)));
     int Bucket = MemNode->Size >> 2;
     
+    STATS_ADD(pc, HeapFreeBytes, MemNode->Size - MEM_ALIGN(sizeof(MemNode->Size)));
 #ifdef DEBUG_HEAP
     printf("HeapFreeMem(0x%lx)\n", (unsigned long)Mem);
 #endif
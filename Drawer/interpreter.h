@@ -170,6 +170,103 @@ struct ValueType
     int StaticQualifier;            /* true if it's a static */
 };
 
+/* direct entry points for a library function which only takes and returns doubles,
+ * the one matching its number of parameters is set */
+struct NativeFunction
+{
+    double (*FP1)(double);
+    double (*FP2)(double, double);
+    double (*FP3)(double, double, double);
+    void (*Vector1)(double *Result, const double *Arg);  /* the same over VECTOR_LANES values, if there's a vector version */
+    void (*Vector2)(double *Result, const double *Arg1, const double *Arg2);
+    void (*Partials)(double *Partial, const double *Arg, double Result);  /* its derivative by each argument at a point, if it has one */
+    int (*Range)(double *Low, double *High, const double *ArgLow, const double *ArgHigh, const int *ArgNaN);  /* its bounds over a box of arguments, those with ArgNaN set also being NaN in places, if it has them. Returns TRUE if it gives NaNs for arguments which aren't */
+};
+
+#define VECTOR_NONE -1                  /* an operand of the vector program which isn't used */
+
+/* operations of the vector program. Ints are kept in doubles, which hold them exactly */
+enum VectorCode
+{
+    VectorConstant,                 /* filled in when the program is compiled */
+    VectorInput,                    /* the values of the last argument */
+    VectorGlobal,
+    VectorAdd,
+    VectorSubtract,
+    VectorMultiply,
+    VectorDivide,
+    VectorNegate,
+    VectorIntAdd,                   /* worked out in long and cut down to an int, as the evaluator does */
+    VectorIntSubtract,
+    VectorIntMultiply,
+    VectorIntDivide,
+    VectorIntModulus,
+    VectorIntShiftLeft,
+    VectorIntShiftRight,
+    VectorIntAnd,
+    VectorIntOr,
+    VectorIntExor,
+    VectorEqual,                    /* comparisons and logical operators give 0 or 1 */
+    VectorNotEqual,
+    VectorLessThan,
+    VectorLessEqual,
+    VectorNot,
+    VectorLogicalAnd,
+    VectorLogicalOr,
+    VectorTest,                     /* a double as a condition, converted to an int */
+    VectorTestLong,                 /* the same converted to a long, as a ternary's condition is */
+    VectorTruncate,                 /* a double converted to an int */
+    VectorSelect,                   /* the second operand where the first isn't 0, otherwise the third */
+    VectorKernel1,                  /* a math function's vector version */
+    VectorKernel2,
+    VectorCall1,                    /* a math function called for each lane */
+    VectorCall2,
+    VectorCall3
+};
+
+/* an operation of the vector program. Its result goes in the register with its own number */
+struct VectorOp
+{
+    enum VectorCode Code;
+    int Result;
+    int Operand[3];                 /* registers, or VECTOR_NONE */
+    const struct NativeFunction *Native;
+    void *Address;                  /* a global's value */
+    enum BaseType Type;             /* and its type */
+    double FP;                      /* a constant */
+};
+
+/* main compiled to work on VECTOR_LANES values of its last argument at a time */
+struct VectorProgram
+{
+    struct VectorOp *Ops;           /* the operations which are run for each block of values */
+    int NumOps;
+    double (*Registers)[VECTOR_LANES];
+    int NumRegisters;
+    int Input;
+    int Result;
+    void *First;                    /* where the first of two arguments is read from, or NULL */
+    double (*Tangents)[VECTOR_LANES];   /* for a batch program, the derivative of each register by the last argument then by the first */
+    double (*Bounds)[VECTOR_LANES];     /* and the lowest value of each register then the highest, for intervals */
+    char (*MayBeNaN)[VECTOR_LANES];     /* with whether each register can also be a NaN, which the bounds leave out */
+};
+
+/* what a function's result depends on, from the least to the most */
+enum FuncPurity
+{
+    PurityPure,                     /* only its arguments, and calling it changes nothing */
+    PurityStateful,                 /* also state the program keeps between calls, such as statics and globals it writes */
+    PurityImpure                    /* the outside world, such as the time, random numbers or output */
+};
+
+/* a remembered result of a pure function */
+struct MemoEntry
+{
+    int IsUsed;
+    double Arg[MEMO_PARAMS_MAX];    /* the arguments as they were passed, ints included */
+    double Result;
+};
+
 /* function definition */
 struct FuncDef
 {
@@ -179,6 +276,10 @@ struct FuncDef
     struct ValueType **ParamType;   /* array of parameter types */
     char **ParamName;               /* array of parameter names */
     void (*Intrinsic)(struct ParseState *Parser, struct Value *, struct Value **, int);            /* intrinsic call address or NULL */
+    struct NativeFunction Native;   /* unboxed version of the intrinsic, if it has one */
+    int IsPure;                     /* the result only depends on the arguments and there are no side effects */
+    enum FuncPurity Purity;         /* worked out for the script's own functions by PurityAnalyse() */
+    struct MemoEntry *Memo;         /* results by arguments, MEMO_TABLE_SIZE of them, or NULL if they aren't remembered */
     struct ParseState Body;         /* lexical tokens of the function body if not intrinsic */
 };
 
@@ -190,7 +291,7 @@ struct MacroDef
     struct ParseState Body;         /* lexical tokens of the function body if not intrinsic */
 };
 
-/* values */
+/* values - kept to the size of the largest scalar, aggregate definitions are stored out of line */
 union AnyValue
 {
     char Character;
@@ -204,8 +305,8 @@ union AnyValue
     char *Identifier;
     char ArrayMem[2];               /* placeholder for where the data starts, doesn't point to it */
     struct ValueType *Typ;
-    struct FuncDef FuncDef;
-    struct MacroDef MacroDef;
+    struct FuncDef *FuncDef;        /* heap allocated function definition */
+    struct MacroDef *MacroDef;      /* heap allocated macro definition */
 #ifndef NO_FP
     double FP;
 #endif
@@ -217,12 +318,12 @@ struct Value
     struct ValueType *Typ;          /* the type of this value */
     union AnyValue *Val;            /* pointer to the AnyValue which holds the actual content */
     struct Value *LValueFrom;       /* if an LValue, this is a Value our LValue is contained within (or NULL) */
-    char ValOnHeap;                 /* this Value is on the heap */
-    char ValOnStack;                /* the AnyValue is on the stack along with this Value */
-    char AnyValOnHeap;              /* the AnyValue is separately allocated from the Value on the heap */
-    char IsLValue;                  /* is modifiable and is allocated somewhere we can usefully modify it */
     int ScopeID;                    /* to know when it goes out of scope */
-    char OutOfScope;
+    unsigned char ValOnHeap : 1;    /* this Value is on the heap */
+    unsigned char ValOnStack : 1;   /* the AnyValue is on the stack along with this Value */
+    unsigned char AnyValOnHeap : 1; /* the AnyValue is separately allocated from the Value on the heap */
+    unsigned char IsLValue : 1;     /* is modifiable and is allocated somewhere we can usefully modify it */
+    unsigned char OutOfScope : 1;   /* the variable has gone out of scope but may be brought back */
 };
 
 /* hash table data structure */
@@ -260,16 +361,24 @@ struct Table
     struct TableEntry **HashTable;
 };
 
+/* a function call whose target has been looked up, remembered by where it's made in the token stream */
+struct CallSite
+{
+    const unsigned char *Pos;               /* the call's open bracket */
+    const char *FuncName;
+    struct Value *FuncValue;
+};
+
 /* stack frame for function calls */
 struct StackFrame
 {
     struct ParseState ReturnParser;         /* how we got here */
     const char *FuncName;                   /* the name of the function we're in */
     struct Value *ReturnValue;              /* copy the return value here */
-    struct Value **Parameter;               /* array of parameter values */
+    struct Value **Parameter;               /* the parameters' values, in the order they're declared */
+    char **ParamName;                       /* and their names, which are looked up before LocalTable */
     int NumParams;                          /* the number of parameters */
-    struct Table LocalTable;                /* the local variables and parameters */
-    struct TableEntry *LocalHashTable[LOCAL_TABLE_SIZE];
+    struct Table LocalTable;                /* the local variables, with no hash table until the first is defined */
     struct StackFrame *PreviousStackFrame;  /* the next lower stack frame */
 };
 
@@ -302,6 +411,14 @@ struct LibraryFunction
     const char *Prototype;
 };
 
+/* a pure library function, whose result can be worked out ahead of time when its arguments
+ * are known, with its direct entry points if it has them. Kept apart from the library tables */
+struct LibraryNative
+{
+    void (*Func)(struct ParseState *Parser, struct Value *, struct Value **, int);
+    struct NativeFunction Native;
+};
+
 /* library function definition */
 struct LibraryConstant
 {
@@ -361,6 +478,49 @@ struct IncludeLibrary
     struct IncludeLibrary *NextLib;
 };
 
+/* how often each line of the program runs and roughly how long it takes, gathered while it's
+ * interpreted. Every statement is counted, but only one in about PROFILE_SAMPLE_INTERVAL is
+ * timed, from its start to the start of the next statement, and that time is scaled up */
+struct LineProfile
+{
+    std::vector<long long> Hits;    /* statements started on each line, the first line at 0 */
+    std::vector<double> Time;       /* estimated seconds spent on each line */
+    const char *FileName;           /* the program's file, lines in the headers aren't counted */
+    int Countdown;                  /* statements until the next one is timed */
+    unsigned int Random;            /* state of the generator spacing out the timed statements */
+    int TimedLine;                  /* the line of the statement being timed, or 0 */
+    double TimedStart;
+};
+
+/* counts of what the interpreter does, from PicocInitialise or from the start of one
+ * evaluation. They're only kept when it's built with FEATURE_STATS, and only interpreted
+ * evaluations add to them, not the compiled or vector ones */
+struct PicocStats
+{
+    long long Tokens;               /* tokens consumed by LexGetToken */
+    long long TableLookups;         /* searches of a table for a key */
+    long long TableChainSteps;      /* entries compared in those searches */
+    long long TableLongestChain;    /* the most entries compared in one */
+    long long HeapAllocs;           /* calls to HeapAllocMem */
+    long long HeapAllocBytes;
+    long long HeapFrees;            /* calls to HeapFreeMem */
+    long long HeapFreeBytes;        /* only known to picoc's own allocator, not with USE_MALLOC_HEAP */
+    long long ScopeBegins;          /* calls to VariableScopeBegin */
+    long long ScopeEnds;            /* and VariableScopeEnd */
+    long long ScopeEntriesScanned;  /* variables both went through */
+    long long FunctionCalls;        /* calls run, to the program's functions and the library's */
+    long long StackHighWater;       /* the most bytes of the stack in use */
+    long long StackSize;            /* the bytes there are, PICOC_STACK_SIZE */
+};
+
+#ifdef FEATURE_STATS
+#define STATS_ADD(pc, Counter, Amount) ((pc)->Stats.Counter += (Amount))
+#define STATS_MAX(pc, Counter, Value) ((pc)->Stats.Counter = ((pc)->Stats.Counter < (Value)) ? (Value) : (pc)->Stats.Counter)
+#else
+#define STATS_ADD(pc, Counter, Amount)
+#define STATS_MAX(pc, Counter, Value)
+#endif
+
 #define FREELIST_BUCKETS 8                          /* freelists for 4, 8, 12 ... 32 byte allocs */
 #define SPLIT_MEM_THRESHOLD 16                      /* don't split memory which is close in size */
 #define BREAKPOINT_TABLE_SIZE 21
@@ -392,6 +552,9 @@ struct Picoc_Struct
     /* the stack */
     struct StackFrame *TopStackFrame;
 
+    /* functions called recently */
+    struct CallSite CallSiteCache[CALL_SITE_CACHE_SIZE];
+
     /* the value passed to exit() */
     double PicocExitValue;
 
@@ -451,6 +614,43 @@ struct Picoc_Struct
     struct TableEntry *BreakpointHashTable[BREAKPOINT_TABLE_SIZE];
     int BreakpointCount;
     int DebugManualBreak;
+
+    /* optimiser */
+    const unsigned char *OptimiseBatchBody;     /* main's body for the whole batch, before it was specialised for a row */
+    int OptimiseRowsUnfit;                      /* main can't be specialised for a row, so rows aren't tried */
+
+    /* JIT */
+    int (*JitMain)(double *Result);             /* main compiled to native code, or NULL. Returns FALSE to have it interpreted */
+    void *JitCode;                              /* executable memory holding the compiled code */
+    int JitCodeSize;
+    struct VectorProgram *JitVector;            /* main compiled to work on a block of values at once, or NULL */
+    struct VectorProgram *JitBatchVector;       /* the same for the whole batch, for derivatives and intervals, or NULL */
+
+    /* seconds spent lexing and parsing since PicocInitialise started on the program, which
+     * evaluations interpreted one at a time add to as they parse their call to main, and spent
+     * optimising, analysing and compiling main once it was parsed */
+    double LexTime;
+    double ParseTime;
+    double CompileTime;
+
+    /* whether PicocParse records its stages for the tracer, only while the program is parsed and
+     * not for each call to main */
+    int TraceParse;
+
+    /* where the lines run are counted, or NULL when the program isn't being profiled */
+    struct LineProfile *Profile;
+
+    /* counters for the evaluation in progress, or for the initialisation before the first,
+     * the last one finished and everything since PicocInitialise started */
+    struct PicocStats Stats;
+    struct PicocStats LastStats;
+    struct PicocStats TotalStats;
+
+    /* native compilation */
+    void *NativeLibrary;                        /* the program built as a shared object, or NULL */
+    double (*NativeMain1)(double);              /* its main(), depending on how many arguments it takes */
+    double (*NativeMain2)(double, double);
+    double *NativeArg;                          /* where the arguments to main are */
     
     /* C library */
     int BigEndian;
@@ -481,7 +681,7 @@ char *TableStrRegister(Picoc *pc, const char *Str);
 char *TableStrRegister2(Picoc *pc, const char *Str, int Len);
 void TableInitTable(struct Table *Tbl, struct TableEntry **HashTable, int Size, int OnHeap);
 int TableSet(Picoc *pc, struct Table *Tbl, char *Key, struct Value *Val, const char *DeclFileName, int DeclLine, int DeclColumn);
-int TableGet(struct Table *Tbl, const char *Key, struct Value **Val, const char **DeclFileName, int *DeclLine, int *DeclColumn);
+int TableGet(Picoc *pc, struct Table *Tbl, const char *Key, struct Value **Val, const char **DeclFileName, int *DeclLine, int *DeclColumn);
 struct Value *TableDelete(Picoc *pc, struct Table *Tbl, const char *Key);
 char *TableSetIdentifier(Picoc *pc, struct Table *Tbl, const char *Ident, int IdentLen);
 void TableStrFree(Picoc *pc);
@@ -498,6 +698,8 @@ void *LexCopyTokens(struct ParseState *StartParser, struct ParseState *EndParser
 void LexInteractiveClear(Picoc *pc, struct ParseState *Parser);
 void LexInteractiveCompleted(Picoc *pc, struct ParseState *Parser);
 void LexInteractiveStatementPrompt(Picoc *pc);
+int LexTokenSize(enum LexToken Token);
+int LexIsWrittenTo(enum LexToken Before, int Brackets, const unsigned char *Pos);
 
 /* parse.c */
 void PicocParseInteractiveNoStartPrompt(Picoc *pc, int EnableDebugger);
@@ -507,6 +709,41 @@ void ParseCleanup(Picoc *pc);
 void ParserCopyPos(struct ParseState *To, struct ParseState *From);
 void ParserCopy(struct ParseState *To, struct ParseState *From);
 
+/* optimise.c */
+void OptimiseInit(Picoc *pc);
+void OptimiseFunctionBody(struct ParseState *Parser, struct FuncDef *Func);
+void OptimiseProgram(Picoc *pc);
+int OptimiseRow(Picoc *pc);
+void OptimiseCleanup(Picoc *pc);
+
+/* purity.c */
+void PurityAnalyse(Picoc *pc);
+
+/* jit.c */
+void JitInit(Picoc *pc);
+void JitCompileMain(Picoc *pc);
+void JitCompileBatch(Picoc *pc);
+void JitCleanup(Picoc *pc);
+
+/* vector.c */
+void VectorRun(struct VectorProgram *Vector, const double *First);
+void VectorFree(Picoc *pc, struct VectorProgram *Vector);
+int VectorEvaluate(Picoc *pc, const double *Last, double *Result, int Count);
+int VectorEvaluatePoints(Picoc *pc, const double *First, const double *Last, double *Result, int Count);
+
+/* gradient.c */
+int GradientPrepare(Picoc *pc, struct VectorProgram *Vector);
+int GradientEvaluate(Picoc *pc, const double *Last, double *Result, double *DLast, double *DFirst, int Count);
+
+/* interval.c */
+int IntervalPrepare(Picoc *pc, struct VectorProgram *Vector);
+int IntervalEvaluate(Picoc *pc, const double *LastLow, const double *LastHigh, const double *FirstLow, const double *FirstHigh, double *Low, double *High, int Count);
+
+/* native.c */
+void NativeInit(Picoc *pc);
+void NativeCompileProgram(Picoc *pc, double *Arg, int ParamCount, const std::string &SourceCode, std::vector<Tweakable> &Tweakables);
+void NativeCleanup(Picoc *pc);
+
 /* expression.c */
 int ExpressionParse(struct ParseState *Parser, struct Value **Result);
 long ExpressionParseInt(struct ParseState *Parser);
@@ -561,7 +798,7 @@ int VariableDefinedAndOutOfScope(Picoc *pc, const char *Ident);
 void VariableRealloc(struct ParseState *Parser, struct Value *FromValue, int NewSize);
 void VariableGet(Picoc *pc, struct ParseState *Parser, const char *Ident, struct Value **LVal);
 void VariableDefinePlatformVar(Picoc *pc, struct ParseState *Parser, const char *Ident, struct ValueType *Typ, union AnyValue *FromValue, int IsWritable);
-void VariableStackFrameAdd(struct ParseState *Parser, const char *FuncName, int NumParams);
+void VariableStackFrameAdd(struct ParseState *Parser, const char *FuncName, struct Value **Parameter, char **ParamName, int NumParams);
 void VariableStackFramePop(struct ParseState *Parser);
 struct Value *VariableStringLiteralGet(Picoc *pc, char *Ident);
 void VariableStringLiteralDefine(Picoc *pc, char *Ident, struct Value *Val);
@@ -595,6 +832,7 @@ void PlatformPutc(unsigned char OutCh, union OutputStreamInfo *);
 void PlatformPrintError(Picoc *pc, const std::string &error);
 void PlatformPrintError(Picoc *pc, char c);
 void PlatformExit(Picoc *pc, int ExitVal);
+double PlatformTime();
 char *PlatformMakeTempName(Picoc *pc, char *TempNameBuffer);
 
 /* include.c */
@@ -611,6 +849,17 @@ void DebugInit(Picoc* pc);
 void DebugCleanup(Picoc* pc);
 void DebugCheckStatement(struct ParseState *Parser);
 
+/* profile.c */
+void ProfileStart(Picoc *pc, struct LineProfile *Profile);
+void ProfileStatement(struct ParseState *Parser);
+void ProfileEndTiming(Picoc *pc);
+
+/* stats.c */
+void StatsInit(Picoc *pc, int StackSize);
+void StatsBegin(Picoc *pc);
+void StatsEnd(Picoc *pc);
+int StatsGet(Picoc *pc, struct PicocStats *Last, struct PicocStats *Total);
+
 
 /* stdio.c */
 extern const char StdioDefs[];
@@ -620,6 +869,7 @@ void StdioSetupFunc(Picoc *pc);
 /* math.c */
 extern struct LibraryFunction MathFunctions[];
 extern LibraryConstant MathConstants[];
+extern struct LibraryNative MathNatives[];
 void MathSetupFunc(Picoc *pc);
 
 /* string.c */
@@ -0,0 +1,519 @@
+/* picoc intervals - bounds main over boxes of its arguments by running the batch's vector
+ * program on intervals. Each register holds the lowest and highest value it can have in each
+ * lane, given boxes of the arguments, so the result bounds main over each box. Conditions
+ * which can go either way give [0, 1], and a select then takes in both sides, fmin() and
+ * fmax() leaving out a side with no values. Floating point results are rounded outwards by
+ * one place, the math functions give their own ranges.
+ *
+ * NaNs are left out of the bounds, but each register also knows whether it can be one, as
+ * when a function's argument leaves its domain. Arithmetic passes a NaN on, but a comparison,
+ * a condition, a conversion to int or min() and the like turn it back into a number, and
+ * those take in every number it could become */
+
+#include <limits.h>
+
+#include "interpreter.h"
+
+extern bool gResetParser;
+
+#define INTERVAL_EITHER 2                   /* a condition which is true in part of a box */
+
+/* whether a range of values is true, false or both. A NaN isn't 0 so it's true, but NaN bounds
+ * aren't known to be either */
+static int IntervalTruth(double Low, double High, int MayBeNaN)
+{
+    if (Low > 0.0 || High < 0.0)
+        return TRUE;
+
+    if (Low == 0.0 && High == 0.0 && !MayBeNaN)
+        return FALSE;
+
+    return INTERVAL_EITHER;
+}
+
+static void IntervalCondition(double *Low, double *High, int Truth)
+{
+    *Low = (Truth == TRUE) ? 1.0 : 0.0;
+    *High = (Truth == FALSE) ? 0.0 : 1.0;
+}
+
+/* round outwards. An infinity less another gives a NaN bound, which can be anything */
+static void IntervalWiden(double *Low, double *High)
+{
+    if (*Low != *Low && *High == *High)
+        *Low = -HUGE_VAL;
+
+    if (*High != *High && *Low == *Low)
+        *High = HUGE_VAL;
+
+    *Low = nextafter(*Low, -HUGE_VAL);
+    *High = nextafter(*High, HUGE_VAL);
+}
+
+/* an int result out of range has wrapped round, and could be anything */
+static void IntervalInt(double *Low, double *High)
+{
+    if (!(*Low >= (double)INT_MIN && *High <= (double)INT_MAX))
+    {
+        *Low = (double)INT_MIN;
+        *High = (double)INT_MAX;
+    }
+}
+
+/* 0 times an infinite bound is 0, the bound is only approached */
+static double IntervalProduct(double A, double B)
+{
+    return (A == 0.0 || B == 0.0) ? 0.0 : A * B;
+}
+
+static void IntervalMultiply(double *Low, double *High, double ALow, double AHigh, double BLow, double BHigh)
+{
+    double Product1 = IntervalProduct(ALow, BLow);
+    double Product2 = IntervalProduct(ALow, BHigh);
+    double Product3 = IntervalProduct(AHigh, BLow);
+    double Product4 = IntervalProduct(AHigh, BHigh);
+
+    *Low = fmin(fmin(Product1, Product2), fmin(Product3, Product4));
+    *High = fmax(fmax(Product1, Product2), fmax(Product3, Product4));
+}
+
+/* a divisor which reaches 0 could give anything. Even one which only reaches it from one side,
+ * as a bound of 0 doesn't say whether the value there is 0 or -0 */
+static void IntervalDivide(double *Low, double *High, double ALow, double AHigh, double BLow, double BHigh)
+{
+    double Quotient1;
+    double Quotient2;
+    double Quotient3;
+    double Quotient4;
+
+    if (BLow > 0.0 || BHigh < 0.0)
+    {
+        Quotient1 = ALow / BLow;
+        Quotient2 = ALow / BHigh;
+        Quotient3 = AHigh / BLow;
+        Quotient4 = AHigh / BHigh;
+        *Low = fmin(fmin(Quotient1, Quotient2), fmin(Quotient3, Quotient4));
+        *High = fmax(fmax(Quotient1, Quotient2), fmax(Quotient3, Quotient4));
+        return;
+    }
+
+    *Low = -HUGE_VAL;
+    *High = HUGE_VAL;
+}
+
+static int IntervalHasZero(double Low, double High)
+{
+    return Low <= 0.0 && High >= 0.0;
+}
+
+static int IntervalIsInfinite(double Low, double High)
+{
+    return isinf(Low) || isinf(High);
+}
+
+/* the bitwise operators are only bounded when both sides are known or can't be negative */
+static void IntervalBitwise(double *Low, double *High, enum VectorCode Code, double ALow, double AHigh, double BLow, double BHigh)
+{
+    double Largest;
+    int Value;
+
+    if (ALow == AHigh && BLow == BHigh)
+    {
+        if (Code == VectorIntAnd)
+            Value = (int)ALow & (int)BLow;
+        else if (Code == VectorIntOr)
+            Value = (int)ALow | (int)BLow;
+        else
+            Value = (int)ALow ^ (int)BLow;
+
+        *Low = *High = Value;
+        return;
+    }
+
+    *Low = (double)INT_MIN;
+    *High = (double)INT_MAX;
+    if (Code == VectorIntAnd && (ALow >= 0.0 || BLow >= 0.0))
+    {
+        *Low = 0.0;
+        *High = (ALow >= 0.0 && BLow >= 0.0) ? fmin(AHigh, BHigh) : (ALow >= 0.0) ? AHigh : BHigh;
+    }
+    else if (Code != VectorIntAnd && ALow >= 0.0 && BLow >= 0.0)
+    {
+        /* no more bits than the larger has */
+        Largest = fmax(AHigh, BHigh);
+        *Low = 0.0;
+        *High = 1.0;
+        while (*High <= Largest)
+            *High *= 2.0;
+
+        *High -= 1.0;
+    }
+}
+
+static void IntervalModulus(double *Low, double *High, double ALow, double AHigh, double Divisor)
+{
+    long long Low64 = (long long)ALow;
+    long long High64 = (long long)AHigh;
+    long long Divisor64 = (long long)Divisor;
+    double Largest = fabs(Divisor) - 1.0;
+
+    /* within one multiple of the divisor it rises with the dividend */
+    if (Low64 / Divisor64 == High64 / Divisor64 && (ALow >= 0.0 || AHigh <= 0.0))
+    {
+        *Low = (double)(Low64 % Divisor64);
+        *High = (double)(High64 % Divisor64);
+        return;
+    }
+
+    *Low = (ALow < 0.0) ? fmax(-Largest, ALow) : 0.0;
+    *High = (AHigh > 0.0) ? fmin(Largest, AHigh) : 0.0;
+}
+
+/* (int)(long) of a value outside the range of an int wraps round */
+static int IntervalTest(double Low, double High, double Limit)
+{
+    if (Low > -1.0 && High < 1.0)
+        return FALSE;
+
+    if ((Low >= 1.0 || High <= -1.0) && Low > -Limit && High < Limit)
+        return TRUE;
+
+    return INTERVAL_EITHER;
+}
+
+/* bound the block of boxes in the input register's bounds. The first argument's global takes
+ * FirstLow and FirstHigh if they're given */
+static void IntervalBound(struct VectorProgram *Vector, const double *FirstLow, const double *FirstHigh)
+{
+    double (*Lows)[VECTOR_LANES] = Vector->Bounds;
+    double (*Highs)[VECTOR_LANES] = &Vector->Bounds[Vector->NumRegisters];
+    const struct VectorOp *Op;
+    double ArgLow[3];
+    double ArgHigh[3];
+    int ArgNaN[3];
+    double Value;
+    int NumArgs;
+    int Decides;
+    int Truth;
+    int Count;
+    int Arg;
+    int Lane;
+
+    for (Count = 0; Count < Vector->NumOps; Count++)
+    {
+        Op = &Vector->Ops[Count];
+
+        double *Low = Lows[Op->Result];
+        double *High = Highs[Op->Result];
+        char *NaN = Vector->MayBeNaN[Op->Result];
+        const double *ALow = (Op->Operand[0] != VECTOR_NONE) ? Lows[Op->Operand[0]] : NULL;
+        const double *AHigh = (Op->Operand[0] != VECTOR_NONE) ? Highs[Op->Operand[0]] : NULL;
+        const char *ANaN = (Op->Operand[0] != VECTOR_NONE) ? Vector->MayBeNaN[Op->Operand[0]] : NULL;
+        const double *BLow = (Op->Operand[1] != VECTOR_NONE) ? Lows[Op->Operand[1]] : NULL;
+        const double *BHigh = (Op->Operand[1] != VECTOR_NONE) ? Highs[Op->Operand[1]] : NULL;
+        const char *BNaN = (Op->Operand[1] != VECTOR_NONE) ? Vector->MayBeNaN[Op->Operand[1]] : NULL;
+        const double *CLow = (Op->Operand[2] != VECTOR_NONE) ? Lows[Op->Operand[2]] : NULL;
+        const double *CHigh = (Op->Operand[2] != VECTOR_NONE) ? Highs[Op->Operand[2]] : NULL;
+        const char *CNaN = (Op->Operand[2] != VECTOR_NONE) ? Vector->MayBeNaN[Op->Operand[2]] : NULL;
+
+        for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+        {
+            /* ints and conditions are never NaNs */
+            NaN[Lane] = FALSE;
+            switch (Op->Code)
+            {
+                case VectorGlobal:
+                    if (FirstLow != NULL && Op->Address == Vector->First)
+                    {
+                        Low[Lane] = FirstLow[Lane];
+                        High[Lane] = FirstHigh[Lane];
+                    }
+                    else
+                    {
+                        Value = (Op->Type == TypeFP) ? *(double *)Op->Address : (double)*(int *)Op->Address;
+                        Low[Lane] = High[Lane] = Value;
+                    }
+                    NaN[Lane] = (Low[Lane] != Low[Lane] || High[Lane] != High[Lane]);
+                    break;
+
+                /* infinity less infinity, 0 times infinity, 0 over 0 and infinity over infinity are NaNs */
+                case VectorAdd:
+                    Low[Lane] = ALow[Lane] + BLow[Lane];
+                    High[Lane] = AHigh[Lane] + BHigh[Lane];
+                    IntervalWiden(&Low[Lane], &High[Lane]);
+                    NaN[Lane] = ANaN[Lane] || BNaN[Lane] || (IntervalIsInfinite(ALow[Lane], AHigh[Lane]) && IntervalIsInfinite(BLow[Lane], BHigh[Lane]));
+                    break;
+
+                case VectorSubtract:
+                    Low[Lane] = ALow[Lane] - BHigh[Lane];
+                    High[Lane] = AHigh[Lane] - BLow[Lane];
+                    IntervalWiden(&Low[Lane], &High[Lane]);
+                    NaN[Lane] = ANaN[Lane] || BNaN[Lane] || (IntervalIsInfinite(ALow[Lane], AHigh[Lane]) && IntervalIsInfinite(BLow[Lane], BHigh[Lane]));
+                    break;
+
+                case VectorMultiply:
+                    IntervalMultiply(&Low[Lane], &High[Lane], ALow[Lane], AHigh[Lane], BLow[Lane], BHigh[Lane]);
+                    IntervalWiden(&Low[Lane], &High[Lane]);
+                    NaN[Lane] = ANaN[Lane] || BNaN[Lane] ||
+                        (IntervalIsInfinite(ALow[Lane], AHigh[Lane]) && IntervalHasZero(BLow[Lane], BHigh[Lane])) ||
+                        (IntervalHasZero(ALow[Lane], AHigh[Lane]) && IntervalIsInfinite(BLow[Lane], BHigh[Lane]));
+                    break;
+
+                case VectorDivide:
+                    IntervalDivide(&Low[Lane], &High[Lane], ALow[Lane], AHigh[Lane], BLow[Lane], BHigh[Lane]);
+                    IntervalWiden(&Low[Lane], &High[Lane]);
+                    NaN[Lane] = ANaN[Lane] || BNaN[Lane] ||
+                        (IntervalHasZero(ALow[Lane], AHigh[Lane]) && IntervalHasZero(BLow[Lane], BHigh[Lane])) ||
+                        (IntervalIsInfinite(ALow[Lane], AHigh[Lane]) && IntervalIsInfinite(BLow[Lane], BHigh[Lane]));
+                    break;
+
+                case VectorNegate:
+                    Low[Lane] = -AHigh[Lane];
+                    High[Lane] = -ALow[Lane];
+                    NaN[Lane] = ANaN[Lane];
+                    break;
+
+                /* ints are held exactly, and so are their sums and products while they're in range */
+                case VectorIntAdd:
+                    Low[Lane] = ALow[Lane] + BLow[Lane];
+                    High[Lane] = AHigh[Lane] + BHigh[Lane];
+                    IntervalInt(&Low[Lane], &High[Lane]);
+                    break;
+
+                case VectorIntSubtract:
+                    Low[Lane] = ALow[Lane] - BHigh[Lane];
+                    High[Lane] = AHigh[Lane] - BLow[Lane];
+                    IntervalInt(&Low[Lane], &High[Lane]);
+                    break;
+
+                case VectorIntMultiply:
+                    IntervalMultiply(&Low[Lane], &High[Lane], ALow[Lane], AHigh[Lane], BLow[Lane], BHigh[Lane]);
+                    IntervalInt(&Low[Lane], &High[Lane]);
+                    break;
+
+                /* ints are only divided and shifted by constants */
+                case VectorIntDivide:
+                    Low[Lane] = (double)((long long)ALow[Lane] / (long long)BLow[Lane]);
+                    High[Lane] = (double)((long long)AHigh[Lane] / (long long)BLow[Lane]);
+                    if (Low[Lane] > High[Lane])
+                    {
+                        Value = Low[Lane];
+                        Low[Lane] = High[Lane];
+                        High[Lane] = Value;
+                    }
+                    IntervalInt(&Low[Lane], &High[Lane]);
+                    break;
+
+                case VectorIntModulus:
+                    IntervalModulus(&Low[Lane], &High[Lane], ALow[Lane], AHigh[Lane], BLow[Lane]);
+                    break;
+
+                case VectorIntShiftLeft:
+                    Low[Lane] = ldexp(ALow[Lane], (int)BLow[Lane]);
+                    High[Lane] = ldexp(AHigh[Lane], (int)BLow[Lane]);
+                    IntervalInt(&Low[Lane], &High[Lane]);
+                    break;
+
+                case VectorIntShiftRight:
+                    Low[Lane] = floor(ldexp(ALow[Lane], -(int)BLow[Lane]));
+                    High[Lane] = floor(ldexp(AHigh[Lane], -(int)BLow[Lane]));
+                    break;
+
+                case VectorIntAnd:
+                case VectorIntOr:
+                case VectorIntExor:
+                    IntervalBitwise(&Low[Lane], &High[Lane], Op->Code, ALow[Lane], AHigh[Lane], BLow[Lane], BHigh[Lane]);
+                    break;
+
+                /* a NaN is unequal to everything */
+                case VectorEqual:
+                case VectorNotEqual:
+                    if (ANaN[Lane] || BNaN[Lane])
+                        IntervalCondition(&Low[Lane], &High[Lane], INTERVAL_EITHER);
+                    else if (AHigh[Lane] < BLow[Lane] || BHigh[Lane] < ALow[Lane])
+                        IntervalCondition(&Low[Lane], &High[Lane], (Op->Code == VectorNotEqual));
+                    else if (ALow[Lane] == AHigh[Lane] && BLow[Lane] == BHigh[Lane] && ALow[Lane] == BLow[Lane])
+                        IntervalCondition(&Low[Lane], &High[Lane], (Op->Code == VectorEqual));
+                    else
+                        IntervalCondition(&Low[Lane], &High[Lane], INTERVAL_EITHER);
+                    break;
+
+                case VectorLessThan:
+                    if (ANaN[Lane] || BNaN[Lane])
+                        IntervalCondition(&Low[Lane], &High[Lane], INTERVAL_EITHER);
+                    else
+                        IntervalCondition(&Low[Lane], &High[Lane], (AHigh[Lane] < BLow[Lane]) ? TRUE : (ALow[Lane] >= BHigh[Lane]) ? FALSE : INTERVAL_EITHER);
+                    break;
+
+                case VectorLessEqual:
+                    if (ANaN[Lane] || BNaN[Lane])
+                        IntervalCondition(&Low[Lane], &High[Lane], INTERVAL_EITHER);
+                    else
+                        IntervalCondition(&Low[Lane], &High[Lane], (AHigh[Lane] <= BLow[Lane]) ? TRUE : (ALow[Lane] > BHigh[Lane]) ? FALSE : INTERVAL_EITHER);
+                    break;
+
+                case VectorNot:
+                    switch (IntervalTruth(ALow[Lane], AHigh[Lane], ANaN[Lane]))
+                    {
+                        case TRUE:  IntervalCondition(&Low[Lane], &High[Lane], FALSE); break;
+                        case FALSE: IntervalCondition(&Low[Lane], &High[Lane], TRUE); break;
+                        default:    IntervalCondition(&Low[Lane], &High[Lane], INTERVAL_EITHER); break;
+                    }
+                    break;
+
+                /* false on either side decides an and, true an or */
+                case VectorLogicalAnd:
+                case VectorLogicalOr:
+                    Decides = (Op->Code == VectorLogicalOr);
+                    if (IntervalTruth(ALow[Lane], AHigh[Lane], ANaN[Lane]) == Decides || IntervalTruth(BLow[Lane], BHigh[Lane], BNaN[Lane]) == Decides)
+                        IntervalCondition(&Low[Lane], &High[Lane], Decides);
+                    else if (IntervalTruth(ALow[Lane], AHigh[Lane], ANaN[Lane]) == !Decides && IntervalTruth(BLow[Lane], BHigh[Lane], BNaN[Lane]) == !Decides)
+                        IntervalCondition(&Low[Lane], &High[Lane], !Decides);
+                    else
+                        IntervalCondition(&Low[Lane], &High[Lane], INTERVAL_EITHER);
+                    break;
+
+                /* what a NaN converts to depends on the machine */
+                case VectorTest:
+                    IntervalCondition(&Low[Lane], &High[Lane], ANaN[Lane] ? INTERVAL_EITHER : IntervalTest(ALow[Lane], AHigh[Lane], (double)INT_MAX + 1.0));
+                    break;
+
+                case VectorTestLong:
+                    IntervalCondition(&Low[Lane], &High[Lane], ANaN[Lane] ? INTERVAL_EITHER : IntervalTest(ALow[Lane], AHigh[Lane], 9223372036854775808.0));
+                    break;
+
+                /* converted the way the vector evaluator does, which gives 0 rather than -0 */
+                case VectorTruncate:
+                    if (!ANaN[Lane] && ALow[Lane] > (double)INT_MIN - 1.0 && AHigh[Lane] < (double)INT_MAX + 1.0)
+                    {
+                        Low[Lane] = (int)(long)ALow[Lane];
+                        High[Lane] = (int)(long)AHigh[Lane];
+                    }
+                    else
+                    {
+                        Low[Lane] = (double)INT_MIN;
+                        High[Lane] = (double)INT_MAX;
+                    }
+                    break;
+
+                case VectorSelect:
+                    Truth = IntervalTruth(ALow[Lane], AHigh[Lane], ANaN[Lane]);
+                    if (Truth == TRUE)
+                    {
+                        Low[Lane] = BLow[Lane];
+                        High[Lane] = BHigh[Lane];
+                        NaN[Lane] = BNaN[Lane];
+                    }
+                    else if (Truth == FALSE)
+                    {
+                        Low[Lane] = CLow[Lane];
+                        High[Lane] = CHigh[Lane];
+                        NaN[Lane] = CNaN[Lane];
+                    }
+                    else
+                    {
+                        Low[Lane] = fmin(BLow[Lane], CLow[Lane]);
+                        High[Lane] = fmax(BHigh[Lane], CHigh[Lane]);
+                        NaN[Lane] = BNaN[Lane] || CNaN[Lane];
+                    }
+                    break;
+
+                case VectorKernel1:
+                case VectorKernel2:
+                case VectorCall1:
+                case VectorCall2:
+                case VectorCall3:
+                    NumArgs = 0;
+                    while (NumArgs < 3 && Op->Operand[NumArgs] != VECTOR_NONE)
+                        NumArgs++;
+
+                    for (Arg = 0; Arg < NumArgs; Arg++)
+                    {
+                        ArgLow[Arg] = Lows[Op->Operand[Arg]][Lane];
+                        ArgHigh[Arg] = Highs[Op->Operand[Arg]][Lane];
+                        ArgNaN[Arg] = Vector->MayBeNaN[Op->Operand[Arg]][Lane];
+                        NaN[Lane] |= ArgNaN[Arg];
+                    }
+
+                    NaN[Lane] |= Op->Native->Range(&Low[Lane], &High[Lane], ArgLow, ArgHigh, ArgNaN);
+                    IntervalWiden(&Low[Lane], &High[Lane]);
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+/* make room for the bounds in the batch's vector program, if every function it calls gives
+ * its range. Returns FALSE if main can't be evaluated on intervals */
+int IntervalPrepare(Picoc *pc, struct VectorProgram *Vector)
+{
+    int Count;
+    int Lane;
+
+    for (Count = 0; Count < Vector->NumOps; Count++)
+    {
+        if (Vector->Ops[Count].Code >= VectorKernel1 && Vector->Ops[Count].Native->Range == NULL)
+            return FALSE;
+    }
+
+    Vector->Bounds = (double (*)[VECTOR_LANES])HeapAllocMem(pc, sizeof(double) * VECTOR_LANES * Vector->NumRegisters * 2);
+    Vector->MayBeNaN = (char (*)[VECTOR_LANES])HeapAllocMem(pc, VECTOR_LANES * Vector->NumRegisters);
+    if (Vector->Bounds == NULL || Vector->MayBeNaN == NULL)
+        return FALSE;
+
+    /* a constant's bounds are its value, and it's a NaN if its value is */
+    memcpy((void *)Vector->Bounds, (void *)Vector->Registers, sizeof(double) * VECTOR_LANES * Vector->NumRegisters);
+    memcpy((void *)Vector->Bounds[Vector->NumRegisters], (void *)Vector->Registers, sizeof(double) * VECTOR_LANES * Vector->NumRegisters);
+    for (Count = 0; Count < Vector->NumRegisters; Count++)
+    {
+        for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+            Vector->MayBeNaN[Count][Lane] = (Vector->Registers[Count][Lane] != Vector->Registers[Count][Lane]);
+    }
+    return TRUE;
+}
+
+/* bound main over Count boxes of its arguments, given by the lowest and highest value of the
+ * last argument and of the first. FirstLow and FirstHigh may be NULL to use the first argument's
+ * value as it is. The bounds hold every value main has in the box which isn't a NaN, NaN bounds
+ * meaning there aren't any. Returns FALSE if main can't be evaluated on intervals */
+int IntervalEvaluate(Picoc *pc, const double *LastLow, const double *LastHigh, const double *FirstLow, const double *FirstHigh, double *Low, double *High, int Count)
+{
+    struct VectorProgram *Vector = pc->JitBatchVector;
+    double (*Highs)[VECTOR_LANES];
+    double BlockLow[VECTOR_LANES];
+    double BlockHigh[VECTOR_LANES];
+    int Start;
+    int Lanes;
+    int Lane;
+    int From;
+
+    if (Vector == NULL || Vector->MayBeNaN == NULL || gResetParser)
+        return FALSE;
+
+    Highs = &Vector->Bounds[Vector->NumRegisters];
+    for (Start = 0; Start < Count; Start += VECTOR_LANES)
+    {
+        Lanes = (Count - Start < VECTOR_LANES) ? Count - Start : VECTOR_LANES;
+        for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+        {
+            From = Start + ((Lane < Lanes) ? Lane : Lanes-1);
+            Vector->Bounds[Vector->Input][Lane] = LastLow[From];
+            Highs[Vector->Input][Lane] = LastHigh[From];
+            Vector->MayBeNaN[Vector->Input][Lane] = (LastLow[From] != LastLow[From] || LastHigh[From] != LastHigh[From]);
+            if (FirstLow != NULL)
+            {
+                BlockLow[Lane] = FirstLow[From];
+                BlockHigh[Lane] = FirstHigh[From];
+            }
+        }
+
+        IntervalBound(Vector, (FirstLow != NULL) ? BlockLow : NULL, (FirstLow != NULL) ? BlockHigh : NULL);
+        memcpy((void *)&Low[Start], (void *)Vector->Bounds[Vector->Result], sizeof(double) * Lanes);
+        memcpy((void *)&High[Start], (void *)Highs[Vector->Result], sizeof(double) * Lanes);
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,2677 @@
+/* picoc JIT - compiles main() to x86-64 machine code when all it does is arithmetic on
+ * int and double variables, if, while, do and for, and calls to the math functions.
+ * Each evaluation then runs natively instead of being parsed again from the tokens.
+ * When there are no loops it's also compiled to a vector program, which vector.c runs on
+ * a whole block of values of the last argument at once, gradient.c runs carrying the
+ * derivatives by the arguments along, and interval.c runs on intervals of them.
+ *
+ * Anything the compiler doesn't understand leaves main to the interpreter. The compiled
+ * code can also give up on a single evaluation, as when an integer is divided by zero,
+ * and the interpreter then runs that evaluation from the start. That's safe because the
+ * compiled code never changes anything but its own locals */
+
+#ifdef _WIN32
+# define WIN32_LEAN_AND_MEAN
+# define NOMINMAX
+# include <windows.h>
+#endif
+
+#include "interpreter.h"
+
+#ifdef FEATURE_JIT
+
+#include <limits.h>
+#include <stdint.h>
+#ifndef _WIN32
+# include <sys/mman.h>
+#endif
+
+#define TOKEN_DATA_OFFSET 2
+#define JIT_CODE_MAX (64*1024)              /* space for the code of one main() */
+#define JIT_MACRO_DEPTH_MAX 8               /* how deeply macros can use other macros */
+
+/* registers, numbered as they're encoded in instructions */
+#define JIT_RAX 0
+#define JIT_RCX 1
+#define JIT_RDX 2
+#define JIT_RSP 4
+#define JIT_RBP 5
+#define JIT_RDI 7
+#define JIT_RIP -1                          /* a constant, addressed relative to the code */
+
+/* condition codes. The opposite of each one is the same code with the lowest bit flipped */
+#define JIT_CC_B 0x2
+#define JIT_CC_AE 0x3
+#define JIT_CC_E 0x4
+#define JIT_CC_NE 0x5
+#define JIT_CC_A 0x7
+#define JIT_CC_P 0xa
+#define JIT_CC_NP 0xb
+#define JIT_CC_L 0xc
+#define JIT_CC_GE 0xd
+#define JIT_CC_LE 0xe
+#define JIT_CC_G 0xf
+#define JIT_ALWAYS -1
+
+#define JIT_REX_W 0x48
+
+/* the expression evaluator works in long, so division, shifts and conversions from double
+ * are done at that width before the result is cut down to an int */
+#if LONG_MAX > 0x7fffffffL
+#define JIT_REX_LONG JIT_REX_W
+#else
+#define JIT_REX_LONG 0
+#endif
+
+#ifdef _WIN32
+#define JIT_RESULT_ARG JIT_RCX              /* where the compiled function gets its result pointer */
+#else
+#define JIT_RESULT_ARG JIT_RDI
+#endif
+
+#define JIT_SHADOW_SPACE 32                 /* the bottom of the frame is left for callees on Win64 */
+#define JIT_NO_JUMPS -1                     /* an empty list of jumps */
+
+#define JIT_VECTOR_IF_DEPTH_MAX 16          /* how deeply ifs can be nested in a vector program */
+#define JIT_VECTOR_ZERO 0                   /* the registers which always hold 0 and 1 */
+#define JIT_VECTOR_ONE 1
+
+extern bool gResetParser;
+
+/* a token of the body being compiled */
+struct JitToken
+{
+    const unsigned char *Pos;
+    enum LexToken Token;
+};
+
+/* a parameter or local variable which is in scope */
+struct JitLocal
+{
+    const char *Name;
+    int Depth;
+    enum BaseType Type;
+    int Slot;
+};
+
+enum JitNodeKind
+{
+    JitNodeConstant,
+    JitNodeLocal,
+    JitNodeGlobal,
+    JitNodePrefix,                  /* + - ! ~ */
+    JitNodeIncrement,               /* ++ or -- of a local */
+    JitNodeInfix,
+    JitNodeLogical,                 /* && or || */
+    JitNodeTernary,
+    JitNodeAssign,
+    JitNodeConvert,                 /* a cast */
+    JitNodeCall
+};
+
+/* a parsed expression */
+struct JitNode
+{
+    enum JitNodeKind Kind;
+    enum BaseType Type;             /* TypeInt or TypeFP */
+    enum LexToken Op;
+    struct JitNode *Operand[3];     /* a ternary's condition comes first, a call has its arguments here */
+    int NumOperands;
+    int Slot;                       /* the local read or assigned to */
+    void *Address;                  /* a global's value or the function to call */
+    const struct NativeFunction *Native;    /* the function called, for its vector version */
+    int IsPostfix;
+    int HasSideEffects;             /* assigns to a local */
+    int Integer;
+    double FP;
+};
+
+/* jumps out of the loop being compiled */
+struct JitLoop
+{
+    int Breaks;
+    int Continues;
+};
+
+/* a memory operand */
+struct JitMem
+{
+    int Base;                       /* the register holding the address, or JIT_RIP */
+    int Disp;                       /* the offset from it, or which constant */
+};
+
+struct JitState
+{
+    Picoc *pc;
+    struct JitToken *Tokens;
+    int NumTokens;
+    int Pos;
+    struct JitToken *MacroTokens[JIT_MACRO_DEPTH_MAX];
+    int MacroDepth;
+    struct JitNode *Nodes;
+    int NumNodes;
+    int MaxNodes;
+    struct JitLocal *Locals;
+    int NumLocals;
+    int MaxLocals;
+    int Depth;
+    int NumSlots;                   /* stack slots given to locals, every declaration has its own */
+    int NumTemps;                   /* stack slots holding partial results */
+    int MaxTemps;
+    unsigned char *Code;
+    int CodeSize;
+    double *Constants;
+    int NumConstants;
+    int *ConstantUses;              /* where the code refers to a constant */
+    int NumConstantUses;
+    int MaxConstants;
+    int Bails;                      /* jumps which hand the evaluation to the interpreter */
+    int Returns;
+    struct VectorOp *Ops;           /* the vector program being compiled */
+    int NumOps;
+    int MaxOps;
+    int *LocalRegisters;            /* the register holding each local's value at this point */
+    int *SavedRegisters;            /* copies of those for each if being compiled */
+    int IfDepth;
+    double *LastArg;                /* the argument which is different in each lane */
+    double *FirstArg;               /* the other one, if there are two */
+    int Input;
+    int Path;                       /* lanes where the statement being compiled runs */
+    int Done;                       /* lanes which have returned */
+    int Result;
+    int HasReturned;                /* every lane on the path has returned */
+    jmp_buf Bail;                   /* something we can't compile - leave main to the interpreter */
+};
+
+static struct JitNode *JitExpression(struct JitState *State, int MinPrecedence);
+static struct JitNode *JitUnary(struct JitState *State);
+static void JitEmit(struct JitState *State, struct JitNode *Node);
+static void JitStatement(struct JitState *State, struct JitLoop *Loop);
+static int JitJump(struct JitState *State, int Condition, int List);
+
+
+static void JitBail(struct JitState *State)
+{
+    longjmp(State->Bail, 1);
+}
+
+/*
+ * parsing
+ */
+
+static enum LexToken JitPeek(struct JitState *State)
+{
+    return State->Tokens[State->Pos].Token;
+}
+
+static enum LexToken JitPeekAhead(struct JitState *State, int Ahead)
+{
+    if (State->Pos + Ahead >= State->NumTokens)
+        return TokenEndOfFunction;
+
+    return State->Tokens[State->Pos + Ahead].Token;
+}
+
+static void JitExpect(struct JitState *State, enum LexToken Token)
+{
+    if (JitPeek(State) != Token)
+        JitBail(State);
+
+    State->Pos++;
+}
+
+/* the registered identifier string stored with an identifier token */
+static const char *JitIdentifier(struct JitState *State, int Index)
+{
+    const char *Ident;
+
+    memcpy((void *)&Ident, (void *)(State->Tokens[Index].Pos + TOKEN_DATA_OFFSET), sizeof(Ident));
+    return Ident;
+}
+
+/* split a body into tokens. Returns the number of tokens or 0 if it has anything we don't compile */
+static int JitScanTokens(const unsigned char *Pos, struct JitToken *Tokens)
+{
+    enum LexToken Token;
+    int NumTokens = 0;
+
+    while (TRUE)
+    {
+        Token = (enum LexToken)*Pos;
+        if (Token == TokenEOF || (Token >= TokenHashDefine && Token <= TokenHashEndif))
+            return 0;
+
+        if (Token != TokenEndOfLine)
+        {
+            if (Tokens != NULL)
+            {
+                Tokens[NumTokens].Pos = Pos;
+                Tokens[NumTokens].Token = Token;
+            }
+            NumTokens++;
+
+            if (Token == TokenEndOfFunction)
+                return NumTokens;
+        }
+
+        Pos += TOKEN_DATA_OFFSET + LexTokenSize(Token);
+    }
+}
+
+static struct JitNode *JitNewNode(struct JitState *State, enum JitNodeKind Kind, enum BaseType Type)
+{
+    struct JitNode *Node;
+
+    if (State->NumNodes >= State->MaxNodes)
+        JitBail(State);
+
+    Node = &State->Nodes[State->NumNodes++];
+    memset((void *)Node, '\0', sizeof(*Node));
+    Node->Kind = Kind;
+    Node->Type = Type;
+    return Node;
+}
+
+static struct JitNode *JitNewOperator(struct JitState *State, enum JitNodeKind Kind, enum BaseType Type, enum LexToken Op, struct JitNode *Left, struct JitNode *Right)
+{
+    struct JitNode *Node = JitNewNode(State, Kind, Type);
+
+    Node->Op = Op;
+    Node->Operand[0] = Left;
+    Node->Operand[1] = Right;
+    Node->NumOperands = (Right != NULL) ? 2 : 1;
+    Node->HasSideEffects = Left->HasSideEffects || (Right != NULL && Right->HasSideEffects);
+    return Node;
+}
+
+static struct JitLocal *JitFindLocal(struct JitState *State, const char *Ident)
+{
+    int Count;
+
+    for (Count = State->NumLocals-1; Count >= 0; Count--)
+    {
+        if (State->Locals[Count].Name == Ident)
+            return &State->Locals[Count];
+    }
+
+    return NULL;
+}
+
+/* a new local variable with a stack slot of its own */
+static void JitAddLocal(struct JitState *State, const char *Ident, enum BaseType Type)
+{
+    struct JitLocal *Local;
+
+    /* redeclaring a name in the same function fails at run time */
+    if (JitFindLocal(State, Ident) != NULL || State->NumLocals >= State->MaxLocals)
+        JitBail(State);
+
+    Local = &State->Locals[State->NumLocals++];
+    Local->Name = Ident;
+    Local->Depth = State->Depth;
+    Local->Type = Type;
+    Local->Slot = State->NumSlots++;
+}
+
+static void JitEndScope(struct JitState *State)
+{
+    while (State->NumLocals > 0 && State->Locals[State->NumLocals-1].Depth >= State->Depth)
+        State->NumLocals--;
+
+    State->Depth--;
+}
+
+static int JitInfixPrecedence(enum LexToken Token)
+{
+    switch (Token)
+    {
+        case TokenAssign: case TokenAddAssign: case TokenSubtractAssign: case TokenMultiplyAssign:
+        case TokenDivideAssign: case TokenModulusAssign: case TokenShiftLeftAssign: case TokenShiftRightAssign:
+        case TokenArithmeticAndAssign: case TokenArithmeticOrAssign: case TokenArithmeticExorAssign:
+                                    return 2;
+        case TokenQuestionMark: case TokenColon:
+                                    return 3;
+        case TokenLogicalOr:        return 4;
+        case TokenLogicalAnd:       return 5;
+        case TokenArithmeticOr:     return 6;
+        case TokenArithmeticExor:   return 7;
+        case TokenAmpersand:        return 8;
+        case TokenEqual: case TokenNotEqual:
+                                    return 9;
+        case TokenLessThan: case TokenGreaterThan: case TokenLessEqual: case TokenGreaterEqual:
+                                    return 10;
+        case TokenShiftLeft: case TokenShiftRight:
+                                    return 11;
+        case TokenPlus: case TokenMinus:
+                                    return 12;
+        case TokenAsterisk: case TokenSlash: case TokenModulus:
+                                    return 13;
+        default:                    return 0;
+    }
+}
+
+static int JitIsComparison(enum LexToken Op)
+{
+    return Op >= TokenEqual && Op <= TokenGreaterEqual;
+}
+
+/* the operator a compound assignment applies */
+static enum LexToken JitAssignOperator(enum LexToken Op)
+{
+    switch (Op)
+    {
+        case TokenAddAssign:            return TokenPlus;
+        case TokenSubtractAssign:       return TokenMinus;
+        case TokenMultiplyAssign:       return TokenAsterisk;
+        case TokenDivideAssign:         return TokenSlash;
+        case TokenModulusAssign:        return TokenModulus;
+        case TokenShiftLeftAssign:      return TokenShiftLeft;
+        case TokenShiftRightAssign:     return TokenShiftRight;
+        case TokenArithmeticAndAssign:  return TokenAmpersand;
+        case TokenArithmeticOrAssign:   return TokenArithmeticOr;
+        case TokenArithmeticExorAssign: return TokenArithmeticExor;
+        default:                        return TokenNone;
+    }
+}
+
+/* is this the start of a type name, as in a cast or a declaration? */
+static int JitIsType(enum LexToken Token)
+{
+    switch (Token)
+    {
+        case TokenIntType: case TokenCharType: case TokenFloatType: case TokenDoubleType: case TokenVoidType:
+        case TokenLongType: case TokenSignedType: case TokenShortType: case TokenUnsignedType:
+        case TokenStructType: case TokenUnionType: case TokenEnumType:
+        case TokenStaticType: case TokenAutoType: case TokenRegisterType: case TokenExternType:
+            return TRUE;
+
+        default:
+            return FALSE;
+    }
+}
+
+/* the only types we compile are int and double */
+static enum BaseType JitParseType(struct JitState *State)
+{
+    enum LexToken Token = JitPeek(State);
+
+    State->Pos++;
+    switch (Token)
+    {
+        case TokenIntType:      return TypeInt;
+        case TokenFloatType:
+        case TokenDoubleType:   return TypeFP;
+        default:                JitBail(State); return TypeVoid;
+    }
+}
+
+/* a prefix operator. As in the evaluator, ! of a double is a double */
+static struct JitNode *JitPrefix(struct JitState *State, enum LexToken Op, struct JitNode *Operand)
+{
+    if (Op == TokenUnaryExor && Operand->Type != TypeInt)
+        JitBail(State);
+
+    return JitNewOperator(State, JitNodePrefix, Operand->Type, Op, Operand, NULL);
+}
+
+static struct JitNode *JitIncrement(struct JitState *State, enum LexToken Op, struct JitNode *Operand, int IsPostfix)
+{
+    struct JitNode *Node;
+
+    if (Operand->Kind != JitNodeLocal)
+        JitBail(State);
+
+    Node = JitNewNode(State, JitNodeIncrement, Operand->Type);
+    Node->Op = Op;
+    Node->Slot = Operand->Slot;
+    Node->IsPostfix = IsPostfix;
+    Node->HasSideEffects = TRUE;
+    return Node;
+}
+
+/* an infix operator with the result types the evaluator gives */
+static struct JitNode *JitInfix(struct JitState *State, enum LexToken Op, struct JitNode *Left, struct JitNode *Right)
+{
+    int IsFP = (Left->Type == TypeFP || Right->Type == TypeFP);
+
+    switch (Op)
+    {
+        case TokenPlus: case TokenMinus: case TokenAsterisk: case TokenSlash:
+            return JitNewOperator(State, JitNodeInfix, IsFP ? TypeFP : TypeInt, Op, Left, Right);
+
+        case TokenEqual: case TokenNotEqual: case TokenLessThan: case TokenGreaterThan:
+        case TokenLessEqual: case TokenGreaterEqual:
+            return JitNewOperator(State, JitNodeInfix, TypeInt, Op, Left, Right);
+
+        case TokenModulus: case TokenShiftLeft: case TokenShiftRight:
+        case TokenAmpersand: case TokenArithmeticOr: case TokenArithmeticExor:
+            if (IsFP)
+                JitBail(State);
+
+            return JitNewOperator(State, JitNodeInfix, TypeInt, Op, Left, Right);
+
+        case TokenLogicalOr: case TokenLogicalAnd:
+            /* the right hand side might not be evaluated at all */
+            if (IsFP || Right->HasSideEffects)
+                JitBail(State);
+
+            return JitNewOperator(State, JitNodeLogical, TypeInt, Op, Left, Right);
+
+        default:
+            JitBail(State);
+            return NULL;
+    }
+}
+
+/* an assignment to a local, which keeps its type */
+static struct JitNode *JitAssign(struct JitState *State, enum LexToken Op, struct JitNode *Left, struct JitNode *Right)
+{
+    struct JitNode *Node;
+
+    if (Left->Kind != JitNodeLocal)
+        JitBail(State);
+
+    switch (Op)
+    {
+        case TokenAssign: case TokenAddAssign: case TokenSubtractAssign:
+        case TokenMultiplyAssign: case TokenDivideAssign:
+            break;
+
+        default:
+            if (Left->Type != TypeInt || Right->Type != TypeInt)
+                JitBail(State);
+            break;
+    }
+
+    Node = JitNewOperator(State, JitNodeAssign, Left->Type, Op, Right, NULL);
+    Node->Slot = Left->Slot;
+    Node->HasSideEffects = TRUE;
+    return Node;
+}
+
+/* x ? y : z. The evaluator works out both sides so they mustn't change anything */
+static struct JitNode *JitTernary(struct JitState *State, struct JitNode *Condition, struct JitNode *Then, struct JitNode *Else)
+{
+    struct JitNode *Node;
+
+    if (Then->Type != Else->Type || Then->HasSideEffects || Else->HasSideEffects)
+        JitBail(State);
+
+    Node = JitNewOperator(State, JitNodeTernary, Then->Type, TokenQuestionMark, Condition, Then);
+    Node->Operand[2] = Else;
+    Node->NumOperands = 3;
+    return Node;
+}
+
+/* a call to a math function which has a direct entry point */
+static struct JitNode *JitCall(struct JitState *State, const char *Ident)
+{
+    struct JitNode *Node = JitNewNode(State, JitNodeCall, TypeFP);
+    struct JitNode *Arg;
+    struct FuncDef *Func;
+    struct Value *Val;
+
+    if (JitFindLocal(State, Ident) != NULL || !TableGet(State->pc, &State->pc->GlobalTable, Ident, &Val, NULL, NULL, NULL) || Val->Typ != &State->pc->FunctionType)
+        JitBail(State);
+
+    Func = Val->Val->FuncDef;
+    if (!Func->IsPure || Func->VarArgs || Func->ReturnType != &State->pc->FPType)
+        JitBail(State);
+
+    switch (Func->NumParams)
+    {
+        case 1:     Node->Address = (void *)Func->Native.FP1; break;
+        case 2:     Node->Address = (void *)Func->Native.FP2; break;
+        case 3:     Node->Address = (void *)Func->Native.FP3; break;
+        default:    break;
+    }
+
+    if (Node->Address == NULL)
+        JitBail(State);
+
+    Node->Native = &Func->Native;
+    JitExpect(State, TokenOpenBracket);
+    while (JitPeek(State) != TokenCloseBracket)
+    {
+        if (Node->NumOperands > 0)
+            JitExpect(State, TokenComma);
+
+        Arg = JitExpression(State, 2);
+        if (Node->NumOperands >= Func->NumParams)
+            JitBail(State);
+
+        Node->Operand[Node->NumOperands++] = Arg;
+        Node->HasSideEffects = Node->HasSideEffects || Arg->HasSideEffects;
+    }
+    JitExpect(State, TokenCloseBracket);
+
+    if (Node->NumOperands != Func->NumParams)
+        JitBail(State);
+
+    return Node;
+}
+
+/* a macro without parameters, which is evaluated in the caller's scope */
+static struct JitNode *JitMacro(struct JitState *State, struct MacroDef *Macro)
+{
+    struct JitToken *OldTokens = State->Tokens;
+    int OldNumTokens = State->NumTokens;
+    int OldPos = State->Pos;
+    struct JitToken *Tokens;
+    struct JitNode *Node;
+    int NumTokens;
+
+    if (Macro->NumParams != 0 || State->MacroDepth >= JIT_MACRO_DEPTH_MAX)
+        JitBail(State);
+
+    NumTokens = JitScanTokens(Macro->Body.Pos, NULL);
+    if (NumTokens == 0)
+        JitBail(State);
+
+    Tokens = (struct JitToken *)HeapAllocMem(State->pc, sizeof(struct JitToken) * NumTokens);
+    if (Tokens == NULL)
+        JitBail(State);
+
+    State->MacroTokens[State->MacroDepth++] = Tokens;
+    JitScanTokens(Macro->Body.Pos, Tokens);
+    State->Tokens = Tokens;
+    State->NumTokens = NumTokens;
+    State->Pos = 0;
+
+    Node = JitExpression(State, 2);
+    JitExpect(State, TokenEndOfFunction);
+
+    State->Tokens = OldTokens;
+    State->NumTokens = OldNumTokens;
+    State->Pos = OldPos;
+    State->MacroDepth--;
+    HeapFreeMem(State->pc, Tokens);
+    State->MacroTokens[State->MacroDepth] = NULL;
+    return Node;
+}
+
+/* a variable, a global or a macro */
+static struct JitNode *JitVariable(struct JitState *State, const char *Ident)
+{
+    struct JitLocal *Local = JitFindLocal(State, Ident);
+    struct JitNode *Node;
+    struct Value *Val;
+
+    if (Local != NULL)
+    {
+        Node = JitNewNode(State, JitNodeLocal, Local->Type);
+        Node->Slot = Local->Slot;
+        return Node;
+    }
+
+    if (!TableGet(State->pc, &State->pc->GlobalTable, Ident, &Val, NULL, NULL, NULL))
+        JitBail(State);
+
+    if (Val->Typ == &State->pc->MacroType)
+        return JitMacro(State, Val->Val->MacroDef);
+
+    /* globals are read where they live, nothing compiled can change them */
+    if (Val->Typ == &State->pc->FPType)
+        Node = JitNewNode(State, JitNodeGlobal, TypeFP);
+    else if (Val->Typ == &State->pc->IntType)
+        Node = JitNewNode(State, JitNodeGlobal, TypeInt);
+    else
+        JitBail(State);
+
+    Node->Address = (void *)Val->Val;
+    return Node;
+}
+
+/* a primary expression followed by any postfix operators */
+static struct JitNode *JitPrimary(struct JitState *State)
+{
+    const unsigned char *Data = State->Tokens[State->Pos].Pos + TOKEN_DATA_OFFSET;
+    struct JitNode *Node = NULL;
+    const char *Ident;
+    long Integer;
+
+    switch (JitPeek(State))
+    {
+        case TokenIntegerConstant:
+            /* integer constants are longs, only those which fit in an int behave the same as one */
+            memcpy((void *)&Integer, (void *)Data, sizeof(long));
+            if (Integer < INT_MIN || Integer > INT_MAX)
+                JitBail(State);
+
+            Node = JitNewNode(State, JitNodeConstant, TypeInt);
+            Node->Integer = (int)Integer;
+            State->Pos++;
+            break;
+
+        case TokenCharacterConstant:
+            Node = JitNewNode(State, JitNodeConstant, TypeInt);
+            Node->Integer = *(const char *)Data;
+            State->Pos++;
+            break;
+
+        case TokenFPConstant:
+            Node = JitNewNode(State, JitNodeConstant, TypeFP);
+            memcpy((void *)&Node->FP, (void *)Data, sizeof(double));
+            State->Pos++;
+            break;
+
+        case TokenIdentifier:
+            Ident = JitIdentifier(State, State->Pos);
+            State->Pos++;
+            if (JitPeek(State) == TokenOpenBracket)
+                Node = JitCall(State, Ident);
+            else
+                Node = JitVariable(State, Ident);
+            break;
+
+        case TokenOpenBracket:
+            State->Pos++;
+            Node = JitExpression(State, 2);
+            JitExpect(State, TokenCloseBracket);
+            break;
+
+        default:
+            JitBail(State);
+            break;
+    }
+
+    while (JitPeek(State) == TokenIncrement || JitPeek(State) == TokenDecrement)
+    {
+        Node = JitIncrement(State, JitPeek(State), Node, TRUE);
+        State->Pos++;
+    }
+
+    return Node;
+}
+
+/* a cast to int or double */
+static struct JitNode *JitCast(struct JitState *State)
+{
+    enum BaseType Type;
+
+    JitExpect(State, TokenOpenBracket);
+    Type = JitParseType(State);
+    JitExpect(State, TokenCloseBracket);
+
+    return JitNewOperator(State, JitNodeConvert, Type, TokenCast, JitUnary(State), NULL);
+}
+
+/* a prefix operator expression */
+static struct JitNode *JitUnary(struct JitState *State)
+{
+    enum LexToken Token = JitPeek(State);
+
+    switch (Token)
+    {
+        case TokenPlus:
+        case TokenMinus:
+        case TokenUnaryNot:
+        case TokenUnaryExor:
+            State->Pos++;
+            return JitPrefix(State, Token, JitUnary(State));
+
+        case TokenIncrement:
+        case TokenDecrement:
+            State->Pos++;
+            return JitIncrement(State, Token, JitUnary(State), FALSE);
+
+        case TokenOpenBracket:
+            if (JitIsType(JitPeekAhead(State, 1)))
+                return JitCast(State);
+
+            return JitPrimary(State);
+
+        default:
+            return JitPrimary(State);
+    }
+}
+
+/* an expression made of infix operators with at least the given precedence */
+static struct JitNode *JitExpression(struct JitState *State, int MinPrecedence)
+{
+    struct JitNode *Node = JitUnary(State);
+    struct JitNode *Then;
+    struct JitNode *Else;
+    enum LexToken Op;
+    int Precedence;
+
+    while (TRUE)
+    {
+        Op = JitPeek(State);
+        Precedence = JitInfixPrecedence(Op);
+        if (Precedence == 0 || Precedence < MinPrecedence || Op == TokenColon)
+            break;
+
+        State->Pos++;
+        if (Precedence == 2)
+            Node = JitAssign(State, Op, Node, JitExpression(State, 2));
+
+        else if (Op == TokenQuestionMark)
+        {
+            /* the evaluator groups chained ternaries its own way, leave those to it */
+            Then = JitExpression(State, 4);
+            JitExpect(State, TokenColon);
+            Else = JitExpression(State, 4);
+            if (JitPeek(State) == TokenQuestionMark)
+                JitBail(State);
+
+            Node = JitTernary(State, Node, Then, Else);
+        }
+        else
+            Node = JitInfix(State, Op, Node, JitExpression(State, Precedence+1));
+    }
+
+    return Node;
+}
+
+/*
+ * code generation. Expressions leave their result in eax or xmm0. An infix operator has
+ * its right operand in ecx or xmm1. Nothing is kept in a register while another
+ * expression is compiled, partial results go into temporaries at the bottom of the frame
+ */
+
+static void JitByte(struct JitState *State, int Byte)
+{
+    if (State->CodeSize >= JIT_CODE_MAX)
+        JitBail(State);
+
+    State->Code[State->CodeSize++] = (unsigned char)Byte;
+}
+
+static void JitInt32(struct JitState *State, int Value)
+{
+    int Count;
+
+    for (Count = 0; Count < 4; Count++)
+        JitByte(State, (int)(((unsigned int)Value >> (Count*8)) & 0xff));
+}
+
+static void JitInt64(struct JitState *State, uintptr_t Value)
+{
+    int Count;
+
+    for (Count = 0; Count < 8; Count++)
+        JitByte(State, (int)((Value >> (Count*8)) & 0xff));
+}
+
+static int JitRead32(struct JitState *State, int Pos)
+{
+    int Value;
+
+    memcpy((void *)&Value, (void *)&State->Code[Pos], sizeof(Value));
+    return Value;
+}
+
+static void JitWrite32(struct JitState *State, int Pos, int Value)
+{
+    memcpy((void *)&State->Code[Pos], (void *)&Value, sizeof(Value));
+}
+
+/* the start of an instruction - optional prefix and REX bytes then a one or two byte opcode */
+static void JitOpcode(struct JitState *State, int Prefix, int Rex, int Opcode)
+{
+    if (Prefix != 0)
+        JitByte(State, Prefix);
+
+    if (Rex != 0)
+        JitByte(State, Rex);
+
+    if (Opcode > 0xff)
+        JitByte(State, Opcode >> 8);
+
+    JitByte(State, Opcode & 0xff);
+}
+
+/* an instruction with two register operands */
+static void JitRegReg(struct JitState *State, int Prefix, int Rex, int Opcode, int Reg, int RM)
+{
+    JitOpcode(State, Prefix, Rex, Opcode);
+    JitByte(State, 0xc0 | (Reg << 3) | RM);
+}
+
+/* an instruction with a register and a memory operand */
+static void JitRegMem(struct JitState *State, int Prefix, int Rex, int Opcode, int Reg, struct JitMem *Mem)
+{
+    JitOpcode(State, Prefix, Rex, Opcode);
+    if (Mem->Base == JIT_RIP)
+    {
+        /* the constant's number is replaced with its offset once the code is complete */
+        JitByte(State, (Reg << 3) | 0x05);
+        if (State->NumConstantUses >= State->MaxConstants)
+            JitBail(State);
+
+        State->ConstantUses[State->NumConstantUses++] = State->CodeSize;
+        JitInt32(State, Mem->Disp);
+    }
+    else
+    {
+        JitByte(State, 0x80 | (Reg << 3) | Mem->Base);
+        if (Mem->Base == JIT_RSP)
+            JitByte(State, 0x24);
+
+        JitInt32(State, Mem->Disp);
+    }
+}
+
+static void JitMoveImmediate64(struct JitState *State, int Reg, uintptr_t Value)
+{
+    JitOpcode(State, 0, JIT_REX_W, 0xb8 + Reg);
+    JitInt64(State, Value);
+}
+
+static void JitMoveImmediate32(struct JitState *State, int Reg, int Value)
+{
+    JitByte(State, 0xb8 + Reg);
+    JitInt32(State, Value);
+}
+
+/* a local's stack slot, below the saved result pointer */
+static struct JitMem JitSlot(int Slot)
+{
+    struct JitMem Mem;
+
+    Mem.Base = JIT_RBP;
+    Mem.Disp = -16 - 8 * Slot;
+    return Mem;
+}
+
+static struct JitMem JitTemp(int Temp)
+{
+    struct JitMem Mem;
+
+    Mem.Base = JIT_RSP;
+    Mem.Disp = JIT_SHADOW_SPACE + 8 * Temp;
+    return Mem;
+}
+
+static int JitPushTemp(struct JitState *State)
+{
+    int Temp = State->NumTemps++;
+
+    if (State->NumTemps > State->MaxTemps)
+        State->MaxTemps = State->NumTemps;
+
+    return Temp;
+}
+
+/* a double constant, stored after the code */
+static struct JitMem JitConstant(struct JitState *State, double Value)
+{
+    struct JitMem Mem;
+    int Count;
+
+    for (Count = 0; Count < State->NumConstants; Count++)
+    {
+        if (memcmp((void *)&State->Constants[Count], (void *)&Value, sizeof(double)) == 0)
+            break;
+    }
+
+    if (Count == State->NumConstants)
+    {
+        if (State->NumConstants >= State->MaxConstants)
+            JitBail(State);
+
+        State->Constants[State->NumConstants++] = Value;
+    }
+
+    Mem.Base = JIT_RIP;
+    Mem.Disp = Count;
+    return Mem;
+}
+
+/* a global, its address goes in the given register */
+static struct JitMem JitGlobal(struct JitState *State, int Reg, void *Address)
+{
+    struct JitMem Mem;
+
+    JitMoveImmediate64(State, Reg, (uintptr_t)Address);
+    Mem.Base = Reg;
+    Mem.Disp = 0;
+    return Mem;
+}
+
+/* load register 0 or 1 from memory holding a value of FromType, converting it to Type */
+static void JitLoad(struct JitState *State, int Reg, enum BaseType Type, enum BaseType FromType, struct JitMem *Mem)
+{
+    if (Type == TypeFP && FromType == TypeFP)
+        JitRegMem(State, 0xf2, 0, 0x0f10, Reg, Mem);        /* movsd */
+    else if (Type == TypeFP)
+        JitRegMem(State, 0xf2, 0, 0x0f2a, Reg, Mem);        /* cvtsi2sd */
+    else if (FromType == TypeFP)
+        JitRegMem(State, 0xf2, JIT_REX_LONG, 0x0f2c, Reg, Mem);    /* cvttsd2si */
+    else
+        JitRegMem(State, 0, 0, 0x8b, Reg, Mem);             /* mov */
+}
+
+static void JitStore(struct JitState *State, int Reg, enum BaseType Type, struct JitMem *Mem)
+{
+    if (Type == TypeFP)
+        JitRegMem(State, 0xf2, 0, 0x0f11, Reg, Mem);        /* movsd */
+    else
+        JitRegMem(State, 0, 0, 0x89, Reg, Mem);             /* mov */
+}
+
+/* convert eax or xmm0 the way an assignment would */
+static void JitConvert(struct JitState *State, enum BaseType From, enum BaseType To)
+{
+    if (From == To)
+        return;
+
+    if (To == TypeFP)
+        JitRegReg(State, 0xf2, 0, 0x0f2a, 0, JIT_RAX);                  /* cvtsi2sd xmm0, eax */
+    else
+        JitRegReg(State, 0xf2, JIT_REX_LONG, 0x0f2c, JIT_RAX, 0);       /* cvttsd2si rax, xmm0 */
+}
+
+/* set al when the condition holds, then widen it */
+static void JitSetCondition(struct JitState *State, int Condition)
+{
+    JitRegReg(State, 0, 0, 0x0f90 | Condition, 0, JIT_RAX);             /* setcc al */
+    JitRegReg(State, 0, 0, 0x0fb6, JIT_RAX, JIT_RAX);                   /* movzx eax, al */
+}
+
+/* constants and variables can be loaded straight into either register */
+static int JitIsSimple(struct JitNode *Node)
+{
+    return Node->Kind == JitNodeConstant || Node->Kind == JitNodeLocal || Node->Kind == JitNodeGlobal;
+}
+
+static void JitLoadSimple(struct JitState *State, struct JitNode *Node, int Reg, enum BaseType Type)
+{
+    struct JitMem Mem;
+    unsigned long long Bits;
+    double Value;
+
+    switch (Node->Kind)
+    {
+        case JitNodeConstant:
+            if (Type == TypeInt)
+            {
+                JitMoveImmediate32(State, Reg, Node->Integer);
+                break;
+            }
+
+            Value = (Node->Type == TypeFP) ? Node->FP : (double)Node->Integer;
+            memcpy((void *)&Bits, (void *)&Value, sizeof(Bits));
+            if (Bits == 0)
+                JitRegReg(State, 0x66, 0, 0x0f57, Reg, Reg);            /* xorpd */
+            else
+            {
+                Mem = JitConstant(State, Value);
+                JitLoad(State, Reg, TypeFP, TypeFP, &Mem);
+            }
+            break;
+
+        case JitNodeLocal:
+            Mem = JitSlot(Node->Slot);
+            JitLoad(State, Reg, Type, Node->Type, &Mem);
+            break;
+
+        default:
+            Mem = JitGlobal(State, (Reg == 0) ? JIT_RAX : JIT_RDX, Node->Address);
+            JitLoad(State, Reg, Type, Node->Type, &Mem);
+            break;
+    }
+}
+
+/* move eax to ecx or xmm0 to xmm1 */
+static void JitMoveToSecond(struct JitState *State, enum BaseType Type)
+{
+    if (Type == TypeFP)
+        JitRegReg(State, 0x66, 0, 0x0f28, 1, 0);                        /* movapd xmm1, xmm0 */
+    else
+        JitRegReg(State, 0, 0, 0x89, JIT_RAX, JIT_RCX);                 /* mov ecx, eax */
+}
+
+/* evaluate both operands of an infix operator as Type. Variables are read when the operator
+ * is applied, after the other operand, the same as the evaluator's lvalues are */
+static void JitOperands(struct JitState *State, struct JitNode *Left, struct JitNode *Right, enum BaseType Type)
+{
+    struct JitMem Mem;
+
+    if (JitIsSimple(Left))
+    {
+        if (!JitIsSimple(Right))
+        {
+            JitEmit(State, Right);
+            JitConvert(State, Right->Type, Type);
+            JitMoveToSecond(State, Type);
+        }
+
+        JitLoadSimple(State, Left, 0, Type);
+        if (JitIsSimple(Right))
+            JitLoadSimple(State, Right, 1, Type);
+    }
+    else if (JitIsSimple(Right))
+    {
+        JitEmit(State, Left);
+        JitConvert(State, Left->Type, Type);
+        JitLoadSimple(State, Right, 1, Type);
+    }
+    else
+    {
+        JitEmit(State, Left);
+        JitConvert(State, Left->Type, Type);
+        Mem = JitTemp(JitPushTemp(State));
+        JitStore(State, 0, Type, &Mem);
+
+        JitEmit(State, Right);
+        JitConvert(State, Right->Type, Type);
+        JitMoveToSecond(State, Type);
+        JitLoad(State, 0, Type, Type, &Mem);
+        State->NumTemps--;
+    }
+}
+
+/* eax / ecx or eax % ecx, done in long like the evaluator. Dividing by zero is left to the interpreter */
+static void JitDivide(struct JitState *State, int IsModulus)
+{
+    JitRegReg(State, 0, 0, 0x85, JIT_RCX, JIT_RCX);                     /* test ecx, ecx */
+    State->Bails = JitJump(State, JIT_CC_E, State->Bails);
+
+    if (JIT_REX_LONG != 0)
+    {
+        JitRegReg(State, 0, JIT_REX_W, 0x63, JIT_RAX, JIT_RAX);         /* movsxd rax, eax */
+        JitRegReg(State, 0, JIT_REX_W, 0x63, JIT_RCX, JIT_RCX);         /* movsxd rcx, ecx */
+    }
+    JitOpcode(State, 0, JIT_REX_LONG, 0x99);                            /* cqo */
+    JitRegReg(State, 0, JIT_REX_LONG, 0xf7, 7, JIT_RCX);                /* idiv rcx */
+
+    if (IsModulus)
+        JitRegReg(State, 0, 0, 0x89, JIT_RDX, JIT_RAX);                 /* mov eax, edx */
+}
+
+/* apply an arithmetic or bitwise operator to the operands */
+static void JitArithmetic(struct JitState *State, enum LexToken Op, enum BaseType Type)
+{
+    if (Type == TypeFP)
+    {
+        switch (Op)
+        {
+            case TokenPlus:     JitRegReg(State, 0xf2, 0, 0x0f58, 0, 1); break;    /* addsd */
+            case TokenMinus:    JitRegReg(State, 0xf2, 0, 0x0f5c, 0, 1); break;    /* subsd */
+            case TokenAsterisk: JitRegReg(State, 0xf2, 0, 0x0f59, 0, 1); break;    /* mulsd */
+            case TokenSlash:    JitRegReg(State, 0xf2, 0, 0x0f5e, 0, 1); break;    /* divsd */
+            default:            JitBail(State); break;
+        }
+        return;
+    }
+
+    switch (Op)
+    {
+        case TokenPlus:             JitRegReg(State, 0, 0, 0x01, JIT_RCX, JIT_RAX); break;     /* add */
+        case TokenMinus:            JitRegReg(State, 0, 0, 0x29, JIT_RCX, JIT_RAX); break;     /* sub */
+        case TokenAsterisk:         JitRegReg(State, 0, 0, 0x0faf, JIT_RAX, JIT_RCX); break;   /* imul */
+        case TokenAmpersand:        JitRegReg(State, 0, 0, 0x21, JIT_RCX, JIT_RAX); break;     /* and */
+        case TokenArithmeticOr:     JitRegReg(State, 0, 0, 0x09, JIT_RCX, JIT_RAX); break;     /* or */
+        case TokenArithmeticExor:   JitRegReg(State, 0, 0, 0x31, JIT_RCX, JIT_RAX); break;     /* xor */
+        case TokenSlash:            JitDivide(State, FALSE); break;
+        case TokenModulus:          JitDivide(State, TRUE); break;
+
+        case TokenShiftLeft:
+        case TokenShiftRight:
+            if (JIT_REX_LONG != 0)
+                JitRegReg(State, 0, JIT_REX_W, 0x63, JIT_RAX, JIT_RAX); /* movsxd rax, eax */
+
+            JitRegReg(State, 0, JIT_REX_LONG, 0xd3, (Op == TokenShiftLeft) ? 4 : 7, JIT_RAX);    /* shl/sar rax, cl */
+            break;
+
+        default:
+            JitBail(State);
+            break;
+    }
+}
+
+/* a double == or != has to look at the parity flag too, which a single jump can't */
+static int JitIsFPEquality(struct JitNode *Node)
+{
+    return (Node->Op == TokenEqual || Node->Op == TokenNotEqual) &&
+        (Node->Operand[0]->Type == TypeFP || Node->Operand[1]->Type == TypeFP);
+}
+
+/* compare the operands, returning the condition code which is set when the comparison holds.
+ * Comparisons of doubles are arranged so that NaNs make them false */
+static int JitCompare(struct JitState *State, struct JitNode *Node)
+{
+    enum BaseType Type = (Node->Operand[0]->Type == TypeFP || Node->Operand[1]->Type == TypeFP) ? TypeFP : TypeInt;
+
+    JitOperands(State, Node->Operand[0], Node->Operand[1], Type);
+    if (Type == TypeInt)
+    {
+        JitRegReg(State, 0, 0, 0x39, JIT_RCX, JIT_RAX);                 /* cmp eax, ecx */
+        switch (Node->Op)
+        {
+            case TokenEqual:        return JIT_CC_E;
+            case TokenNotEqual:     return JIT_CC_NE;
+            case TokenLessThan:     return JIT_CC_L;
+            case TokenGreaterThan:  return JIT_CC_G;
+            case TokenLessEqual:    return JIT_CC_LE;
+            default:                return JIT_CC_GE;
+        }
+    }
+
+    switch (Node->Op)
+    {
+        case TokenLessThan:
+        case TokenLessEqual:
+            JitRegReg(State, 0x66, 0, 0x0f2e, 1, 0);                    /* ucomisd xmm1, xmm0 */
+            return (Node->Op == TokenLessThan) ? JIT_CC_A : JIT_CC_AE;
+
+        default:
+            JitRegReg(State, 0x66, 0, 0x0f2e, 0, 1);                    /* ucomisd xmm0, xmm1 */
+            switch (Node->Op)
+            {
+                case TokenEqual:        return JIT_CC_E;
+                case TokenNotEqual:     return JIT_CC_NE;
+                case TokenGreaterThan:  return JIT_CC_A;
+                default:                return JIT_CC_AE;
+            }
+    }
+}
+
+/* a comparison as a value of 0 or 1 */
+static void JitCompareValue(struct JitState *State, struct JitNode *Node)
+{
+    int Condition = JitCompare(State, Node);
+
+    if (JitIsFPEquality(Node))
+    {
+        /* unordered sets ZF too, so equality also needs PF clear */
+        JitRegReg(State, 0, 0, 0x0f90 | Condition, 0, JIT_RAX);                                     /* setcc al */
+        JitRegReg(State, 0, 0, 0x0f90 | ((Node->Op == TokenEqual) ? JIT_CC_NP : JIT_CC_P), 0, JIT_RCX);  /* setcc cl */
+        JitRegReg(State, 0, 0, (Node->Op == TokenEqual) ? 0x20 : 0x08, JIT_RCX, JIT_RAX);          /* and/or al, cl */
+        JitRegReg(State, 0, 0, 0x0fb6, JIT_RAX, JIT_RAX);                                           /* movzx eax, al */
+    }
+    else
+        JitSetCondition(State, Condition);
+}
+
+/* set the flags to test a value against zero. Conditions are converted to an int first, as
+ * in ExpressionParseInt(), the condition of a ternary to a long */
+static void JitTest(struct JitState *State, enum BaseType Type, int IsLong)
+{
+    int Rex = 0;
+
+    if (Type == TypeFP)
+    {
+        JitConvert(State, TypeFP, TypeInt);
+        if (IsLong)
+            Rex = JIT_REX_LONG;
+    }
+
+    JitRegReg(State, 0, Rex, 0x85, JIT_RAX, JIT_RAX);                   /* test eax, eax */
+}
+
+/* a jump whose target isn't known yet. It's added to a list of jumps going to the same place,
+ * linked through their offsets. Returns the new list */
+static int JitJump(struct JitState *State, int Condition, int List)
+{
+    int Pos;
+
+    if (Condition == JIT_ALWAYS)
+        JitByte(State, 0xe9);
+    else
+    {
+        JitByte(State, 0x0f);
+        JitByte(State, 0x80 | Condition);
+    }
+
+    Pos = State->CodeSize;
+    JitInt32(State, List);
+    return Pos;
+}
+
+/* point a list of jumps at their target */
+static void JitPatch(struct JitState *State, int List, int Target)
+{
+    int Next;
+
+    while (List != JIT_NO_JUMPS)
+    {
+        Next = JitRead32(State, List);
+        JitWrite32(State, List, Target - (List + 4));
+        List = Next;
+    }
+}
+
+static void JitJumpTo(struct JitState *State, int Condition, int Target)
+{
+    JitPatch(State, JitJump(State, Condition, JIT_NO_JUMPS), Target);
+}
+
+/* hand over to the interpreter if the user has asked for a reset, which it then carries out */
+static void JitCheckReset(struct JitState *State)
+{
+    JitMoveImmediate64(State, JIT_RAX, (uintptr_t)&gResetParser);
+    JitByte(State, 0x80);                                               /* cmp byte [rax], 0 */
+    JitByte(State, 0x38);
+    JitByte(State, 0x00);
+    State->Bails = JitJump(State, JIT_CC_NE, State->Bails);
+}
+
+/* jump if a condition is false, returns the list of jumps with this one added */
+static int JitBranchIfFalse(struct JitState *State, struct JitNode *Node, int List)
+{
+    if (Node->Kind == JitNodeInfix && JitIsComparison(Node->Op) && !JitIsFPEquality(Node))
+        return JitJump(State, JitCompare(State, Node) ^ 1, List);
+
+    JitEmit(State, Node);
+    JitTest(State, Node->Type, FALSE);
+    return JitJump(State, JIT_CC_E, List);
+}
+
+static void JitEmitPrefix(struct JitState *State, struct JitNode *Node)
+{
+    JitEmit(State, Node->Operand[0]);
+    switch (Node->Op)
+    {
+        case TokenMinus:
+            if (Node->Type == TypeFP)
+            {
+                /* flip the sign bit so -0.0 comes out right */
+                JitRegReg(State, 0x66, JIT_REX_W, 0x0f7e, 0, JIT_RAX);  /* movq rax, xmm0 */
+                JitRegReg(State, 0, JIT_REX_W, 0x0fba, 7, JIT_RAX);     /* btc rax, 63 */
+                JitByte(State, 63);
+                JitRegReg(State, 0x66, JIT_REX_W, 0x0f6e, 0, JIT_RAX);  /* movq xmm0, rax */
+            }
+            else
+                JitRegReg(State, 0, 0, 0xf7, 3, JIT_RAX);               /* neg eax */
+            break;
+
+        case TokenUnaryNot:
+            if (Node->Type == TypeFP)
+            {
+                JitRegReg(State, 0x66, 0, 0x0f57, 1, 1);                /* xorpd xmm1, xmm1 */
+                JitRegReg(State, 0x66, 0, 0x0f2e, 0, 1);                /* ucomisd xmm0, xmm1 */
+                JitRegReg(State, 0, 0, 0x0f90 | JIT_CC_E, 0, JIT_RAX);  /* sete al */
+                JitRegReg(State, 0, 0, 0x0f90 | JIT_CC_NP, 0, JIT_RCX); /* setnp cl */
+                JitRegReg(State, 0, 0, 0x20, JIT_RCX, JIT_RAX);         /* and al, cl */
+                JitRegReg(State, 0, 0, 0x0fb6, JIT_RAX, JIT_RAX);       /* movzx eax, al */
+                JitConvert(State, TypeInt, TypeFP);
+            }
+            else
+            {
+                JitTest(State, TypeInt, FALSE);
+                JitSetCondition(State, JIT_CC_E);
+            }
+            break;
+
+        case TokenUnaryExor:
+            JitRegReg(State, 0, 0, 0xf7, 2, JIT_RAX);                   /* not eax */
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* ++ and --. As in the evaluator a postfix increment of a double gives the new value */
+static void JitEmitIncrement(struct JitState *State, struct JitNode *Node)
+{
+    struct JitMem Slot = JitSlot(Node->Slot);
+    struct JitMem One;
+
+    if (Node->Type == TypeFP)
+    {
+        One = JitConstant(State, 1.0);
+        JitLoad(State, 0, TypeFP, TypeFP, &Slot);
+        JitRegMem(State, 0xf2, 0, (Node->Op == TokenIncrement) ? 0x0f58 : 0x0f5c, 0, &One);    /* addsd/subsd */
+        JitStore(State, 0, TypeFP, &Slot);
+    }
+    else if (Node->IsPostfix)
+    {
+        JitLoad(State, 0, TypeInt, TypeInt, &Slot);
+        JitByte(State, 0x8d);                                           /* lea ecx, [rax+1] */
+        JitByte(State, 0x48);
+        JitByte(State, (Node->Op == TokenIncrement) ? 0x01 : 0xff);
+        JitStore(State, JIT_RCX, TypeInt, &Slot);
+    }
+    else
+    {
+        JitLoad(State, 0, TypeInt, TypeInt, &Slot);
+        JitByte(State, 0x83);                                           /* add/sub eax, 1 */
+        JitByte(State, (Node->Op == TokenIncrement) ? 0xc0 : 0xe8);
+        JitByte(State, 0x01);
+        JitStore(State, 0, TypeInt, &Slot);
+    }
+}
+
+/* && and ||, the right hand side only runs if it's needed */
+static void JitEmitLogical(struct JitState *State, struct JitNode *Node)
+{
+    int ShortCut;
+    int End;
+
+    JitEmit(State, Node->Operand[0]);
+    JitTest(State, TypeInt, FALSE);
+    ShortCut = JitJump(State, (Node->Op == TokenLogicalAnd) ? JIT_CC_E : JIT_CC_NE, JIT_NO_JUMPS);
+
+    JitEmit(State, Node->Operand[1]);
+    JitTest(State, TypeInt, FALSE);
+    JitSetCondition(State, JIT_CC_NE);
+    End = JitJump(State, JIT_ALWAYS, JIT_NO_JUMPS);
+
+    JitPatch(State, ShortCut, State->CodeSize);
+    JitMoveImmediate32(State, JIT_RAX, (Node->Op == TokenLogicalAnd) ? 0 : 1);
+    JitPatch(State, End, State->CodeSize);
+}
+
+static void JitEmitTernary(struct JitState *State, struct JitNode *Node)
+{
+    int Else;
+    int End;
+
+    JitEmit(State, Node->Operand[0]);
+    JitTest(State, Node->Operand[0]->Type, TRUE);
+    Else = JitJump(State, JIT_CC_E, JIT_NO_JUMPS);
+
+    JitEmit(State, Node->Operand[1]);
+    End = JitJump(State, JIT_ALWAYS, JIT_NO_JUMPS);
+
+    JitPatch(State, Else, State->CodeSize);
+    JitEmit(State, Node->Operand[2]);
+    JitPatch(State, End, State->CodeSize);
+}
+
+/* an assignment. Compound assignments work in double if either side is one */
+static void JitEmitAssign(struct JitState *State, struct JitNode *Node)
+{
+    struct JitMem Slot = JitSlot(Node->Slot);
+    struct JitNode *Value = Node->Operand[0];
+    enum BaseType Type = (Node->Type == TypeFP || Value->Type == TypeFP) ? TypeFP : TypeInt;
+
+    JitEmit(State, Value);
+    if (Node->Op == TokenAssign)
+        JitConvert(State, Value->Type, Node->Type);
+    else
+    {
+        JitConvert(State, Value->Type, Type);
+        JitMoveToSecond(State, Type);
+        JitLoad(State, 0, Type, Node->Type, &Slot);
+        JitArithmetic(State, JitAssignOperator(Node->Op), Type);
+        JitConvert(State, Type, Node->Type);
+    }
+
+    JitStore(State, 0, Node->Type, &Slot);
+}
+
+/* call a math function through its direct entry point. The arguments go in xmm0 to xmm2
+ * in both the Win64 and System V conventions */
+static void JitEmitCall(struct JitState *State, struct JitNode *Node)
+{
+    struct JitMem Mem;
+    int FirstTemp = State->NumTemps;
+    int Count;
+
+    if (Node->NumOperands == 1)
+    {
+        JitEmit(State, Node->Operand[0]);
+        JitConvert(State, Node->Operand[0]->Type, TypeFP);
+    }
+    else
+    {
+        for (Count = 0; Count < Node->NumOperands; Count++)
+        {
+            JitEmit(State, Node->Operand[Count]);
+            JitConvert(State, Node->Operand[Count]->Type, TypeFP);
+            Mem = JitTemp(JitPushTemp(State));
+            JitStore(State, 0, TypeFP, &Mem);
+        }
+
+        for (Count = 0; Count < Node->NumOperands; Count++)
+        {
+            Mem = JitTemp(FirstTemp + Count);
+            JitLoad(State, Count, TypeFP, TypeFP, &Mem);
+        }
+
+        State->NumTemps = FirstTemp;
+    }
+
+    JitByte(State, 0x49);                                               /* mov r11, imm64 */
+    JitByte(State, 0xbb);
+    JitInt64(State, (uintptr_t)Node->Address);
+    JitByte(State, 0x41);                                               /* call r11 */
+    JitByte(State, 0xff);
+    JitByte(State, 0xd3);
+}
+
+static void JitEmit(struct JitState *State, struct JitNode *Node)
+{
+    switch (Node->Kind)
+    {
+        case JitNodeConstant:
+        case JitNodeLocal:
+        case JitNodeGlobal:
+            JitLoadSimple(State, Node, 0, Node->Type);
+            break;
+
+        case JitNodePrefix:     JitEmitPrefix(State, Node); break;
+        case JitNodeIncrement:  JitEmitIncrement(State, Node); break;
+        case JitNodeLogical:    JitEmitLogical(State, Node); break;
+        case JitNodeTernary:    JitEmitTernary(State, Node); break;
+        case JitNodeAssign:     JitEmitAssign(State, Node); break;
+        case JitNodeCall:       JitEmitCall(State, Node); break;
+
+        case JitNodeInfix:
+            if (JitIsComparison(Node->Op))
+                JitCompareValue(State, Node);
+            else
+            {
+                JitOperands(State, Node->Operand[0], Node->Operand[1], Node->Type);
+                JitArithmetic(State, Node->Op, Node->Type);
+            }
+            break;
+
+        case JitNodeConvert:
+            JitEmit(State, Node->Operand[0]);
+            JitConvert(State, Node->Operand[0]->Type, Node->Type);
+            break;
+    }
+}
+
+/*
+ * statements
+ */
+
+/* a local variable declaration. The variable is in scope in its own initialiser */
+static void JitDeclaration(struct JitState *State)
+{
+    enum BaseType Type = JitParseType(State);
+    struct JitMem Slot;
+    const char *Ident;
+
+    while (TRUE)
+    {
+        if (JitPeek(State) != TokenIdentifier)
+            JitBail(State);
+
+        Ident = JitIdentifier(State, State->Pos);
+        State->Pos++;
+        JitAddLocal(State, Ident, Type);
+        Slot = JitSlot(State->NumSlots-1);
+
+        if (JitPeek(State) == TokenAssign)
+        {
+            struct JitNode *Init;
+
+            State->Pos++;
+            Init = JitExpression(State, 2);
+            JitEmit(State, Init);
+            JitConvert(State, Init->Type, Type);
+            JitStore(State, 0, Type, &Slot);
+        }
+
+        if (JitPeek(State) != TokenComma)
+            break;
+
+        State->Pos++;
+    }
+}
+
+/* a block of statements between braces */
+static void JitBlock(struct JitState *State, struct JitLoop *Loop)
+{
+    JitExpect(State, TokenLeftBrace);
+    State->Depth++;
+    while (JitPeek(State) != TokenRightBrace)
+        JitStatement(State, Loop);
+
+    State->Pos++;
+    JitEndScope(State);
+}
+
+/* "(" condition ")", returns the jumps taken when it's false */
+static int JitCondition(struct JitState *State, int List)
+{
+    struct JitNode *Condition;
+
+    JitExpect(State, TokenOpenBracket);
+    Condition = JitExpression(State, 2);
+    JitExpect(State, TokenCloseBracket);
+
+    return JitBranchIfFalse(State, Condition, List);
+}
+
+static void JitStatement(struct JitState *State, struct JitLoop *Loop)
+{
+    struct JitLoop Inner;
+    struct JitNode *Node;
+    struct JitMem Mem;
+    int Top;
+    int Else;
+    int End;
+
+    switch (JitPeek(State))
+    {
+        case TokenLeftBrace:
+            JitBlock(State, Loop);
+            return;
+
+        case TokenSemicolon:
+            State->Pos++;
+            return;
+
+        case TokenIf:
+            State->Pos++;
+            Else = JitCondition(State, JIT_NO_JUMPS);
+            JitStatement(State, Loop);
+            if (JitPeek(State) == TokenElse)
+            {
+                State->Pos++;
+                End = JitJump(State, JIT_ALWAYS, JIT_NO_JUMPS);
+                JitPatch(State, Else, State->CodeSize);
+                JitStatement(State, Loop);
+                JitPatch(State, End, State->CodeSize);
+            }
+            else
+                JitPatch(State, Else, State->CodeSize);
+            return;
+
+        case TokenWhile:
+            State->Pos++;
+            Top = State->CodeSize;
+            JitCheckReset(State);
+            Inner.Breaks = JitCondition(State, JIT_NO_JUMPS);
+            Inner.Continues = JIT_NO_JUMPS;
+            JitStatement(State, &Inner);
+            JitPatch(State, Inner.Continues, Top);
+            JitJumpTo(State, JIT_ALWAYS, Top);
+            JitPatch(State, Inner.Breaks, State->CodeSize);
+            return;
+
+        case TokenDo:
+            State->Pos++;
+            Top = State->CodeSize;
+            JitCheckReset(State);
+            Inner.Breaks = JIT_NO_JUMPS;
+            Inner.Continues = JIT_NO_JUMPS;
+            JitStatement(State, &Inner);
+            JitPatch(State, Inner.Continues, State->CodeSize);
+            JitExpect(State, TokenWhile);
+            Inner.Breaks = JitCondition(State, Inner.Breaks);
+            JitJumpTo(State, JIT_ALWAYS, Top);
+            JitPatch(State, Inner.Breaks, State->CodeSize);
+            JitExpect(State, TokenSemicolon);
+            return;
+
+        case TokenFor:
+            State->Pos++;
+            State->Depth++;
+            JitExpect(State, TokenOpenBracket);
+            if (JitIsType(JitPeek(State)))
+                JitDeclaration(State);
+            else if (JitPeek(State) != TokenSemicolon)
+                JitEmit(State, JitExpression(State, 2));
+            JitExpect(State, TokenSemicolon);
+
+            Top = State->CodeSize;
+            JitCheckReset(State);
+            Inner.Breaks = JIT_NO_JUMPS;
+            Inner.Continues = JIT_NO_JUMPS;
+            if (JitPeek(State) != TokenSemicolon)
+                Inner.Breaks = JitBranchIfFalse(State, JitExpression(State, 2), JIT_NO_JUMPS);
+            JitExpect(State, TokenSemicolon);
+
+            /* the increment is compiled after the body */
+            Node = NULL;
+            if (JitPeek(State) != TokenCloseBracket)
+                Node = JitExpression(State, 2);
+            JitExpect(State, TokenCloseBracket);
+
+            /* a declaration as the body would be in scope in the increment */
+            if (JitIsType(JitPeek(State)))
+                JitBail(State);
+
+            JitStatement(State, &Inner);
+            JitPatch(State, Inner.Continues, State->CodeSize);
+            if (Node != NULL)
+                JitEmit(State, Node);
+
+            JitJumpTo(State, JIT_ALWAYS, Top);
+            JitPatch(State, Inner.Breaks, State->CodeSize);
+            JitEndScope(State);
+            return;
+
+        case TokenBreak:
+        case TokenContinue:
+            if (Loop == NULL)
+                JitBail(State);
+
+            if (JitPeek(State) == TokenBreak)
+                Loop->Breaks = JitJump(State, JIT_ALWAYS, Loop->Breaks);
+            else
+                Loop->Continues = JitJump(State, JIT_ALWAYS, Loop->Continues);
+
+            State->Pos++;
+            JitExpect(State, TokenSemicolon);
+            return;
+
+        case TokenReturn:
+            State->Pos++;
+            if (JitPeek(State) == TokenSemicolon)
+                JitBail(State);
+
+            Node = JitExpression(State, 2);
+            JitEmit(State, Node);
+            JitConvert(State, Node->Type, TypeFP);
+
+            Mem.Base = JIT_RBP;
+            Mem.Disp = -8;
+            JitRegMem(State, 0, JIT_REX_W, 0x8b, JIT_RAX, &Mem);             /* mov rax, [rbp-8] */
+            Mem.Base = JIT_RAX;
+            Mem.Disp = 0;
+            JitStore(State, 0, TypeFP, &Mem);
+            JitMoveImmediate32(State, JIT_RAX, 1);
+            State->Returns = JitJump(State, JIT_ALWAYS, State->Returns);
+            JitExpect(State, TokenSemicolon);
+            return;
+
+        case TokenIdentifier:
+            /* a goto label */
+            if (JitPeekAhead(State, 1) == TokenColon)
+                JitBail(State);
+            break;
+
+        case TokenIncrement:
+        case TokenDecrement:
+        case TokenOpenBracket:
+            break;
+
+        default:
+            /* anything else is only a statement if it's a declaration */
+            if (!JitIsType(JitPeek(State)))
+                JitBail(State);
+
+            JitDeclaration(State);
+            JitExpect(State, TokenSemicolon);
+            return;
+    }
+
+    JitEmit(State, JitExpression(State, 2));
+    JitExpect(State, TokenSemicolon);
+}
+
+/* compile main's body. The function takes a pointer for the result and returns TRUE, or
+ * FALSE to have the interpreter do the evaluation instead */
+static void JitFunction(struct JitState *State, struct FuncDef *Func, double **Args)
+{
+    unsigned long long Bits;
+    struct JitMem Mem;
+    int FramePatch;
+    int Constants;
+    int FrameSize;
+    int Init;
+    int Body;
+    int Exit;
+    int Count;
+    int Use;
+
+    JitByte(State, 0x55);                                               /* push rbp */
+    JitRegReg(State, 0, JIT_REX_W, 0x89, JIT_RSP, JIT_RBP);             /* mov rbp, rsp */
+    JitByte(State, JIT_REX_W);                                          /* sub rsp, imm32 */
+    JitByte(State, 0x81);
+    JitByte(State, 0xec);
+    FramePatch = State->CodeSize;
+    JitInt32(State, 0);
+    Mem.Base = JIT_RBP;
+    Mem.Disp = -8;
+    JitRegMem(State, 0, JIT_REX_W, 0x89, JIT_RESULT_ARG, &Mem);         /* mov [rbp-8], result */
+
+    /* the locals are only known at the end, they're set up there */
+    Init = JitJump(State, JIT_ALWAYS, JIT_NO_JUMPS);
+    Body = State->CodeSize;
+
+    for (Count = 0; Count < Func->NumParams; Count++)
+        JitAddLocal(State, Func->ParamName[Count], TypeFP);
+
+    JitBlock(State, NULL);
+    JitExpect(State, TokenEndOfFunction);
+
+    /* falling off the end leaves the result to the interpreter */
+    Exit = State->CodeSize;
+    JitPatch(State, State->Bails, Exit);
+    JitRegReg(State, 0, 0, 0x31, JIT_RAX, JIT_RAX);                     /* xor eax, eax */
+    JitPatch(State, State->Returns, State->CodeSize);
+    JitByte(State, 0xc9);                                               /* leave */
+    JitByte(State, 0xc3);                                               /* ret */
+
+    /* a fresh frame has its locals zeroed, then the arguments are copied in */
+    JitPatch(State, Init, State->CodeSize);
+    State->Bails = JIT_NO_JUMPS;
+    JitCheckReset(State);
+    JitPatch(State, State->Bails, Exit);
+    for (Count = Func->NumParams; Count < State->NumSlots; Count++)
+    {
+        Mem = JitSlot(Count);
+        JitRegMem(State, 0, JIT_REX_W, 0xc7, 0, &Mem);                  /* mov qword [slot], 0 */
+        JitInt32(State, 0);
+    }
+
+    for (Count = 0; Count < Func->NumParams; Count++)
+    {
+        Mem = JitGlobal(State, JIT_RAX, (void *)Args[Count]);
+        JitLoad(State, 0, TypeFP, TypeFP, &Mem);
+        Mem = JitSlot(Count);
+        JitStore(State, 0, TypeFP, &Mem);
+    }
+    JitJumpTo(State, JIT_ALWAYS, Body);
+
+    /* the frame holds the result pointer, the locals, the temporaries and space for callees,
+     * keeping the stack aligned to 16 bytes for calls */
+    FrameSize = 8 + 8 * State->NumSlots + JIT_SHADOW_SPACE + 8 * State->MaxTemps;
+    FrameSize = (FrameSize + 15) & ~15;
+    JitWrite32(State, FramePatch, FrameSize);
+
+    /* the constants go after the code where each use can reach them */
+    while (State->CodeSize % sizeof(double) != 0)
+        JitByte(State, 0xcc);                                           /* int3 */
+
+    Constants = State->CodeSize;
+    for (Count = 0; Count < State->NumConstants; Count++)
+    {
+        memcpy((void *)&Bits, (void *)&State->Constants[Count], sizeof(Bits));
+        JitInt64(State, (uintptr_t)Bits);
+    }
+
+    for (Count = 0; Count < State->NumConstantUses; Count++)
+    {
+        Use = State->ConstantUses[Count];
+        JitWrite32(State, Use, Constants + sizeof(double) * JitRead32(State, Use) - (Use + 4));
+    }
+}
+
+/*
+ * vector evaluation. A main without loops is also compiled to a straight line program which
+ * works out VECTOR_LANES values of its last argument at a time. Every operation has a register
+ * of its own with a value for each lane, and a local's value is in whichever register was last
+ * assigned to it. Both sides of an if run on every lane, then each local either side changed
+ * takes its value from the side the lane's condition chose. Returns are handled the same way,
+ * the result is chosen for the lanes which get to each one. vector.c runs the program
+ */
+
+static int JitVectorEmit(struct JitState *State, struct JitNode *Node);
+static void JitVectorStatement(struct JitState *State);
+static int JitVectorConstantOf(struct JitState *State, double Value);
+
+/* the last operation has only constant operands, it's run now and replaced by its result */
+static int JitVectorFold(struct JitState *State)
+{
+    struct VectorOp Op = State->Ops[State->NumOps-1];
+    double Registers[4][VECTOR_LANES];
+    struct VectorProgram Vector;
+    int Count;
+    int Lane;
+
+    for (Count = 0; Count < 3; Count++)
+    {
+        if (Op.Operand[Count] == VECTOR_NONE)
+            continue;
+
+        for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+            Registers[Count][Lane] = State->Ops[Op.Operand[Count]].FP;
+
+        Op.Operand[Count] = Count;
+    }
+
+    Op.Result = 3;
+    Vector.Ops = &Op;
+    Vector.NumOps = 1;
+    Vector.Registers = Registers;
+    VectorRun(&Vector, NULL);
+
+    State->NumOps--;
+    return JitVectorConstantOf(State, Registers[3][0]);
+}
+
+static int JitVectorNew(struct JitState *State, enum VectorCode Code, int Operand0, int Operand1, int Operand2)
+{
+    struct VectorOp *Op;
+    int Count;
+
+    if (State->NumOps >= State->MaxOps)
+        JitBail(State);
+
+    Op = &State->Ops[State->NumOps];
+    memset((void *)Op, '\0', sizeof(*Op));
+    Op->Code = Code;
+    Op->Result = State->NumOps++;
+    Op->Operand[0] = Operand0;
+    Op->Operand[1] = Operand1;
+    Op->Operand[2] = Operand2;
+
+    /* the operators are worked out on constants, the math functions are left to run */
+    if (Code < VectorAdd || Code > VectorSelect)
+        return Op->Result;
+
+    if (Code == VectorSelect && State->Ops[Operand0].Code == VectorConstant)
+    {
+        State->NumOps--;
+        return (State->Ops[Operand0].FP != 0.0) ? Operand1 : Operand2;
+    }
+
+    for (Count = 0; Count < 3; Count++)
+    {
+        if (Op->Operand[Count] != VECTOR_NONE && State->Ops[Op->Operand[Count]].Code != VectorConstant)
+            return Op->Result;
+    }
+
+    return JitVectorFold(State);
+}
+
+static int JitVectorUnary(struct JitState *State, enum VectorCode Code, int Operand)
+{
+    return JitVectorNew(State, Code, Operand, VECTOR_NONE, VECTOR_NONE);
+}
+
+static int JitVectorBinary(struct JitState *State, enum VectorCode Code, int Left, int Right)
+{
+    return JitVectorNew(State, Code, Left, Right, VECTOR_NONE);
+}
+
+/* the register holding a constant, shared by all its uses */
+static int JitVectorConstantOf(struct JitState *State, double Value)
+{
+    int Register;
+
+    for (Register = 0; Register < State->NumOps; Register++)
+    {
+        if (State->Ops[Register].Code == VectorConstant && memcmp((void *)&State->Ops[Register].FP, (void *)&Value, sizeof(double)) == 0)
+            return Register;
+    }
+
+    Register = JitVectorNew(State, VectorConstant, VECTOR_NONE, VECTOR_NONE, VECTOR_NONE);
+    State->Ops[Register].FP = Value;
+    return Register;
+}
+
+static int JitVectorGlobalOf(struct JitState *State, void *Address, enum BaseType Type)
+{
+    int Register;
+
+    if (Address == (void *)State->LastArg)
+        return State->Input;
+
+    Register = JitVectorNew(State, VectorGlobal, VECTOR_NONE, VECTOR_NONE, VECTOR_NONE);
+    State->Ops[Register].Address = Address;
+    State->Ops[Register].Type = Type;
+    return Register;
+}
+
+/* lanes where both masks are set, the path being all of them is common */
+static int JitVectorAnd(struct JitState *State, int Path, int Mask)
+{
+    if (Path == JIT_VECTOR_ONE)
+        return Mask;
+
+    return JitVectorBinary(State, VectorLogicalAnd, Path, Mask);
+}
+
+/* convert a register the way an assignment would. An int is already a double */
+static int JitVectorConvert(struct JitState *State, int Register, enum BaseType From, enum BaseType To)
+{
+    if (From == TypeFP && To == TypeInt)
+        return JitVectorUnary(State, VectorTruncate, Register);
+
+    return Register;
+}
+
+/* an arithmetic or bitwise operator. An int is only divided or shifted by a constant which
+ * can't go wrong, anything else might need the interpreter to give up on the evaluation */
+static int JitVectorArithmetic(struct JitState *State, enum LexToken Op, enum BaseType Type, int Left, int Right, struct JitNode *RightNode)
+{
+    enum VectorCode Code;
+
+    if (Type == TypeFP)
+    {
+        switch (Op)
+        {
+            case TokenPlus:     Code = VectorAdd; break;
+            case TokenMinus:    Code = VectorSubtract; break;
+            case TokenAsterisk: Code = VectorMultiply; break;
+            case TokenSlash:    Code = VectorDivide; break;
+            default:            JitBail(State); return 0;
+        }
+
+        return JitVectorBinary(State, Code, Left, Right);
+    }
+
+    switch (Op)
+    {
+        case TokenPlus:             Code = VectorIntAdd; break;
+        case TokenMinus:            Code = VectorIntSubtract; break;
+        case TokenAsterisk:         Code = VectorIntMultiply; break;
+        case TokenAmpersand:        Code = VectorIntAnd; break;
+        case TokenArithmeticOr:     Code = VectorIntOr; break;
+        case TokenArithmeticExor:   Code = VectorIntExor; break;
+
+        case TokenSlash:
+        case TokenModulus:
+            if (RightNode->Kind != JitNodeConstant || RightNode->Integer == 0)
+                JitBail(State);
+
+            Code = (Op == TokenSlash) ? VectorIntDivide : VectorIntModulus;
+            break;
+
+        case TokenShiftLeft:
+        case TokenShiftRight:
+            if (RightNode->Kind != JitNodeConstant || RightNode->Integer < 0 || RightNode->Integer > 31)
+                JitBail(State);
+
+            Code = (Op == TokenShiftLeft) ? VectorIntShiftLeft : VectorIntShiftRight;
+            break;
+
+        default:
+            JitBail(State);
+            return 0;
+    }
+
+    return JitVectorBinary(State, Code, Left, Right);
+}
+
+/* both operands of an infix operator. A variable on the left is read after the right hand
+ * side is worked out, as in JitOperands() */
+static void JitVectorOperands(struct JitState *State, struct JitNode *Node, int *Left, int *Right)
+{
+    if (JitIsSimple(Node->Operand[0]) && !JitIsSimple(Node->Operand[1]))
+    {
+        *Right = JitVectorEmit(State, Node->Operand[1]);
+        *Left = JitVectorEmit(State, Node->Operand[0]);
+    }
+    else
+    {
+        *Left = JitVectorEmit(State, Node->Operand[0]);
+        *Right = JitVectorEmit(State, Node->Operand[1]);
+    }
+}
+
+/* a comparison. Those the other way round swap their operands so NaNs still make them false */
+static int JitVectorCompare(struct JitState *State, struct JitNode *Node)
+{
+    int Left;
+    int Right;
+
+    JitVectorOperands(State, Node, &Left, &Right);
+    switch (Node->Op)
+    {
+        case TokenEqual:        return JitVectorBinary(State, VectorEqual, Left, Right);
+        case TokenNotEqual:     return JitVectorBinary(State, VectorNotEqual, Left, Right);
+        case TokenLessThan:     return JitVectorBinary(State, VectorLessThan, Left, Right);
+        case TokenGreaterThan:  return JitVectorBinary(State, VectorLessThan, Right, Left);
+        case TokenLessEqual:    return JitVectorBinary(State, VectorLessEqual, Left, Right);
+        default:                return JitVectorBinary(State, VectorLessEqual, Right, Left);
+    }
+}
+
+static int JitVectorPrefix(struct JitState *State, struct JitNode *Node)
+{
+    int Operand = JitVectorEmit(State, Node->Operand[0]);
+
+    switch (Node->Op)
+    {
+        case TokenMinus:
+            if (Node->Type == TypeFP)
+                return JitVectorUnary(State, VectorNegate, Operand);
+
+            return JitVectorBinary(State, VectorIntSubtract, JIT_VECTOR_ZERO, Operand);
+
+        case TokenUnaryNot:     return JitVectorUnary(State, VectorNot, Operand);
+        case TokenUnaryExor:    return JitVectorBinary(State, VectorIntExor, Operand, JitVectorConstantOf(State, -1.0));
+        default:                return Operand;
+    }
+}
+
+/* ++ and --. As in the evaluator a postfix increment of a double gives the new value */
+static int JitVectorIncrement(struct JitState *State, struct JitNode *Node)
+{
+    int Old = State->LocalRegisters[Node->Slot];
+    enum VectorCode Code;
+
+    if (Node->Type == TypeFP)
+        Code = (Node->Op == TokenIncrement) ? VectorAdd : VectorSubtract;
+    else
+        Code = (Node->Op == TokenIncrement) ? VectorIntAdd : VectorIntSubtract;
+
+    State->LocalRegisters[Node->Slot] = JitVectorBinary(State, Code, Old, JIT_VECTOR_ONE);
+    if (Node->IsPostfix && Node->Type == TypeInt)
+        return Old;
+
+    return State->LocalRegisters[Node->Slot];
+}
+
+/* an assignment. Compound assignments work in double if either side is one */
+static int JitVectorAssign(struct JitState *State, struct JitNode *Node)
+{
+    struct JitNode *Value = Node->Operand[0];
+    enum BaseType Type = (Node->Type == TypeFP || Value->Type == TypeFP) ? TypeFP : TypeInt;
+    int Register = JitVectorEmit(State, Value);
+
+    if (Node->Op == TokenAssign)
+        Register = JitVectorConvert(State, Register, Value->Type, Node->Type);
+    else
+    {
+        Register = JitVectorArithmetic(State, JitAssignOperator(Node->Op), Type, State->LocalRegisters[Node->Slot], Register, Value);
+        Register = JitVectorConvert(State, Register, Type, Node->Type);
+    }
+
+    State->LocalRegisters[Node->Slot] = Register;
+    return Register;
+}
+
+static int JitVectorCall(struct JitState *State, struct JitNode *Node)
+{
+    int Args[3] = { VECTOR_NONE, VECTOR_NONE, VECTOR_NONE };
+    enum VectorCode Code;
+    int Register;
+    int Count;
+
+    for (Count = 0; Count < Node->NumOperands; Count++)
+        Args[Count] = JitVectorEmit(State, Node->Operand[Count]);
+
+    if (Node->NumOperands == 1 && Node->Native->Vector1 != NULL)
+        Code = VectorKernel1;
+    else if (Node->NumOperands == 2 && Node->Native->Vector2 != NULL)
+        Code = VectorKernel2;
+    else if (Node->NumOperands == 1)
+        Code = VectorCall1;
+    else if (Node->NumOperands == 2)
+        Code = VectorCall2;
+    else
+        Code = VectorCall3;
+
+    Register = JitVectorNew(State, Code, Args[0], Args[1], Args[2]);
+    State->Ops[Register].Native = Node->Native;
+    return Register;
+}
+
+/* add the operations for an expression, returning the register with its value */
+static int JitVectorEmit(struct JitState *State, struct JitNode *Node)
+{
+    int Condition;
+    int Left;
+    int Right;
+
+    switch (Node->Kind)
+    {
+        case JitNodeConstant:
+            return JitVectorConstantOf(State, (Node->Type == TypeFP) ? Node->FP : (double)Node->Integer);
+
+        case JitNodeLocal:      return State->LocalRegisters[Node->Slot];
+        case JitNodeGlobal:     return JitVectorGlobalOf(State, Node->Address, Node->Type);
+        case JitNodePrefix:     return JitVectorPrefix(State, Node);
+        case JitNodeIncrement:  return JitVectorIncrement(State, Node);
+        case JitNodeAssign:     return JitVectorAssign(State, Node);
+        case JitNodeCall:       return JitVectorCall(State, Node);
+
+        case JitNodeInfix:
+            if (JitIsComparison(Node->Op))
+                return JitVectorCompare(State, Node);
+
+            JitVectorOperands(State, Node, &Left, &Right);
+            return JitVectorArithmetic(State, Node->Op, Node->Type, Left, Right, Node->Operand[1]);
+
+        case JitNodeLogical:
+            /* the right hand side has no side effects, working it out when it isn't needed is harmless */
+            Left = JitVectorEmit(State, Node->Operand[0]);
+            Right = JitVectorEmit(State, Node->Operand[1]);
+            return JitVectorBinary(State, (Node->Op == TokenLogicalAnd) ? VectorLogicalAnd : VectorLogicalOr, Left, Right);
+
+        case JitNodeTernary:
+            Condition = JitVectorEmit(State, Node->Operand[0]);
+            if (Node->Operand[0]->Type == TypeFP)
+                Condition = JitVectorUnary(State, VectorTestLong, Condition);
+
+            Left = JitVectorEmit(State, Node->Operand[1]);
+            Right = JitVectorEmit(State, Node->Operand[2]);
+            return JitVectorNew(State, VectorSelect, Condition, Left, Right);
+
+        case JitNodeConvert:
+            return JitVectorConvert(State, JitVectorEmit(State, Node->Operand[0]), Node->Operand[0]->Type, Node->Type);
+    }
+
+    JitBail(State);
+    return 0;
+}
+
+/* a local variable declaration. Locals start at zero, as they do in a fresh frame */
+static void JitVectorDeclaration(struct JitState *State)
+{
+    enum BaseType Type = JitParseType(State);
+    struct JitNode *Init;
+    int Slot;
+
+    while (TRUE)
+    {
+        if (JitPeek(State) != TokenIdentifier)
+            JitBail(State);
+
+        JitAddLocal(State, JitIdentifier(State, State->Pos), Type);
+        State->Pos++;
+        Slot = State->NumSlots-1;
+        State->LocalRegisters[Slot] = JIT_VECTOR_ZERO;
+
+        if (JitPeek(State) == TokenAssign)
+        {
+            State->Pos++;
+            Init = JitExpression(State, 2);
+            State->LocalRegisters[Slot] = JitVectorConvert(State, JitVectorEmit(State, Init), Init->Type, Type);
+        }
+
+        if (JitPeek(State) != TokenComma)
+            break;
+
+        State->Pos++;
+    }
+}
+
+static void JitVectorBlock(struct JitState *State)
+{
+    JitExpect(State, TokenLeftBrace);
+    State->Depth++;
+    while (JitPeek(State) != TokenRightBrace)
+        JitVectorStatement(State);
+
+    State->Pos++;
+    JitEndScope(State);
+}
+
+/* both sides of an if are compiled for every lane, then the locals they changed are merged */
+static void JitVectorIf(struct JitState *State)
+{
+    int NumSlots = State->NumSlots;
+    int OuterPath = State->Path;
+    int HasReturned = State->HasReturned;
+    struct JitNode *Node;
+    int *Saved;
+    int *Then;
+    int ThenReturned;
+    int Condition;
+    int Slot;
+
+    if (State->IfDepth >= JIT_VECTOR_IF_DEPTH_MAX)
+        JitBail(State);
+
+    Saved = &State->SavedRegisters[State->IfDepth * 2 * State->MaxLocals];
+    Then = Saved + State->MaxLocals;
+    State->IfDepth++;
+
+    /* a condition is converted to an int, as in ExpressionParseInt() */
+    JitExpect(State, TokenOpenBracket);
+    Node = JitExpression(State, 2);
+    JitExpect(State, TokenCloseBracket);
+    Condition = JitVectorEmit(State, Node);
+    if (Node->Type == TypeFP)
+        Condition = JitVectorUnary(State, VectorTest, Condition);
+
+    memcpy((void *)Saved, (void *)State->LocalRegisters, sizeof(int) * NumSlots);
+    State->Path = JitVectorAnd(State, OuterPath, Condition);
+    JitVectorStatement(State);
+
+    ThenReturned = State->HasReturned;
+    memcpy((void *)Then, (void *)State->LocalRegisters, sizeof(int) * NumSlots);
+    memcpy((void *)State->LocalRegisters, (void *)Saved, sizeof(int) * NumSlots);
+    State->HasReturned = HasReturned;
+
+    if (JitPeek(State) == TokenElse)
+    {
+        State->Pos++;
+        State->Path = JitVectorAnd(State, OuterPath, JitVectorUnary(State, VectorNot, Condition));
+        JitVectorStatement(State);
+    }
+
+    /* locals declared inside either side have gone out of scope */
+    for (Slot = 0; Slot < NumSlots; Slot++)
+    {
+        if (Then[Slot] != State->LocalRegisters[Slot])
+            State->LocalRegisters[Slot] = JitVectorNew(State, VectorSelect, Condition, Then[Slot], State->LocalRegisters[Slot]);
+    }
+
+    State->HasReturned = HasReturned || (ThenReturned && State->HasReturned);
+    State->Path = OuterPath;
+    State->IfDepth--;
+}
+
+/* a return sets the result for the lanes on the path which haven't already returned */
+static void JitVectorReturn(struct JitState *State)
+{
+    struct JitNode *Node;
+    int Value;
+    int Live;
+
+    if (JitPeek(State) == TokenSemicolon)
+        JitBail(State);
+
+    Node = JitExpression(State, 2);
+    JitExpect(State, TokenSemicolon);
+    if (State->HasReturned)
+        return;
+
+    Value = JitVectorEmit(State, Node);
+    if (State->Path == JIT_VECTOR_ONE && State->Done == JIT_VECTOR_ZERO)
+        State->Result = Value;
+    else
+    {
+        Live = State->Path;
+        if (State->Done != JIT_VECTOR_ZERO)
+            Live = JitVectorAnd(State, Live, JitVectorUnary(State, VectorNot, State->Done));
+
+        State->Result = JitVectorNew(State, VectorSelect, Live, Value, State->Result);
+    }
+
+    if (State->Path == JIT_VECTOR_ONE)
+        State->Done = JIT_VECTOR_ONE;
+    else if (State->Done == JIT_VECTOR_ZERO)
+        State->Done = State->Path;
+    else
+        State->Done = JitVectorBinary(State, VectorLogicalOr, State->Done, State->Path);
+
+    State->HasReturned = TRUE;
+}
+
+static void JitVectorStatement(struct JitState *State)
+{
+    switch (JitPeek(State))
+    {
+        case TokenLeftBrace:
+            JitVectorBlock(State);
+            return;
+
+        case TokenSemicolon:
+            State->Pos++;
+            return;
+
+        case TokenIf:
+            State->Pos++;
+            JitVectorIf(State);
+            return;
+
+        case TokenReturn:
+            State->Pos++;
+            JitVectorReturn(State);
+            return;
+
+        case TokenIdentifier:
+            /* a goto label */
+            if (JitPeekAhead(State, 1) == TokenColon)
+                JitBail(State);
+            break;
+
+        case TokenIncrement:
+        case TokenDecrement:
+        case TokenOpenBracket:
+            break;
+
+        default:
+            /* loops would have the lanes going their own ways, they're left to the scalar code */
+            if (!JitIsType(JitPeek(State)))
+                JitBail(State);
+
+            JitVectorDeclaration(State);
+            JitExpect(State, TokenSemicolon);
+            return;
+    }
+
+    JitVectorEmit(State, JitExpression(State, 2));
+    JitExpect(State, TokenSemicolon);
+}
+
+/* compile main's body to a vector program. The last argument is different in each lane, the
+ * others are read from where they're kept */
+static void JitVectorFunction(struct JitState *State, struct FuncDef *Func, double **Args)
+{
+    int Count;
+
+    JitVectorConstantOf(State, 0.0);
+    JitVectorConstantOf(State, 1.0);
+    State->LastArg = Args[Func->NumParams-1];
+    State->FirstArg = (Func->NumParams == 2) ? Args[0] : NULL;
+    State->Input = JitVectorNew(State, VectorInput, VECTOR_NONE, VECTOR_NONE, VECTOR_NONE);
+
+    for (Count = 0; Count < Func->NumParams; Count++)
+    {
+        JitAddLocal(State, Func->ParamName[Count], TypeFP);
+        State->LocalRegisters[Count] = JitVectorGlobalOf(State, (void *)Args[Count], TypeFP);
+    }
+
+    State->Path = JIT_VECTOR_ONE;
+    State->Done = JIT_VECTOR_ZERO;
+    State->Result = JIT_VECTOR_ZERO;
+    JitVectorBlock(State);
+    JitExpect(State, TokenEndOfFunction);
+
+    /* falling off the end leaves the result to the interpreter */
+    if (!State->HasReturned)
+        JitBail(State);
+}
+
+/* keep the operations the result depends on. Constants are put in their registers now, the
+ * rest are run for each block */
+static struct VectorProgram *JitVectorInstall(Picoc *pc, struct JitState *State)
+{
+    struct VectorProgram *Vector;
+    struct VectorOp *Op;
+    char *Live;
+    int Count;
+    int Operand;
+    int Lane;
+
+    Live = (char *)HeapAllocMem(pc, State->NumOps);
+    Vector = (struct VectorProgram *)HeapAllocMem(pc, sizeof(struct VectorProgram));
+    if (Live == NULL || Vector == NULL)
+    {
+        HeapFreeMem(pc, (void *)Live);
+        HeapFreeMem(pc, (void *)Vector);
+        return NULL;
+    }
+
+    Vector->Ops = (struct VectorOp *)HeapAllocMem(pc, sizeof(struct VectorOp) * State->NumOps);
+    Vector->Registers = (double (*)[VECTOR_LANES])HeapAllocMem(pc, sizeof(double) * VECTOR_LANES * State->NumOps);
+    Vector->NumOps = 0;
+    Vector->NumRegisters = State->NumOps;
+    Vector->Input = State->Input;
+    Vector->Result = State->Result;
+    Vector->First = (void *)State->FirstArg;
+
+    if (Vector->Ops != NULL && Vector->Registers != NULL)
+    {
+        Live[State->Result] = TRUE;
+        for (Count = State->NumOps-1; Count >= 0; Count--)
+        {
+            for (Operand = 0; Operand < 3 && Live[Count]; Operand++)
+            {
+                if (State->Ops[Count].Operand[Operand] != VECTOR_NONE)
+                    Live[State->Ops[Count].Operand[Operand]] = TRUE;
+            }
+        }
+
+        for (Count = 0; Count < State->NumOps; Count++)
+        {
+            Op = &State->Ops[Count];
+            if (!Live[Count] || Op->Code == VectorInput)
+                continue;
+
+            if (Op->Code == VectorConstant)
+            {
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Vector->Registers[Count][Lane] = Op->FP;
+            }
+            else
+                Vector->Ops[Vector->NumOps++] = *Op;
+        }
+    }
+    else
+    {
+        VectorFree(pc, Vector);
+        Vector = NULL;
+    }
+
+    HeapFreeMem(pc, (void *)Live);
+    return Vector;
+}
+
+/* copy the code into memory it can run from, reusing the last compile's if it's big enough */
+static int JitInstall(Picoc *pc, unsigned char *Code, int CodeSize)
+{
+#ifdef _WIN32
+    DWORD OldProtect;
+
+    if (pc->JitCode != NULL && pc->JitCodeSize < CodeSize)
+    {
+        VirtualFree(pc->JitCode, 0, MEM_RELEASE);
+        pc->JitCode = NULL;
+    }
+
+    if (pc->JitCode == NULL)
+    {
+        pc->JitCode = VirtualAlloc(NULL, CodeSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (pc->JitCode == NULL)
+            return FALSE;
+
+        pc->JitCodeSize = CodeSize;
+    }
+    else if (!VirtualProtect(pc->JitCode, pc->JitCodeSize, PAGE_READWRITE, &OldProtect))
+        return FALSE;
+
+    memcpy(pc->JitCode, (void *)Code, CodeSize);
+    if (!VirtualProtect(pc->JitCode, pc->JitCodeSize, PAGE_EXECUTE_READ, &OldProtect))
+        return FALSE;
+
+    FlushInstructionCache(GetCurrentProcess(), pc->JitCode, CodeSize);
+#else
+    if (pc->JitCode != NULL && pc->JitCodeSize < CodeSize)
+    {
+        munmap(pc->JitCode, pc->JitCodeSize);
+        pc->JitCode = NULL;
+    }
+
+    if (pc->JitCode == NULL)
+    {
+        pc->JitCode = mmap(NULL, CodeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (pc->JitCode == MAP_FAILED)
+        {
+            pc->JitCode = NULL;
+            return FALSE;
+        }
+
+        pc->JitCodeSize = CodeSize;
+    }
+    else if (mprotect(pc->JitCode, pc->JitCodeSize, PROT_READ | PROT_WRITE) != 0)
+        return FALSE;
+
+    memcpy(pc->JitCode, (void *)Code, CodeSize);
+    if (mprotect(pc->JitCode, pc->JitCodeSize, PROT_READ | PROT_EXEC) != 0)
+        return FALSE;
+#endif
+
+    return TRUE;
+}
+
+/* nothing has been compiled yet */
+void JitInit(Picoc *pc)
+{
+    pc->JitMain = NULL;
+    pc->JitCode = NULL;
+    pc->JitCodeSize = 0;
+    pc->JitVector = NULL;
+    pc->JitBatchVector = NULL;
+}
+
+/* get ready to compile a body. Returns FALSE if there's no memory for it */
+static int JitStart(Picoc *pc, struct JitState *State, struct FuncDef *Func)
+{
+    memset((void *)State, '\0', sizeof(*State));
+    State->pc = pc;
+    State->NumTokens = JitScanTokens(Func->Body.Pos, NULL);
+    if (State->NumTokens == 0)
+        return FALSE;
+
+    State->MaxNodes = State->NumTokens * 4 + 64;
+    State->MaxLocals = State->NumTokens + Func->NumParams;
+    State->MaxConstants = State->NumTokens * 2 + 2;
+    State->MaxOps = State->NumTokens * 4 + 64;
+    State->Tokens = (struct JitToken *)HeapAllocMem(pc, sizeof(struct JitToken) * State->NumTokens);
+    State->Nodes = (struct JitNode *)HeapAllocMem(pc, sizeof(struct JitNode) * State->MaxNodes);
+    State->Locals = (struct JitLocal *)HeapAllocMem(pc, sizeof(struct JitLocal) * State->MaxLocals);
+    State->Constants = (double *)HeapAllocMem(pc, sizeof(double) * State->MaxConstants);
+    State->ConstantUses = (int *)HeapAllocMem(pc, sizeof(int) * State->MaxConstants);
+    State->Code = (unsigned char *)HeapAllocMem(pc, JIT_CODE_MAX);
+    State->Ops = (struct VectorOp *)HeapAllocMem(pc, sizeof(struct VectorOp) * State->MaxOps);
+    State->LocalRegisters = (int *)HeapAllocMem(pc, sizeof(int) * State->MaxLocals);
+    State->SavedRegisters = (int *)HeapAllocMem(pc, sizeof(int) * State->MaxLocals * 2 * JIT_VECTOR_IF_DEPTH_MAX);
+    State->Bails = JIT_NO_JUMPS;
+    State->Returns = JIT_NO_JUMPS;
+
+    if (State->Tokens == NULL || State->Nodes == NULL || State->Locals == NULL || State->Constants == NULL ||
+            State->ConstantUses == NULL || State->Code == NULL || State->Ops == NULL ||
+            State->LocalRegisters == NULL || State->SavedRegisters == NULL)
+        return FALSE;
+
+    JitScanTokens(Func->Body.Pos, State->Tokens);
+    return TRUE;
+}
+
+static void JitFinish(Picoc *pc, struct JitState *State)
+{
+    int Count;
+
+    /* a bail from inside a macro leaves its tokens behind */
+    for (Count = 0; Count < JIT_MACRO_DEPTH_MAX; Count++)
+    {
+        if (State->MacroTokens[Count] != NULL)
+            HeapFreeMem(pc, (void *)State->MacroTokens[Count]);
+    }
+
+    HeapFreeMem(pc, (void *)State->Tokens);
+    HeapFreeMem(pc, (void *)State->Nodes);
+    HeapFreeMem(pc, (void *)State->Locals);
+    HeapFreeMem(pc, (void *)State->Constants);
+    HeapFreeMem(pc, (void *)State->ConstantUses);
+    HeapFreeMem(pc, (void *)State->Code);
+    HeapFreeMem(pc, (void *)State->Ops);
+    HeapFreeMem(pc, (void *)State->LocalRegisters);
+    HeapFreeMem(pc, (void *)State->SavedRegisters);
+}
+
+/* main, if it's a function of one or two doubles, and where its arguments are. The arguments
+ * are read from where the platform variables keep them */
+static struct FuncDef *JitFindMain(Picoc *pc, double **Args)
+{
+    struct Value *MainValue;
+    struct Value *ArgValue;
+    struct FuncDef *Func;
+    int Count;
+
+    if (!TableGet(pc, &pc->GlobalTable, TableStrRegister(pc, "main"), &MainValue, NULL, NULL, NULL) || MainValue->Typ != &pc->FunctionType)
+        return NULL;
+
+    Func = MainValue->Val->FuncDef;
+    if (Func->Body.Pos == NULL || Func->VarArgs || Func->NumParams < 1 || Func->NumParams > 2)
+        return NULL;
+
+    for (Count = 0; Count < Func->NumParams; Count++)
+    {
+        if (Func->ParamType[Count] != &pc->FPType ||
+                !TableGet(pc, &pc->GlobalTable, TableStrRegister(pc, (Func->NumParams == 1) ? "__arg" : (Count == 0) ? "__arg1" : "__arg2"), &ArgValue, NULL, NULL, NULL) ||
+                ArgValue->Typ != &pc->FPType)
+            return NULL;
+
+        Args[Count] = &ArgValue->Val->FP;
+    }
+
+    return Func;
+}
+
+/* compile main if we can, to machine code and if it has no loops to a vector program too.
+ * Called whenever main's body changes */
+void JitCompileMain(Picoc *pc)
+{
+    struct JitState State;
+    struct FuncDef *Func;
+    double *Args[2];
+
+    pc->JitMain = NULL;
+    VectorFree(pc, pc->JitVector);
+    pc->JitVector = NULL;
+    Func = JitFindMain(pc, Args);
+    if (Func == NULL)
+        return;
+
+    if (JitStart(pc, &State, Func) && setjmp(State.Bail) == 0)
+    {
+        JitFunction(&State, Func, Args);
+        if (JitInstall(pc, State.Code, State.CodeSize))
+            pc->JitMain = (int (*)(double *))pc->JitCode;
+    }
+    JitFinish(pc, &State);
+
+    /* evaluating lanes side by side is only the same as one at a time if nothing carries over */
+    if (Func->Purity != PurityPure)
+        return;
+
+    if (JitStart(pc, &State, Func) && setjmp(State.Bail) == 0)
+    {
+        JitVectorFunction(&State, Func, Args);
+        pc->JitVector = JitVectorInstall(pc, &State);
+    }
+    JitFinish(pc, &State);
+}
+
+/* compile main's batch body to a vector program which can also give its derivatives and
+ * work on intervals, if every function it calls supports that. Rows don't get their own,
+ * a row's body has the first argument folded into it so it can't vary. Called once the
+ * program has been optimised for the batch */
+void JitCompileBatch(Picoc *pc)
+{
+    struct JitState State;
+    struct VectorProgram *Vector;
+    struct FuncDef *Func;
+    double *Args[2];
+    int Differentiable;
+    int Boundable;
+
+    VectorFree(pc, pc->JitBatchVector);
+    pc->JitBatchVector = NULL;
+    Func = JitFindMain(pc, Args);
+    if (Func == NULL || Func->Purity != PurityPure)
+        return;
+
+    if (JitStart(pc, &State, Func) && setjmp(State.Bail) == 0)
+    {
+        JitVectorFunction(&State, Func, Args);
+        pc->JitBatchVector = JitVectorInstall(pc, &State);
+    }
+    JitFinish(pc, &State);
+
+    Vector = pc->JitBatchVector;
+    if (Vector == NULL)
+        return;
+
+    Differentiable = GradientPrepare(pc, Vector);
+    Boundable = IntervalPrepare(pc, Vector);
+    if (!Differentiable && !Boundable)
+    {
+        VectorFree(pc, Vector);
+        pc->JitBatchVector = NULL;
+    }
+}
+
+void JitCleanup(Picoc *pc)
+{
+    if (pc->JitCode != NULL)
+    {
+#ifdef _WIN32
+        VirtualFree(pc->JitCode, 0, MEM_RELEASE);
+#else
+        munmap(pc->JitCode, pc->JitCodeSize);
+#endif
+    }
+
+    VectorFree(pc, pc->JitVector);
+    VectorFree(pc, pc->JitBatchVector);
+    JitInit(pc);
+}
+
+#else
+
+/* there's no code generator for this machine, main is always interpreted */
+void JitInit(Picoc *pc)
+{
+    pc->JitMain = NULL;
+    pc->JitCode = NULL;
+    pc->JitCodeSize = 0;
+    pc->JitVector = NULL;
+    pc->JitBatchVector = NULL;
+}
+
+void JitCompileMain(Picoc *pc)
+{
+}
+
+void JitCompileBatch(Picoc *pc)
+{
+}
+
+void JitCleanup(Picoc *pc)
+{
+}
+
+#endif
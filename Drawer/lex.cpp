@@ -122,7 +122,7 @@ enum LexToken LexCheckReservedWord(Picoc *pc, const char *Word)
 {
     struct Value *val;
     
-    if (TableGet(&pc->ReservedWordTable, Word, &val, NULL, NULL, NULL))
+    if (TableGet(pc, &pc->ReservedWordTable, Word, &val, NULL, NULL, NULL))
         return ((struct ReservedWord *)val)->Token;
     else
         return TokenNone;
@@ -524,6 +524,66 @@ int LexTokenSize(enum LexToken Token)
     }
 }
 
+/* the first token at or after Pos in a body's tokens which isn't a line break */
+static const unsigned char *LexSkipLineBreaks(const unsigned char *Pos)
+{
+    while ((enum LexToken)*Pos == TokenEndOfLine)
+        Pos += TOKEN_DATA_OFFSET;
+
+    return Pos;
+}
+
+/* is the identifier at Pos in a body's tokens assigned to, incremented or decremented, as a
+ * whole, through an index or member, or in brackets like (g) = 1? Brackets is how many open
+ * brackets come right before it and Before the token ahead of those. Used to find what a
+ * script writes without running it, so it may take some reads for writes but never the
+ * other way round */
+int LexIsWrittenTo(enum LexToken Before, int Brackets, const unsigned char *Pos)
+{
+    enum LexToken Token;
+    int Nesting;
+
+    if (Before == TokenIncrement || Before == TokenDecrement)
+        return TRUE;
+
+    /* the first bracket of a call, a condition or sizeof isn't around the variable */
+    if (Brackets > 0 && (Before == TokenIdentifier || Before == TokenIf || Before == TokenWhile || Before == TokenFor || Before == TokenSwitch || Before == TokenSizeof))
+        Brackets--;
+
+    Pos += TOKEN_DATA_OFFSET + LexTokenSize(TokenIdentifier);
+    while (TRUE)
+    {
+        Pos = LexSkipLineBreaks(Pos);
+        Token = (enum LexToken)*Pos;
+        if (Token == TokenDot || Token == TokenArrow)
+        {
+            /* the member's name */
+            Pos = LexSkipLineBreaks(Pos + TOKEN_DATA_OFFSET);
+            Pos += TOKEN_DATA_OFFSET + LexTokenSize((enum LexToken)*Pos);
+        }
+        else if (Token == TokenLeftSquareBracket)
+        {
+            for (Nesting = 0; Token != TokenEndOfFunction && Token != TokenEOF; Token = (enum LexToken)*Pos)
+            {
+                Pos += TOKEN_DATA_OFFSET + LexTokenSize(Token);
+                if (Token == TokenLeftSquareBracket)
+                    Nesting++;
+                else if (Token == TokenRightSquareBracket && --Nesting == 0)
+                    break;
+            }
+        }
+        else if (Token == TokenCloseBracket && Brackets > 0)
+        {
+            Pos += TOKEN_DATA_OFFSET;
+            Brackets--;
+        }
+        else
+            break;
+    }
+
+    return (Token >= TokenAssign && Token <= TokenArithmeticExorAssign) || Token == TokenIncrement || Token == TokenDecrement;
+}
+
 /* produce tokens from the lexer and return a heap buffer with the result - used for scanning */
 void *LexTokenise(Picoc *pc, struct LexState *Lexer, int *TokenLen)
 {
@@ -784,7 +844,7 @@ void LexHashIfdef(struct ParseState *Parser, int IfNot)
         ProgramFail(Parser, "identifier expected");
     
     /* is the identifier defined? */
-    IsDefined = TableGet(&Parser->pc->GlobalTable, IdentValue->Val->Identifier, &SavedValue, NULL, NULL, NULL);
+    IsDefined = TableGet(Parser->pc, &Parser->pc->GlobalTable, IdentValue->Val->Identifier, &SavedValue, NULL, NULL, NULL);
     if (Parser->HashIfEvaluateToLevel == Parser->HashIfLevel && ( (IsDefined && !IfNot) || (!IsDefined && IfNot)) )
     {
         /* #if is active, evaluate to this new level */
@@ -806,13 +866,13 @@ void LexHashIf(struct ParseState *Parser)
     if (Token == TokenIdentifier)
     {
         /* look up a value from a macro definition */
-        if (!TableGet(&Parser->pc->GlobalTable, IdentValue->Val->Identifier, &SavedValue, NULL, NULL, NULL))
+        if (!TableGet(Parser->pc, &Parser->pc->GlobalTable, IdentValue->Val->Identifier, &SavedValue, NULL, NULL, NULL))
             ProgramFail(Parser, "'" + std::string(IdentValue->Val->Identifier) + "' is undefined");
         
         if (SavedValue->Typ->Base != TypeMacro)
             ProgramFail(Parser, "value expected");
         
-        ParserCopy(&MacroParser, &SavedValue->Val->MacroDef.Body);
+        ParserCopy(&MacroParser, &SavedValue->Val->MacroDef->Body);
         Token = LexGetRawToken(&MacroParser, &IdentValue, TRUE);
     }
     
@@ -922,6 +982,8 @@ enum LexToken LexGetToken(struct ParseState *Parser, struct Value **Value, int I
             
     } while (TryNextToken);
     
+    if (IncPos)
+        STATS_ADD(Parser->pc, Tokens, 1);
     return Token;
 }
 
@@ -0,0 +1,361 @@
+/* picoc native compilation - builds the program with the system's C compiler as a shared
+ * object and calls its main() directly instead of interpreting it.
+ *
+ * The interpreter has already parsed the program by the time it's compiled, so it's the
+ * validator, and it's still used when there's no compiler or the program doesn't compile.
+ * Built objects are kept in a cache directory under a hash of their source, so going back
+ * to a program or just moving a tweakable doesn't run the compiler again. So are the
+ * programs which didn't compile, which are left to the interpreter until the compiler changes.
+ * The cache keeps the NATIVE_CACHE_MAX most recently used of them */
+
+#include "picoc.h"
+#include "interpreter.h"
+
+/* set from the UI to build programs with the system's compiler */
+bool gNativeCompile = false;
+
+#ifdef FEATURE_NATIVE_COMPILE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <dirent.h>
+#include <utime.h>
+#include <algorithm>
+
+#define NATIVE_PATH_MAX 1024
+#define NATIVE_MAIN_NAME "picoc_native_main"
+#define NATIVE_CACHE_NAME "cplot"           /* the directory of built objects in the user's cache */
+#define NATIVE_CACHE_MAX 64                 /* most built objects and failures kept there */
+
+/* what the interpreter provides without any #include */
+static const char NativePrelude[] =
+    "#define _DEFAULT_SOURCE\n"
+    "#include <math.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "#define TRUE 1\n"
+    "#define FALSE 0\n"
+    "#define main " NATIVE_MAIN_NAME "\n"
+    "static double sgn(double v) { return (0.0 < v) - (v < 0.0); }\n"
+    "static double min(double a, double b) { return a < b ? a : b; }\n"
+    "static double max(double a, double b) { return a > b ? a : b; }\n"
+    "static double clamp(double s, double low, double high) { return s < low ? low : (s > high ? high : s); }\n"
+    "static double lerp(double i, double a, double b) { return (1.0-i) * a + i * b; }\n";
+
+/* snprintf which fails instead of cutting the text short, a path cut short could be anywhere */
+static int NativeFormat(char *Buffer, int Size, const char *Format, ...)
+{
+    va_list Args;
+    int Length;
+
+    va_start(Args, Format);
+    Length = vsnprintf(Buffer, Size, Format, Args);
+    va_end(Args);
+
+    return Length >= 0 && Length < Size;
+}
+
+/* 64 bit FNV-1a, to name the built objects */
+static uint64_t NativeHash(const std::string &Text)
+{
+    uint64_t Hash = 0xcbf29ce484222325ULL;
+    size_t Count;
+
+    for (Count = 0; Count < Text.size(); Count++)
+    {
+        Hash ^= (unsigned char)Text[Count];
+        Hash *= 0x100000001b3ULL;
+    }
+
+    return Hash;
+}
+
+/* remove all but the NATIVE_CACHE_MAX - 1 most recently used files from the cache, leaving room
+ * for the one about to be built. Each is touched when it's used, so their modification times say
+ * which those are */
+static void NativeCachePrune(const char *Dir)
+{
+    std::vector<std::pair<time_t, std::string> > Entries;
+    char Path[NATIVE_PATH_MAX];
+    struct dirent *Entry;
+    struct stat Info;
+    DIR *Listing;
+    size_t Count;
+
+    Listing = opendir(Dir);
+    if (Listing == NULL)
+        return;
+
+    while ((Entry = readdir(Listing)) != NULL)
+    {
+        if (NativeFormat(Path, sizeof(Path), "%s/%s", Dir, Entry->d_name) && stat(Path, &Info) == 0 && S_ISREG(Info.st_mode))
+            Entries.push_back(std::make_pair(Info.st_mtime, std::string(Path)));
+    }
+    closedir(Listing);
+
+    if (Entries.size() < NATIVE_CACHE_MAX)
+        return;
+
+    std::sort(Entries.begin(), Entries.end());
+    for (Count = 0; Count <= Entries.size() - NATIVE_CACHE_MAX; Count++)
+        remove(Entries[Count].second.c_str());
+}
+
+/* find or make the cache directory, and prune it. Returns FALSE if there's nowhere to put built objects */
+static int NativeCacheDir(char *Dir, int Size)
+{
+    const char *Base = getenv("XDG_CACHE_HOME");
+    struct stat Info;
+
+    if (Base != NULL && Base[0] != '\0')
+    {
+        if (!NativeFormat(Dir, Size, "%s", Base))
+            return FALSE;
+    }
+    else if ((Base = getenv("HOME")) != NULL && Base[0] != '\0')
+    {
+        if (!NativeFormat(Dir, Size, "%s/.cache", Base))
+            return FALSE;
+    }
+    else
+        NativeFormat(Dir, Size, "/tmp");
+
+    mkdir(Dir, 0700);
+    if (!NativeFormat(Dir + strlen(Dir), Size - strlen(Dir), "/%s", NATIVE_CACHE_NAME))
+        return FALSE;
+
+    mkdir(Dir, 0700);
+    if (stat(Dir, &Info) != 0 || !S_ISDIR(Info.st_mode))
+        return FALSE;
+
+    NativeCachePrune(Dir);
+    return TRUE;
+}
+
+/* what identifies the compiler: the file the command's first word resolves to through PATH and
+ * symbolic links, and when that was changed, so upgrading it builds everything again and gives
+ * programs which failed another try. Just the command if it can't be found */
+static std::string NativeCompilerIdentity(const char *Compiler)
+{
+    std::string Identity = Compiler;
+    std::string Program = Identity.substr(0, Identity.find(' '));
+    std::string Path = Program;
+    const char *Search = getenv("PATH");
+    char *Resolved;
+    char Time[64];
+    struct stat Info;
+    size_t Start;
+    size_t End;
+
+    /* a bare name is the first executable of that name along PATH */
+    if (Program.find('/') == std::string::npos && Search != NULL)
+    {
+        for (Start = 0; Start <= strlen(Search); Start = End + 1)
+        {
+            End = strcspn(Search + Start, ":") + Start;
+            Path = (End > Start ? std::string(Search + Start, End - Start) : std::string(".")) + "/" + Program;
+            if (access(Path.c_str(), X_OK) == 0)
+                break;
+        }
+    }
+
+    Resolved = realpath(Path.c_str(), NULL);
+    if (Resolved == NULL)
+        return Identity;
+
+    if (stat(Resolved, &Info) == 0)
+    {
+        NativeFormat(Time, sizeof(Time), "%lld", (long long)Info.st_mtime);
+        Identity = Identity + '\0' + Resolved + '\0' + Time;
+    }
+
+    free(Resolved);
+    return Identity;
+}
+
+/* the source file given to the compiler. Tweakables are declared extern ahead of the program
+ * and defined after it, so they're symbols of the built object which are set for each batch */
+static std::string NativeSource(const std::string &SourceCode, std::vector<Tweakable> &Tweakables)
+{
+    std::string Source = NativePrelude;
+    size_t Count;
+
+    for (Count = 0; Count < Tweakables.size(); Count++)
+        Source += "extern double " + Tweakables[Count].name + ";\n";
+
+    Source += "#line 1 \"main.c\"\n";
+    Source += SourceCode;
+    Source += "\n";
+
+    for (Count = 0; Count < Tweakables.size(); Count++)
+        Source += "double " + Tweakables[Count].name + ";\n";
+
+    return Source;
+}
+
+/* run the compiler. The object is built under a temporary name and renamed into place so
+ * another evaluation never loads one which is half written. If the compiler fails, an empty
+ * file at FailedPath says so */
+static int NativeBuild(const char *Compiler, const std::string &Source, const char *SourcePath, const char *LibraryPath, const char *FailedPath)
+{
+    char TempPath[NATIVE_PATH_MAX];
+    char Command[NATIVE_PATH_MAX*3];
+    FILE *SourceFile;
+    int Written;
+    int Result;
+
+    if (!NativeFormat(TempPath, sizeof(TempPath), "%s.%d", LibraryPath, (int)getpid()) ||
+            !NativeFormat(Command, sizeof(Command), "%s -O2 -shared -fPIC -o '%s' '%s' -lm >/dev/null 2>&1", Compiler, TempPath, SourcePath))
+        return FALSE;
+
+    SourceFile = fopen(SourcePath, "w");
+    if (SourceFile == NULL)
+        return FALSE;
+
+    Written = (fwrite(Source.c_str(), 1, Source.size(), SourceFile) == Source.size());
+    if (fclose(SourceFile) != 0 || !Written)
+    {
+        remove(SourcePath);
+        return FALSE;
+    }
+
+    Result = system(Command);
+    remove(SourcePath);
+
+    if (Result != 0)
+    {
+        SourceFile = fopen(FailedPath, "w");
+        if (SourceFile != NULL)
+            fclose(SourceFile);
+    }
+
+    if (Result != 0 || rename(TempPath, LibraryPath) != 0)
+    {
+        remove(TempPath);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* nothing has been built yet */
+void NativeInit(Picoc *pc)
+{
+    pc->NativeLibrary = NULL;
+    pc->NativeMain1 = NULL;
+    pc->NativeMain2 = NULL;
+    pc->NativeArg = NULL;
+}
+
+/* build the program if native compilation is on, and load it. Any failure leaves it to the interpreter */
+void NativeCompileProgram(Picoc *pc, double *Arg, int ParamCount, const std::string &SourceCode, std::vector<Tweakable> &Tweakables)
+{
+    const char *Compiler = getenv("CC");
+    char Dir[NATIVE_PATH_MAX];
+    char SourcePath[NATIVE_PATH_MAX];
+    char LibraryPath[NATIVE_PATH_MAX];
+    char FailedPath[NATIVE_PATH_MAX];
+    std::string Source;
+    unsigned long long Hash;
+    struct Value *MainValue;
+    struct stat Info;
+    void *Main;
+    double *Value;
+    size_t Count;
+
+    if (!gNativeCompile || !TableGet(pc, &pc->GlobalTable, TableStrRegister(pc, "main"), &MainValue, NULL, NULL, NULL))
+        return;
+
+    /* it's called with doubles, which the interpreter doesn't insist on */
+    for (Count = 0; Count < (size_t)ParamCount; Count++)
+    {
+        if (MainValue->Val->FuncDef->ParamType[Count] != &pc->FPType)
+            return;
+    }
+
+    if (!NativeCacheDir(Dir, sizeof(Dir)))
+        return;
+
+    if (Compiler == NULL || Compiler[0] == '\0')
+        Compiler = "cc";
+
+    /* the compiler is part of the key, changing it builds everything again */
+    Source = NativeSource(SourceCode, Tweakables);
+    Hash = (unsigned long long)NativeHash(Source + '\0' + NativeCompilerIdentity(Compiler));
+    if (!NativeFormat(SourcePath, sizeof(SourcePath), "%s/%016llx.c", Dir, Hash) ||
+            !NativeFormat(LibraryPath, sizeof(LibraryPath), "%s/%016llx.so", Dir, Hash) ||
+            !NativeFormat(FailedPath, sizeof(FailedPath), "%s/%016llx.failed", Dir, Hash))
+        return;
+
+    /* it didn't compile last time, and the source and compiler are the same. Touching it
+     * keeps it from being pruned */
+    if (stat(FailedPath, &Info) == 0)
+    {
+        utime(FailedPath, NULL);
+        return;
+    }
+
+    if (stat(LibraryPath, &Info) == 0)
+        utime(LibraryPath, NULL);
+    else if (!NativeBuild(Compiler, Source, SourcePath, LibraryPath, FailedPath))
+        return;
+
+    pc->NativeLibrary = dlopen(LibraryPath, RTLD_NOW | RTLD_LOCAL);
+    if (pc->NativeLibrary == NULL)
+        return;
+
+    Main = dlsym(pc->NativeLibrary, NATIVE_MAIN_NAME);
+    for (Count = 0; Count < Tweakables.size() && Main != NULL; Count++)
+    {
+        Value = (double *)dlsym(pc->NativeLibrary, Tweakables[Count].name.c_str());
+        if (Value == NULL)
+            Main = NULL;
+        else
+            *Value = Tweakables[Count].value;
+    }
+
+    if (Main == NULL)
+    {
+        NativeCleanup(pc);
+        return;
+    }
+
+    /* main has been checked to take as many arguments as there are */
+    pc->NativeArg = Arg;
+    if (ParamCount == 1)
+        pc->NativeMain1 = (double (*)(double))Main;
+    else
+        pc->NativeMain2 = (double (*)(double, double))Main;
+}
+
+void NativeCleanup(Picoc *pc)
+{
+    if (pc->NativeLibrary != NULL)
+        dlclose(pc->NativeLibrary);
+
+    NativeInit(pc);
+}
+
+#else
+
+/* there's no dynamic loading on this host, programs are always interpreted */
+void NativeInit(Picoc *pc)
+{
+    pc->NativeLibrary = NULL;
+    pc->NativeMain1 = NULL;
+    pc->NativeMain2 = NULL;
+    pc->NativeArg = NULL;
+}
+
+void NativeCompileProgram(Picoc *pc, double *Arg, int ParamCount, const std::string &SourceCode, std::vector<Tweakable> &Tweakables)
+{
+}
+
+void NativeCleanup(Picoc *pc)
+{
+}
+
+#endif
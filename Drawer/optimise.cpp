@@ -0,0 +1,1602 @@
+/* picoc optimiser - rewrites the token stream of a function body so that
+ * constant sub-expressions are folded into single constant tokens and code
+ * which can never run is dropped. The result is still an ordinary token
+ * stream which the parser runs in the usual way.
+ *
+ * Bodies are optimised once when they're defined and again when a batch of
+ * evaluations is about to start. By then tweakables and the script's globals
+ * have the values they'll keep for the whole batch, so anything computed
+ * only from them is folded too and local variables initialised from them
+ * disappear. That leaves only the work which depends on the arguments to be
+ * done for each sample */
+
+#include "interpreter.h"
+
+#define TOKEN_DATA_OFFSET 2
+
+/* a value known while optimising */
+struct OptConst
+{
+    int IsFP;
+    long Integer;
+    double FP;
+};
+
+/* a token of the body being optimised */
+struct OptToken
+{
+    const unsigned char *Pos;       /* where the token starts in the original stream */
+    enum LexToken Token;
+    int NumEndOfLines;              /* line breaks which follow this token */
+};
+
+/* a replacement for a range of tokens */
+struct OptEdit
+{
+    int Start;
+    int End;                        /* one past the last token replaced */
+    enum LexToken Token;            /* replacement token or TokenNone to remove the range */
+    struct OptConst Value;
+    int IsDeclaration;              /* removes a declaration whose variables have all been folded away */
+};
+
+/* a parameter or local variable which is in scope */
+struct OptLocal
+{
+    const char *Name;
+    int Depth;
+    int IsConst;                    /* its value is known wherever it's used */
+    struct OptConst Value;
+};
+
+/* what's known about the whole program when optimising for a batch of evaluations */
+struct OptProgram
+{
+    const char *FileName;           /* where the script's own globals are declared */
+    const char *MainName;
+    const char **Written;           /* names which are assigned to or have their address taken somewhere */
+    int NumWritten;
+    int GlobalsAliased;             /* a global pointer or aggregate could change any global */
+    int MainCalled;                 /* main is called from the script itself */
+};
+
+/* a parsed expression */
+struct OptNode
+{
+    int Start;
+    int End;
+    int IsConst;
+    int IsLiteral;                  /* a single constant token, no need to rewrite it */
+    struct OptConst Value;
+};
+
+struct OptState
+{
+    Picoc *pc;
+    struct ParseState *Parser;
+    struct OptToken *Tokens;
+    int NumTokens;
+    int Pos;
+    struct OptEdit *Edits;
+    int NumEdits;
+    int MaxEdits;
+    struct OptLocal *Locals;
+    int NumLocals;
+    int Depth;
+    int TernaryDepth;
+    int NumLabels;                  /* case, default and goto labels seen so far */
+    struct OptProgram *Program;     /* NULL when the function is first defined */
+    int KeepDeclarations;           /* locals may be used where we can't see, as in macros */
+    jmp_buf Bail;                   /* something we don't handle - leave the body alone */
+};
+
+static void OptimiseExpression(struct OptState *State, int MinPrecedence, struct OptNode *Node);
+static void OptimiseUnary(struct OptState *State, struct OptNode *Node);
+static void OptimiseStatement(struct OptState *State);
+
+
+static void OptimiseBail(struct OptState *State)
+{
+    longjmp(State->Bail, 1);
+}
+
+static enum LexToken OptimisePeek(struct OptState *State)
+{
+    return State->Tokens[State->Pos].Token;
+}
+
+static enum LexToken OptimisePeekAhead(struct OptState *State, int Ahead)
+{
+    if (State->Pos + Ahead >= State->NumTokens)
+        return TokenEndOfFunction;
+
+    return State->Tokens[State->Pos + Ahead].Token;
+}
+
+static void OptimiseExpect(struct OptState *State, enum LexToken Token)
+{
+    if (OptimisePeek(State) != Token)
+        OptimiseBail(State);
+
+    State->Pos++;
+}
+
+/* the registered identifier string stored with an identifier token */
+static const char *OptimiseIdentifier(struct OptState *State, int Index)
+{
+    const char *Ident;
+
+    memcpy((void *)&Ident, (void *)(State->Tokens[Index].Pos + TOKEN_DATA_OFFSET), sizeof(Ident));
+    return Ident;
+}
+
+/* read the value of a constant token */
+static void OptimiseLiteral(struct OptState *State, int Index, struct OptConst *Value)
+{
+    const unsigned char *Data = State->Tokens[Index].Pos + TOKEN_DATA_OFFSET;
+
+    Value->IsFP = FALSE;
+    switch (State->Tokens[Index].Token)
+    {
+        case TokenIntegerConstant:      memcpy((void *)&Value->Integer, (void *)Data, sizeof(long)); break;
+        case TokenCharacterConstant:    Value->Integer = (long)*(const char *)Data; break;
+        case TokenFPConstant:           memcpy((void *)&Value->FP, (void *)Data, sizeof(double)); Value->IsFP = TRUE; break;
+        default:                        OptimiseBail(State); break;
+    }
+}
+
+static double OptimiseToFP(struct OptConst *Value)
+{
+    return Value->IsFP ? Value->FP : (double)Value->Integer;
+}
+
+static long OptimiseToInteger(struct OptConst *Value)
+{
+    return Value->IsFP ? (long)Value->FP : Value->Integer;
+}
+
+/* record a rewrite of a range of tokens */
+static void OptimiseEdit(struct OptState *State, int Start, int End, enum LexToken Token, struct OptConst *Value)
+{
+    struct OptEdit *Edit;
+
+    if (State->NumEdits >= State->MaxEdits)
+        OptimiseBail(State);
+
+    Edit = &State->Edits[State->NumEdits++];
+
+    Edit->Start = Start;
+    Edit->End = End;
+    Edit->Token = Token;
+    Edit->IsDeclaration = FALSE;
+    if (Value != NULL)
+        Edit->Value = *Value;
+}
+
+/* an expression is complete - replace it with a single token if it turned out to be constant */
+static void OptimiseFlush(struct OptState *State, struct OptNode *Node)
+{
+    if (Node->IsConst && !Node->IsLiteral)
+    {
+        OptimiseEdit(State, Node->Start, Node->End, Node->Value.IsFP ? TokenFPConstant : TokenIntegerConstant, &Node->Value);
+        Node->IsLiteral = TRUE;
+    }
+}
+
+/* a node whose value isn't known, its constant children get rewritten on their own */
+static void OptimiseNotConst(struct OptState *State, struct OptNode *Node, struct OptNode *Left, struct OptNode *Right)
+{
+    if (Left != NULL)
+        OptimiseFlush(State, Left);
+
+    if (Right != NULL)
+        OptimiseFlush(State, Right);
+
+    Node->IsConst = FALSE;
+    Node->IsLiteral = FALSE;
+}
+
+/* look for a library constant such as M_PI */
+static int OptimiseLibraryConstant(struct OptState *State, const char *Ident, struct OptConst *Value)
+{
+    struct Value *Val;
+    int Count;
+
+    if (!TableGet(State->pc, &State->pc->GlobalTable, Ident, &Val, NULL, NULL, NULL))
+        return FALSE;
+
+    for (Count = 0; MathConstants[Count].CstValue != NULL; Count++)
+    {
+        if (MathConstants[Count].CstValue != Val->Val)
+            continue;
+
+        if (Val->Typ == &State->pc->FPType)
+        {
+            Value->IsFP = TRUE;
+            Value->FP = Val->Val->FP;
+            return TRUE;
+        }
+        else if (Val->Typ == &State->pc->IntType)
+        {
+            Value->IsFP = FALSE;
+            Value->Integer = Val->Val->Integer;
+            return TRUE;
+        }
+
+        return FALSE;
+    }
+
+    return FALSE;
+}
+
+/* is this name a parameter or local variable at this point? */
+static int OptimiseIsLocal(struct OptState *State, const char *Ident)
+{
+    int Count;
+
+    for (Count = State->NumLocals-1; Count >= 0; Count--)
+    {
+        if (State->Locals[Count].Name == Ident)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* a new local variable, Value is NULL unless it's known for as long as the variable is in scope */
+static void OptimiseAddLocal(struct OptState *State, const char *Ident, struct OptConst *Value)
+{
+    struct OptLocal *Local = &State->Locals[State->NumLocals++];
+
+    Local->Name = Ident;
+    Local->Depth = State->Depth;
+    Local->IsConst = (Value != NULL);
+    if (Value != NULL)
+        Local->Value = *Value;
+}
+
+static void OptimiseEndScope(struct OptState *State)
+{
+    while (State->NumLocals > 0 && State->Locals[State->NumLocals-1].Depth >= State->Depth)
+        State->NumLocals--;
+
+    State->Depth--;
+}
+
+/* is this name assigned to, incremented or has its address taken anywhere in the program? */
+static int OptimiseProgramWrites(struct OptProgram *Program, const char *Ident)
+{
+    int Count;
+
+    for (Count = 0; Count < Program->NumWritten; Count++)
+    {
+        if (Program->Written[Count] == Ident)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static int OptimiseIsWritten(struct OptState *State, const char *Ident)
+{
+    return OptimiseProgramWrites(State->Program, Ident);
+}
+
+/* read a scalar value the way the expression evaluator would */
+static int OptimiseReadValue(struct Value *Val, struct OptConst *Value)
+{
+    Value->IsFP = FALSE;
+    switch (Val->Typ->Base)
+    {
+        case TypeFP:        Value->IsFP = TRUE; Value->FP = Val->Val->FP; return TRUE;
+        case TypeInt:       Value->Integer = Val->Val->Integer; return TRUE;
+        case TypeShort:     Value->Integer = Val->Val->ShortInteger; return TRUE;
+        case TypeChar:      Value->Integer = Val->Val->Character; return TRUE;
+        default:            return FALSE;
+    }
+}
+
+/* a global which keeps its value for the whole batch - either a read-only platform value
+ * such as a tweakable or a scalar global of the script's own which nothing ever writes to */
+static int OptimiseBatchConstant(struct OptState *State, const char *Ident, struct OptConst *Value)
+{
+    struct Value *Val;
+    const char *DeclFileName;
+    int DeclLine;
+    int DeclColumn;
+
+    /* the arguments change from one evaluation to the next */
+    if (strncmp(Ident, "__", 2) == 0)
+        return FALSE;
+
+    if (!TableGet(State->pc, &State->pc->GlobalTable, Ident, &Val, &DeclFileName, &DeclLine, &DeclColumn))
+        return FALSE;
+
+    if (Val->IsLValue && (DeclFileName != State->Program->FileName || State->Program->GlobalsAliased || OptimiseIsWritten(State, Ident)))
+        return FALSE;
+
+    return OptimiseReadValue(Val, Value);
+}
+
+/* the value of a variable if it's known at this point */
+static int OptimiseLookup(struct OptState *State, const char *Ident, struct OptConst *Value)
+{
+    int Count;
+
+    for (Count = State->NumLocals-1; Count >= 0; Count--)
+    {
+        if (State->Locals[Count].Name == Ident)
+        {
+            if (State->Locals[Count].IsConst)
+                *Value = State->Locals[Count].Value;
+
+            return State->Locals[Count].IsConst;
+        }
+    }
+
+    if (OptimiseLibraryConstant(State, Ident, Value))
+        return TRUE;
+
+    return State->Program != NULL && OptimiseBatchConstant(State, Ident, Value);
+}
+
+/* is this name a macro? macros run in their caller's scope so they can see its locals */
+static int OptimiseIsMacro(struct OptState *State, const char *Ident)
+{
+    struct Value *Val;
+
+    return !OptimiseIsLocal(State, Ident) && TableGet(State->pc, &State->pc->GlobalTable, Ident, &Val, NULL, NULL, NULL) && Val->Typ == &State->pc->MacroType;
+}
+
+/* a library function which always gives the same result for the same arguments */
+static struct FuncDef *OptimisePureIntrinsic(struct OptState *State, const char *Ident)
+{
+    struct Value *Val;
+    struct FuncDef *Func;
+    int Count;
+
+    if (OptimiseIsLocal(State, Ident) || !TableGet(State->pc, &State->pc->GlobalTable, Ident, &Val, NULL, NULL, NULL) || Val->Typ != &State->pc->FunctionType)
+        return NULL;
+
+    Func = Val->Val->FuncDef;
+    if (Func->Intrinsic == NULL || !Func->IsPure || Func->VarArgs || Func->ReturnType != &State->pc->FPType)
+        return NULL;
+
+    for (Count = 0; Count < Func->NumParams; Count++)
+    {
+        if (Func->ParamType[Count] != &State->pc->FPType && Func->ParamType[Count] != &State->pc->IntType)
+            return NULL;
+    }
+
+    return Func;
+}
+
+/* call a pure intrinsic with constant arguments */
+static void OptimiseCallIntrinsic(struct OptState *State, struct FuncDef *Func, struct OptNode *Args, struct OptConst *Result)
+{
+    struct Value ParamValue[PARAMETER_MAX];
+    union AnyValue ParamData[PARAMETER_MAX];
+    struct Value *Param[PARAMETER_MAX];
+    struct Value ReturnValue;
+    union AnyValue ReturnData;
+    int Count;
+
+    for (Count = 0; Count < Func->NumParams; Count++)
+    {
+        memset((void *)&ParamValue[Count], '\0', sizeof(struct Value));
+        ParamValue[Count].Typ = Func->ParamType[Count];
+        ParamValue[Count].Val = &ParamData[Count];
+        if (Func->ParamType[Count] == &State->pc->FPType)
+            ParamData[Count].FP = OptimiseToFP(&Args[Count].Value);
+        else
+            ParamData[Count].Integer = (int)OptimiseToInteger(&Args[Count].Value);
+
+        Param[Count] = &ParamValue[Count];
+    }
+
+    memset((void *)&ReturnValue, '\0', sizeof(ReturnValue));
+    ReturnValue.Typ = Func->ReturnType;
+    ReturnValue.Val = &ReturnData;
+    Func->Intrinsic(State->Parser, &ReturnValue, Param, Func->NumParams);
+
+    Result->IsFP = TRUE;
+    Result->FP = ReturnData.FP;
+}
+
+/* fold a prefix operator, giving the same result the expression evaluator would */
+static int OptimiseFoldPrefix(enum LexToken Op, struct OptConst *Operand, struct OptConst *Result)
+{
+    if (Operand->IsFP)
+    {
+        Result->IsFP = TRUE;
+        switch (Op)
+        {
+            case TokenPlus:     Result->FP = Operand->FP; break;
+            case TokenMinus:    Result->FP = -Operand->FP; break;
+            case TokenUnaryNot: Result->FP = !Operand->FP; break;
+            default:            return FALSE;
+        }
+    }
+    else
+    {
+        Result->IsFP = FALSE;
+        switch (Op)
+        {
+            case TokenPlus:     Result->Integer = Operand->Integer; break;
+            case TokenMinus:    Result->Integer = -Operand->Integer; break;
+            case TokenUnaryNot: Result->Integer = !Operand->Integer; break;
+            case TokenUnaryExor:Result->Integer = ~Operand->Integer; break;
+            default:            return FALSE;
+        }
+
+        /* integer results are pushed as an int */
+        Result->Integer = (int)Result->Integer;
+    }
+
+    return TRUE;
+}
+
+/* fold an infix operator, giving the same result the expression evaluator would */
+static int OptimiseFoldInfix(enum LexToken Op, struct OptConst *Bottom, struct OptConst *Top, struct OptConst *Result)
+{
+    long ResultInt = 0;
+
+    if (Bottom->IsFP || Top->IsFP)
+    {
+        double BottomFP = OptimiseToFP(Bottom);
+        double TopFP = OptimiseToFP(Top);
+
+        Result->IsFP = TRUE;
+        switch (Op)
+        {
+            case TokenPlus:         Result->FP = BottomFP + TopFP; return TRUE;
+            case TokenMinus:        Result->FP = BottomFP - TopFP; return TRUE;
+            case TokenAsterisk:     Result->FP = BottomFP * TopFP; return TRUE;
+            case TokenSlash:        Result->FP = BottomFP / TopFP; return TRUE;
+            case TokenEqual:        ResultInt = BottomFP == TopFP; break;
+            case TokenNotEqual:     ResultInt = BottomFP != TopFP; break;
+            case TokenLessThan:     ResultInt = BottomFP < TopFP; break;
+            case TokenGreaterThan:  ResultInt = BottomFP > TopFP; break;
+            case TokenLessEqual:    ResultInt = BottomFP <= TopFP; break;
+            case TokenGreaterEqual: ResultInt = BottomFP >= TopFP; break;
+            default:                return FALSE;
+        }
+    }
+    else
+    {
+        long BottomInt = Bottom->Integer;
+        long TopInt = Top->Integer;
+
+        switch (Op)
+        {
+            case TokenLogicalOr:    ResultInt = BottomInt || TopInt; break;
+            case TokenLogicalAnd:   ResultInt = BottomInt && TopInt; break;
+            case TokenArithmeticOr: ResultInt = BottomInt | TopInt; break;
+            case TokenArithmeticExor: ResultInt = BottomInt ^ TopInt; break;
+            case TokenAmpersand:    ResultInt = BottomInt & TopInt; break;
+            case TokenEqual:        ResultInt = BottomInt == TopInt; break;
+            case TokenNotEqual:     ResultInt = BottomInt != TopInt; break;
+            case TokenLessThan:     ResultInt = BottomInt < TopInt; break;
+            case TokenGreaterThan:  ResultInt = BottomInt > TopInt; break;
+            case TokenLessEqual:    ResultInt = BottomInt <= TopInt; break;
+            case TokenGreaterEqual: ResultInt = BottomInt >= TopInt; break;
+            case TokenPlus:         ResultInt = BottomInt + TopInt; break;
+            case TokenMinus:        ResultInt = BottomInt - TopInt; break;
+            case TokenAsterisk:     ResultInt = BottomInt * TopInt; break;
+            case TokenShiftLeft:
+            case TokenShiftRight:
+                if (TopInt < 0 || TopInt >= (long)(sizeof(long) * 8))
+                    return FALSE;
+
+                ResultInt = (Op == TokenShiftLeft) ? BottomInt << TopInt : BottomInt >> TopInt;
+                break;
+            case TokenSlash:
+            case TokenModulus:
+                /* leave division by zero to fail at run time */
+                if (TopInt == 0)
+                    return FALSE;
+
+                ResultInt = (Op == TokenSlash) ? BottomInt / TopInt : BottomInt % TopInt;
+                break;
+            default:                return FALSE;
+        }
+    }
+
+    /* integer results are pushed as an int */
+    Result->IsFP = FALSE;
+    Result->Integer = (int)ResultInt;
+    return TRUE;
+}
+
+static int OptimiseInfixPrecedence(enum LexToken Token)
+{
+    switch (Token)
+    {
+        case TokenAssign: case TokenAddAssign: case TokenSubtractAssign: case TokenMultiplyAssign:
+        case TokenDivideAssign: case TokenModulusAssign: case TokenShiftLeftAssign: case TokenShiftRightAssign:
+        case TokenArithmeticAndAssign: case TokenArithmeticOrAssign: case TokenArithmeticExorAssign:
+                                    return 2;
+        case TokenQuestionMark: case TokenColon:
+                                    return 3;
+        case TokenLogicalOr:        return 4;
+        case TokenLogicalAnd:       return 5;
+        case TokenArithmeticOr:     return 6;
+        case TokenArithmeticExor:   return 7;
+        case TokenAmpersand:        return 8;
+        case TokenEqual: case TokenNotEqual:
+                                    return 9;
+        case TokenLessThan: case TokenGreaterThan: case TokenLessEqual: case TokenGreaterEqual:
+                                    return 10;
+        case TokenShiftLeft: case TokenShiftRight:
+                                    return 11;
+        case TokenPlus: case TokenMinus:
+                                    return 12;
+        case TokenAsterisk: case TokenSlash: case TokenModulus:
+                                    return 13;
+        default:                    return 0;
+    }
+}
+
+/* is this the start of a type name, as in a cast or a declaration? */
+static int OptimiseIsType(struct OptState *State, enum LexToken Token, int Index)
+{
+    struct Value *Val;
+
+    switch (Token)
+    {
+        case TokenIntType: case TokenCharType: case TokenFloatType: case TokenDoubleType: case TokenVoidType:
+        case TokenLongType: case TokenSignedType: case TokenShortType: case TokenUnsignedType:
+        case TokenStructType: case TokenUnionType: case TokenEnumType:
+        case TokenStaticType: case TokenAutoType: case TokenRegisterType: case TokenExternType:
+            return TRUE;
+
+        case TokenIdentifier:
+            /* a typedef name */
+            return !OptimiseIsLocal(State, OptimiseIdentifier(State, Index)) &&
+                TableGet(State->pc, &State->pc->GlobalTable, OptimiseIdentifier(State, Index), &Val, NULL, NULL, NULL) &&
+                Val->Typ == &State->pc->TypeType;
+
+        default:
+            return FALSE;
+    }
+}
+
+/* a function or macro call. The call itself is only folded for pure math functions */
+static void OptimiseCall(struct OptState *State, const char *Ident, struct OptNode *Node)
+{
+    struct OptNode Args[PARAMETER_MAX];
+    struct OptNode Arg;
+    struct FuncDef *Func = OptimisePureIntrinsic(State, Ident);
+    int NumArgs = 0;
+    int AllConst = TRUE;
+    int Count;
+
+    OptimiseExpect(State, TokenOpenBracket);
+    if (OptimisePeek(State) != TokenCloseBracket)
+    {
+        do
+        {
+            OptimiseExpression(State, 2, &Arg);
+            AllConst = AllConst && Arg.IsConst;
+            if (NumArgs < PARAMETER_MAX)
+                Args[NumArgs] = Arg;
+            else
+                OptimiseFlush(State, &Arg);
+
+            NumArgs++;
+
+        } while (OptimisePeek(State) == TokenComma && (State->Pos++, TRUE));
+    }
+    OptimiseExpect(State, TokenCloseBracket);
+
+    Node->End = State->Pos;
+    if (Func != NULL && AllConst && NumArgs == Func->NumParams)
+    {
+        OptimiseCallIntrinsic(State, Func, Args, &Node->Value);
+        Node->IsConst = TRUE;
+        Node->IsLiteral = FALSE;
+    }
+    else
+    {
+        for (Count = 0; Count < NumArgs && Count < PARAMETER_MAX; Count++)
+            OptimiseFlush(State, &Args[Count]);
+
+        OptimiseNotConst(State, Node, NULL, NULL);
+    }
+}
+
+/* a primary expression followed by any postfix operators */
+static void OptimisePrimary(struct OptState *State, struct OptNode *Node)
+{
+    struct OptNode Inner;
+    enum LexToken Token = OptimisePeek(State);
+
+    Node->Start = State->Pos;
+    switch (Token)
+    {
+        case TokenIntegerConstant:
+        case TokenFPConstant:
+        case TokenCharacterConstant:
+            OptimiseLiteral(State, State->Pos, &Node->Value);
+            State->Pos++;
+            Node->IsConst = TRUE;
+            Node->IsLiteral = TRUE;
+            break;
+
+        case TokenStringConstant:
+            State->Pos++;
+            OptimiseNotConst(State, Node, NULL, NULL);
+            break;
+
+        case TokenIdentifier:
+        {
+            const char *Ident = OptimiseIdentifier(State, State->Pos);
+
+            State->Pos++;
+            if (OptimiseIsMacro(State, Ident))
+                State->KeepDeclarations = TRUE;
+
+            if (OptimisePeek(State) == TokenOpenBracket)
+                OptimiseCall(State, Ident, Node);
+
+            else if (OptimiseLookup(State, Ident, &Node->Value))
+            {
+                Node->IsConst = TRUE;
+                Node->IsLiteral = FALSE;
+            }
+            else
+                OptimiseNotConst(State, Node, NULL, NULL);
+            break;
+        }
+
+        case TokenOpenBracket:
+            State->Pos++;
+            OptimiseExpression(State, 2, &Inner);
+            OptimiseExpect(State, TokenCloseBracket);
+            Node->IsConst = Inner.IsConst;
+            Node->IsLiteral = FALSE;
+            Node->Value = Inner.Value;
+            break;
+
+        default:
+            OptimiseBail(State);
+            break;
+    }
+
+    /* postfix operators */
+    while (TRUE)
+    {
+        Token = OptimisePeek(State);
+        if (Token == TokenLeftSquareBracket)
+        {
+            State->Pos++;
+            OptimiseExpression(State, 2, &Inner);
+            OptimiseFlush(State, &Inner);
+            OptimiseExpect(State, TokenRightSquareBracket);
+        }
+        else if (Token == TokenDot || Token == TokenArrow)
+        {
+            State->Pos++;
+            OptimiseExpect(State, TokenIdentifier);
+        }
+        else if (Token == TokenIncrement || Token == TokenDecrement)
+        {
+            /* a constant can't be modified, leave it to fail at run time */
+            if (Node->IsConst)
+                OptimiseBail(State);
+
+            State->Pos++;
+        }
+        else
+            break;
+
+        OptimiseNotConst(State, Node, NULL, NULL);
+    }
+
+    Node->End = State->Pos;
+}
+
+/* convert a value to a plain numeric type as an assignment would, returns FALSE for other types */
+static int OptimiseConvert(enum LexToken Type, struct OptConst *From, struct OptConst *To)
+{
+    switch (Type)
+    {
+        case TokenIntType:
+        case TokenLongType:
+            To->IsFP = FALSE;
+            To->Integer = OptimiseToInteger(From);
+            if (Type == TokenIntType)
+                To->Integer = (int)To->Integer;
+            return TRUE;
+
+        case TokenDoubleType:
+        case TokenFloatType:
+            To->IsFP = TRUE;
+            To->FP = OptimiseToFP(From);
+            return TRUE;
+
+        default:
+            return FALSE;
+    }
+}
+
+/* a cast - only casts to the plain numeric types are folded */
+static void OptimiseCast(struct OptState *State, struct OptNode *Node)
+{
+    struct OptNode Operand;
+    enum LexToken CastTo = TokenNone;
+    int NumTypeTokens = 0;
+
+    OptimiseExpect(State, TokenOpenBracket);
+    while (OptimisePeek(State) != TokenCloseBracket)
+    {
+        CastTo = OptimisePeek(State);
+        if (CastTo == TokenEndOfFunction)
+            OptimiseBail(State);
+
+        State->Pos++;
+        NumTypeTokens++;
+    }
+    State->Pos++;
+
+    OptimiseUnary(State, &Operand);
+    Node->End = State->Pos;
+    if (Operand.IsConst && NumTypeTokens == 1 && OptimiseConvert(CastTo, &Operand.Value, &Node->Value))
+    {
+        Node->IsConst = TRUE;
+        Node->IsLiteral = FALSE;
+    }
+    else
+        OptimiseNotConst(State, Node, &Operand, NULL);
+}
+
+/* a prefix operator expression */
+static void OptimiseUnary(struct OptState *State, struct OptNode *Node)
+{
+    struct OptNode Operand;
+    enum LexToken Token = OptimisePeek(State);
+
+    Node->Start = State->Pos;
+    switch (Token)
+    {
+        case TokenPlus:
+        case TokenMinus:
+        case TokenUnaryNot:
+        case TokenUnaryExor:
+            State->Pos++;
+            OptimiseUnary(State, &Operand);
+            Node->End = State->Pos;
+            if (Operand.IsConst && OptimiseFoldPrefix(Token, &Operand.Value, &Node->Value))
+            {
+                Node->IsConst = TRUE;
+                Node->IsLiteral = FALSE;
+            }
+            else
+                OptimiseNotConst(State, Node, &Operand, NULL);
+            break;
+
+        case TokenIncrement:
+        case TokenDecrement:
+        case TokenAmpersand:
+            State->Pos++;
+            OptimiseUnary(State, &Operand);
+            if (Operand.IsConst)
+                OptimiseBail(State);
+
+            Node->End = State->Pos;
+            OptimiseNotConst(State, Node, NULL, NULL);
+            break;
+
+        case TokenAsterisk:
+            State->Pos++;
+            OptimiseUnary(State, &Operand);
+            Node->End = State->Pos;
+            OptimiseNotConst(State, Node, &Operand, NULL);
+            break;
+
+        case TokenOpenBracket:
+            if (OptimiseIsType(State, OptimisePeekAhead(State, 1), State->Pos+1))
+                OptimiseCast(State, Node);
+            else
+                OptimisePrimary(State, Node);
+            break;
+
+        default:
+            OptimisePrimary(State, Node);
+            break;
+    }
+}
+
+/* an expression made of infix operators with at least the given precedence */
+static void OptimiseExpression(struct OptState *State, int MinPrecedence, struct OptNode *Node)
+{
+    struct OptNode Right;
+    struct OptNode Left;
+    enum LexToken Op;
+    int Precedence;
+
+    OptimiseUnary(State, Node);
+    while (TRUE)
+    {
+        Op = OptimisePeek(State);
+        Precedence = OptimiseInfixPrecedence(Op);
+        if (Precedence == 0 || Precedence < MinPrecedence || (Op == TokenColon && State->TernaryDepth == 0))
+            break;
+
+        State->Pos++;
+        Left = *Node;
+        if (Precedence == 2)
+        {
+            /* assignment - right associative and never constant */
+            if (Left.IsConst)
+                OptimiseBail(State);
+
+            OptimiseExpression(State, 2, &Right);
+            OptimiseNotConst(State, Node, NULL, &Right);
+        }
+        else if (Op == TokenQuestionMark || Op == TokenColon)
+        {
+            /* the branches are folded separately but the choice between them is left alone */
+            State->TernaryDepth += (Op == TokenQuestionMark) ? 1 : -1;
+            OptimiseExpression(State, Precedence+1, &Right);
+            OptimiseNotConst(State, Node, &Left, &Right);
+        }
+        else
+        {
+            OptimiseExpression(State, Precedence+1, &Right);
+            if (Left.IsConst && Right.IsConst && OptimiseFoldInfix(Op, &Left.Value, &Right.Value, &Node->Value))
+            {
+                Node->IsConst = TRUE;
+                Node->IsLiteral = FALSE;
+            }
+            else
+                OptimiseNotConst(State, Node, &Left, &Right);
+        }
+
+        Node->Start = Left.Start;
+        Node->End = State->Pos;
+    }
+}
+
+/* a complete expression, as in a statement or a condition */
+static void OptimiseFullExpression(struct OptState *State, struct OptNode *Node)
+{
+    int OldTernaryDepth = State->TernaryDepth;
+
+    State->TernaryDepth = 0;
+    OptimiseExpression(State, 2, Node);
+    State->TernaryDepth = OldTernaryDepth;
+}
+
+/* is the condition of an if or while true? conditions are coerced to an integer */
+static int OptimiseIsTrue(struct OptConst *Value)
+{
+    return OptimiseToInteger(Value) != 0;
+}
+
+/* a local variable declaration. When optimising for a batch a plain numeric variable which is
+ * initialised to a known value and never changed is replaced by that value wherever it's used.
+ * Returns TRUE if that happened to every variable declared */
+static int OptimiseDeclaration(struct OptState *State)
+{
+    struct OptNode Init;
+    struct OptConst Value;
+    enum LexToken Type = TokenNone;
+    const char *Ident;
+    int NumTypeTokens = 0;
+    int AllConst = TRUE;
+    int IsConst;
+    int Depth;
+
+    while (OptimiseIsType(State, OptimisePeek(State), State->Pos))
+    {
+        switch (OptimisePeek(State))
+        {
+            case TokenStructType: case TokenUnionType: case TokenEnumType:
+            case TokenStaticType: case TokenExternType: case TokenIdentifier:
+                OptimiseBail(State);
+                break;
+
+            default:
+                Type = OptimisePeek(State);
+                NumTypeTokens++;
+                State->Pos++;
+                break;
+        }
+    }
+
+    while (TRUE)
+    {
+        IsConst = State->Program != NULL && NumTypeTokens == 1 &&
+            (Type == TokenIntType || Type == TokenDoubleType || Type == TokenFloatType);
+
+        while (OptimisePeek(State) == TokenAsterisk)
+        {
+            IsConst = FALSE;
+            State->Pos++;
+        }
+
+        if (OptimisePeek(State) != TokenIdentifier)
+            OptimiseBail(State);
+
+        Ident = OptimiseIdentifier(State, State->Pos);
+        State->Pos++;
+        if (IsConst && OptimiseIsWritten(State, Ident))
+            IsConst = FALSE;
+
+        while (OptimisePeek(State) == TokenLeftSquareBracket)
+        {
+            IsConst = FALSE;
+            State->Pos++;
+            if (OptimisePeek(State) != TokenRightSquareBracket)
+            {
+                OptimiseFullExpression(State, &Init);
+                OptimiseFlush(State, &Init);
+            }
+            OptimiseExpect(State, TokenRightSquareBracket);
+        }
+
+        if (OptimisePeek(State) == TokenAssign)
+        {
+            State->Pos++;
+            if (OptimisePeek(State) == TokenLeftBrace)
+            {
+                /* array initialiser - skip over it, we can't tell which variables it uses */
+                State->KeepDeclarations = TRUE;
+                for (Depth = 0; Depth > 0 || OptimisePeek(State) == TokenLeftBrace; State->Pos++)
+                {
+                    if (OptimisePeek(State) == TokenLeftBrace)
+                        Depth++;
+                    else if (OptimisePeek(State) == TokenRightBrace)
+                        Depth--;
+                    else if (OptimisePeek(State) == TokenEndOfFunction)
+                        OptimiseBail(State);
+                }
+            }
+            else
+            {
+                OptimiseFullExpression(State, &Init);
+                OptimiseFlush(State, &Init);
+                IsConst = IsConst && Init.IsConst && OptimiseConvert(Type, &Init.Value, &Value);
+            }
+        }
+        else
+            IsConst = FALSE;
+
+        /* the variable is in scope once its declarator is complete */
+        OptimiseAddLocal(State, Ident, IsConst ? &Value : NULL);
+        AllConst = AllConst && IsConst;
+
+        if (OptimisePeek(State) != TokenComma)
+            break;
+
+        State->Pos++;
+    }
+
+    return AllConst;
+}
+
+/* a block of statements between braces */
+static void OptimiseBlock(struct OptState *State)
+{
+    OptimiseExpect(State, TokenLeftBrace);
+    State->Depth++;
+    while (OptimisePeek(State) != TokenRightBrace)
+        OptimiseStatement(State);
+
+    State->Pos++;
+    OptimiseEndScope(State);
+}
+
+/* "(" condition ")" */
+static void OptimiseCondition(struct OptState *State, struct OptNode *Cond)
+{
+    OptimiseExpect(State, TokenOpenBracket);
+    OptimiseFullExpression(State, Cond);
+    OptimiseExpect(State, TokenCloseBracket);
+}
+
+static void OptimiseStatement(struct OptState *State)
+{
+    struct OptNode Node;
+    int Start = State->Pos;
+    int NumLabels = State->NumLabels;
+
+    switch (OptimisePeek(State))
+    {
+        case TokenLeftBrace:
+            OptimiseBlock(State);
+            return;
+
+        case TokenSemicolon:
+            State->Pos++;
+            return;
+
+        case TokenIf:
+        {
+            int ThenStart;
+            int ThenEnd;
+            int ElseStart = -1;
+
+            State->Pos++;
+            OptimiseCondition(State, &Node);
+            ThenStart = State->Pos;
+            OptimiseStatement(State);
+            ThenEnd = State->Pos;
+            if (OptimisePeek(State) == TokenElse)
+            {
+                State->Pos++;
+                ElseStart = State->Pos;
+                OptimiseStatement(State);
+            }
+
+            if (!Node.IsConst || State->NumLabels != NumLabels)
+                OptimiseFlush(State, &Node);
+
+            else if (OptimiseIsTrue(&Node.Value))
+            {
+                /* only the "then" part can run */
+                OptimiseEdit(State, Start, ThenStart, TokenNone, NULL);
+                if (ElseStart >= 0)
+                    OptimiseEdit(State, ThenEnd, State->Pos, TokenNone, NULL);
+            }
+            else if (ElseStart >= 0)
+            {
+                /* only the "else" part can run */
+                OptimiseEdit(State, Start, ElseStart, TokenNone, NULL);
+            }
+            else
+                OptimiseEdit(State, Start, State->Pos, TokenSemicolon, NULL);
+            return;
+        }
+
+        case TokenWhile:
+            State->Pos++;
+            OptimiseCondition(State, &Node);
+            OptimiseStatement(State);
+            if (Node.IsConst && !OptimiseIsTrue(&Node.Value) && State->NumLabels == NumLabels)
+                OptimiseEdit(State, Start, State->Pos, TokenSemicolon, NULL);
+            else
+                OptimiseFlush(State, &Node);
+            return;
+
+        case TokenDo:
+            State->Pos++;
+            OptimiseStatement(State);
+            OptimiseExpect(State, TokenWhile);
+            OptimiseCondition(State, &Node);
+            OptimiseFlush(State, &Node);
+            OptimiseExpect(State, TokenSemicolon);
+            return;
+
+        case TokenFor:
+            State->Pos++;
+            State->Depth++;
+            OptimiseExpect(State, TokenOpenBracket);
+            if (OptimiseIsType(State, OptimisePeek(State), State->Pos))
+                OptimiseDeclaration(State);
+            else if (OptimisePeek(State) != TokenSemicolon)
+            {
+                OptimiseFullExpression(State, &Node);
+                OptimiseFlush(State, &Node);
+            }
+            OptimiseExpect(State, TokenSemicolon);
+            if (OptimisePeek(State) != TokenSemicolon)
+            {
+                OptimiseFullExpression(State, &Node);
+                OptimiseFlush(State, &Node);
+            }
+            OptimiseExpect(State, TokenSemicolon);
+            if (OptimisePeek(State) != TokenCloseBracket)
+            {
+                OptimiseFullExpression(State, &Node);
+                OptimiseFlush(State, &Node);
+            }
+            OptimiseExpect(State, TokenCloseBracket);
+            OptimiseStatement(State);
+            OptimiseEndScope(State);
+            return;
+
+        case TokenSwitch:
+            State->Pos++;
+            OptimiseCondition(State, &Node);
+            OptimiseFlush(State, &Node);
+            OptimiseStatement(State);
+            return;
+
+        case TokenCase:
+            State->Pos++;
+            OptimiseFullExpression(State, &Node);
+            OptimiseFlush(State, &Node);
+            OptimiseExpect(State, TokenColon);
+            State->NumLabels++;
+            return;
+
+        case TokenDefault:
+            State->Pos++;
+            OptimiseExpect(State, TokenColon);
+            State->NumLabels++;
+            return;
+
+        case TokenBreak:
+        case TokenContinue:
+            State->Pos++;
+            OptimiseExpect(State, TokenSemicolon);
+            return;
+
+        case TokenGoto:
+            /* a jump could skip a declaration which we'd otherwise remove */
+            State->KeepDeclarations = TRUE;
+            State->Pos++;
+            OptimiseExpect(State, TokenIdentifier);
+            OptimiseExpect(State, TokenSemicolon);
+            return;
+
+        case TokenReturn:
+            State->Pos++;
+            if (OptimisePeek(State) != TokenSemicolon)
+            {
+                OptimiseFullExpression(State, &Node);
+                OptimiseFlush(State, &Node);
+            }
+            OptimiseExpect(State, TokenSemicolon);
+            return;
+
+        case TokenIdentifier:
+            if (OptimisePeekAhead(State, 1) == TokenColon)
+            {
+                /* a goto label */
+                State->Pos += 2;
+                State->NumLabels++;
+                return;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    if (OptimiseIsType(State, OptimisePeek(State), State->Pos))
+    {
+        if (OptimiseDeclaration(State))
+        {
+            /* every use of these variables has been replaced by its value */
+            OptimiseExpect(State, TokenSemicolon);
+            OptimiseEdit(State, Start, State->Pos, TokenSemicolon, NULL);
+            State->Edits[State->NumEdits-1].IsDeclaration = TRUE;
+            return;
+        }
+    }
+    else
+    {
+        OptimiseFullExpression(State, &Node);
+        OptimiseFlush(State, &Node);
+    }
+
+    OptimiseExpect(State, TokenSemicolon);
+}
+
+/* split the body into tokens, returns FALSE if it contains anything we don't want to touch */
+static int OptimiseScanTokens(struct OptState *State, const unsigned char *Pos)
+{
+    enum LexToken Token;
+
+    State->NumTokens = 0;
+    while (TRUE)
+    {
+        Token = (enum LexToken)*Pos;
+        if (Token == TokenEndOfLine)
+        {
+            if (State->NumTokens == 0)
+                return FALSE;
+
+            if (State->Tokens != NULL)
+                State->Tokens[State->NumTokens-1].NumEndOfLines++;
+        }
+        else
+        {
+            if (Token == TokenEOF || (Token >= TokenHashDefine && Token <= TokenHashEndif))
+                return FALSE;
+
+            if (State->Tokens != NULL)
+            {
+                State->Tokens[State->NumTokens].Pos = Pos;
+                State->Tokens[State->NumTokens].Token = Token;
+                State->Tokens[State->NumTokens].NumEndOfLines = 0;
+            }
+            State->NumTokens++;
+
+            if (Token == TokenEndOfFunction)
+                return TRUE;
+        }
+
+        Pos += TOKEN_DATA_OFFSET + LexTokenSize(Token);
+    }
+}
+
+/* order edits by position, outer edits before the ones they contain */
+static int OptimiseCompareEdits(const void *A, const void *B)
+{
+    const struct OptEdit *EditA = (const struct OptEdit *)A;
+    const struct OptEdit *EditB = (const struct OptEdit *)B;
+
+    if (EditA->Start != EditB->Start)
+        return EditA->Start - EditB->Start;
+
+    return EditB->End - EditA->End;
+}
+
+/* write the body out with the edits applied. Returns the size used, writes nothing if NewTokens is NULL */
+static int OptimiseWrite(struct OptState *State, unsigned char *NewTokens)
+{
+    int Size = 0;
+    int TokenNo = 0;
+    int EditNo = 0;
+    int NumEndOfLines;
+    int TokenSize;
+    int Count;
+    struct OptEdit *Edit;
+
+    while (TokenNo < State->NumTokens)
+    {
+        /* skip edits inside a range which has already been replaced */
+        while (EditNo < State->NumEdits && State->Edits[EditNo].Start < TokenNo)
+            EditNo++;
+
+        if (EditNo < State->NumEdits && State->Edits[EditNo].Start == TokenNo)
+        {
+            Edit = &State->Edits[EditNo++];
+            if (Edit->Token != TokenNone)
+            {
+                if (NewTokens != NULL)
+                {
+                    NewTokens[Size] = (unsigned char)Edit->Token;
+                    NewTokens[Size+1] = State->Tokens[Edit->Start].Pos[1];
+                    if (Edit->Token == TokenFPConstant)
+                        memcpy((void *)&NewTokens[Size+TOKEN_DATA_OFFSET], (void *)&Edit->Value.FP, sizeof(double));
+                    else if (Edit->Token == TokenIntegerConstant)
+                        memcpy((void *)&NewTokens[Size+TOKEN_DATA_OFFSET], (void *)&Edit->Value.Integer, sizeof(long));
+                }
+                Size += TOKEN_DATA_OFFSET + LexTokenSize(Edit->Token);
+            }
+
+            /* keep the line breaks so line numbers stay right */
+            for (NumEndOfLines = 0; TokenNo < Edit->End; TokenNo++)
+                NumEndOfLines += State->Tokens[TokenNo].NumEndOfLines;
+        }
+        else
+        {
+            TokenSize = TOKEN_DATA_OFFSET + LexTokenSize(State->Tokens[TokenNo].Token);
+            if (NewTokens != NULL)
+                memcpy((void *)&NewTokens[Size], (void *)State->Tokens[TokenNo].Pos, State->Tokens[TokenNo].Token == TokenEndOfFunction ? 1 : TokenSize);
+
+            Size += TokenSize;
+            NumEndOfLines = State->Tokens[TokenNo].NumEndOfLines;
+            TokenNo++;
+        }
+
+        for (Count = 0; Count < NumEndOfLines; Count++)
+        {
+            if (NewTokens != NULL)
+            {
+                NewTokens[Size] = (unsigned char)TokenEndOfLine;
+                NewTokens[Size+1] = 0;
+            }
+            Size += TOKEN_DATA_OFFSET;
+        }
+    }
+
+    return Size;
+}
+
+/* drop the removal of declarations if their variables might be used somewhere we couldn't see */
+static void OptimiseKeepDeclarations(struct OptState *State)
+{
+    int Count;
+    int NumEdits = 0;
+
+    for (Count = 0; Count < State->NumEdits; Count++)
+    {
+        if (!State->Edits[Count].IsDeclaration)
+            State->Edits[NumEdits++] = State->Edits[Count];
+    }
+
+    State->NumEdits = NumEdits;
+}
+
+/* find the edits for a whole body, or none if it has something we don't handle. On its own
+ * so nothing of OptimiseBody's is live across the longjmp */
+static void OptimiseFindEdits(struct OptState *State)
+{
+    if (setjmp(State->Bail) == 0)
+    {
+        OptimiseBlock(State);
+        if (OptimisePeek(State) != TokenEndOfFunction)
+            State->NumEdits = 0;
+    }
+    else
+        State->NumEdits = 0;
+}
+
+/* optimise a body where the first NumBound parameters have known values.
+ * Returns the new body or NULL if nothing could be changed */
+static unsigned char *OptimiseBody(struct ParseState *Parser, struct FuncDef *Func, struct OptProgram *Program, struct OptConst *Bound, int NumBound)
+{
+    struct OptState State;
+    Picoc *pc = Parser->pc;
+    unsigned char *NewTokens = NULL;
+    int Count;
+
+    if (Func->Intrinsic != NULL || Func->Body.Pos == NULL)
+        return NULL;
+
+    memset((void *)&State, '\0', sizeof(State));
+    State.pc = pc;
+    State.Parser = Parser;
+    State.Program = Program;
+    if (!OptimiseScanTokens(&State, Func->Body.Pos))
+        return NULL;
+
+    State.Tokens = (struct OptToken *)HeapAllocMem(pc, sizeof(struct OptToken) * State.NumTokens);
+    State.MaxEdits = State.NumTokens * 2;
+    State.Edits = (struct OptEdit *)HeapAllocMem(pc, sizeof(struct OptEdit) * State.MaxEdits);
+    State.Locals = (struct OptLocal *)HeapAllocMem(pc, sizeof(struct OptLocal) * (State.NumTokens + Func->NumParams));
+    if (State.Tokens == NULL || State.Edits == NULL || State.Locals == NULL)
+        ProgramFail(Parser, "out of memory");
+
+    OptimiseScanTokens(&State, Func->Body.Pos);
+    for (Count = 0; Count < Func->NumParams; Count++)
+        OptimiseAddLocal(&State, Func->ParamName[Count], (Count < NumBound) ? &Bound[Count] : NULL);
+
+    OptimiseFindEdits(&State);
+    if (State.KeepDeclarations)
+        OptimiseKeepDeclarations(&State);
+
+    if (State.NumEdits > 0)
+    {
+        qsort((void *)State.Edits, State.NumEdits, sizeof(struct OptEdit), OptimiseCompareEdits);
+        NewTokens = (unsigned char *)VariableAlloc(pc, Parser, OptimiseWrite(&State, NULL), TRUE);
+        OptimiseWrite(&State, NewTokens);
+    }
+
+    HeapFreeMem(pc, State.Tokens);
+    HeapFreeMem(pc, State.Edits);
+    HeapFreeMem(pc, State.Locals);
+
+    return NewTokens;
+}
+
+/* replace a body with its optimised version */
+static void OptimiseReplaceBody(struct ParseState *Parser, struct FuncDef *Func, struct OptProgram *Program)
+{
+    unsigned char *NewTokens = OptimiseBody(Parser, Func, Program, NULL, 0);
+
+    if (NewTokens != NULL)
+    {
+        HeapFreeMem(Parser->pc, (void *)Func->Body.Pos);
+        Func->Body.Pos = NewTokens;
+    }
+}
+
+/* fold constants and remove dead code in a function body */
+void OptimiseFunctionBody(struct ParseState *Parser, struct FuncDef *Func)
+{
+    OptimiseReplaceBody(Parser, Func, NULL);
+}
+
+/* note the names a body assigns to, increments, decrements or takes the address of.
+ * Only counts them if there's nowhere to store them yet */
+static void OptimiseScanWrites(struct OptProgram *Program, const unsigned char *Pos)
+{
+    enum LexToken Token;
+    enum LexToken Before = TokenNone;
+    int Brackets = 0;
+    const char *Ident;
+
+    while (TRUE)
+    {
+        Token = (enum LexToken)*Pos;
+        if (Token == TokenEndOfFunction || Token == TokenEOF)
+            return;
+
+        if (Token == TokenIdentifier)
+        {
+            memcpy((void *)&Ident, (void *)(Pos + TOKEN_DATA_OFFSET), sizeof(Ident));
+            if (Ident == Program->MainName)
+                Program->MainCalled = TRUE;
+
+            if (Before == TokenAmpersand || LexIsWrittenTo(Before, Brackets, Pos))
+            {
+                if (Program->Written != NULL)
+                    Program->Written[Program->NumWritten] = Ident;
+
+                Program->NumWritten++;
+            }
+        }
+
+        /* open brackets are looked through to what's before them */
+        if (Token == TokenOpenBracket)
+            Brackets++;
+        else if (Token != TokenEndOfLine)
+        {
+            Before = Token;
+            Brackets = 0;
+        }
+
+        Pos += TOKEN_DATA_OFFSET + LexTokenSize(Token);
+    }
+}
+
+/* look through all the script's functions and macros for anything which changes its globals */
+static void OptimiseScanProgram(Picoc *pc, struct OptProgram *Program)
+{
+    struct TableEntry *Entry;
+    struct Value *Val;
+    int Count;
+
+    Program->NumWritten = 0;
+    for (Count = 0; Count < pc->GlobalTable.Size; Count++)
+    {
+        for (Entry = pc->GlobalTable.HashTable[Count]; Entry != NULL; Entry = Entry->Next)
+        {
+            Val = Entry->p.v.Val;
+            if (Val->Typ == &pc->FunctionType)
+            {
+                if (Val->Val->FuncDef->Intrinsic == NULL && Val->Val->FuncDef->Body.Pos != NULL)
+                    OptimiseScanWrites(Program, Val->Val->FuncDef->Body.Pos);
+            }
+            else if (Val->Typ == &pc->MacroType)
+                OptimiseScanWrites(Program, Val->Val->MacroDef->Body.Pos);
+
+            else if (Entry->DeclFileName == Program->FileName)
+            {
+                switch (Val->Typ->Base)
+                {
+                    case TypePointer: case TypeArray: case TypeStruct: case TypeUnion:
+                        Program->GlobalsAliased = TRUE;
+                        break;
+
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+}
+
+/* gather what's known about the program as a whole, returns main's value or NULL if there isn't one */
+static struct Value *OptimiseBeginProgram(Picoc *pc, struct OptProgram *Program)
+{
+    struct Value *MainValue;
+    int DeclLine;
+    int DeclColumn;
+
+    memset((void *)Program, '\0', sizeof(*Program));
+    Program->MainName = TableStrRegister(pc, "main");
+    if (!TableGet(pc, &pc->GlobalTable, Program->MainName, &MainValue, &Program->FileName, &DeclLine, &DeclColumn) || MainValue->Typ != &pc->FunctionType)
+        return NULL;
+
+    /* count the names which are written to, then collect them */
+    OptimiseScanProgram(pc, Program);
+    Program->Written = (const char **)HeapAllocMem(pc, sizeof(const char *) * (Program->NumWritten + 1));
+    if (Program->Written == NULL)
+        ProgramFailNoParser(pc, "out of memory");
+
+    OptimiseScanProgram(pc, Program);
+    return MainValue;
+}
+
+/* specialise every function in the script for a batch of evaluations. This is called once the
+ * program has been loaded and before the first evaluation, so anything which only depends on
+ * tweakables, constants and globals is worked out once for the batch instead of every sample */
+void OptimiseProgram(Picoc *pc)
+{
+    struct OptProgram Program;
+    struct ParseState Parser;
+    struct TableEntry *Entry;
+    struct Value *Val;
+    int Count;
+
+    if (OptimiseBeginProgram(pc, &Program) == NULL)
+        return;
+
+    for (Count = 0; Count < pc->GlobalTable.Size; Count++)
+    {
+        for (Entry = pc->GlobalTable.HashTable[Count]; Entry != NULL; Entry = Entry->Next)
+        {
+            Val = Entry->p.v.Val;
+            if (Val->Typ == &pc->FunctionType && Entry->DeclFileName == Program.FileName)
+            {
+                ParserCopy(&Parser, &Val->Val->FuncDef->Body);
+                OptimiseReplaceBody(&Parser, Val->Val->FuncDef, &Program);
+            }
+        }
+    }
+
+    HeapFreeMem(pc, (void *)Program.Written);
+}
+
+/* nothing has been specialised for a row yet */
+void OptimiseInit(Picoc *pc)
+{
+    pc->OptimiseBatchBody = NULL;
+    pc->OptimiseRowsUnfit = FALSE;
+}
+
+/* go back to main's body as it was specialised for the whole batch */
+static void OptimiseRestoreBatchBody(Picoc *pc, struct FuncDef *Func)
+{
+    if (pc->OptimiseBatchBody == NULL)
+        pc->OptimiseBatchBody = Func->Body.Pos;
+
+    else if (Func->Body.Pos != pc->OptimiseBatchBody)
+    {
+        HeapFreeMem(pc, (void *)Func->Body.Pos);
+        Func->Body.Pos = pc->OptimiseBatchBody;
+    }
+}
+
+/* specialise main for a row of a surface, where the first argument stays the same and only the
+ * second one changes. Anything which depends only on the first argument is then worked out once
+ * per row instead of for every point. Returns FALSE if main's body is the same as for the last
+ * row, so what was compiled from it still holds */
+int OptimiseRow(Picoc *pc)
+{
+    struct OptProgram Program;
+    struct ParseState Parser;
+    struct OptConst Bound;
+    struct Value *MainValue;
+    struct Value *ArgValue;
+    struct FuncDef *Func;
+    unsigned char *NewTokens;
+    int WasSpecialised;
+
+    /* what rules a program out doesn't change from row to row */
+    if (pc->OptimiseRowsUnfit)
+        return FALSE;
+
+    if (!TableGet(pc, &pc->GlobalTable, TableStrRegister(pc, "main"), &MainValue, NULL, NULL, NULL) || MainValue->Typ != &pc->FunctionType)
+        return FALSE;
+
+    /* start again from the batch body, the last row's may have lost code which writes to variables */
+    Func = MainValue->Val->FuncDef;
+    if (Func->Body.Pos == NULL)
+        return FALSE;
+
+    WasSpecialised = pc->OptimiseBatchBody != NULL && Func->Body.Pos != pc->OptimiseBatchBody;
+    OptimiseRestoreBatchBody(pc, Func);
+    OptimiseBeginProgram(pc, &Program);
+
+    if (Func->NumParams == 2 && Func->ParamType[0] == &pc->FPType && !Program.MainCalled &&
+            !OptimiseProgramWrites(&Program, Func->ParamName[0]) &&
+            TableGet(pc, &pc->GlobalTable, TableStrRegister(pc, "__arg1"), &ArgValue, NULL, NULL, NULL))
+    {
+        Bound.IsFP = TRUE;
+        Bound.FP = ArgValue->Val->FP;
+        ParserCopy(&Parser, &Func->Body);
+        NewTokens = OptimiseBody(&Parser, Func, &Program, &Bound, 1);
+        if (NewTokens != NULL)
+            Func->Body.Pos = NewTokens;
+    }
+    else
+        pc->OptimiseRowsUnfit = TRUE;
+
+    HeapFreeMem(pc, (void *)Program.Written);
+
+    /* a new row body may be where the last one was freed, so only the batch body twice is the same */
+    return WasSpecialised || Func->Body.Pos != pc->OptimiseBatchBody;
+}
+
+/* put main's batch body back so it's freed along with the function */
+void OptimiseCleanup(Picoc *pc)
+{
+    struct Value *MainValue;
+
+    if (pc->OptimiseBatchBody == NULL)
+        return;
+
+    if (TableGet(pc, &pc->GlobalTable, TableStrRegister(pc, "main"), &MainValue, NULL, NULL, NULL) && MainValue->Typ == &pc->FunctionType)
+        OptimiseRestoreBatchBody(pc, MainValue->Val->FuncDef);
+
+    pc->OptimiseBatchBody = NULL;
+}
@@ -2,6 +2,7 @@
 
 #include "picoc.h"
 #include "interpreter.h"
+#include "Trace.h"
 
 bool gResetParser = false;
 
@@ -79,22 +80,28 @@ struct Value *ParseFunctionDefinition(struct ParseState *Parser, struct ValueTyp
     if (ParamCount > PARAMETER_MAX)
         ProgramFail(Parser, "too many parameters (" + std::to_string(PARAMETER_MAX) + " allowed)");
     
-    FuncValue = VariableAllocValueAndData(pc, Parser, sizeof(struct FuncDef) + sizeof(struct ValueType *) * ParamCount + sizeof(const char *) * ParamCount, FALSE, NULL, TRUE);
+    /* the definition lives out of line so the value itself only holds a pointer to it */
+    FuncValue = VariableAllocValueAndData(pc, Parser, sizeof(struct FuncDef *), FALSE, NULL, TRUE);
     FuncValue->Typ = &pc->FunctionType;
-    FuncValue->Val->FuncDef.ReturnType = ReturnType;
-    FuncValue->Val->FuncDef.NumParams = ParamCount;
-    FuncValue->Val->FuncDef.VarArgs = FALSE;
-    FuncValue->Val->FuncDef.ParamType = (struct ValueType **)((char *)FuncValue->Val + sizeof(struct FuncDef));
-    FuncValue->Val->FuncDef.ParamName = (char **)((char *)FuncValue->Val->FuncDef.ParamType + sizeof(struct ValueType *) * ParamCount);
+    FuncValue->Val->FuncDef = (struct FuncDef *)HeapAllocMem(pc, sizeof(struct FuncDef) + sizeof(struct ValueType *) * ParamCount + sizeof(const char *) * ParamCount);
+    if (FuncValue->Val->FuncDef == NULL)
+        ProgramFail(Parser, "out of memory");
+    FuncValue->Val->FuncDef->ReturnType = ReturnType;
+    FuncValue->Val->FuncDef->NumParams = ParamCount;
+    FuncValue->Val->FuncDef->VarArgs = FALSE;
+    FuncValue->Val->FuncDef->Purity = PurityImpure;
+    FuncValue->Val->FuncDef->Memo = NULL;
+    FuncValue->Val->FuncDef->ParamType = (struct ValueType **)((char *)FuncValue->Val->FuncDef + sizeof(struct FuncDef));
+    FuncValue->Val->FuncDef->ParamName = (char **)((char *)FuncValue->Val->FuncDef->ParamType + sizeof(struct ValueType *) * ParamCount);
    
-    for (ParamCount = 0; ParamCount < FuncValue->Val->FuncDef.NumParams; ParamCount++)
+    for (ParamCount = 0; ParamCount < FuncValue->Val->FuncDef->NumParams; ParamCount++)
     { 
         /* harvest the parameters into the function definition */
-        if (ParamCount == FuncValue->Val->FuncDef.NumParams-1 && LexGetToken(&ParamParser, NULL, FALSE) == TokenEllipsis)
+        if (ParamCount == FuncValue->Val->FuncDef->NumParams-1 && LexGetToken(&ParamParser, NULL, FALSE) == TokenEllipsis)
         { 
             /* ellipsis at end */
-            FuncValue->Val->FuncDef.NumParams--;
-            FuncValue->Val->FuncDef.VarArgs = TRUE;
+            FuncValue->Val->FuncDef->NumParams--;
+            FuncValue->Val->FuncDef->VarArgs = TRUE;
             break;
         }
         else
@@ -105,30 +112,30 @@ struct Value *ParseFunctionDefinition(struct ParseState *Parser, struct ValueTyp
             {
                 /* this isn't a real parameter at all - delete it */
                 ParamCount--;
-                FuncValue->Val->FuncDef.NumParams--;
+                FuncValue->Val->FuncDef->NumParams--;
             }
             else
             {
-                FuncValue->Val->FuncDef.ParamType[ParamCount] = ParamType;
-                FuncValue->Val->FuncDef.ParamName[ParamCount] = ParamIdentifier;
+                FuncValue->Val->FuncDef->ParamType[ParamCount] = ParamType;
+                FuncValue->Val->FuncDef->ParamName[ParamCount] = ParamIdentifier;
             }
         }
         
         Token = LexGetToken(&ParamParser, NULL, TRUE);
-        if (Token != TokenComma && ParamCount < FuncValue->Val->FuncDef.NumParams-1)
+        if (Token != TokenComma && ParamCount < FuncValue->Val->FuncDef->NumParams-1)
             ProgramFail(&ParamParser, "comma expected");
     }
     
-    if (FuncValue->Val->FuncDef.NumParams != 0 && Token != TokenCloseBracket && Token != TokenComma && Token != TokenEllipsis)
+    if (FuncValue->Val->FuncDef->NumParams != 0 && Token != TokenCloseBracket && Token != TokenComma && Token != TokenEllipsis)
         ProgramFail(&ParamParser, "bad parameter");
     
     if (strcmp(Identifier, "main") == 0)
     {
         /* make sure it's int main() */
-        if ( FuncValue->Val->FuncDef.ReturnType != &pc->FPType )
+        if ( FuncValue->Val->FuncDef->ReturnType != &pc->FPType )
             ProgramFail(Parser, "main() should return a double");
 
-        if (FuncValue->Val->FuncDef.NumParams == 0 || FuncValue->Val->FuncDef.ParamType[0] != &pc->FPType)
+        if (FuncValue->Val->FuncDef->NumParams == 0 || FuncValue->Val->FuncDef->ParamType[0] != &pc->FPType)
             ProgramFail(Parser, "bad parameters to main()");
     }
     
@@ -146,16 +153,18 @@ struct Value *ParseFunctionDefinition(struct ParseState *Parser, struct ValueTyp
         if (ParseStatementMaybeRun(Parser, FALSE, TRUE) != ParseResultOk)
             ProgramFail(Parser, "function definition expected");
 
-        FuncValue->Val->FuncDef.Body = FuncBody;
-        FuncValue->Val->FuncDef.Body.Pos = (unsigned char*)LexCopyTokens(&FuncBody, Parser);
+        FuncValue->Val->FuncDef->Body = FuncBody;
+        FuncValue->Val->FuncDef->Body.Pos = (unsigned char*)LexCopyTokens(&FuncBody, Parser);
+        OptimiseFunctionBody(Parser, FuncValue->Val->FuncDef);
 
         /* is this function already in the global table? */
-        if (TableGet(&pc->GlobalTable, Identifier, &OldFuncValue, NULL, NULL, NULL))
+        if (TableGet(pc, &pc->GlobalTable, Identifier, &OldFuncValue, NULL, NULL, NULL))
         {
-            if (OldFuncValue->Val->FuncDef.Body.Pos == NULL)
+            if (OldFuncValue->Val->FuncDef->Body.Pos == NULL)
             {
-                /* override an old function prototype */
+                /* override an old function prototype, forgetting any calls which found it */
                 VariableFree(pc, TableDelete(pc, &pc->GlobalTable, Identifier));
+                memset((void *)&pc->CallSiteCache[0], '\0', sizeof(pc->CallSiteCache));
             }
             else
                 ProgramFail(Parser, "'" + std::string(Identifier)  + "' is already defined");
@@ -362,6 +371,19 @@ int ParseDeclaration(struct ParseState *Parser, enum LexToken Token)
     return TRUE;
 }
 
+/* allocate a macro value along with its out of line definition */
+static struct Value *ParseAllocMacro(struct ParseState *Parser, int NumParams)
+{
+    struct Value *MacroValue = VariableAllocValueAndData(Parser->pc, Parser, sizeof(struct MacroDef *), FALSE, NULL, TRUE);
+
+    MacroValue->Val->MacroDef = (struct MacroDef *)HeapAllocMem(Parser->pc, sizeof(struct MacroDef) + sizeof(const char *) * NumParams);
+    if (MacroValue->Val->MacroDef == NULL)
+        ProgramFail(Parser, "out of memory");
+
+    MacroValue->Val->MacroDef->NumParams = NumParams;
+    return MacroValue;
+}
+
 /* parse a #define macro definition and store it for later */
 void ParseMacroDefinition(struct ParseState *Parser)
 {
@@ -385,16 +407,15 @@ void ParseMacroDefinition(struct ParseState *Parser)
         
         ParserCopy(&ParamParser, Parser);
         NumParams = ParseCountParams(&ParamParser);
-        MacroValue = VariableAllocValueAndData(Parser->pc, Parser, sizeof(struct MacroDef) + sizeof(const char *) * NumParams, FALSE, NULL, TRUE);
-        MacroValue->Val->MacroDef.NumParams = NumParams;
-        MacroValue->Val->MacroDef.ParamName = (char **)((char *)MacroValue->Val + sizeof(struct MacroDef));
+        MacroValue = ParseAllocMacro(Parser, NumParams);
+        MacroValue->Val->MacroDef->ParamName = (char **)((char *)MacroValue->Val->MacroDef + sizeof(struct MacroDef));
 
         Token = LexGetToken(Parser, &ParamName, TRUE);
         
         while (Token == TokenIdentifier)
         {
             /* store a parameter name */
-            MacroValue->Val->MacroDef.ParamName[ParamCount++] = ParamName->Val->Identifier;
+            MacroValue->Val->MacroDef->ParamName[ParamCount++] = ParamName->Val->Identifier;
             
             /* get the trailing comma */
             Token = LexGetToken(Parser, NULL, TRUE);
@@ -411,15 +432,14 @@ void ParseMacroDefinition(struct ParseState *Parser)
     else
     {
         /* allocate a simple unparameterised macro */
-        MacroValue = VariableAllocValueAndData(Parser->pc, Parser, sizeof(struct MacroDef), FALSE, NULL, TRUE);
-        MacroValue->Val->MacroDef.NumParams = 0;
+        MacroValue = ParseAllocMacro(Parser, 0);
     }
     
     /* copy the body of the macro to execute later */
-    ParserCopy(&MacroValue->Val->MacroDef.Body, Parser);
+    ParserCopy(&MacroValue->Val->MacroDef->Body, Parser);
     MacroValue->Typ = &Parser->pc->MacroType;
     LexToEndOfLine(Parser);
-    MacroValue->Val->MacroDef.Body.Pos = (unsigned char*)LexCopyTokens(&MacroValue->Val->MacroDef.Body, Parser);
+    MacroValue->Val->MacroDef->Body.Pos = (unsigned char*)LexCopyTokens(&MacroValue->Val->MacroDef->Body, Parser);
     
     if (!TableSet(Parser->pc, &Parser->pc->GlobalTable, MacroNameStr, MacroValue, (char *)Parser->FileName, Parser->Line, Parser->CharacterPos))
 		ProgramFail(Parser, "'" + std::string(MacroNameStr) + "' is already defined");
@@ -590,6 +610,11 @@ enum ParseResult ParseStatement(struct ParseState *Parser, int CheckTrailingSemi
     /* take note of where we are and then grab a token to see what statement we have */   
     ParserCopy(&PreState, Parser);
     Token = LexGetToken(Parser, &LexerValue, TRUE);
+
+    /* if we're profiling, count the statement against the line it starts on. The brace
+     * ending a block is parsed as one but isn't */
+    if (Parser->pc->Profile != NULL && Parser->Mode == RunModeRun && Token != TokenEOF && Token != TokenRightBrace)
+        ProfileStatement(Parser);
     
     switch (Token)
     {
@@ -954,8 +979,14 @@ void PicocParse(Picoc *pc, const char *FileName, const char *Source, int SourceL
     enum ParseResult Ok;
     struct CleanupTokenNode *NewCleanupNode;
     char *RegFileName = TableStrRegister(pc, FileName);
+    double StartTime = PlatformTime();
+    double TraceStart = pc->TraceParse ? Trace::now() : 0;
     
     void *Tokens = LexAnalyse(pc, RegFileName, Source, SourceLen, NULL);
+    double LexedTime = PlatformTime();
+    pc->LexTime += LexedTime - StartTime;
+    if (pc->TraceParse)
+        Trace::complete("LexAnalyse", "interpreter", TraceStart);
     
     /* allocate a cleanup node so we can clean up the tokens later */
     if (!CleanupNow)
@@ -981,12 +1012,20 @@ void PicocParse(Picoc *pc, const char *FileName, const char *Source, int SourceL
 		if (gResetParser)
 			ProgramFail(&Parser, "Reset");
 
+        /* each of the program's declarations and definitions, main's among them */
+        double StatementStart = pc->TraceParse ? Trace::now() : 0;
         Ok = ParseStatement(&Parser, TRUE);
+        if (pc->TraceParse)
+            Trace::complete("ParseStatement", "interpreter", StatementStart);
     } while (Ok == ParseResultOk);
     
     if (Ok == ParseResultError)
         ProgramFail(&Parser, "parse error");
     
+    pc->ParseTime += PlatformTime() - LexedTime;
+    if (pc->TraceParse)
+        Trace::complete("PicocParse", "interpreter", TraceStart);
+
     /* clean up */
     if (CleanupNow)
         HeapFreeMem(pc, Tokens);
@@ -17,8 +17,26 @@
 
 double PicocEvaluate(Picoc& pc, int paramCount, std::string &errorBuffer)
 {
+	/* a profiled program is always interpreted, for its lines to be seen */
+	if (pc.Profile == NULL)
+	{
+		/* a program built with the system's compiler is called directly */
+		if (pc.NativeMain1 != NULL)
+			return pc.NativeMain1(pc.NativeArg[0]);
+
+		if (pc.NativeMain2 != NULL)
+			return pc.NativeMain2(pc.NativeArg[0], pc.NativeArg[1]);
+
+		/* compiled main hands an evaluation back to the interpreter if it can't finish it */
+		if (pc.JitMain != NULL && pc.JitMain(&pc.PicocExitValue))
+			return pc.PicocExitValue;
+	}
+
+	StatsBegin(&pc);
 	if (PicocPlatformSetExitPoint(&pc))
 	{
+		ProfileEndTiming(&pc);
+		StatsEnd(&pc);
 		errorBuffer = pc.ErrorBuffer;
 		if (errorBuffer.empty())
 			errorBuffer = "unknown error";
@@ -29,7 +47,88 @@ double PicocEvaluate(Picoc& pc, int paramCount, std::string &errorBuffer)
 		PicocParse(&pc, "startup", CALL_MAIN_WITH_ARGS_RETURN_DOUBLE, strlen(CALL_MAIN_WITH_ARGS_RETURN_DOUBLE), TRUE, TRUE, FALSE);
 	else if (paramCount == 2)
 		PicocParse(&pc, "startup", CALL_MAIN_WITH_2ARGS_RETURN_DOUBLE, strlen(CALL_MAIN_WITH_2ARGS_RETURN_DOUBLE), TRUE, TRUE, FALSE);
-    
+
+	ProfileEndTiming(&pc);
+	StatsEnd(&pc);
     return pc.PicocExitValue;
 }
 
+/* called by two-argument programs when the first argument changes. Everything which only
+ * depends on it is worked out here instead of for every evaluation along the row */
+void PicocPrepareRow(Picoc& pc, std::string &errorBuffer)
+{
+	/* a natively built program does all its own work */
+	if (pc.NativeLibrary != NULL)
+		return;
+
+	if (PicocPlatformSetExitPoint(&pc))
+	{
+		errorBuffer = pc.ErrorBuffer;
+		if (errorBuffer.empty())
+			errorBuffer = "unknown error";
+		return;
+	}
+
+	if (OptimiseRow(&pc))
+		JitCompileMain(&pc);
+}
+
+/* evaluate main for a whole row of values of its last argument at once. Returns false if
+ * they have to be evaluated one at a time instead */
+bool PicocEvaluateVector(Picoc& pc, const double *lastArg, double *result, int count)
+{
+	/* a natively built or profiled program is called for each value */
+	if (pc.NativeLibrary != NULL || pc.Profile != NULL)
+		return false;
+
+	return VectorEvaluate(&pc, lastArg, result, count) != FALSE;
+}
+
+/* the same, also giving the derivatives of main by its last and first argument, which dFirst
+ * may be NULL to leave out. Returns false if main can't be differentiated */
+bool PicocEvaluateGradient(Picoc& pc, const double *lastArg, double *result, double *dLast, double *dFirst, int count)
+{
+	if (pc.NativeLibrary != NULL || pc.Profile != NULL)
+		return false;
+
+	return GradientEvaluate(&pc, lastArg, result, dLast, dFirst, count) != FALSE;
+}
+
+/* evaluate a main of two arguments at points scattered over both of them, given by firstArg
+ * and lastArg, without preparing a row for each. Returns false if they have to be evaluated
+ * one at a time instead */
+bool PicocEvaluatePoints(Picoc& pc, const double *firstArg, const double *lastArg, double *result, int count)
+{
+	if (pc.NativeLibrary != NULL || pc.Profile != NULL)
+		return false;
+
+	return VectorEvaluatePoints(&pc, firstArg, lastArg, result, count) != FALSE;
+}
+
+/* bound main over boxes of its arguments, from lastLow to lastHigh and firstLow to firstHigh,
+ * which may be NULL to leave the first argument as it is. Each box's bounds hold every value
+ * main has in it, they're NaN if it has none. Returns false if main can't be bounded */
+bool PicocEvaluateInterval(Picoc& pc, const double *lastLow, const double *lastHigh, const double *firstLow, const double *firstHigh, double *low, double *high, int count)
+{
+	if (pc.NativeLibrary != NULL || pc.Profile != NULL)
+		return false;
+
+	return IntervalEvaluate(&pc, lastLow, lastHigh, firstLow, firstHigh, low, high, count) != FALSE;
+}
+
+/* count how often each line of the program runs and estimate how long it takes, in profile,
+ * from now on, or stop with NULL. Call it once the program is initialised. The evaluations
+ * are all interpreted while it's profiled, the functions working on many values at once
+ * return false */
+void PicocProfile(Picoc& pc, struct LineProfile *profile)
+{
+	ProfileStart(&pc, profile);
+}
+
+/* what the interpreter did in the last evaluation it interpreted, or in initialising the
+ * program before the first, and since it was initialised, into whichever of last and total
+ * isn't NULL. Returns false when it wasn't built with FEATURE_STATS to count them */
+bool PicocGetStats(Picoc& pc, struct PicocStats *last, struct PicocStats *total)
+{
+	return StatsGet(&pc, last, total) != FALSE;
+}
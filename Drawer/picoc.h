@@ -19,6 +19,13 @@
 #include "interpreter.h"
 
 double PicocEvaluate(Picoc& pc, int paramCount, std::string &errorBuffer);
+void PicocPrepareRow(Picoc& pc, std::string &errorBuffer);
+bool PicocEvaluateVector(Picoc& pc, const double *lastArg, double *result, int count);
+bool PicocEvaluateGradient(Picoc& pc, const double *lastArg, double *result, double *dLast, double *dFirst, int count);
+bool PicocEvaluatePoints(Picoc& pc, const double *firstArg, const double *lastArg, double *result, int count);
+bool PicocEvaluateInterval(Picoc& pc, const double *lastLow, const double *lastHigh, const double *firstLow, const double *firstHigh, double *low, double *high, int count);
+void PicocProfile(Picoc& pc, struct LineProfile *profile);
+bool PicocGetStats(Picoc& pc, struct PicocStats *last, struct PicocStats *total);
 
 #include <setjmp.h>
 
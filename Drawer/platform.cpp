@@ -3,6 +3,7 @@
  
 #include "picoc.h"
 #include "interpreter.h"
+#include "Trace.h"
 
 #define PICOC_STACK_SIZE (128*1024)              /* space for the the stack */
 
@@ -12,9 +13,12 @@ extern bool gResetParser;
 void PicocInitialise(Picoc *pc, double* arg, int paramCount, const std::string &SourceCode, std::vector<Tweakable>& tweakables, std::string &errorBuffer)
 {
 	gResetParser = false;
+	double TraceStart = Trace::now();
 
 	if (PicocPlatformSetExitPoint(pc))
 	{
+		pc->TraceParse = FALSE;
+		StatsEnd(pc);
 		errorBuffer = pc->ErrorBuffer;
 		if (errorBuffer.empty())
 			errorBuffer = "unknown error";
@@ -24,10 +28,14 @@ void PicocInitialise(Picoc *pc, double* arg, int paramCount, const std::string &
     PlatformInit(pc);
     BasicIOInit(pc);
     HeapInit(pc, PICOC_STACK_SIZE);
+    StatsInit(pc, PICOC_STACK_SIZE);
     TableInit(pc);
     VariableInit(pc);
     LexInit(pc);
     TypeInit(pc);
+    OptimiseInit(pc);
+    JitInit(pc);
+    NativeInit(pc);
 #ifndef NO_HASH_INCLUDE
     IncludeInit(pc);
 #endif
@@ -42,7 +50,12 @@ void PicocInitialise(Picoc *pc, double* arg, int paramCount, const std::string &
 #endif
     DebugInit(pc);
 
+	/* only the program's own parsing is timed, with the headers it includes */
+	pc->LexTime = 0;
+	pc->ParseTime = 0;
+	pc->TraceParse = Trace::enabled();
 	PicocParse(pc, "main.c", SourceCode.c_str(), SourceCode.size(), TRUE, FALSE, FALSE);
+	pc->TraceParse = FALSE;
 
 	/* check if the program wants arguments */
 	if (!VariableDefined(pc, TableStrRegister(pc, "main")))
@@ -53,7 +66,7 @@ void PicocInitialise(Picoc *pc, double* arg, int paramCount, const std::string &
 	if (FuncValue->Typ->Base != TypeFunction)
 		ProgramFailNoParser(pc, "main is not a function - can't call it");
 
-	if (FuncValue->Val->FuncDef.ReturnType != &pc->FPType)
+	if (FuncValue->Val->FuncDef->ReturnType != &pc->FPType)
 	{
 		ProgramFailNoParser(pc, "main function must return a double");
 	}
@@ -63,33 +76,51 @@ void PicocInitialise(Picoc *pc, double* arg, int paramCount, const std::string &
 	if (paramCount == 1)
 	{
 		
-		if (FuncValue->Val->FuncDef.NumParams != 0)
+		if (FuncValue->Val->FuncDef->NumParams != 0)
 		{
 			/* define the arguments */
 			VariableDefinePlatformVar(pc, NULL, "__arg", &pc->FPType, (union AnyValue *)arg, FALSE);
 		}
 
-		if (FuncValue->Val->FuncDef.NumParams != 1)// || FuncValue->Val->FuncDef.ParamType != &pc->FPType)
+		if (FuncValue->Val->FuncDef->NumParams != 1)// || FuncValue->Val->FuncDef->ParamType != &pc->FPType)
 			ProgramFailNoParser(pc, "main function must take a double as a param");
 	}
 	else
 	{
 
-		if (FuncValue->Val->FuncDef.NumParams != 0)
+		if (FuncValue->Val->FuncDef->NumParams != 0)
 		{
 			/* define the arguments */
 			VariableDefinePlatformVar(pc, NULL, "__arg1", &pc->FPType, (union AnyValue *)arg, FALSE);
 			VariableDefinePlatformVar(pc, NULL, "__arg2", &pc->FPType, (union AnyValue *)(&arg[1]), FALSE);
 		}
 
-		if (FuncValue->Val->FuncDef.NumParams != 2)// || FuncValue->Val->FuncDef.ParamType != &pc->FPType)
+		if (FuncValue->Val->FuncDef->NumParams != 2)// || FuncValue->Val->FuncDef->ParamType != &pc->FPType)
 			ProgramFailNoParser(pc, "main function must take two double as a param");
 	}
+
+	/* tweakables and globals won't change until the next batch, work out what depends only on them */
+	double CompileStart = PlatformTime();
+	double TraceCompileStart = Trace::now();
+	OptimiseProgram(pc);
+	PurityAnalyse(pc);
+	JitCompileMain(pc);
+	JitCompileBatch(pc);
+
+	/* the program has been checked, it can be built natively if that's been asked for */
+	NativeCompileProgram(pc, arg, paramCount, SourceCode, tweakables);
+	pc->CompileTime = PlatformTime() - CompileStart;
+	Trace::complete("compile", "interpreter", TraceCompileStart);
+	Trace::complete("PicocInitialise", "interpreter", TraceStart);
+	StatsEnd(pc);
 }
 
 /* free memory */
 void PicocCleanup(Picoc *pc)
 {
+    OptimiseCleanup(pc);
+    JitCleanup(pc);
+    NativeCleanup(pc);
     DebugCleanup(pc);
 #ifndef NO_HASH_INCLUDE
     IncludeCleanup(pc);
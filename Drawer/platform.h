@@ -27,6 +27,22 @@
 #define LINEBUFFER_MAX 256                  /* maximum number of characters on a line */
 #define LOCAL_TABLE_SIZE 11                 /* size of local variable table (can expand) */
 #define STRUCT_TABLE_SIZE 11                /* size of struct/union member table (can expand) */
+#define CALL_SITE_CACHE_SIZE 64             /* number of resolved function calls remembered */
+#define VECTOR_LANES 8                      /* number of values the vector evaluator works on together */
+#define MEMO_TABLE_SIZE 128                 /* number of results remembered for each pure function */
+#define MEMO_PARAMS_MAX 4                   /* most parameters a function can have for its results to be remembered */
+#if (defined(_M_X64) || defined(__x86_64__)) && !defined(NO_JIT)
+#define FEATURE_JIT                         /* compile main() to native code when it's simple enough */
+#endif
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+#define VECTOR_TARGET __attribute__((target_clones("avx2", "default")))   /* an AVX2 version of the vector loops is picked at load time */
+#else
+#define VECTOR_TARGET                       /* vector loops are built for whatever the compiler's flags allow */
+#endif
+#if !defined(_WIN32) && !defined(NO_NATIVE_COMPILE)
+#define FEATURE_NATIVE_COMPILE              /* build programs with the system's C compiler on request */
+#endif
+/* FEATURE_STATS, defined by the build, counts the interpreter's work in Picoc's Stats */
 
 #define INTERACTIVE_PROMPT_START "starting picoc " PICOC_VERSION "\n"
 #define INTERACTIVE_PROMPT_STATEMENT "picoc> "
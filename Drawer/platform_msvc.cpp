@@ -1,5 +1,6 @@
 #include "picoc.h"
 #include "interpreter.h"
+#include <chrono>
 
 /* mark where to end the program for platforms which require this */
 jmp_buf PicocExitBuf;
@@ -80,6 +81,12 @@ void PicocPlatformScanFile(Picoc *pc, const char *SourceStr)
     PicocParse(pc, "main.c", SourceStr, strlen(SourceStr), TRUE, FALSE, TRUE);
 }
 
+/* a steady clock, in seconds */
+double PlatformTime()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 /* exit the program */
 void PlatformExit(Picoc *pc, int RetVal)
 {
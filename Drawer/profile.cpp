@@ -0,0 +1,75 @@
+/* picoc line profiler - counts the statements started on each line of the
+ * program as it's interpreted, and times a random sample of them to tell
+ * which lines the time goes to without reading the clock for each one */
+
+#include "interpreter.h"
+
+#define PROFILE_SAMPLE_INTERVAL 64          /* statements between timed ones, on average */
+
+/* how many statements until the next one is timed, from 1 to twice the interval so that
+ * loops whose length divides the interval aren't always timed on the same line */
+static int ProfileNextCountdown(struct LineProfile *Profile)
+{
+    /* xorshift, it only has to be quick and not follow the program's own patterns */
+    Profile->Random ^= Profile->Random << 13;
+    Profile->Random ^= Profile->Random >> 17;
+    Profile->Random ^= Profile->Random << 5;
+    return 1 + Profile->Random % (2 * PROFILE_SAMPLE_INTERVAL - 1);
+}
+
+/* count the lines of the program already parsed into Profile from now on, or stop counting
+ * when it's NULL */
+void ProfileStart(Picoc *pc, struct LineProfile *Profile)
+{
+    pc->Profile = Profile;
+    if (Profile == NULL)
+        return;
+
+    Profile->Hits.clear();
+    Profile->Time.clear();
+    Profile->FileName = TableStrRegister(pc, "main.c");
+    Profile->Random = 2463534242u;
+    Profile->Countdown = ProfileNextCountdown(Profile);
+    Profile->TimedLine = 0;
+}
+
+/* called as each statement starts running */
+void ProfileStatement(struct ParseState *Parser)
+{
+    struct LineProfile *Profile = Parser->pc->Profile;
+    int Line = Parser->Line;
+
+    /* the statement being timed ends where this one starts */
+    if (Profile->TimedLine != 0)
+        ProfileEndTiming(Parser->pc);
+
+    if (Parser->FileName != Profile->FileName || Line < 1)
+        return;
+
+    if ((int)Profile->Hits.size() < Line)
+    {
+        Profile->Hits.resize(Line, 0);
+        Profile->Time.resize(Line, 0.0);
+    }
+    Profile->Hits[Line-1]++;
+
+    if (--Profile->Countdown == 0)
+    {
+        Profile->Countdown = ProfileNextCountdown(Profile);
+        Profile->TimedLine = Line;
+        Profile->TimedStart = PlatformTime();
+    }
+}
+
+/* the statement being timed is over, at the start of the next one or at the end of the
+ * evaluation, the last statement of which shouldn't be charged for what's done between two */
+void ProfileEndTiming(Picoc *pc)
+{
+    struct LineProfile *Profile = pc->Profile;
+
+    if (Profile == NULL || Profile->TimedLine == 0)
+        return;
+
+    Profile->Time[Profile->TimedLine-1] += (PlatformTime() - Profile->TimedStart) * PROFILE_SAMPLE_INTERVAL;
+    Profile->TimedLine = 0;
+}
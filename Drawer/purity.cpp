@@ -0,0 +1,564 @@
+/* picoc purity analysis - works out what the result of each of the script's functions
+ * depends on, so evaluations are only cached, reordered or run side by side when that
+ * can't change what they give.
+ *
+ * It works on the token streams of the bodies once the program has been loaded. A function
+ * is pure if it has no static locals, writes no globals, reads no global which anything
+ * writes to and only calls pure functions. Pointers could reach anything, so using them at
+ * all counts as keeping state. Library functions are pure if they're marked so, anything
+ * else they do is taken to be talking to the outside world, as rand(), time() and printf()
+ * do. Calls between the script's functions are settled by starting them all as pure and
+ * making them worse until nothing changes.
+ *
+ * Pure functions then get a table of results by arguments, so a helper called again with
+ * the same values doesn't run again. A program is loaded afresh whenever it or a tweakable
+ * changes, which starts the tables empty */
+
+#include "interpreter.h"
+
+#define TOKEN_DATA_OFFSET 2
+#define PURITY_MACRO_DEPTH_MAX 8            /* how deeply macros can use other macros before we give up */
+
+/* a token of the body being looked at */
+struct PurityToken
+{
+    enum LexToken Token;
+    const char *Ident;                      /* the registered name of an identifier, or NULL */
+    const unsigned char *Pos;               /* where it is in the body's tokens */
+};
+
+/* a parameter or local variable which is in scope */
+struct PurityLocal
+{
+    const char *Name;
+    int Depth;
+};
+
+struct PurityState
+{
+    Picoc *pc;
+    const char **Written;                   /* globals which are assigned to or incremented somewhere */
+    int NumWritten;
+    int Collecting;                         /* only gathering the writes, NULL Written just counts them */
+};
+
+/* the function or macro body being looked at */
+struct PurityBody
+{
+    struct PurityToken *Tokens;
+    int NumTokens;
+    struct PurityLocal *Locals;
+    int NumLocals;
+    int Depth;
+};
+
+static enum FuncPurity PurityScan(struct PurityState *State, const unsigned char *Pos, struct FuncDef *Func, int MacroDepth);
+
+
+static enum FuncPurity PurityWorst(enum FuncPurity A, enum FuncPurity B)
+{
+    return (A > B) ? A : B;
+}
+
+/* read the tokens of a body up to its end, leaving out line breaks. Tokens is NULL to count them */
+static int PurityReadTokens(const unsigned char *Pos, struct PurityToken *Tokens)
+{
+    enum LexToken Token;
+    int NumTokens = 0;
+
+    while (TRUE)
+    {
+        Token = (enum LexToken)*Pos;
+        if (Token == TokenEndOfFunction || Token == TokenEOF)
+            return NumTokens;
+
+        if (Token != TokenEndOfLine)
+        {
+            if (Tokens != NULL)
+            {
+                Tokens[NumTokens].Token = Token;
+                Tokens[NumTokens].Ident = NULL;
+                Tokens[NumTokens].Pos = Pos;
+                if (Token == TokenIdentifier)
+                    memcpy((void *)&Tokens[NumTokens].Ident, (void *)(Pos + TOKEN_DATA_OFFSET), sizeof(const char *));
+            }
+
+            NumTokens++;
+        }
+
+        Pos += TOKEN_DATA_OFFSET + LexTokenSize(Token);
+    }
+}
+
+static enum LexToken PurityPeek(struct PurityBody *Body, int Index)
+{
+    if (Index < 0 || Index >= Body->NumTokens)
+        return TokenNone;
+
+    return Body->Tokens[Index].Token;
+}
+
+static int PurityIsLocal(struct PurityBody *Body, const char *Ident)
+{
+    int Count;
+
+    for (Count = Body->NumLocals-1; Count >= 0; Count--)
+    {
+        if (Body->Locals[Count].Name == Ident)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void PurityAddLocal(struct PurityBody *Body, const char *Ident)
+{
+    Body->Locals[Body->NumLocals].Name = Ident;
+    Body->Locals[Body->NumLocals].Depth = Body->Depth;
+    Body->NumLocals++;
+}
+
+/* the global value with this name, or NULL */
+static struct Value *PurityGlobal(struct PurityState *State, struct PurityBody *Body, const char *Ident)
+{
+    struct Value *Val;
+
+    if (PurityIsLocal(Body, Ident) || !TableGet(State->pc, &State->pc->GlobalTable, Ident, &Val, NULL, NULL, NULL))
+        return NULL;
+
+    return Val;
+}
+
+/* is this the start of a type name? */
+static int PurityIsType(struct PurityState *State, struct PurityBody *Body, int Index)
+{
+    struct Value *Val;
+
+    switch (PurityPeek(Body, Index))
+    {
+        case TokenIntType: case TokenCharType: case TokenFloatType: case TokenDoubleType: case TokenVoidType:
+        case TokenLongType: case TokenSignedType: case TokenShortType: case TokenUnsignedType:
+        case TokenStructType: case TokenUnionType: case TokenEnumType:
+        case TokenStaticType: case TokenAutoType: case TokenRegisterType: case TokenExternType:
+            return TRUE;
+
+        case TokenIdentifier:
+            /* a typedef name */
+            Val = PurityGlobal(State, Body, Body->Tokens[Index].Ident);
+            return Val != NULL && Val->Typ == &State->pc->TypeType;
+
+        default:
+            return FALSE;
+    }
+}
+
+/* does a type here start a declaration rather than a cast or sizeof? */
+static int PurityIsDeclaration(struct PurityBody *Body, int Index)
+{
+    switch (PurityPeek(Body, Index-1))
+    {
+        case TokenNone: case TokenSemicolon: case TokenLeftBrace: case TokenRightBrace: case TokenColon:
+            return TRUE;
+
+        case TokenOpenBracket:
+            return PurityPeek(Body, Index-2) == TokenFor;
+
+        default:
+            return FALSE;
+    }
+}
+
+/* does the token before this one end an operand, making this an infix operator? */
+static int PurityIsInfix(struct PurityBody *Body, int Index)
+{
+    switch (PurityPeek(Body, Index-1))
+    {
+        case TokenIdentifier: case TokenIntegerConstant: case TokenFPConstant: case TokenStringConstant: case TokenCharacterConstant:
+        case TokenCloseBracket: case TokenRightSquareBracket: case TokenIncrement: case TokenDecrement:
+            return TRUE;
+
+        default:
+            return FALSE;
+    }
+}
+
+/* is the variable named at Index assigned to, incremented or decremented, as a whole,
+ * through an index or member or in brackets? */
+static int PurityIsWrite(struct PurityBody *Body, int Index)
+{
+    int Brackets = 0;
+
+    while (PurityPeek(Body, Index-1-Brackets) == TokenOpenBracket)
+        Brackets++;
+
+    return LexIsWrittenTo(PurityPeek(Body, Index-1-Brackets), Brackets, Body->Tokens[Index].Pos);
+}
+
+/* could the global named at Index be changed through a pointer from here? That's taking
+ * its address, or using an array, pointer or aggregate other than by indexing it or
+ * picking a member out */
+static int PurityEscapes(struct PurityBody *Body, struct Value *Val, int Index)
+{
+    if (PurityPeek(Body, Index-1) == TokenAmpersand && !PurityIsInfix(Body, Index-1))
+        return TRUE;
+
+    switch (Val->Typ->Base)
+    {
+        case TypePointer: case TypeArray: case TypeStruct: case TypeUnion:
+            return PurityPeek(Body, Index+1) != TokenLeftSquareBracket && PurityPeek(Body, Index+1) != TokenDot;
+
+        default:
+            return FALSE;
+    }
+}
+
+/* note a global which is written to */
+static void PurityAddWritten(struct PurityState *State, const char *Ident)
+{
+    if (!State->Collecting)
+        return;
+
+    if (State->Written != NULL)
+        State->Written[State->NumWritten] = Ident;
+
+    State->NumWritten++;
+}
+
+static int PurityIsWritten(struct PurityState *State, const char *Ident)
+{
+    int Count;
+
+    for (Count = 0; Count < State->NumWritten; Count++)
+    {
+        if (State->Written[Count] == Ident)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* a macro which changes things may change any global it's given, from the open bracket
+ * of its arguments to the matching close */
+static void PurityMacroArgs(struct PurityState *State, struct PurityBody *Body, int Index)
+{
+    struct Value *Val;
+    int Nesting = 0;
+
+    for (; Index < Body->NumTokens; Index++)
+    {
+        if (PurityPeek(Body, Index) == TokenOpenBracket)
+            Nesting++;
+        else if (PurityPeek(Body, Index) == TokenCloseBracket && --Nesting == 0)
+            return;
+        else if (PurityPeek(Body, Index) == TokenIdentifier && (Val = PurityGlobal(State, Body, Body->Tokens[Index].Ident)) != NULL)
+            PurityAddWritten(State, Body->Tokens[Index].Ident);
+    }
+}
+
+/* what using this identifier does to the body's purity */
+static enum FuncPurity PurityIdentifier(struct PurityState *State, struct PurityBody *Body, int Index, int MacroDepth)
+{
+    const char *Ident = Body->Tokens[Index].Ident;
+    enum FuncPurity Purity;
+    struct Value *Val;
+    int IsCall = (PurityPeek(Body, Index+1) == TokenOpenBracket);
+
+    if (PurityIsLocal(Body, Ident))
+        return PurityPure;
+
+    Val = PurityGlobal(State, Body, Ident);
+    if (Val != NULL && Val->Typ == &State->pc->FunctionType)
+        return IsCall ? Val->Val->FuncDef->Purity : PurityStateful;
+
+    if (Val != NULL && Val->Typ == &State->pc->MacroType)
+    {
+        if (MacroDepth >= PURITY_MACRO_DEPTH_MAX)
+            return PurityImpure;
+
+        Purity = PurityScan(State, Val->Val->MacroDef->Body.Pos, NULL, MacroDepth+1);
+        if (Purity != PurityPure && IsCall)
+            PurityMacroArgs(State, Body, Index+1);
+
+        return Purity;
+    }
+
+    if (Val != NULL && Val->Typ == &State->pc->TypeType)
+        return PurityPure;
+
+    /* calling something we don't know about */
+    if (IsCall)
+        return PurityImpure;
+
+    /* a global, or in a macro maybe one of its parameters standing for anything */
+    if (PurityIsWrite(Body, Index) || (Val != NULL && PurityEscapes(Body, Val, Index)))
+    {
+        if (Val != NULL)
+            PurityAddWritten(State, Ident);
+
+        return PurityStateful;
+    }
+
+    if (!State->Collecting && PurityIsWritten(State, Ident))
+        return PurityStateful;
+
+    return PurityPure;
+}
+
+/* look through a function's body, or a macro's when Func is NULL */
+static enum FuncPurity PurityScan(struct PurityState *State, const unsigned char *Pos, struct FuncDef *Func, int MacroDepth)
+{
+    enum FuncPurity Purity = PurityPure;
+    struct PurityBody Body;
+    enum LexToken Token;
+    int Declaring = FALSE;
+    int ExpectDeclarator = FALSE;
+    int IsExtern = FALSE;
+    int Nesting = 0;
+    int NumParams = (Func != NULL) ? Func->NumParams : 0;
+    int Count;
+
+    if (Pos == NULL)
+        return PurityImpure;
+
+    memset((void *)&Body, '\0', sizeof(Body));
+    Body.NumTokens = PurityReadTokens(Pos, NULL);
+    Body.Tokens = (struct PurityToken *)HeapAllocMem(State->pc, sizeof(struct PurityToken) * (Body.NumTokens + 1));
+    Body.Locals = (struct PurityLocal *)HeapAllocMem(State->pc, sizeof(struct PurityLocal) * (Body.NumTokens + NumParams + 1));
+    if (Body.Tokens == NULL || Body.Locals == NULL)
+    {
+        HeapFreeMem(State->pc, (void *)Body.Tokens);
+        HeapFreeMem(State->pc, (void *)Body.Locals);
+        return PurityImpure;
+    }
+    PurityReadTokens(Pos, Body.Tokens);
+
+    for (Count = 0; Count < NumParams; Count++)
+    {
+        PurityAddLocal(&Body, Func->ParamName[Count]);
+        if (Func->ParamType[Count]->Base == TypePointer || Func->ParamType[Count]->Base == TypeArray)
+            Purity = PurityStateful;
+    }
+
+    for (Count = 0; Count < Body.NumTokens; Count++)
+    {
+        Token = Body.Tokens[Count].Token;
+
+        /* the first name after the type, or after a comma, is a new variable */
+        if (ExpectDeclarator)
+        {
+            if (PurityIsType(State, &Body, Count))
+            {
+                if (Token == TokenStaticType)
+                    Purity = PurityWorst(Purity, PurityStateful);
+                else if (Token == TokenExternType)
+                    IsExtern = TRUE;
+                else if ((Token == TokenStructType || Token == TokenUnionType || Token == TokenEnumType) && PurityPeek(&Body, Count+1) == TokenIdentifier)
+                    Count++;
+                continue;
+            }
+
+            ExpectDeclarator = FALSE;
+            if (Token == TokenAsterisk)
+            {
+                /* a pointer */
+                Purity = PurityWorst(Purity, PurityStateful);
+                ExpectDeclarator = TRUE;
+                continue;
+            }
+
+            if (Token == TokenIdentifier)
+            {
+                if (!IsExtern)
+                    PurityAddLocal(&Body, Body.Tokens[Count].Ident);
+                continue;
+            }
+        }
+
+        switch (Token)
+        {
+            case TokenLeftBrace:
+                Body.Depth++;
+                Nesting++;
+                break;
+
+            case TokenRightBrace:
+                while (Body.NumLocals > NumParams && Body.Locals[Body.NumLocals-1].Depth >= Body.Depth)
+                    Body.NumLocals--;
+
+                Body.Depth--;
+                Nesting--;
+                break;
+
+            case TokenOpenBracket: case TokenLeftSquareBracket:
+                Nesting++;
+                break;
+
+            case TokenCloseBracket: case TokenRightSquareBracket:
+                Nesting--;
+                break;
+
+            case TokenComma:
+                ExpectDeclarator = Declaring && Nesting == 0;
+                break;
+
+            case TokenSemicolon:
+                Declaring = FALSE;
+                break;
+
+            case TokenArrow:
+                Purity = PurityWorst(Purity, PurityStateful);
+                break;
+
+            case TokenAmpersand: case TokenAsterisk:
+                /* taking an address or going through a pointer */
+                if (!PurityIsInfix(&Body, Count))
+                    Purity = PurityWorst(Purity, PurityStateful);
+                break;
+
+            case TokenIdentifier:
+                if (PurityIsType(State, &Body, Count) && PurityIsDeclaration(&Body, Count))
+                {
+                    Declaring = ExpectDeclarator = TRUE;
+                    IsExtern = FALSE;
+                    Nesting = 0;
+                }
+                else if (PurityPeek(&Body, Count-1) != TokenDot && PurityPeek(&Body, Count-1) != TokenArrow)
+                {
+                    /* in a macro even its own parameters may stand for the caller's globals */
+                    if (Func == NULL && PurityIsWrite(&Body, Count))
+                        Purity = PurityWorst(Purity, PurityStateful);
+
+                    Purity = PurityWorst(Purity, PurityIdentifier(State, &Body, Count, MacroDepth));
+                }
+                break;
+
+            default:
+                if (PurityIsType(State, &Body, Count) && PurityIsDeclaration(&Body, Count))
+                {
+                    Declaring = TRUE;
+                    IsExtern = FALSE;
+                    Nesting = 0;
+                    Count--;
+                    ExpectDeclarator = TRUE;
+                }
+                break;
+        }
+    }
+
+    HeapFreeMem(State->pc, (void *)Body.Tokens);
+    HeapFreeMem(State->pc, (void *)Body.Locals);
+    return Purity;
+}
+
+/* look at every function and macro of the script. Returns TRUE if any function got worse */
+static int PurityScanProgram(struct PurityState *State)
+{
+    struct TableEntry *Entry;
+    struct Value *Val;
+    struct FuncDef *Func;
+    enum FuncPurity Purity;
+    int Changed = FALSE;
+    int Count;
+
+    for (Count = 0; Count < State->pc->GlobalTable.Size; Count++)
+    {
+        for (Entry = State->pc->GlobalTable.HashTable[Count]; Entry != NULL; Entry = Entry->Next)
+        {
+            Val = Entry->p.v.Val;
+            if (Val->Typ == &State->pc->MacroType && State->Collecting)
+                PurityScan(State, Val->Val->MacroDef->Body.Pos, NULL, 0);
+
+            if (Val->Typ != &State->pc->FunctionType || Val->Val->FuncDef->Intrinsic != NULL)
+                continue;
+
+            Func = Val->Val->FuncDef;
+            Purity = PurityScan(State, Func->Body.Pos, Func, 0);
+            if (!State->Collecting && Purity > Func->Purity)
+            {
+                Func->Purity = Purity;
+                Changed = TRUE;
+            }
+        }
+    }
+
+    return Changed;
+}
+
+/* can a function's results be remembered? Its arguments and result have to fit in a
+ * MemoEntry. main isn't, it's rarely called with the same arguments twice */
+static int PurityCanMemo(Picoc *pc, const char *Name, struct FuncDef *Func)
+{
+    int Count;
+
+    if (Func->Purity != PurityPure || Func->VarArgs || Func->NumParams > MEMO_PARAMS_MAX || Name == TableStrRegister(pc, "main") ||
+            (Func->ReturnType != &pc->FPType && Func->ReturnType != &pc->IntType))
+        return FALSE;
+
+    for (Count = 0; Count < Func->NumParams; Count++)
+    {
+        if (Func->ParamType[Count] != &pc->FPType && Func->ParamType[Count] != &pc->IntType)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* give each pure function somewhere to remember its results. Without the memory they're
+ * just worked out every time */
+static void PurityAddMemo(Picoc *pc)
+{
+    struct TableEntry *Entry;
+    struct FuncDef *Func;
+    int Count;
+
+    for (Count = 0; Count < pc->GlobalTable.Size; Count++)
+    {
+        for (Entry = pc->GlobalTable.HashTable[Count]; Entry != NULL; Entry = Entry->Next)
+        {
+            if (Entry->p.v.Val->Typ != &pc->FunctionType || Entry->p.v.Val->Val->FuncDef->Intrinsic != NULL)
+                continue;
+
+            Func = Entry->p.v.Val->Val->FuncDef;
+            if (Func->Memo == NULL && PurityCanMemo(pc, Entry->p.v.Key, Func))
+                Func->Memo = (struct MemoEntry *)HeapAllocMem(pc, sizeof(struct MemoEntry) * MEMO_TABLE_SIZE);
+        }
+    }
+}
+
+/* work out the purity of all the script's functions */
+void PurityAnalyse(Picoc *pc)
+{
+    struct PurityState State;
+    struct TableEntry *Entry;
+    struct Value *Val;
+    int Count;
+
+    for (Count = 0; Count < pc->GlobalTable.Size; Count++)
+    {
+        for (Entry = pc->GlobalTable.HashTable[Count]; Entry != NULL; Entry = Entry->Next)
+        {
+            Val = Entry->p.v.Val;
+            if (Val->Typ == &pc->FunctionType && Val->Val->FuncDef->Intrinsic == NULL)
+                Val->Val->FuncDef->Purity = (Val->Val->FuncDef->Body.Pos != NULL) ? PurityPure : PurityImpure;
+        }
+    }
+
+    /* count the globals which are written to, then collect them */
+    memset((void *)&State, '\0', sizeof(State));
+    State.pc = pc;
+    State.Collecting = TRUE;
+    PurityScanProgram(&State);
+    State.Written = (const char **)HeapAllocMem(pc, sizeof(const char *) * (State.NumWritten + 1));
+    if (State.Written == NULL)
+        ProgramFailNoParser(pc, "out of memory");
+
+    State.NumWritten = 0;
+    PurityScanProgram(&State);
+
+    State.Collecting = FALSE;
+    while (PurityScanProgram(&State))
+        ;
+
+    HeapFreeMem(pc, (void *)State.Written);
+    PurityAddMemo(pc);
+}
@@ -0,0 +1,100 @@
+/* picoc counters - what the interpreter did in each evaluation, for finding
+ * regressions and checking optimisations without a profiler. Everything is
+ * counted where the work is done, by STATS_ADD and STATS_MAX, which are empty
+ * unless the interpreter is built with FEATURE_STATS */
+
+#include "interpreter.h"
+
+#ifdef FEATURE_STATS
+/* add the counts in From to To */
+static void StatsAccumulate(struct PicocStats *To, const struct PicocStats *From)
+{
+    To->Tokens += From->Tokens;
+    To->TableLookups += From->TableLookups;
+    To->TableChainSteps += From->TableChainSteps;
+    if (To->TableLongestChain < From->TableLongestChain)
+        To->TableLongestChain = From->TableLongestChain;
+    To->HeapAllocs += From->HeapAllocs;
+    To->HeapAllocBytes += From->HeapAllocBytes;
+    To->HeapFrees += From->HeapFrees;
+    To->HeapFreeBytes += From->HeapFreeBytes;
+    To->ScopeBegins += From->ScopeBegins;
+    To->ScopeEnds += From->ScopeEnds;
+    To->ScopeEntriesScanned += From->ScopeEntriesScanned;
+    To->FunctionCalls += From->FunctionCalls;
+    if (To->StackHighWater < From->StackHighWater)
+        To->StackHighWater = From->StackHighWater;
+    To->StackSize = From->StackSize;
+}
+
+/* add what's been counted to the totals and start counting again from nothing */
+static void StatsFold(Picoc *pc)
+{
+    long long StackSize = pc->Stats.StackSize;
+
+    StatsAccumulate(&pc->TotalStats, &pc->Stats);
+    memset(&pc->Stats, '\0', sizeof(pc->Stats));
+    pc->Stats.StackSize = StackSize;
+    pc->Stats.StackHighWater = (char *)pc->HeapStackTop - (char *)&(pc->HeapMemory)[0];
+}
+
+/* start counting for a program, with a stack of StackSize bytes. Called once the heap is set up */
+void StatsInit(Picoc *pc, int StackSize)
+{
+    memset(&pc->Stats, '\0', sizeof(pc->Stats));
+    memset(&pc->LastStats, '\0', sizeof(pc->LastStats));
+    memset(&pc->TotalStats, '\0', sizeof(pc->TotalStats));
+    pc->Stats.StackSize = StackSize;
+    pc->Stats.StackHighWater = (char *)pc->HeapStackTop - (char *)&(pc->HeapMemory)[0];
+}
+
+/* an evaluation is starting. What was done since the last one ended, like preparing a row,
+ * only goes to the totals */
+void StatsBegin(Picoc *pc)
+{
+    StatsFold(pc);
+}
+
+/* an evaluation, or the initialisation, has finished, successfully or not */
+void StatsEnd(Picoc *pc)
+{
+    pc->LastStats = pc->Stats;
+    StatsFold(pc);
+}
+
+/* the counts for the last evaluation and since the program was initialised, into either of
+ * Last and Total which isn't NULL. Returns FALSE when the interpreter doesn't count */
+int StatsGet(Picoc *pc, struct PicocStats *Last, struct PicocStats *Total)
+{
+    if (Last != NULL)
+        *Last = pc->LastStats;
+
+    if (Total != NULL)
+    {
+        *Total = pc->TotalStats;
+        StatsAccumulate(Total, &pc->Stats);
+    }
+    return TRUE;
+}
+
+#else
+
+/* nothing is counted */
+void StatsInit(Picoc *, int)
+{
+}
+
+void StatsBegin(Picoc *)
+{
+}
+
+void StatsEnd(Picoc *)
+{
+}
+
+int StatsGet(Picoc *, struct PicocStats *, struct PicocStats *)
+{
+    return FALSE;
+}
+
+#endif
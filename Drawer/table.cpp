@@ -38,19 +38,29 @@ void TableInitTable(struct Table *Tbl, struct TableEntry **HashTable, int Size,
 }
 
 /* check a hash table entry for a key */
-static struct TableEntry *TableSearch(struct Table *Tbl, const char *Key, int *AddAt)
+static struct TableEntry *TableSearch(Picoc *pc, struct Table *Tbl, const char *Key, int *AddAt)
 {
     struct TableEntry *Entry;
     int HashValue = ((unsigned long)Key) % Tbl->Size;   /* shared strings have unique addresses so we don't need to hash them */
+#ifdef FEATURE_STATS
+    long long Steps = 0;
+#endif
     
+    STATS_ADD(pc, TableLookups, 1);
     for (Entry = Tbl->HashTable[HashValue]; Entry != NULL; Entry = Entry->Next)
     {
+#ifdef FEATURE_STATS
+        Steps++;
+#endif
         if (Entry->p.v.Key == Key)
-            return Entry;   /* found */
+            break;   /* found */
     }
+    STATS_ADD(pc, TableChainSteps, Steps);
+    STATS_MAX(pc, TableLongestChain, Steps);
     
-    *AddAt = HashValue;    /* didn't find it in the chain */
-    return NULL;
+    if (Entry == NULL)
+        *AddAt = HashValue;    /* didn't find it in the chain */
+    return Entry;
 }
 
 /* set an identifier to a value. returns FALSE if it already exists. 
@@ -58,7 +68,7 @@ static struct TableEntry *TableSearch(struct Table *Tbl, const char *Key, int *A
 int TableSet(Picoc *pc, struct Table *Tbl, char *Key, struct Value *Val, const char *DeclFileName, int DeclLine, int DeclColumn)
 {
     int AddAt;
-    struct TableEntry *FoundEntry = TableSearch(Tbl, Key, &AddAt);
+    struct TableEntry *FoundEntry = TableSearch(pc, Tbl, Key, &AddAt);
     
     if (FoundEntry == NULL)
     {   /* add it to the table */
@@ -78,10 +88,10 @@ int TableSet(Picoc *pc, struct Table *Tbl, char *Key, struct Value *Val, const c
 
 /* find a value in a table. returns FALSE if not found. 
  * Key must be a shared string from TableStrRegister() */
-int TableGet(struct Table *Tbl, const char *Key, struct Value **Val, const char **DeclFileName, int *DeclLine, int *DeclColumn)
+int TableGet(Picoc *pc, struct Table *Tbl, const char *Key, struct Value **Val, const char **DeclFileName, int *DeclLine, int *DeclColumn)
 {
     int AddAt;
-    struct TableEntry *FoundEntry = TableSearch(Tbl, Key, &AddAt);
+    struct TableEntry *FoundEntry = TableSearch(pc, Tbl, Key, &AddAt);
     if (FoundEntry == NULL)
         return FALSE;
     
@@ -120,26 +130,36 @@ struct Value *TableDelete(Picoc *pc, struct Table *Tbl, const char *Key)
 }
 
 /* check a hash table entry for an identifier */
-static struct TableEntry *TableSearchIdentifier(struct Table *Tbl, const char *Key, int Len, int *AddAt)
+static struct TableEntry *TableSearchIdentifier(Picoc *pc, struct Table *Tbl, const char *Key, int Len, int *AddAt)
 {
     struct TableEntry *Entry;
     int HashValue = TableHash(Key, Len) % Tbl->Size;
+#ifdef FEATURE_STATS
+    long long Steps = 0;
+#endif
     
+    STATS_ADD(pc, TableLookups, 1);
     for (Entry = Tbl->HashTable[HashValue]; Entry != NULL; Entry = Entry->Next)
     {
+#ifdef FEATURE_STATS
+        Steps++;
+#endif
         if (strncmp(&Entry->p.Key[0], (char *)Key, Len) == 0 && Entry->p.Key[Len] == '\0')
-            return Entry;   /* found */
+            break;   /* found */
     }
+    STATS_ADD(pc, TableChainSteps, Steps);
+    STATS_MAX(pc, TableLongestChain, Steps);
     
-    *AddAt = HashValue;    /* didn't find it in the chain */
-    return NULL;
+    if (Entry == NULL)
+        *AddAt = HashValue;    /* didn't find it in the chain */
+    return Entry;
 }
 
 /* set an identifier and return the identifier. share if possible */
 char *TableSetIdentifier(Picoc *pc, struct Table *Tbl, const char *Ident, int IdentLen)
 {
     int AddAt;
-    struct TableEntry *FoundEntry = TableSearchIdentifier(Tbl, Ident, IdentLen, &AddAt);
+    struct TableEntry *FoundEntry = TableSearchIdentifier(pc, Tbl, Ident, IdentLen, &AddAt);
     
     if (FoundEntry != NULL)
         return &FoundEntry->p.Key[0];
@@ -14,6 +14,7 @@ void VariableInit(Picoc *pc)
     TableInitTable(&(pc->GlobalTable), &(pc->GlobalHashTable)[0], GLOBAL_TABLE_SIZE, TRUE);
     TableInitTable(&pc->StringLiteralTable, &pc->StringLiteralHashTable[0], STRING_LITERAL_TABLE_SIZE, TRUE);
     pc->TopStackFrame = NULL;
+    memset((void *)&pc->CallSiteCache[0], '\0', sizeof(pc->CallSiteCache));
 }
 
 /* deallocate the contents of a variable */
@@ -21,13 +22,23 @@ void VariableFree(Picoc *pc, struct Value *Val)
 {
     if (Val->ValOnHeap || Val->AnyValOnHeap)
     {
-        /* free function bodies */
-        if (Val->Typ == &pc->FunctionType && Val->Val->FuncDef.Intrinsic == NULL && Val->Val->FuncDef.Body.Pos != NULL)
-            HeapFreeMem(pc, (void *)Val->Val->FuncDef.Body.Pos);
+        /* free function bodies and definitions */
+        if (Val->Typ == &pc->FunctionType && Val->Val->FuncDef != NULL)
+        {
+            if (Val->Val->FuncDef->Intrinsic == NULL && Val->Val->FuncDef->Body.Pos != NULL)
+                HeapFreeMem(pc, (void *)Val->Val->FuncDef->Body.Pos);
+
+            if (Val->Val->FuncDef->Memo != NULL)
+                HeapFreeMem(pc, (void *)Val->Val->FuncDef->Memo);
+            HeapFreeMem(pc, Val->Val->FuncDef);
+        }
 
-        /* free macro bodies */
-        if (Val->Typ == &pc->MacroType)
-            HeapFreeMem(pc, (void *)Val->Val->MacroDef.Body.Pos);
+        /* free macro bodies and definitions */
+        if (Val->Typ == &pc->MacroType && Val->Val->MacroDef != NULL)
+        {
+            HeapFreeMem(pc, (void *)Val->Val->MacroDef->Body.Pos);
+            HeapFreeMem(pc, Val->Val->MacroDef);
+        }
 
         /* free the AnyValue */
         if (Val->AnyValOnHeap)
@@ -165,6 +176,67 @@ void VariableRealloc(struct ParseState *Parser, struct Value *FromValue, int New
     FromValue->AnyValOnHeap = TRUE;
 }
 
+/* a parameter of the current function by name, or NULL. Parameters are kept by position rather
+ * than in the local table, and most functions only have a few, so they're found by comparing
+ * the registered names' addresses. Ident must be registered */
+static struct Value *VariableParameter(struct StackFrame *Frame, const char *Ident)
+{
+    int Count;
+
+    for (Count = 0; Count < Frame->NumParams; Count++)
+    {
+        if (Frame->ParamName[Count] == Ident)
+            return Frame->Parameter[Count];
+    }
+
+    return NULL;
+}
+
+/* look a variable up among the current function's parameters and locals. Ident must be registered */
+static int VariableGetLocal(Picoc *pc, const char *Ident, struct Value **LVal)
+{
+    struct StackFrame *Frame = pc->TopStackFrame;
+
+    if (Frame == NULL)
+        return FALSE;
+
+    if ((*LVal = VariableParameter(Frame, Ident)) != NULL)
+        return TRUE;
+
+    return Frame->LocalTable.Size > 0 && TableGet(pc, &Frame->LocalTable, Ident, LVal, NULL, NULL, NULL);
+}
+
+/* the table a new variable goes in: the globals, or the current function's locals. The locals'
+ * hash table is only made when the first of them is defined, so calls to functions without any
+ * don't pay for it. Like the locals themselves it's on the stack, and goes with the frame */
+static struct Table *VariableDefineTable(Picoc *pc, struct ParseState *Parser, const char *Ident)
+{
+    struct StackFrame *Frame = pc->TopStackFrame;
+    struct TableEntry **HashTable;
+
+    if (Frame == NULL)
+        return &pc->GlobalTable;
+
+    if (VariableParameter(Frame, Ident) != NULL)
+    {
+        if (Parser)
+            ProgramFail(Parser, "'" + std::string(Ident) + "' is already defined");
+        else
+            ProgramFailNoParser(pc, "'" + std::string(Ident) + "' is already defined");
+    }
+
+    if (Frame->LocalTable.Size == 0)
+    {
+        HashTable = (struct TableEntry **)HeapAllocStack(pc, sizeof(struct TableEntry *) * LOCAL_TABLE_SIZE);
+        if (HashTable == NULL)
+            ProgramFail(Parser, "out of memory");
+
+        TableInitTable(&Frame->LocalTable, HashTable, LOCAL_TABLE_SIZE, FALSE);
+    }
+
+    return &Frame->LocalTable;
+}
+
 int VariableScopeBegin(struct ParseState * Parser, int* OldScopeID)
 {
     struct TableEntry *Entry;
@@ -179,6 +251,8 @@ int VariableScopeBegin(struct ParseState * Parser, int* OldScopeID)
 
     if (Parser->ScopeID == -1) return -1;
 
+    STATS_ADD(pc, ScopeBegins, 1);
+
     /* XXX dumb hash, let's hope for no collisions... */
     *OldScopeID = Parser->ScopeID;
     Parser->ScopeID = (int)(intptr_t)(Parser->SourceText) * ((int)(intptr_t)(Parser->Pos) / sizeof(char*));
@@ -190,6 +264,7 @@ int VariableScopeBegin(struct ParseState * Parser, int* OldScopeID)
         for (Entry = HashTable->HashTable[Count]; Entry != NULL; Entry = NextEntry)
         {
             NextEntry = Entry->Next;
+            STATS_ADD(pc, ScopeEntriesScanned, 1);
             if (Entry->p.v.Val->ScopeID == Parser->ScopeID && Entry->p.v.Val->OutOfScope)
             {
                 Entry->p.v.Val->OutOfScope = FALSE;
@@ -220,11 +295,14 @@ void VariableScopeEnd(struct ParseState * Parser, int ScopeID, int PrevScopeID)
 
     if (ScopeID == -1) return;
 
+    STATS_ADD(pc, ScopeEnds, 1);
+
     for (Count = 0; Count < HashTable->Size; Count++)
     {
         for (Entry = HashTable->HashTable[Count]; Entry != NULL; Entry = NextEntry)
         {
             NextEntry = Entry->Next;
+            STATS_ADD(pc, ScopeEntriesScanned, 1);
             if (Entry->p.v.Val->ScopeID == ScopeID && !Entry->p.v.Val->OutOfScope)
             {
                 #ifdef VAR_SCOPE_DEBUG
@@ -262,7 +340,7 @@ int VariableDefinedAndOutOfScope(Picoc * pc, const char* Ident)
 struct Value *VariableDefine(Picoc *pc, struct ParseState *Parser, char *Ident, struct Value *InitValue, struct ValueType *Typ, int MakeWritable)
 {
     struct Value * AssignValue;
-    struct Table * currentTable = (pc->TopStackFrame == NULL) ? &(pc->GlobalTable) : &(pc->TopStackFrame)->LocalTable;
+    struct Table * currentTable = VariableDefineTable(pc, Parser, Ident);
     
     int ScopeID = Parser ? Parser->ScopeID : -1;
 #ifdef VAR_SCOPE_DEBUG
@@ -323,7 +401,7 @@ struct Value *VariableDefineButIgnoreIdentical(struct ParseState *Parser, char *
         RegisteredMangledName = TableStrRegister(pc, MangledName);
         
         /* is this static already defined? */
-        if (!TableGet(&pc->GlobalTable, RegisteredMangledName, &ExistingValue, &DeclFileName, &DeclLine, &DeclColumn))
+        if (!TableGet(pc, &pc->GlobalTable, RegisteredMangledName, &ExistingValue, &DeclFileName, &DeclLine, &DeclColumn))
         {
             /* define the mangled-named static variable store in the global scope */
             ExistingValue = VariableAllocValueFromType(Parser->pc, Parser, Typ, TRUE, NULL, TRUE);
@@ -337,7 +415,8 @@ struct Value *VariableDefineButIgnoreIdentical(struct ParseState *Parser, char *
     }
     else
     {
-        if (Parser->Line != 0 && TableGet((pc->TopStackFrame == NULL) ? &pc->GlobalTable : &pc->TopStackFrame->LocalTable, Ident, &ExistingValue, &DeclFileName, &DeclLine, &DeclColumn)
+        if (Parser->Line != 0 && (pc->TopStackFrame == NULL || pc->TopStackFrame->LocalTable.Size > 0) &&
+                TableGet(pc, (pc->TopStackFrame == NULL) ? &pc->GlobalTable : &pc->TopStackFrame->LocalTable, Ident, &ExistingValue, &DeclFileName, &DeclLine, &DeclColumn)
                 && DeclFileName == Parser->FileName && DeclLine == Parser->Line && DeclColumn == Parser->CharacterPos)
             return ExistingValue;
         else
@@ -350,9 +429,9 @@ int VariableDefined(Picoc *pc, const char *Ident)
 {
     struct Value *FoundValue;
     
-    if (pc->TopStackFrame == NULL || !TableGet(&pc->TopStackFrame->LocalTable, Ident, &FoundValue, NULL, NULL, NULL))
+    if (!VariableGetLocal(pc, Ident, &FoundValue))
     {
-        if (!TableGet(&pc->GlobalTable, Ident, &FoundValue, NULL, NULL, NULL))
+        if (!TableGet(pc, &pc->GlobalTable, Ident, &FoundValue, NULL, NULL, NULL))
             return FALSE;
     }
 
@@ -362,9 +441,9 @@ int VariableDefined(Picoc *pc, const char *Ident)
 /* get the value of a variable. must be defined. Ident must be registered */
 void VariableGet(Picoc *pc, struct ParseState *Parser, const char *Ident, struct Value **LVal)
 {
-    if (pc->TopStackFrame == NULL || !TableGet(&pc->TopStackFrame->LocalTable, Ident, LVal, NULL, NULL, NULL))
+    if (!VariableGetLocal(pc, Ident, LVal))
     {
-        if (!TableGet(&pc->GlobalTable, Ident, LVal, NULL, NULL, NULL))
+        if (!TableGet(pc, &pc->GlobalTable, Ident, LVal, NULL, NULL, NULL))
         {
             if (VariableDefinedAndOutOfScope(pc, Ident))
                 ProgramFail(Parser, "'" + std::string(Ident) + "' is out of scope");
@@ -378,10 +457,11 @@ void VariableGet(Picoc *pc, struct ParseState *Parser, const char *Ident, struct
 void VariableDefinePlatformVar(Picoc *pc, struct ParseState *Parser, const char *Ident, struct ValueType *Typ, union AnyValue *FromValue, int IsWritable)
 {
     struct Value *SomeValue = VariableAllocValueAndData(pc, NULL, 0, IsWritable, NULL, TRUE);
+    char *RegisteredIdent = TableStrRegister(pc, Ident);
     SomeValue->Typ = Typ;
     SomeValue->Val = FromValue;
     
-	if (!TableSet(pc, (pc->TopStackFrame == NULL) ? &pc->GlobalTable : &pc->TopStackFrame->LocalTable, TableStrRegister(pc, Ident), SomeValue, Parser ? Parser->FileName : NULL, Parser ? Parser->Line : 0, Parser ? Parser->CharacterPos : 0))
+	if (!TableSet(pc, VariableDefineTable(pc, Parser, RegisteredIdent), RegisteredIdent, SomeValue, Parser ? Parser->FileName : NULL, Parser ? Parser->Line : 0, Parser ? Parser->CharacterPos : 0))
 	{
 		if (Parser)
 			ProgramFail(Parser, "'" + std::string(Ident) + "' is already defined");
@@ -416,22 +496,36 @@ void VariableStackPop(struct ParseState *Parser, struct Value *Var)
         ProgramFail(Parser, "stack underrun");
 }
 
-/* add a stack frame when doing a function call */
-void VariableStackFrameAdd(struct ParseState *Parser, const char *FuncName, int NumParams)
+/* add a stack frame when doing a function call. The values allocated for the arguments are the
+ * parameters, each found by its position in ParamName rather than being defined in the local
+ * table. ParamName's strings must be registered */
+void VariableStackFrameAdd(struct ParseState *Parser, const char *FuncName, struct Value **Parameter, char **ParamName, int NumParams)
 {
     struct StackFrame *NewFrame;
+    int Count;
     
     HeapPushStackFrame(Parser->pc);
-    NewFrame = (StackFrame*)HeapAllocStack(Parser->pc, sizeof(struct StackFrame) + sizeof(struct Value *) * NumParams);
+    NewFrame = (StackFrame*)HeapAllocStack(Parser->pc, sizeof(struct StackFrame));
     if (NewFrame == NULL)
         ProgramFail(Parser, "out of memory");
         
     ParserCopy(&NewFrame->ReturnParser, Parser);
     NewFrame->FuncName = FuncName;
-    NewFrame->Parameter = (NumParams > 0) ? ((Value**)((char *)NewFrame + sizeof(struct StackFrame))) : NULL;
-    TableInitTable(&NewFrame->LocalTable, &NewFrame->LocalHashTable[0], LOCAL_TABLE_SIZE, FALSE);
+    NewFrame->Parameter = Parameter;
+    NewFrame->ParamName = ParamName;
+    NewFrame->NumParams = NumParams;
+    NewFrame->LocalTable.Size = 0;
+    NewFrame->LocalTable.OnHeap = FALSE;
+    NewFrame->LocalTable.HashTable = NULL;
     NewFrame->PreviousStackFrame = Parser->pc->TopStackFrame;
     Parser->pc->TopStackFrame = NewFrame;
+
+    for (Count = 0; Count < NumParams; Count++)
+    {
+        Parameter[Count]->IsLValue = TRUE;
+        Parameter[Count]->ScopeID = -1;     /* parameters don't go out of scope */
+        Parameter[Count]->OutOfScope = FALSE;
+    }
 }
 
 /* remove a stack frame */
@@ -450,7 +544,7 @@ struct Value *VariableStringLiteralGet(Picoc *pc, char *Ident)
 {
     struct Value *LVal = NULL;
 
-    if (TableGet(&pc->StringLiteralTable, Ident, &LVal, NULL, NULL, NULL))
+    if (TableGet(pc, &pc->StringLiteralTable, Ident, &LVal, NULL, NULL, NULL))
         return LVal;
     else
         return NULL;
@@ -0,0 +1,283 @@
+/* picoc vector evaluator - runs the vector program the JIT compiles a main without loops to,
+ * on VECTOR_LANES values of its last argument at a time. Each operation is a loop over the
+ * lanes which the compiler turns into SIMD code, and a call to a math function goes to its
+ * vector version when it has one */
+
+#include "interpreter.h"
+
+extern bool gResetParser;
+
+/* run the program on the block of values in the input register, and the block of values of
+ * the first argument in First if it's given */
+VECTOR_TARGET void VectorRun(struct VectorProgram *Vector, const double *First)
+{
+    const struct VectorOp *Op;
+    double Value;
+    int Count;
+    int Lane;
+
+    for (Count = 0; Count < Vector->NumOps; Count++)
+    {
+        Op = &Vector->Ops[Count];
+
+        /* no operation's result is one of its own operands */
+        double *__restrict Result = Vector->Registers[Op->Result];
+        const double *__restrict A = (Op->Operand[0] != VECTOR_NONE) ? Vector->Registers[Op->Operand[0]] : NULL;
+        const double *__restrict B = (Op->Operand[1] != VECTOR_NONE) ? Vector->Registers[Op->Operand[1]] : NULL;
+        const double *__restrict C = (Op->Operand[2] != VECTOR_NONE) ? Vector->Registers[Op->Operand[2]] : NULL;
+
+        switch (Op->Code)
+        {
+            case VectorGlobal:
+                if (First != NULL && Op->Address == Vector->First)
+                {
+                    for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                        Result[Lane] = First[Lane];
+                    break;
+                }
+
+                Value = (Op->Type == TypeFP) ? *(double *)Op->Address : (double)*(int *)Op->Address;
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = Value;
+                break;
+
+            case VectorAdd:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = A[Lane] + B[Lane];
+                break;
+
+            case VectorSubtract:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = A[Lane] - B[Lane];
+                break;
+
+            case VectorMultiply:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = A[Lane] * B[Lane];
+                break;
+
+            case VectorDivide:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = A[Lane] / B[Lane];
+                break;
+
+            case VectorNegate:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = -A[Lane];
+                break;
+
+            case VectorIntAdd:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (int)((long long)A[Lane] + (long long)B[Lane]);
+                break;
+
+            case VectorIntSubtract:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (int)((long long)A[Lane] - (long long)B[Lane]);
+                break;
+
+            case VectorIntMultiply:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (int)((long long)A[Lane] * (long long)B[Lane]);
+                break;
+
+            case VectorIntDivide:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (int)((long long)A[Lane] / (long long)B[Lane]);
+                break;
+
+            case VectorIntModulus:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (int)((long long)A[Lane] % (long long)B[Lane]);
+                break;
+
+            case VectorIntShiftLeft:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (int)((long)A[Lane] << (int)B[Lane]);
+                break;
+
+            case VectorIntShiftRight:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (int)((long)A[Lane] >> (int)B[Lane]);
+                break;
+
+            case VectorIntAnd:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (int)A[Lane] & (int)B[Lane];
+                break;
+
+            case VectorIntOr:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (int)A[Lane] | (int)B[Lane];
+                break;
+
+            case VectorIntExor:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (int)A[Lane] ^ (int)B[Lane];
+                break;
+
+            case VectorEqual:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (A[Lane] == B[Lane]) ? 1.0 : 0.0;
+                break;
+
+            case VectorNotEqual:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (A[Lane] != B[Lane]) ? 1.0 : 0.0;
+                break;
+
+            case VectorLessThan:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (A[Lane] < B[Lane]) ? 1.0 : 0.0;
+                break;
+
+            case VectorLessEqual:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (A[Lane] <= B[Lane]) ? 1.0 : 0.0;
+                break;
+
+            case VectorNot:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (A[Lane] == 0.0) ? 1.0 : 0.0;
+                break;
+
+            case VectorLogicalAnd:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = ((A[Lane] != 0.0) & (B[Lane] != 0.0)) ? 1.0 : 0.0;
+                break;
+
+            case VectorLogicalOr:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = ((A[Lane] != 0.0) | (B[Lane] != 0.0)) ? 1.0 : 0.0;
+                break;
+
+            case VectorTest:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = ((int)(long)A[Lane] != 0) ? 1.0 : 0.0;
+                break;
+
+            case VectorTestLong:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = ((long)A[Lane] != 0) ? 1.0 : 0.0;
+                break;
+
+            case VectorTruncate:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (int)(long)A[Lane];
+                break;
+
+            case VectorSelect:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = (A[Lane] != 0.0) ? B[Lane] : C[Lane];
+                break;
+
+            case VectorKernel1:
+                Op->Native->Vector1(Result, A);
+                break;
+
+            case VectorKernel2:
+                Op->Native->Vector2(Result, A, B);
+                break;
+
+            case VectorCall1:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = Op->Native->FP1(A[Lane]);
+                break;
+
+            case VectorCall2:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = Op->Native->FP2(A[Lane], B[Lane]);
+                break;
+
+            case VectorCall3:
+                for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+                    Result[Lane] = Op->Native->FP3(A[Lane], B[Lane], C[Lane]);
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+/* free a vector program, which may be NULL */
+void VectorFree(Picoc *pc, struct VectorProgram *Vector)
+{
+    if (Vector == NULL)
+        return;
+
+    HeapFreeMem(pc, (void *)Vector->Ops);
+    HeapFreeMem(pc, (void *)Vector->Registers);
+    if (Vector->Tangents != NULL)
+        HeapFreeMem(pc, (void *)Vector->Tangents);
+
+    if (Vector->Bounds != NULL)
+        HeapFreeMem(pc, (void *)Vector->Bounds);
+
+    if (Vector->MayBeNaN != NULL)
+        HeapFreeMem(pc, (void *)Vector->MayBeNaN);
+
+    HeapFreeMem(pc, (void *)Vector);
+}
+
+/* evaluate main for Count values of its last argument, a block of lanes at a time. Returns
+ * FALSE if there's no vector program, leaving each value to be evaluated on its own */
+int VectorEvaluate(Picoc *pc, const double *Last, double *Result, int Count)
+{
+    struct VectorProgram *Vector = pc->JitVector;
+    double *Input;
+    int Start;
+    int Lanes;
+    int Lane;
+
+    /* the interpreter carries out a reset */
+    if (Vector == NULL || gResetParser)
+        return FALSE;
+
+    Input = Vector->Registers[Vector->Input];
+    for (Start = 0; Start < Count; Start += VECTOR_LANES)
+    {
+        /* the last block is filled out with copies of its last value */
+        Lanes = (Count - Start < VECTOR_LANES) ? Count - Start : VECTOR_LANES;
+        for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+            Input[Lane] = Last[Start + ((Lane < Lanes) ? Lane : Lanes-1)];
+
+        VectorRun(Vector, NULL);
+        memcpy((void *)&Result[Start], (void *)Vector->Registers[Vector->Result], sizeof(double) * Lanes);
+    }
+
+    return TRUE;
+}
+
+/* evaluate main at Count points scattered over both its arguments, each of them giving the
+ * first argument's value as well as the last's. Returns FALSE if there's no batch program */
+int VectorEvaluatePoints(Picoc *pc, const double *First, const double *Last, double *Result, int Count)
+{
+    struct VectorProgram *Vector = pc->JitBatchVector;
+    double BlockFirst[VECTOR_LANES];
+    double *Input;
+    int Start;
+    int Lanes;
+    int Lane;
+    int From;
+
+    if (Vector == NULL || gResetParser)
+        return FALSE;
+
+    Input = Vector->Registers[Vector->Input];
+    for (Start = 0; Start < Count; Start += VECTOR_LANES)
+    {
+        Lanes = (Count - Start < VECTOR_LANES) ? Count - Start : VECTOR_LANES;
+        for (Lane = 0; Lane < VECTOR_LANES; Lane++)
+        {
+            From = Start + ((Lane < Lanes) ? Lane : Lanes-1);
+            Input[Lane] = Last[From];
+            BlockFirst[Lane] = First[From];
+        }
+
+        VectorRun(Vector, BlockFirst);
+        memcpy((void *)&Result[Start], (void *)Vector->Registers[Vector->Result], sizeof(double) * Lanes);
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,380 @@
+#include "picoc.h"
+#include "interpreter.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+// cplot-bench: times the interpreter on a corpus of scripts, each stage on its own. Every run
+// initialises a script, samples its main() over a curve's points the way the graph does, and
+// cleans up. The figures are the medians over the runs, and can be saved and compared later on
+
+#ifndef CPLOT_BENCH_SCRIPTS
+#define CPLOT_BENCH_SCRIPTS "bench/scripts"
+#endif
+
+namespace
+{
+	// the corpus, from the cheapest call into the interpreter to the library and its types
+	const char* const corpus[] = { "trivial", "polynomial", "trig", "loops", "recursion", "structs", "strings" };
+
+	// as many points as a curve has on screen, sampled again and again until it's taken long
+	// enough to be timed
+	const int    numPoint = 1024;
+	const double minSampleTime = 0.02;
+
+	struct Result
+	{
+		std::string name;
+		std::string path;        // vector when main ran on blocks of x, scalar when one x at a time
+		double      initialise;  // PicocInitialise, microseconds
+		double      lex;         // the parts of it spent lexing, parsing and compiling, microseconds
+		double      parse;
+		double      compile;
+		double      sample;      // nanoseconds per sample
+		double      cleanup;     // PicocCleanup, microseconds
+		bool        counted;     // whether the interpreter counted its work, in the last run
+		PicocStats  stats;       // in its last evaluation that was interpreted, or its initialisation
+		bool        interpreted; // whether any of its evaluations were, for stats to be a point's
+	};
+
+	double now()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	double median(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		return values.empty() ? 0.0 : values[values.size() / 2];
+	}
+
+	bool readFile(const std::string& path, std::string& text)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			return false;
+		std::stringstream stream;
+		stream << file.rdbuf();
+		text = stream.str();
+		return true;
+	}
+
+	// the name a script's reported under, its file name without the directory or extension
+	std::string scriptName(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+		size_t dot = name.rfind('.');
+		return dot == std::string::npos ? name : name.substr(0, dot);
+	}
+
+	bool bench(const std::string& path, int runs, Result& result, std::string& errorBuffer)
+	{
+		std::string source;
+		if (!readFile(path, source))
+		{
+			errorBuffer = "can't read " + path;
+			return false;
+		}
+
+		std::vector<double> xs(numPoint);
+		std::vector<double> ys(numPoint);
+		for (int i = 0; i < numPoint; i++)
+		{
+			xs[i] = (double)i / numPoint * 20.0 - 10.0;
+		}
+
+		std::vector<double> initialises, lexes, parses, compiles, samples, cleanups;
+		int repeat = 1;
+		bool vectorDone = false;
+		for (int run = 0; run < runs; run++)
+		{
+			Picoc pc;
+			std::vector<Tweakable> tweakables;
+			double x;
+			double start = now();
+			PicocInitialise(&pc, &x, 1, source, tweakables, errorBuffer);
+			double initialised = now();
+			if (!errorBuffer.empty())
+			{
+				PicocCleanup(&pc);
+				return false;
+			}
+			// before sampling, which parses its calls to main when they're interpreted
+			lexes.push_back(pc.LexTime);
+			parses.push_back(pc.ParseTime);
+			compiles.push_back(pc.CompileTime);
+
+			// the same path as the graph's: the whole curve at once when main allows it
+			for (int r = 0; r < repeat && errorBuffer.empty(); r++)
+			{
+				vectorDone = PicocEvaluateVector(pc, &xs[0], &ys[0], numPoint);
+				for (int i = 0; i < numPoint && !vectorDone; i++)
+				{
+					x = xs[i];
+					ys[i] = PicocEvaluate(pc, 1, errorBuffer);
+					if (!errorBuffer.empty())
+						break;
+				}
+			}
+			double sampled = now();
+			PicocStats total;
+			result.counted = PicocGetStats(pc, &result.stats, &total);
+			result.interpreted = total.Tokens > result.stats.Tokens;
+
+			PicocCleanup(&pc);
+			double cleaned = now();
+			if (!errorBuffer.empty())
+				return false;
+
+			initialises.push_back(initialised - start);
+			samples.push_back((sampled - initialised) / ((double)repeat * numPoint));
+			cleanups.push_back(cleaned - sampled);
+
+			// the first run sets how many times the curve's sampled in the others
+			if (run == 0 && sampled - initialised < minSampleTime)
+			{
+				repeat = (int)std::min(100000.0, std::ceil(minSampleTime / std::max(sampled - initialised, 1e-7)));
+			}
+		}
+
+		result.name = scriptName(path);
+		result.path = vectorDone ? "vector" : "scalar";
+		result.initialise = median(initialises) * 1e6;
+		result.lex = median(lexes) * 1e6;
+		result.parse = median(parses) * 1e6;
+		result.compile = median(compiles) * 1e6;
+		result.sample = median(samples) * 1e9;
+		result.cleanup = median(cleanups) * 1e6;
+		return true;
+	}
+
+	// the counters of each script's last interpreted evaluation, or of its initialisation when the
+	// points were all evaluated without the interpreter
+	void printStats(const std::vector<Result>& results)
+	{
+		if (!results.empty() && !results[0].counted)
+		{
+			std::fprintf(stderr, "cplot-bench: the interpreter doesn't count its work, configure with -DCPLOT_STATS=ON\n");
+			return;
+		}
+
+		std::printf("\n%-12s %-10s %8s %8s %6s %7s %7s %9s %7s %7s %8s %7s %11s\n", "script", "counted", "tokens", "lookups", "steps",
+			"longest", "allocs", "bytes", "frees", "scopes", "scanned", "calls", "stack");
+		for (const Result& it : results)
+		{
+			const PicocStats& s = it.stats;
+			std::printf("%-12s %-10s %8lld %8lld %6.2f %7lld %7lld %9lld %7lld %7lld %8lld %7lld %5lld/%-5lld\n", it.name.c_str(),
+				it.interpreted ? "point" : "initialise", s.Tokens, s.TableLookups, s.TableLookups > 0 ? (double)s.TableChainSteps / s.TableLookups : 0.0,
+				s.TableLongestChain, s.HeapAllocs, s.HeapAllocBytes, s.HeapFrees, s.ScopeBegins, s.ScopeEntriesScanned,
+				s.FunctionCalls, s.StackHighWater, s.StackSize);
+		}
+	}
+
+	const char* tsvHeader = "script\tpath\tinitialise_us\tlex_us\tparse_us\tcompile_us\tsample_ns\tcleanup_us\n";
+
+	void writeTsv(FILE* output, const std::vector<Result>& results)
+	{
+		std::fputs(tsvHeader, output);
+		for (const Result& it : results)
+		{
+			std::fprintf(output, "%s\t%s\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\n", it.name.c_str(), it.path.c_str(),
+				it.initialise, it.lex, it.parse, it.compile, it.sample, it.cleanup);
+		}
+	}
+
+	bool readTsv(const std::string& path, std::map<std::string, Result>& results)
+	{
+		std::string text;
+		if (!readFile(path, text))
+			return false;
+
+		std::istringstream lines(text);
+		std::string line;
+		std::getline(lines, line);
+		while (std::getline(lines, line))
+		{
+			char name[256];
+			char kind[16];
+			Result result;
+			if (std::sscanf(line.c_str(), "%255s %15s %lf %lf %lf %lf %lf %lf", name, kind, &result.initialise,
+				&result.lex, &result.parse, &result.compile, &result.sample, &result.cleanup) == 8)
+			{
+				result.name = name;
+				result.path = kind;
+				results[result.name] = result;
+			}
+		}
+		return true;
+	}
+
+	// how much slower than the baseline, as a percentage
+	double change(double value, double baseline)
+	{
+		return baseline > 0.0 ? (value / baseline - 1.0) * 100.0 : 0.0;
+	}
+
+	void usage()
+	{
+		std::fprintf(stderr,
+			"usage: cplot-bench [options] [script.c ...]\n"
+			"  -n, --runs N          runs of each script, 15 by default\n"
+			"      --tsv             print tab separated values instead of a table\n"
+			"      --save FILE       save the results as tab separated values, as a baseline\n"
+			"      --baseline FILE   compare with results saved earlier\n"
+			"      --max-regression PERCENT\n"
+			"                        fail when a script samples this much slower than the baseline\n"
+			"      --native          build main() with the system's compiler, where that's supported\n"
+			"      --stats           print what the interpreter did to evaluate a point, when it's\n"
+			"                        built with CPLOT_STATS\n"
+			"\n"
+			"Without scripts, the corpus in " CPLOT_BENCH_SCRIPTS " is run.\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int runs = 15;
+	bool tsv = false;
+	bool stats = false;
+	const char* savePath = nullptr;
+	const char* baselinePath = nullptr;
+	double maxRegression = -1.0;
+	std::vector<std::string> paths;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+		bool hasValue = i + 1 < argc;
+		if ((option == "-n" || option == "--runs") && hasValue)
+		{
+			runs = std::atoi(argv[++i]);
+			if (runs <= 0)
+			{
+				std::fprintf(stderr, "cplot-bench: bad number of runs %s\n", argv[i]);
+				return 2;
+			}
+		}
+		else if (option == "--tsv")
+		{
+			tsv = true;
+		}
+		else if (option == "--stats")
+		{
+			stats = true;
+		}
+		else if (option == "--save" && hasValue)
+		{
+			savePath = argv[++i];
+		}
+		else if (option == "--baseline" && hasValue)
+		{
+			baselinePath = argv[++i];
+		}
+		else if (option == "--max-regression" && hasValue)
+		{
+			maxRegression = std::atof(argv[++i]);
+		}
+		else if (option == "--native")
+		{
+			extern bool gNativeCompile;
+			gNativeCompile = true;
+		}
+		else if (option == "-h" || option == "--help")
+		{
+			usage();
+			return 0;
+		}
+		else if (option[0] != '-')
+		{
+			paths.push_back(argv[i]);
+		}
+		else
+		{
+			usage();
+			return 2;
+		}
+	}
+	if (paths.empty())
+	{
+		for (const char* name : corpus)
+		{
+			paths.push_back(std::string(CPLOT_BENCH_SCRIPTS) + "/" + name + ".c");
+		}
+	}
+
+	std::map<std::string, Result> baseline;
+	if (baselinePath != nullptr && !readTsv(baselinePath, baseline))
+	{
+		std::fprintf(stderr, "cplot-bench: can't read %s\n", baselinePath);
+		return 1;
+	}
+
+	if (!tsv)
+	{
+		std::printf("%-12s %-7s %11s %9s %9s %9s %10s %10s", "script", "path", "initialise", "lex", "parse",
+			"compile", "cleanup", "ns/sample");
+		std::printf(baseline.empty() ? "\n" : " %10s\n", "vs base");
+		std::printf("%-12s %-7s %11s %9s %9s %9s %10s\n", "", "", "us", "us", "us", "us", "us");
+	}
+
+	std::vector<Result> results;
+	bool regressed = false;
+	for (const std::string& path : paths)
+	{
+		Result result;
+		std::string errorBuffer;
+		if (!bench(path, runs, result, errorBuffer))
+		{
+			std::fprintf(stderr, "%s:\n%s\n", path.c_str(), errorBuffer.c_str());
+			return 1;
+		}
+		results.push_back(result);
+
+		auto base = baseline.find(result.name);
+		if (base != baseline.end() && maxRegression >= 0.0 && change(result.sample, base->second.sample) > maxRegression)
+			regressed = true;
+
+		if (!tsv)
+		{
+			std::printf("%-12s %-7s %11.1f %9.1f %9.1f %9.1f %10.1f %10.1f", result.name.c_str(), result.path.c_str(),
+				result.initialise, result.lex, result.parse, result.compile, result.cleanup, result.sample);
+			if (base != baseline.end())
+				std::printf(" %+9.1f%%\n", change(result.sample, base->second.sample));
+			else
+				std::printf(baseline.empty() ? "\n" : " %10s\n", "-");
+			std::fflush(stdout);
+		}
+	}
+
+	if (tsv)
+		writeTsv(stdout, results);
+
+	if (stats)
+		printStats(results);
+
+	if (savePath != nullptr)
+	{
+		FILE* file = std::fopen(savePath, "w");
+		if (file == nullptr)
+		{
+			std::fprintf(stderr, "cplot-bench: can't write %s\n", savePath);
+			return 1;
+		}
+		writeTsv(file, results);
+		std::fclose(file);
+	}
+
+	if (regressed)
+	{
+		std::fprintf(stderr, "cplot-bench: sampling is more than %g%% slower than the baseline\n", maxRegression);
+		return 1;
+	}
+	return 0;
+}
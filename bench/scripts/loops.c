@@ -0,0 +1,11 @@
+/* a partial Fourier series, summed in a loop */
+double main(double x)
+{
+	double sum = 0;
+	int k;
+	for (k = 1; k <= 32; k++)
+	{
+		sum += sin(k * x) / k;
+	}
+	return sum;
+}
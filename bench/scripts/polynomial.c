@@ -0,0 +1,5 @@
+/* arithmetic only, Horner's scheme for a degree 7 polynomial */
+double main(double x)
+{
+	return ((((((0.5 * x - 1.2) * x + 0.7) * x - 3.1) * x + 2.0) * x - 0.3) * x + 1.5) * x - 4.0;
+}
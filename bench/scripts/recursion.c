@@ -0,0 +1,19 @@
+/* function calls, recursive ones, with ints and doubles */
+int fibonacci(int n)
+{
+	if (n < 2)
+		return n;
+	return fibonacci(n - 1) + fibonacci(n - 2);
+}
+
+double power(double v, int n)
+{
+	if (n == 0)
+		return 1.0;
+	return v * power(v, n - 1);
+}
+
+double main(double x)
+{
+	return fibonacci(10) + power(x * 0.1, 6);
+}
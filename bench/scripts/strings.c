@@ -0,0 +1,7 @@
+/* formatting and measuring strings */
+double main(double x)
+{
+	char buffer[64];
+	sprintf(buffer, "x = %f, %d", x, (int)x);
+	return strlen(buffer) + buffer[0];
+}
@@ -0,0 +1,25 @@
+/* a struct and arrays of them, read and written through pointers */
+struct Point
+{
+	double x;
+	double y;
+};
+
+double main(double x)
+{
+	struct Point points[16];
+	struct Point *p;
+	double length = 0;
+	int i;
+	for (i = 0; i < 16; i++)
+	{
+		points[i].x = x + i;
+		points[i].y = x * i;
+	}
+	for (i = 1; i < 16; i++)
+	{
+		p = &points[i];
+		length += fabs(p->x - points[i - 1].x) + fabs(p->y - points[i - 1].y);
+	}
+	return length;
+}
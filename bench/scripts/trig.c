@@ -0,0 +1,6 @@
+/* calls to the maths library */
+double main(double x)
+{
+	double s = sin(x) * cos(0.5 * x);
+	return s + tan(0.1 * x) * exp(-0.05 * x * x) + sqrt(fabs(x)) * atan2(x, 3.0);
+}
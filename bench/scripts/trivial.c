@@ -0,0 +1,5 @@
+/* the least main can do: the cost of a call into the interpreter */
+double main(double x)
+{
+	return x;
+}
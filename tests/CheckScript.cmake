@@ -0,0 +1,8 @@
+# runs a script through cplot-eval and fails unless it gives what's in its .expected file:
+# cmake -DEVAL=cplot-eval -DSCRIPT=name.c -P CheckScript.cmake
+execute_process(COMMAND ${EVAL} --points 4 --range 0:3 ${SCRIPT} OUTPUT_VARIABLE actual ERROR_VARIABLE errors RESULT_VARIABLE result)
+string(REGEX REPLACE "\\.c$" ".expected" expectedPath ${SCRIPT})
+file(READ ${expectedPath} expected)
+if(NOT result EQUAL 0 OR NOT actual STREQUAL expected)
+	message(FATAL_ERROR "${SCRIPT} gave\n${actual}${errors}instead of\n${expected}")
+endif()
@@ -0,0 +1,135 @@
+#include "picoc.h"
+#include "interpreter.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// cplot-interval-check: bounds main() over boxes of its two arguments with the interval evaluator,
+// then evaluates it at points inside each box and fails if any value falls outside its box's
+// bounds. main() is each of a few programs the bounds once got wrong, then random ones built from
+// the operators and math functions the vector evaluator handles
+
+namespace
+{
+	const char* const regressions[] =
+	{
+		"min(sqrt(x), 1.0) - y",
+		"-0.497 < pow(atan2(x, 0.24), -0.16) ? 1.0 : 2.0",
+		"atan2(0, (int)y)",
+		"max(log(x), y) + clamp(x, sqrt(y), 1.0)",
+		"(int)sqrt(x - 0.5) + ((asin(y) == asin(y)) ? 0.0 : 1.0)",
+	};
+
+	const int numProgram = 400;
+	const int numBox = 24;
+	const int numSample = 48;
+
+	// a random expression of x and y, depth operators deep at most
+	std::string expression(std::mt19937& random, int depth)
+	{
+		auto pick = [&](int count) { return (int)(random() % count); };
+		static const char* const constants[] = { "0.0", "1.0", "-1.0", "0.5", "2.0", "-0.497", "0.24", "3.0", "1e300", "0.0 / 0.0" };
+		if (depth == 0 || pick(4) == 0)
+		{
+			switch (pick(3))
+			{
+				case 0:  return "x";
+				case 1:  return "y";
+				default: return constants[pick(10)];
+			}
+		}
+
+		auto sub = [&]() { return expression(random, depth - 1); };
+		static const char* const infix[] = { " + ", " - ", " * ", " / ", " < ", " <= ", " == ", " != ", " && ", " || " };
+		static const char* const functions1[] = { "sqrt", "log", "exp", "sin", "cos", "tan", "asin", "acos", "atan", "fabs", "floor", "ceil", "round", "sgn", "tanh", "sinh", "cosh", "log10" };
+		static const char* const functions2[] = { "pow", "atan2", "min", "max", "fmod" };
+		switch (pick(7))
+		{
+			case 0:  return "(" + sub() + infix[pick(10)] + sub() + ")";
+			case 1:  return "(" + sub() + infix[pick(4)] + sub() + ")";
+			case 2:  return std::string(functions1[pick(18)]) + "(" + sub() + ")";
+			case 3:  return std::string(functions2[pick(5)]) + "(" + sub() + ", " + sub() + ")";
+			case 4:  return std::string(pick(2) ? "clamp(" : "lerp(") + sub() + ", " + sub() + ", " + sub() + ")";
+			case 5:  return "(" + sub() + " ? " + sub() + " : " + sub() + ")";
+			default: return std::string(pick(2) ? "(int)(" : (pick(2) ? "-(" : "!(")) + sub() + ")";
+		}
+	}
+
+	// the number of samples outside their bounds, printing the first of them
+	int check(const std::string& body, std::mt19937& random)
+	{
+		std::string source = "double main(double x, double y)\n{\n    return " + body + ";\n}\n";
+		std::vector<Tweakable> tweakables;
+		std::string errorBuffer;
+		double point[2] = { 0.0, 0.0 };
+		Picoc pc;
+		PicocInitialise(&pc, point, 2, source, tweakables, errorBuffer);
+		if (!errorBuffer.empty())
+		{
+			std::printf("%s doesn't compile: %s\n", body.c_str(), errorBuffer.c_str());
+			PicocCleanup(&pc);
+			return 1;
+		}
+
+		std::uniform_real_distribution<double> place(-3.0, 3.0);
+		std::uniform_real_distribution<double> size(0.0, 1.5);
+		std::vector<double> xLows(numBox), xHighs(numBox), yLows(numBox), yHighs(numBox), lows(numBox), highs(numBox);
+		for (int i = 0; i < numBox; i++)
+		{
+			xLows[i] = place(random);
+			xHighs[i] = xLows[i] + size(random);
+			yLows[i] = place(random);
+			yHighs[i] = yLows[i] + size(random);
+		}
+
+		int failures = 0;
+		if (PicocEvaluateInterval(pc, &yLows[0], &yHighs[0], &xLows[0], &xHighs[0], &lows[0], &highs[0], numBox))
+		{
+			// the corners, then points anywhere in the box
+			std::vector<double> xs(numSample), ys(numSample), values(numSample);
+			std::uniform_real_distribution<double> along(0.0, 1.0);
+			for (int i = 0; i < numBox; i++)
+			{
+				for (int j = 0; j < numSample; j++)
+				{
+					double u = j < 4 ? (j & 1) : along(random);
+					double v = j < 4 ? (j >> 1) : along(random);
+					xs[j] = xLows[i] + u * (xHighs[i] - xLows[i]);
+					ys[j] = yLows[i] + v * (yHighs[i] - yLows[i]);
+				}
+
+				if (!PicocEvaluatePoints(pc, &xs[0], &ys[0], &values[0], numSample))
+					break;
+
+				for (int j = 0; j < numSample; j++)
+				{
+					if (std::isnan(values[j]) || (values[j] >= lows[i] && values[j] <= highs[i]))
+						continue;
+
+					if (failures++ == 0)
+						std::printf("%s is %.17g at x = %.17g, y = %.17g, outside [%.17g, %.17g] over x in [%.17g, %.17g], y in [%.17g, %.17g]\n",
+							body.c_str(), values[j], xs[j], ys[j], lows[i], highs[i], xLows[i], xHighs[i], yLows[i], yHighs[i]);
+				}
+			}
+		}
+
+		PicocCleanup(&pc);
+		return failures;
+	}
+}
+
+int main()
+{
+	std::mt19937 random(20240601);
+	int failed = 0;
+	for (const char* body : regressions)
+		failed += check(body, random) != 0;
+
+	for (int i = 0; i < numProgram; i++)
+		failed += check(expression(random, 4), random) != 0;
+
+	std::printf("%d of %d programs had values outside their bounds\n", failed, numProgram + (int)(sizeof(regressions) / sizeof(regressions[0])));
+	return failed == 0 ? 0 : 1;
+}
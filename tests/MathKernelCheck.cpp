@@ -0,0 +1,126 @@
+#include "picoc.h"
+#include "interpreter.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+// cplot-math-check: runs the vector evaluator's sin, cos, exp, log and pow kernels on random
+// arguments in each of the ranges math.cpp documents an error for, and fails if any result is
+// further from the long double result than that many units in the last place
+
+namespace
+{
+	const int numBlock = 1 << 15;
+
+	// the kernels are found through MathNatives by the C library function they stand in for
+	const NativeFunction* native(double (*fp1)(double), double (*fp2)(double, double))
+	{
+		for (const LibraryNative* entry = MathNatives; entry->Func != NULL; entry++)
+		{
+			if ((fp1 != NULL && entry->Native.FP1 == fp1) || (fp2 != NULL && entry->Native.FP2 == fp2))
+				return &entry->Native;
+		}
+		return NULL;
+	}
+
+	// the error of value in units in the last place of the double nearest exact
+	double ulps(double value, long double exact)
+	{
+		double nearest = (double)exact;
+		if (std::isinf(nearest) || std::isnan(nearest) || std::isnan(value))
+			return value == nearest || (std::isnan(value) && std::isnan(nearest)) ? 0.0 : HUGE_VAL;
+
+		int exponent;
+		std::frexp(nearest == 0.0 ? DBL_MIN : nearest, &exponent);
+		double ulp = std::ldexp(1.0, std::max(exponent, DBL_MIN_EXP) - DBL_MANT_DIG);
+		return (double)(std::fabs((long double)value - exact) / ulp);
+	}
+
+	// the largest error of a one argument kernel over arguments drawn by argument
+	template<typename Draw> double worst1(const NativeFunction* function, long double (*exact)(long double), Draw argument, std::mt19937_64& random)
+	{
+		double args[VECTOR_LANES], results[VECTOR_LANES];
+		double worst = 0.0;
+		for (int block = 0; block < numBlock; block++)
+		{
+			for (int lane = 0; lane < VECTOR_LANES; lane++)
+				args[lane] = argument(random);
+
+			function->Vector1(results, args);
+			for (int lane = 0; lane < VECTOR_LANES; lane++)
+				worst = std::max(worst, ulps(results[lane], exact(args[lane])));
+		}
+		return worst;
+	}
+
+	// the same for pow, with bases drawn by base for each power
+	template<typename DrawPower, typename DrawBase> double worstPow(const NativeFunction* function, DrawPower power, DrawBase base, std::mt19937_64& random)
+	{
+		double bases[VECTOR_LANES], powers[VECTOR_LANES], results[VECTOR_LANES];
+		double worst = 0.0;
+		for (int block = 0; block < numBlock; block++)
+		{
+			for (int lane = 0; lane < VECTOR_LANES; lane++)
+			{
+				powers[lane] = power(random);
+				bases[lane] = base(random, powers[lane]);
+			}
+
+			function->Vector2(results, bases, powers);
+			for (int lane = 0; lane < VECTOR_LANES; lane++)
+				worst = std::max(worst, ulps(results[lane], powl(bases[lane], powers[lane])));
+		}
+		return worst;
+	}
+
+	int report(const char* name, const char* range, double worst, double bound)
+	{
+		std::printf("%-4s %-30s %8.3f ULP, documented %g\n", name, range, worst, bound);
+		return worst <= bound ? 0 : 1;
+	}
+}
+
+int main()
+{
+	const NativeFunction* sinNative = native(sin, NULL);
+	const NativeFunction* cosNative = native(cos, NULL);
+	const NativeFunction* expNative = native(exp, NULL);
+	const NativeFunction* logNative = native(log, NULL);
+	const NativeFunction* powNative = native(NULL, pow);
+	if (sinNative == NULL || sinNative->Vector1 == NULL || cosNative == NULL || cosNative->Vector1 == NULL || expNative == NULL || expNative->Vector1 == NULL ||
+		logNative == NULL || logNative->Vector1 == NULL || powNative == NULL || powNative->Vector2 == NULL)
+	{
+		std::printf("a vector kernel is missing from MathNatives\n");
+		return 1;
+	}
+
+	std::mt19937_64 random(20240601);
+	std::uniform_real_distribution<double> trig(-823549.0, 823549.0);
+	std::uniform_real_distribution<double> small(-8.0, 8.0);
+	std::uniform_real_distribution<double> exponent(-707.0, 707.0);
+	std::uniform_real_distribution<double> unit(0.0, 1.0);
+	std::uniform_int_distribution<unsigned long long> bits(0x0010000000000000ULL, 0x7fefffffffffffffULL);
+	auto normal = [&](std::mt19937_64& r) { unsigned long long b = bits(r); double x; std::memcpy(&x, &b, sizeof(x)); return x; };
+	auto near = [&](std::mt19937_64& r) { return std::exp(small(r)); };
+
+	int failed = 0;
+	failed += report("sin", "|x| < 823549", worst1(sinNative, sinl, [&](std::mt19937_64& r) { return trig(r); }, random), 0.78);
+	failed += report("sin", "|x| < 8", worst1(sinNative, sinl, [&](std::mt19937_64& r) { return small(r); }, random), 0.78);
+	failed += report("cos", "|x| < 823549", worst1(cosNative, cosl, [&](std::mt19937_64& r) { return trig(r); }, random), 0.78);
+	failed += report("cos", "|x| < 8", worst1(cosNative, cosl, [&](std::mt19937_64& r) { return small(r); }, random), 0.78);
+	failed += report("exp", "|x| <= 707", worst1(expNative, expl, [&](std::mt19937_64& r) { return exponent(r); }, random), 0.89);
+	failed += report("log", "all normal x > 0", worst1(logNative, logl, normal, random), 0.66);
+	failed += report("log", "0.0003 < x < 3000", worst1(logNative, logl, near, random), 0.66);
+
+	// bases for which |y ln(x)| <= 707, spread evenly in ln(x)
+	auto base = [&](std::mt19937_64& r, double y) { double limit = std::min(707.0 / std::fabs(y), 700.0); return std::exp((2.0 * unit(r) - 1.0) * limit); };
+	std::uniform_real_distribution<double> power16(-16.0, 16.0);
+	std::uniform_real_distribution<double> power1024(-1024.0, 1024.0);
+	failed += report("pow", "|y ln(x)| <= 707, |y| <= 16", worstPow(powNative, [&](std::mt19937_64& r) { return power16(r); }, base, random), 1.6);
+	failed += report("pow", "|y ln(x)| <= 707, |y| <= 1024", worstPow(powNative, [&](std::mt19937_64& r) { return power1024(r); }, base, random), 80.0);
+
+	return failed == 0 ? 0 : 1;
+}
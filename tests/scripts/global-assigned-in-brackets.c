@@ -0,0 +1,13 @@
+/* another function assigns to the global through brackets, so main can't fold it to 1 */
+double g = 1;
+
+void set(double v)
+{
+    (g) = v;
+}
+
+double main(double x)
+{
+    set(x);
+    return g;
+}
@@ -0,0 +1,13 @@
+/* another function increments the global through brackets, so main can't fold it to 1 */
+int g = 1;
+
+void inc()
+{
+    (g)++;
+}
+
+double main(double x)
+{
+    inc();
+    return g;
+}
@@ -0,0 +1,13 @@
+/* the same with a compound assignment through brackets */
+double g = 0;
+
+double f(double v)
+{
+    (g) += v;
+    return g;
+}
+
+double main(double x)
+{
+    return f(1) + f(1);
+}
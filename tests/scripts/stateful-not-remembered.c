@@ -0,0 +1,13 @@
+/* f keeps a running total in g, so each call gives a new result and can't be remembered */
+double g = 0;
+
+double f(double v)
+{
+    (g) = g + v;
+    return g;
+}
+
+double main(double x)
+{
+    return f(1) + f(1);
+}